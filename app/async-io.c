@@ -0,0 +1,564 @@
+// O_DIRECT is a GNU extension
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "async-io.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// io_uring is driven through the raw syscalls, so no liburing is needed;
+// without the kernel headers only the thread pool is built
+#if defined(__linux__) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#include <linux/io_uring.h>
+#define ASYNC_IO_HAVE_URING 1
+#endif
+
+struct AsyncIo
+{
+  AsyncIoBackend backend;
+  size_t depth;
+  size_t inFlight;
+  bool broken;
+
+  // io_uring
+  int ringFd;
+  void* sqRing;
+  size_t sqRingSize;
+  void* cqRing;
+  size_t cqRingSize;
+  void* sqes;
+  size_t sqesSize;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  void* cqes;
+  unsigned unsubmitted;
+
+  // Thread pool
+  pthread_t threads[ASYNC_IO_MAX_THREADS];
+  size_t threadCount;
+  pthread_mutex_t mutex;
+  pthread_cond_t queued;
+  pthread_cond_t completed;
+  AsyncIoRequest* queueHead;
+  AsyncIoRequest* queueTail;
+  AsyncIoRequest* doneHead;
+  bool stopping;
+};
+
+static AsyncIoBackend preferredAsyncIoBackend = ASYNC_IO_URING;
+
+void setAsyncIoBackend(AsyncIoBackend backend)
+{
+  preferredAsyncIoBackend = backend;
+}
+
+AsyncIoBackend getAsyncIoBackend(const AsyncIo* io)
+{
+  return io->backend;
+}
+
+const char* getAsyncIoBackendName(AsyncIoBackend backend)
+{
+  return backend == ASYNC_IO_URING ? "io_uring" : "thread";
+}
+
+size_t countAsyncIoInFlight(const AsyncIo* io)
+{
+  return io->inFlight;
+}
+
+#ifdef ASYNC_IO_HAVE_URING
+void unmapAsyncIoRing(AsyncIo* io)
+{
+  if (io->sqes != MAP_FAILED)
+    munmap(io->sqes, io->sqesSize);
+  if (io->cqRing != MAP_FAILED && io->cqRing != io->sqRing)
+    munmap(io->cqRing, io->cqRingSize);
+  if (io->sqRing != MAP_FAILED)
+    munmap(io->sqRing, io->sqRingSize);
+  close(io->ringFd);
+}
+
+bool setupAsyncIoRing(AsyncIo* io)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = (int)syscall(__NR_io_uring_setup, (unsigned)io->depth, &params);
+  if (fd < 0)
+    return false;
+
+  // IORING_OP_READ and IORING_OP_WRITE arrived together with this feature
+  if (!(params.features & IORING_FEAT_RW_CUR_POS))
+  {
+    close(fd);
+    return false;
+  }
+
+  io->ringFd = fd;
+  io->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  io->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  io->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (io->cqRingSize > io->sqRingSize)
+      io->sqRingSize = io->cqRingSize;
+    io->cqRingSize = io->sqRingSize;
+  }
+
+  io->sqRing = mmap(NULL, io->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  io->cqRing = MAP_FAILED;
+  io->sqes = MAP_FAILED;
+  if (io->sqRing != MAP_FAILED)
+  {
+    io->cqRing = (params.features & IORING_FEAT_SINGLE_MMAP)
+                     ? io->sqRing
+                     : mmap(NULL, io->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  }
+  if (io->cqRing != MAP_FAILED)
+    io->sqes = mmap(NULL, io->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (io->sqes == MAP_FAILED)
+  {
+    unmapAsyncIoRing(io);
+    return false;
+  }
+
+  char* sq = (char*)io->sqRing;
+  char* cq = (char*)io->cqRing;
+  io->sqTail = (unsigned*)(sq + params.sq_off.tail);
+  io->sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+  io->sqArray = (unsigned*)(sq + params.sq_off.array);
+  io->cqHead = (unsigned*)(cq + params.cq_off.head);
+  io->cqTail = (unsigned*)(cq + params.cq_off.tail);
+  io->cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+  io->cqes = cq + params.cq_off.cqes;
+  io->unsubmitted = 0;
+
+  // The kernel may round the ring up, but never below the requested depth
+  return true;
+}
+
+void submitAsyncIoRing(AsyncIo* io, AsyncIoRequest* request)
+{
+  // Only this thread writes the tail, the kernel only reads it
+  unsigned tail = *io->sqTail;
+  unsigned index = tail & *io->sqMask;
+  struct io_uring_sqe* sqe = (struct io_uring_sqe*)io->sqes + index;
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = request->fd;
+  sqe->addr = (uint64_t)(uintptr_t)request->buffer;
+  sqe->len = (uint32_t)request->size;
+  sqe->off = request->offset;
+  sqe->user_data = (uint64_t)(uintptr_t)request;
+  io->sqArray[index] = index;
+  __atomic_store_n(io->sqTail, tail + 1, __ATOMIC_RELEASE);
+  io->unsubmitted++;
+}
+
+AsyncIoRequest* waitAsyncIoRing(AsyncIo* io)
+{
+  for (;;)
+  {
+    unsigned head = *io->cqHead;
+    if (head != __atomic_load_n(io->cqTail, __ATOMIC_ACQUIRE))
+    {
+      struct io_uring_cqe* cqe = (struct io_uring_cqe*)io->cqes + (head & *io->cqMask);
+      AsyncIoRequest* request = (AsyncIoRequest*)(uintptr_t)cqe->user_data;
+      request->result = cqe->res;
+      __atomic_store_n(io->cqHead, head + 1, __ATOMIC_RELEASE);
+      return request;
+    }
+
+    // Everything queued since the last call is handed over with the wait
+    long submitted = syscall(__NR_io_uring_enter, io->ringFd, io->unsubmitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (submitted < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+        continue;
+      return NULL;
+    }
+    io->unsubmitted -= (unsigned)submitted;
+  }
+}
+#endif
+
+long transferAsyncIoRequest(AsyncIoRequest* request)
+{
+  // Unlike a single io_uring request, short transfers are retried here
+  size_t done = 0;
+  while (done < request->size)
+  {
+    char* buffer = (char*)request->buffer + done;
+    ssize_t n = request->write
+                    ? pwrite(request->fd, buffer, request->size - done, (off_t)(request->offset + done))
+                    : pread(request->fd, buffer, request->size - done, (off_t)(request->offset + done));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return done > 0 ? (long)done : -errno;
+    if (n == 0)
+      break;
+    done += (size_t)n;
+  }
+  return (long)done;
+}
+
+static void* runAsyncIoWorker(void* arg)
+{
+  AsyncIo* io = (AsyncIo*)arg;
+  pthread_mutex_lock(&io->mutex);
+  for (;;)
+  {
+    while (!io->queueHead && !io->stopping)
+      pthread_cond_wait(&io->queued, &io->mutex);
+    if (!io->queueHead)
+      break;
+
+    AsyncIoRequest* request = io->queueHead;
+    io->queueHead = request->next;
+    if (!io->queueHead)
+      io->queueTail = NULL;
+    pthread_mutex_unlock(&io->mutex);
+
+    request->result = transferAsyncIoRequest(request);
+
+    pthread_mutex_lock(&io->mutex);
+    request->next = io->doneHead;
+    io->doneHead = request;
+    pthread_cond_signal(&io->completed);
+  }
+  pthread_mutex_unlock(&io->mutex);
+  return NULL;
+}
+
+bool startAsyncIoThreads(AsyncIo* io)
+{
+  pthread_mutex_init(&io->mutex, NULL);
+  pthread_cond_init(&io->queued, NULL);
+  pthread_cond_init(&io->completed, NULL);
+  io->queueHead = NULL;
+  io->queueTail = NULL;
+  io->doneHead = NULL;
+  io->stopping = false;
+
+  size_t threadCount = io->depth < ASYNC_IO_MAX_THREADS ? io->depth : ASYNC_IO_MAX_THREADS;
+  for (io->threadCount = 0; io->threadCount < threadCount; io->threadCount++)
+  {
+    if (pthread_create(&io->threads[io->threadCount], NULL, runAsyncIoWorker, io) != 0)
+      break;
+  }
+  return io->threadCount > 0;
+}
+
+void stopAsyncIoThreads(AsyncIo* io)
+{
+  pthread_mutex_lock(&io->mutex);
+  io->stopping = true;
+  pthread_cond_broadcast(&io->queued);
+  pthread_mutex_unlock(&io->mutex);
+
+  for (size_t i = 0; i < io->threadCount; i++)
+    pthread_join(io->threads[i], NULL);
+  pthread_cond_destroy(&io->completed);
+  pthread_cond_destroy(&io->queued);
+  pthread_mutex_destroy(&io->mutex);
+}
+
+AsyncIo* createAsyncIo(size_t depth)
+{
+  AsyncIo* io = (AsyncIo*)malloc(sizeof(AsyncIo));
+  memset(io, 0, sizeof(AsyncIo));
+  io->depth = depth > 0 ? depth : 1;
+
+#ifdef ASYNC_IO_HAVE_URING
+  if (preferredAsyncIoBackend == ASYNC_IO_URING && setupAsyncIoRing(io))
+  {
+    io->backend = ASYNC_IO_URING;
+    return io;
+  }
+#endif
+
+  io->backend = ASYNC_IO_THREADS;
+  if (!startAsyncIoThreads(io))
+  {
+    stopAsyncIoThreads(io);
+    free(io);
+    return NULL;
+  }
+  return io;
+}
+
+static pthread_key_t threadAsyncIoKey;
+static pthread_once_t threadAsyncIoOnce = PTHREAD_ONCE_INIT;
+
+static void destroyThreadAsyncIo(void* io)
+{
+  destroyAsyncIo((AsyncIo*)io);
+}
+
+static void createThreadAsyncIoKey()
+{
+  pthread_key_create(&threadAsyncIoKey, destroyThreadAsyncIo);
+}
+
+AsyncIo* getThreadAsyncIo()
+{
+  pthread_once(&threadAsyncIoOnce, createThreadAsyncIoKey);
+  AsyncIo* io = (AsyncIo*)pthread_getspecific(threadAsyncIoKey);
+  if (!io)
+  {
+    io = createAsyncIo(ASYNC_IO_THREAD_DEPTH);
+    if (io)
+      pthread_setspecific(threadAsyncIoKey, io);
+  }
+  return io;
+}
+
+void destroyAsyncIo(AsyncIo* io)
+{
+  // Buffers of requests still in flight belong to the caller, so they are
+  // waited for before the queue goes away
+  while (io->inFlight > 0 && waitAsyncIo(io))
+    ;
+
+#ifdef ASYNC_IO_HAVE_URING
+  if (io->backend == ASYNC_IO_URING)
+    unmapAsyncIoRing(io);
+#endif
+  if (io->backend == ASYNC_IO_THREADS)
+    stopAsyncIoThreads(io);
+  free(io);
+}
+
+bool submitAsyncIo(AsyncIo* io, AsyncIoRequest* request)
+{
+  if (io->inFlight >= io->depth || io->broken)
+    return false;
+  io->inFlight++;
+  request->result = 0;
+  request->done = false;
+  request->next = NULL;
+
+#ifdef ASYNC_IO_HAVE_URING
+  if (io->backend == ASYNC_IO_URING)
+  {
+    submitAsyncIoRing(io, request);
+    return true;
+  }
+#endif
+
+  pthread_mutex_lock(&io->mutex);
+  if (io->queueTail)
+    io->queueTail->next = request;
+  else
+    io->queueHead = request;
+  io->queueTail = request;
+  pthread_cond_signal(&io->queued);
+  pthread_mutex_unlock(&io->mutex);
+  return true;
+}
+
+AsyncIoRequest* waitAsyncIo(AsyncIo* io)
+{
+  if (io->inFlight == 0 || io->broken)
+    return NULL;
+
+  AsyncIoRequest* request = NULL;
+#ifdef ASYNC_IO_HAVE_URING
+  if (io->backend == ASYNC_IO_URING)
+  {
+    request = waitAsyncIoRing(io);
+    if (!request)
+      io->broken = true;
+  }
+#endif
+
+  if (io->backend == ASYNC_IO_THREADS)
+  {
+    pthread_mutex_lock(&io->mutex);
+    while (!io->doneHead)
+      pthread_cond_wait(&io->completed, &io->mutex);
+    request = io->doneHead;
+    io->doneHead = request->next;
+    pthread_mutex_unlock(&io->mutex);
+  }
+
+  if (request)
+  {
+    io->inFlight--;
+    request->done = true;
+  }
+  return request;
+}
+
+bool waitAsyncIoRequest(AsyncIo* io, AsyncIoRequest* request)
+{
+  while (!request->done)
+  {
+    if (!waitAsyncIo(io))
+      return false;
+  }
+  return true;
+}
+
+void startAsyncIo(AsyncIo* io)
+{
+#ifdef ASYNC_IO_HAVE_URING
+  // A failed enter is left to the next wait, which reports it
+  if (io->backend == ASYNC_IO_URING && io->unsubmitted > 0 && !io->broken)
+  {
+    long submitted = syscall(__NR_io_uring_enter, io->ringFd, io->unsubmitted, 0, 0, NULL, 0);
+    if (submitted > 0)
+      io->unsubmitted -= (unsigned)submitted;
+  }
+#else
+  (void)io;
+#endif
+}
+
+void openAsyncIoWriter(AsyncIoWriter* writer, int fd, uint64_t offset, size_t bufferSize)
+{
+  writer->io = getThreadAsyncIo();
+  writer->fd = fd;
+  writer->offset = offset;
+  writer->bufferSize = bufferSize > 0 ? bufferSize : ASYNC_IO_WRITER_BUFFER_SIZE;
+  writer->current = 0;
+  writer->size = 0;
+  writer->failed = false;
+  for (size_t i = 0; i < ASYNC_IO_WRITER_BUFFERS; i++)
+  {
+    writer->buffers[i] = (char*)malloc(writer->bufferSize);
+    writer->pending[i] = false;
+    if (!writer->buffers[i])
+      writer->failed = true;
+  }
+}
+
+bool waitAsyncIoWriterBuffer(AsyncIoWriter* writer, size_t index)
+{
+  AsyncIoRequest* request = &writer->requests[index];
+  while (writer->pending[index])
+  {
+    writer->pending[index] = false;
+    if (!waitAsyncIoRequest(writer->io, request) || request->result <= 0)
+    {
+      writer->failed = true;
+    }
+    else if ((size_t)request->result < request->size)
+    {
+      // A short write is not an error for the kernel, so the rest is sent again
+      request->buffer = (char*)request->buffer + request->result;
+      request->size -= (size_t)request->result;
+      request->offset += (uint64_t)request->result;
+      if (submitAsyncIo(writer->io, request))
+        writer->pending[index] = true;
+      else if (transferAsyncIoRequest(request) != (long)request->size)
+        writer->failed = true;
+    }
+  }
+  return !writer->failed;
+}
+
+void submitAsyncIoWriterBuffer(AsyncIoWriter* writer)
+{
+  size_t index = writer->current;
+  AsyncIoRequest* request = &writer->requests[index];
+  request->fd = writer->fd;
+  request->write = true;
+  request->buffer = writer->buffers[index];
+  request->size = writer->size;
+  request->offset = writer->offset;
+  request->context = writer;
+
+  if (writer->io && submitAsyncIo(writer->io, request))
+  {
+    writer->pending[index] = true;
+    startAsyncIo(writer->io);
+  }
+  else if (transferAsyncIoRequest(request) != (long)writer->size)
+  {
+    writer->failed = true;
+  }
+
+  writer->offset += writer->size;
+  writer->size = 0;
+  writer->current = (index + 1) % ASYNC_IO_WRITER_BUFFERS;
+}
+
+bool writeAsyncIoWriter(AsyncIoWriter* writer, const void* data, size_t size)
+{
+  const char* bytes = (const char*)data;
+  while (size > 0 && !writer->failed)
+  {
+    // The buffer about to be filled may still be in flight from two rounds ago
+    if (writer->size == 0 && !waitAsyncIoWriterBuffer(writer, writer->current))
+      break;
+
+    size_t take = writer->bufferSize - writer->size;
+    if (take > size)
+      take = size;
+    memcpy(writer->buffers[writer->current] + writer->size, bytes, take);
+    writer->size += take;
+    bytes += take;
+    size -= take;
+    if (writer->size == writer->bufferSize)
+      submitAsyncIoWriterBuffer(writer);
+  }
+  return !writer->failed;
+}
+
+uint64_t getAsyncIoWriterOffset(const AsyncIoWriter* writer)
+{
+  return writer->offset + writer->size;
+}
+
+bool closeAsyncIoWriter(AsyncIoWriter* writer)
+{
+  if (writer->size > 0 && !writer->failed)
+    submitAsyncIoWriterBuffer(writer);
+  for (size_t i = 0; i < ASYNC_IO_WRITER_BUFFERS; i++)
+  {
+    waitAsyncIoWriterBuffer(writer, i);
+    free(writer->buffers[i]);
+  }
+  return !writer->failed;
+}
+
+int openDirectDescriptor(int fd)
+{
+  // The path of the descriptor is used so that any open file can be reused
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+  int directFd = open(path, O_RDONLY | O_DIRECT | O_CLOEXEC);
+  if (directFd < 0)
+    return -1;
+
+  // Some file systems accept the flag and only reject the reads
+  void* probe = NULL;
+  if (posix_memalign(&probe, ASYNC_IO_DIRECT_ALIGNMENT, ASYNC_IO_DIRECT_ALIGNMENT) != 0)
+    probe = NULL;
+  bool readable = probe && pread(directFd, probe, ASYNC_IO_DIRECT_ALIGNMENT, 0) >= 0;
+  free(probe);
+  if (!readable)
+  {
+    close(directFd);
+    return -1;
+  }
+  return directFd;
+}
+
+void closeDirectDescriptor(int fd)
+{
+  close(fd);
+}
@@ -0,0 +1,299 @@
+/**
+ * @file async-io.h
+ * @brief Letture e scritture asincrone su file.
+ *
+ * Le richieste vengono inviate al kernel con io_uring, così più letture
+ * possono essere in corso nello stesso momento senza un thread per
+ * ciascuna. Se io_uring non è disponibile (kernel vecchio, syscall
+ * bloccata o disattivata) le stesse richieste vengono eseguite con
+ * pread/pwrite da un gruppo di thread. Chi usa questo modulo non vede la
+ * differenza: invia le richieste e ne attende il completamento, in un
+ * ordine qualsiasi.
+ *
+ * Ogni thread ha una sua coda (getThreadAsyncIo), creata al primo uso e
+ * condivisa da tutte le letture e scritture di quel thread: più utenti
+ * possono averci richieste in corso nello stesso momento, se ognuno
+ * attende le proprie con waitAsyncIoRequest. Un AsyncIo va usato da un
+ * solo thread alla volta.
+ */
+
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Numero massimo di thread del gruppo usato senza io_uring.
+ */
+#define ASYNC_IO_MAX_THREADS 16
+
+/**
+ * @brief Allineamento richiesto da buffer, posizioni e dimensioni delle
+ *        letture su un descrittore aperto con openDirectDescriptor.
+ */
+#define ASYNC_IO_DIRECT_ALIGNMENT 4096
+
+/**
+ * @brief Numero massimo di richieste in corso nella coda di un thread.
+ */
+#define ASYNC_IO_THREAD_DEPTH 128
+
+/**
+ * @brief Dimensione predefinita di ciascuno dei due buffer di un
+ *        AsyncIoWriter.
+ */
+#define ASYNC_IO_WRITER_BUFFER_SIZE (1 << 20)
+
+/**
+ * @brief Numero di buffer di un AsyncIoWriter: mentre uno viene scritto,
+ *        l'altro si riempie.
+ */
+#define ASYNC_IO_WRITER_BUFFERS 2
+
+/**
+ * @enum AsyncIoBackend
+ * @brief Meccanismo con cui vengono eseguite le richieste.
+ */
+typedef enum AsyncIoBackend
+{
+  ASYNC_IO_URING = 1,
+  ASYNC_IO_THREADS
+} AsyncIoBackend;
+
+/**
+ * @struct AsyncIoRequest
+ * @brief Lettura o scrittura da eseguire; appartiene a chi la invia e deve
+ *        restare valida finché non viene restituita da waitAsyncIo.
+ *
+ * @var fd
+ * Descrittore del file.
+ * @var write
+ * true per una scrittura, false per una lettura.
+ * @var buffer
+ * Memoria da cui scrivere o in cui leggere.
+ * @var size
+ * Numero di byte da trasferire.
+ * @var offset
+ * Posizione nel file.
+ * @var result
+ * Byte trasferiti, oppure -errno in caso di errore.
+ * @var context
+ * Dato libero di chi invia la richiesta.
+ * @var done
+ * true quando la richiesta è stata restituita da waitAsyncIo.
+ * @var next
+ * Uso interno.
+ */
+typedef struct AsyncIoRequest
+{
+  int fd;
+  bool write;
+  void* buffer;
+  size_t size;
+  uint64_t offset;
+  long result;
+  void* context;
+  bool done;
+  struct AsyncIoRequest* next;
+} AsyncIoRequest;
+
+/**
+ * @brief Coda di richieste asincrone.
+ */
+typedef struct AsyncIo AsyncIo;
+
+/**
+ * @brief Sceglie il meccanismo usato dalle code create da ora in poi.
+ *
+ * Con ASYNC_IO_URING (predefinito) si prova io_uring e si ripiega sui
+ * thread se non è disponibile; con ASYNC_IO_THREADS si usano sempre i
+ * thread.
+ *
+ * @param backend Meccanismo preferito.
+ */
+void setAsyncIoBackend(AsyncIoBackend backend);
+
+/**
+ * @brief Crea una coda di richieste.
+ * @param depth Numero massimo di richieste in corso contemporaneamente.
+ * @return Puntatore alla coda, NULL in caso di errore.
+ */
+AsyncIo* createAsyncIo(size_t depth);
+
+/**
+ * @brief Chiude una coda dopo averne atteso le richieste in corso.
+ * @param io Puntatore alla coda.
+ */
+void destroyAsyncIo(AsyncIo* io);
+
+/**
+ * @brief Restituisce la coda del thread chiamante.
+ *
+ * La coda viene creata al primo uso, con profondità ASYNC_IO_THREAD_DEPTH
+ * e il meccanismo scelto in quel momento, e viene chiusa quando il thread
+ * termina.
+ *
+ * @return Puntatore alla coda, NULL se non può essere creata.
+ */
+AsyncIo* getThreadAsyncIo();
+
+/**
+ * @brief Restituisce il meccanismo usato da una coda.
+ * @param io Puntatore alla coda.
+ */
+AsyncIoBackend getAsyncIoBackend(const AsyncIo* io);
+
+/**
+ * @brief Restituisce il nome di un meccanismo ("io_uring" o "thread").
+ * @param backend Meccanismo.
+ */
+const char* getAsyncIoBackendName(AsyncIoBackend backend);
+
+/**
+ * @brief Restituisce il numero di richieste inviate e non ancora
+ *        restituite da waitAsyncIo.
+ * @param io Puntatore alla coda.
+ */
+size_t countAsyncIoInFlight(const AsyncIo* io);
+
+/**
+ * @brief Invia una richiesta.
+ *
+ * Con io_uring le richieste inviate una dopo l'altra partono insieme con
+ * una sola syscall alla chiamata successiva di waitAsyncIo.
+ *
+ * @param io Puntatore alla coda.
+ * @param request Richiesta da eseguire.
+ * @return false se la coda è piena.
+ */
+bool submitAsyncIo(AsyncIo* io, AsyncIoRequest* request);
+
+/**
+ * @brief Fa partire subito le richieste inviate, senza attenderne il
+ *        completamento.
+ *
+ * Serve a chi invia una richiesta e nel frattempo lavora, come chi scrive
+ * un buffer mentre riempie il successivo.
+ *
+ * @param io Puntatore alla coda.
+ */
+void startAsyncIo(AsyncIo* io);
+
+/**
+ * @brief Attende il completamento di una richiesta qualsiasi.
+ * @param io Puntatore alla coda.
+ * @return La richiesta completata, con `result` impostato; NULL se non ci
+ *         sono richieste in corso o se la coda non funziona più.
+ */
+AsyncIoRequest* waitAsyncIo(AsyncIo* io);
+
+/**
+ * @brief Attende il completamento di una certa richiesta.
+ *
+ * Le richieste di altri utenti della coda completate nel frattempo vengono
+ * solo segnate come terminate (`done`).
+ *
+ * @param io Puntatore alla coda.
+ * @param request Richiesta inviata su `io`.
+ * @return false se la coda non funziona più.
+ */
+bool waitAsyncIoRequest(AsyncIo* io, AsyncIoRequest* request);
+
+/**
+ * @struct AsyncIoWriter
+ * @brief Scrittura sequenziale di un file a buffer grandi.
+ *
+ * I dati vengono copiati in un buffer; quando è pieno la sua scrittura
+ * parte sulla coda del thread e i dati successivi vanno nell'altro buffer,
+ * così la preparazione dei dati e la scrittura si sovrappongono. Senza
+ * coda i buffer vengono scritti con pwrite.
+ *
+ * @var io
+ * Coda delle scritture, NULL se si scrive con pwrite.
+ * @var fd
+ * Descrittore del file.
+ * @var offset
+ * Posizione nel file del buffer corrente.
+ * @var bufferSize
+ * Dimensione di ciascun buffer.
+ * @var buffers
+ * Buffer dei dati.
+ * @var requests
+ * Scritture dei buffer.
+ * @var pending
+ * Per ogni buffer, true se la sua scrittura è in corso.
+ * @var current
+ * Buffer che si sta riempiendo.
+ * @var size
+ * Byte nel buffer corrente.
+ * @var failed
+ * true se una scrittura non è riuscita.
+ */
+typedef struct AsyncIoWriter
+{
+  AsyncIo* io;
+  int fd;
+  uint64_t offset;
+  size_t bufferSize;
+  char* buffers[ASYNC_IO_WRITER_BUFFERS];
+  AsyncIoRequest requests[ASYNC_IO_WRITER_BUFFERS];
+  bool pending[ASYNC_IO_WRITER_BUFFERS];
+  size_t current;
+  size_t size;
+  bool failed;
+} AsyncIoWriter;
+
+/**
+ * @brief Inizia la scrittura sequenziale di un file.
+ *
+ * Finché lo scrittore è aperto il file non va scritto in altri modi.
+ *
+ * @param writer Scrittore da inizializzare.
+ * @param fd Descrittore del file.
+ * @param offset Posizione da cui scrivere.
+ * @param bufferSize Dimensione di ciascun buffer (0 per
+ *                   ASYNC_IO_WRITER_BUFFER_SIZE).
+ */
+void openAsyncIoWriter(AsyncIoWriter* writer, int fd, uint64_t offset, size_t bufferSize);
+
+/**
+ * @brief Aggiunge dati al file.
+ * @param writer Scrittore aperto.
+ * @param data Dati da scrivere.
+ * @param size Numero di byte.
+ * @return false se una scrittura non è riuscita.
+ */
+bool writeAsyncIoWriter(AsyncIoWriter* writer, const void* data, size_t size);
+
+/**
+ * @brief Restituisce la posizione nel file del prossimo byte scritto.
+ * @param writer Scrittore aperto.
+ */
+uint64_t getAsyncIoWriterOffset(const AsyncIoWriter* writer);
+
+/**
+ * @brief Scrive i dati rimasti, attende tutte le scritture e libera lo
+ *        scrittore.
+ * @param writer Scrittore aperto.
+ * @return false se una scrittura non è riuscita.
+ */
+bool closeAsyncIoWriter(AsyncIoWriter* writer);
+
+/**
+ * @brief Apre di nuovo in sola lettura, con O_DIRECT, il file di un
+ *        descrittore; le letture dal nuovo descrittore non passano dalla
+ *        cache del kernel e non la riempiono.
+ * @param fd Descrittore del file.
+ * @return Nuovo descrittore, -1 se il file system non supporta O_DIRECT.
+ */
+int openDirectDescriptor(int fd);
+
+/**
+ * @brief Chiude un descrittore aperto con openDirectDescriptor.
+ * @param fd Descrittore da chiudere.
+ */
+void closeDirectDescriptor(int fd);
+
+#endif // ASYNC_IO_H
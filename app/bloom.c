@@ -0,0 +1,110 @@
+#include "bloom.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void initBloomFilter(BloomFilter* filter, size_t expectedItems, double falsePositiveRate)
+{
+  if (expectedItems == 0)
+    expectedItems = 1;
+  if (falsePositiveRate <= 0.0 || falsePositiveRate >= 1.0)
+    falsePositiveRate = 0.01;
+
+  // Optimal sizes: m = -n ln p / (ln 2)^2 and k = m / n ln 2
+  const double ln2 = 0.69314718055994530942;
+  double bits = -(double)expectedItems * log(falsePositiveRate) / (ln2 * ln2);
+  size_t words = (size_t)(bits / 64.0) + 1;
+  size_t hashCount = (size_t)(bits / expectedItems * ln2 + 0.5);
+
+  filter->bitCount = words * 64;
+  filter->hashCount = hashCount > 0 ? hashCount : 1;
+  filter->itemCount = 0;
+  filter->bits = (uint64_t*)calloc(words, sizeof(uint64_t));
+}
+
+void freeBloomFilter(BloomFilter* filter)
+{
+  free(filter->bits);
+  filter->bits = NULL;
+}
+
+uint64_t hashBloomKey(const void* key, size_t size)
+{
+  // FNV-1a followed by a finalizer so both halves are usable as hashes
+  const unsigned char* bytes = (const unsigned char*)key;
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+void addToBloomFilter(BloomFilter* filter, const void* key, size_t size)
+{
+  // The k positions come from two hashes (h1 + i * h2) instead of k hash functions
+  uint64_t hash = hashBloomKey(key, size);
+  uint64_t h1 = hash & 0xffffffffu;
+  uint64_t h2 = (hash >> 32) | 1;
+  for (size_t i = 0; i < filter->hashCount; i++)
+  {
+    size_t bit = (size_t)((h1 + i * h2) % filter->bitCount);
+    filter->bits[bit / 64] |= (uint64_t)1 << (bit % 64);
+  }
+  filter->itemCount++;
+}
+
+bool mayContainBloomFilter(const BloomFilter* filter, const void* key, size_t size)
+{
+  uint64_t hash = hashBloomKey(key, size);
+  uint64_t h1 = hash & 0xffffffffu;
+  uint64_t h2 = (hash >> 32) | 1;
+  for (size_t i = 0; i < filter->hashCount; i++)
+  {
+    size_t bit = (size_t)((h1 + i * h2) % filter->bitCount);
+    if (!(filter->bits[bit / 64] & ((uint64_t)1 << (bit % 64))))
+      return false;
+  }
+  return true;
+}
+
+double estimateBloomFilterFalsePositiveRate(const BloomFilter* filter)
+{
+  size_t setBits = 0;
+  for (size_t i = 0; i < filter->bitCount / 64; i++)
+    setBits += __builtin_popcountll(filter->bits[i]);
+
+  return pow((double)setBits / filter->bitCount, (double)filter->hashCount);
+}
+
+bool writeBloomFilter(const BloomFilter* filter, FILE* fp)
+{
+  uint64_t header[3] = {filter->bitCount, filter->hashCount, filter->itemCount};
+  return fwrite(header, sizeof(uint64_t), 3, fp) == 3 &&
+         fwrite(filter->bits, sizeof(uint64_t), filter->bitCount / 64, fp) == filter->bitCount / 64;
+}
+
+bool readBloomFilter(BloomFilter* filter, FILE* fp)
+{
+  uint64_t header[3];
+  if (fread(header, sizeof(uint64_t), 3, fp) != 3 || header[0] == 0 || header[0] % 64 != 0 || header[1] == 0)
+    return false;
+
+  filter->bitCount = header[0];
+  filter->hashCount = header[1];
+  filter->itemCount = header[2];
+  filter->bits = (uint64_t*)malloc(filter->bitCount / 8);
+  if (fread(filter->bits, sizeof(uint64_t), filter->bitCount / 64, fp) != filter->bitCount / 64)
+  {
+    freeBloomFilter(filter);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file bloom.h
+ * @brief Filtro di Bloom su chiavi binarie.
+ *
+ * Un filtro di Bloom risponde "sicuramente assente" oppure "forse
+ * presente": non ha falsi negativi, mentre la probabilità di falsi
+ * positivi dipende dal numero di bit per chiave.
+ */
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @struct BloomFilter
+ * @brief Filtro di Bloom.
+ *
+ * @var bits
+ * Array di bit, in parole da 64 bit.
+ * @var bitCount
+ * Numero di bit del filtro (multiplo di 64).
+ * @var hashCount
+ * Numero di funzioni hash per chiave.
+ * @var itemCount
+ * Numero di chiavi inserite.
+ */
+typedef struct BloomFilter
+{
+  uint64_t* bits;
+  size_t bitCount;
+  size_t hashCount;
+  size_t itemCount;
+} BloomFilter;
+
+/**
+ * @brief Inizializza un filtro vuoto dimensionato per un numero di chiavi.
+ *
+ * @param filter Puntatore al filtro.
+ * @param expectedItems Numero di chiavi previste.
+ * @param falsePositiveRate Probabilità di falsi positivi desiderata
+ *                          (tra 0 e 1, esclusi).
+ */
+void initBloomFilter(BloomFilter* filter, size_t expectedItems, double falsePositiveRate);
+
+/**
+ * @brief Libera la memoria del filtro.
+ *
+ * @param filter Puntatore al filtro.
+ */
+void freeBloomFilter(BloomFilter* filter);
+
+/**
+ * @brief Inserisce una chiave nel filtro.
+ *
+ * @param filter Puntatore al filtro.
+ * @param key Byte della chiave.
+ * @param size Numero di byte della chiave.
+ */
+void addToBloomFilter(BloomFilter* filter, const void* key, size_t size);
+
+/**
+ * @brief Verifica se una chiave può essere presente nel filtro.
+ *
+ * @param filter Puntatore al filtro.
+ * @param key Byte della chiave.
+ * @param size Numero di byte della chiave.
+ * @return false se la chiave è sicuramente assente, true se può esserci.
+ */
+bool mayContainBloomFilter(const BloomFilter* filter, const void* key, size_t size);
+
+/**
+ * @brief Stima la probabilità di falsi positivi dai bit impostati.
+ *
+ * @param filter Puntatore al filtro.
+ * @return Probabilità stimata di falsi positivi.
+ */
+double estimateBloomFilterFalsePositiveRate(const BloomFilter* filter);
+
+/**
+ * @brief Scrive il filtro su file alla posizione corrente.
+ *
+ * @return true se la scrittura ha avuto successo.
+ */
+bool writeBloomFilter(const BloomFilter* filter, FILE* fp);
+
+/**
+ * @brief Legge un filtro scritto con writeBloomFilter.
+ *
+ * @return true se la lettura ha avuto successo; in caso di errore il
+ *         filtro non deve essere usato né liberato.
+ */
+bool readBloomFilter(BloomFilter* filter, FILE* fp);
+
+#endif // BLOOM_H
@@ -0,0 +1,364 @@
+#include "compress.h"
+#include <stdint.h>
+#include <string.h>
+
+#define COMPRESS_HASH_BITS 14
+#define COMPRESS_MIN_MATCH 4
+#define COMPRESS_MAX_OFFSET 65535
+
+#define COMPRESSED_STREAM_MAGIC "PLZS"
+#define COMPRESSED_STREAM_VERSION 1
+
+typedef struct CompressedStreamHeader
+{
+  char magic[4];
+  uint32_t version;
+} CompressedStreamHeader;
+
+// A frame is stored raw when compressing doesn't make it smaller, the end of
+// the stream is a frame with no data
+typedef struct CompressedFrameHeader
+{
+  uint32_t rawSize;
+  uint32_t storedSize;
+} CompressedFrameHeader;
+
+uint32_t readCompressWord(const unsigned char* p)
+{
+  uint32_t word;
+  memcpy(&word, p, sizeof(uint32_t));
+  return word;
+}
+
+uint32_t hashCompressWord(uint32_t word)
+{
+  return (word * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
+
+// Lengths that don't fit in the token nibble continue in bytes of up to 255
+bool writeCompressLength(unsigned char** out, const unsigned char* end, size_t length)
+{
+  while (length >= 255)
+  {
+    if (*out >= end)
+      return false;
+    *(*out)++ = 255;
+    length -= 255;
+  }
+  if (*out >= end)
+    return false;
+  *(*out)++ = (unsigned char)length;
+  return true;
+}
+
+bool readCompressLength(const unsigned char** in, const unsigned char* end, size_t* length)
+{
+  unsigned char byte;
+  do
+  {
+    if (*in >= end)
+      return false;
+    byte = *(*in)++;
+    *length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// The last sequence of a block has literals only (offset 0)
+bool writeCompressSequence(unsigned char** out, const unsigned char* end, const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+  unsigned char* p = *out;
+  if (p >= end)
+    return false;
+
+  unsigned char* token = p++;
+  *token = (unsigned char)((literalLength >= 15 ? 15 : literalLength) << 4);
+  if (literalLength >= 15 && !writeCompressLength(&p, end, literalLength - 15))
+    return false;
+  if ((size_t)(end - p) < literalLength)
+    return false;
+  memcpy(p, literals, literalLength);
+  p += literalLength;
+
+  if (offset > 0)
+  {
+    size_t extra = matchLength - COMPRESS_MIN_MATCH;
+    *token |= (unsigned char)(extra >= 15 ? 15 : extra);
+    if (end - p < 2)
+      return false;
+    *p++ = (unsigned char)(offset & 0xff);
+    *p++ = (unsigned char)(offset >> 8);
+    if (extra >= 15 && !writeCompressLength(&p, end, extra - 15))
+      return false;
+  }
+
+  *out = p;
+  return true;
+}
+
+size_t compressBlock(const char* src, size_t size, char* dst, size_t capacity)
+{
+  const unsigned char* in = (const unsigned char*)src;
+  unsigned char* out = (unsigned char*)dst;
+  const unsigned char* outEnd = out + capacity;
+
+  // Last position where each hashed 4-byte word was seen
+  uint32_t table[1 << COMPRESS_HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  size_t anchor = 0;
+  size_t i = 0;
+  while (i + COMPRESS_MIN_MATCH <= size)
+  {
+    uint32_t word = readCompressWord(in + i);
+    uint32_t hash = hashCompressWord(word);
+    size_t candidate = table[hash];
+    table[hash] = (uint32_t)i;
+
+    if (candidate >= i || i - candidate > COMPRESS_MAX_OFFSET || readCompressWord(in + candidate) != word)
+    {
+      // Step faster through data that doesn't compress
+      i += 1 + ((i - anchor) >> 6);
+      continue;
+    }
+
+    // Extend the match backwards over the pending literals, then forwards
+    while (i > anchor && candidate > 0 && in[i - 1] == in[candidate - 1])
+    {
+      i--;
+      candidate--;
+    }
+    size_t length = COMPRESS_MIN_MATCH;
+    while (i + length < size && in[candidate + length] == in[i + length])
+      length++;
+
+    if (!writeCompressSequence(&out, outEnd, in + anchor, i - anchor, i - candidate, length))
+      return 0;
+
+    i += length;
+    anchor = i;
+  }
+
+  if (!writeCompressSequence(&out, outEnd, in + anchor, size - anchor, 0, 0))
+    return 0;
+  return out - (unsigned char*)dst;
+}
+
+bool decompressBlock(const char* src, size_t size, char* dst, size_t rawSize)
+{
+  const unsigned char* in = (const unsigned char*)src;
+  const unsigned char* inEnd = in + size;
+  unsigned char* out = (unsigned char*)dst;
+  unsigned char* outStart = out;
+  unsigned char* outEnd = out + rawSize;
+
+  while (in < inEnd)
+  {
+    unsigned char token = *in++;
+
+    size_t literalLength = token >> 4;
+    if (literalLength == 15 && !readCompressLength(&in, inEnd, &literalLength))
+      return false;
+    if ((size_t)(inEnd - in) < literalLength || (size_t)(outEnd - out) < literalLength)
+      return false;
+    memcpy(out, in, literalLength);
+    in += literalLength;
+    out += literalLength;
+
+    if (in == inEnd)
+      break;
+
+    if (inEnd - in < 2)
+      return false;
+    size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+    in += 2;
+
+    size_t matchLength = token & 15;
+    if (matchLength == 15 && !readCompressLength(&in, inEnd, &matchLength))
+      return false;
+    matchLength += COMPRESS_MIN_MATCH;
+
+    if (offset == 0 || offset > (size_t)(out - outStart) || (size_t)(outEnd - out) < matchLength)
+      return false;
+
+    // Overlapping matches repeat the last `offset` bytes, so they are copied
+    // one byte at a time
+    const unsigned char* match = out - offset;
+    if (offset >= matchLength)
+    {
+      memcpy(out, match, matchLength);
+    }
+    else
+    {
+      for (size_t j = 0; j < matchLength; j++)
+        out[j] = match[j];
+    }
+    out += matchLength;
+  }
+
+  return out == outEnd;
+}
+
+bool writeCompressedFrame(CompressedWriter* writer)
+{
+  CompressedFrameHeader frame;
+  frame.rawSize = (uint32_t)writer->input.size;
+
+  size_t storedSize = compressBlock(writer->input.data, writer->input.size, writer->output.data, writer->output.capacity);
+  const char* stored = writer->output.data;
+  if (storedSize == 0 || storedSize >= writer->input.size)
+  {
+    storedSize = writer->input.size;
+    stored = writer->input.data;
+  }
+  frame.storedSize = (uint32_t)storedSize;
+
+  if (fwrite(&frame, sizeof(CompressedFrameHeader), 1, writer->fp) != 1 ||
+      fwrite(stored, 1, storedSize, writer->fp) != storedSize)
+    writer->failed = true;
+
+  clearBuffer(&writer->input);
+  return !writer->failed;
+}
+
+bool openCompressedWriter(CompressedWriter* writer, FILE* fp)
+{
+  writer->fp = fp;
+  writer->failed = false;
+  initBuffer(&writer->input, COMPRESSED_FRAME_SIZE);
+  initBuffer(&writer->output, COMPRESS_BOUND(COMPRESSED_FRAME_SIZE));
+
+  CompressedStreamHeader header;
+  memset(&header, 0, sizeof(CompressedStreamHeader));
+  memcpy(header.magic, COMPRESSED_STREAM_MAGIC, 4);
+  header.version = COMPRESSED_STREAM_VERSION;
+  if (fwrite(&header, sizeof(CompressedStreamHeader), 1, fp) != 1)
+    writer->failed = true;
+  return !writer->failed;
+}
+
+bool writeCompressed(CompressedWriter* writer, const void* data, size_t size)
+{
+  const char* bytes = (const char*)data;
+  while (size > 0 && !writer->failed)
+  {
+    size_t length = COMPRESSED_FRAME_SIZE - writer->input.size;
+    if (length > size)
+      length = size;
+    appendBuffer(&writer->input, bytes, length);
+    bytes += length;
+    size -= length;
+
+    if (writer->input.size == COMPRESSED_FRAME_SIZE)
+      writeCompressedFrame(writer);
+  }
+  return !writer->failed;
+}
+
+bool closeCompressedWriter(CompressedWriter* writer)
+{
+  if (!writer->failed && writer->input.size > 0)
+    writeCompressedFrame(writer);
+
+  CompressedFrameHeader end = {0, 0};
+  if (!writer->failed && fwrite(&end, sizeof(CompressedFrameHeader), 1, writer->fp) != 1)
+    writer->failed = true;
+
+  freeBuffer(&writer->input);
+  freeBuffer(&writer->output);
+  return !writer->failed;
+}
+
+bool isCompressedFile(FILE* fp)
+{
+  CompressedStreamHeader header;
+  fseek(fp, 0, SEEK_SET);
+  bool compressed = fread(&header, sizeof(CompressedStreamHeader), 1, fp) == 1 &&
+                    memcmp(header.magic, COMPRESSED_STREAM_MAGIC, 4) == 0;
+  fseek(fp, 0, SEEK_SET);
+  return compressed;
+}
+
+bool openCompressedReader(CompressedReader* reader, FILE* fp)
+{
+  reader->fp = fp;
+  reader->pos = 0;
+  reader->ended = false;
+  reader->failed = false;
+  initBuffer(&reader->frame, COMPRESSED_FRAME_SIZE);
+  initBuffer(&reader->input, COMPRESSED_FRAME_SIZE);
+
+  CompressedStreamHeader header;
+  fseek(fp, 0, SEEK_SET);
+  if (fread(&header, sizeof(CompressedStreamHeader), 1, fp) != 1 ||
+      memcmp(header.magic, COMPRESSED_STREAM_MAGIC, 4) != 0 ||
+      header.version != COMPRESSED_STREAM_VERSION)
+  {
+    reader->failed = true;
+    reader->ended = true;
+  }
+  return !reader->failed;
+}
+
+bool readCompressedFrame(CompressedReader* reader)
+{
+  CompressedFrameHeader frame;
+  if (fread(&frame, sizeof(CompressedFrameHeader), 1, reader->fp) != 1 ||
+      frame.rawSize > COMPRESSED_FRAME_SIZE || frame.storedSize > frame.rawSize)
+  {
+    reader->failed = true;
+    return false;
+  }
+
+  reader->pos = 0;
+  clearBuffer(&reader->frame);
+  if (frame.rawSize == 0)
+  {
+    reader->ended = true;
+    return false;
+  }
+
+  if (frame.storedSize == frame.rawSize)
+  {
+    if (fread(reader->frame.data, 1, frame.rawSize, reader->fp) != frame.rawSize)
+    {
+      reader->failed = true;
+      return false;
+    }
+  }
+  else if (fread(reader->input.data, 1, frame.storedSize, reader->fp) != frame.storedSize ||
+           !decompressBlock(reader->input.data, frame.storedSize, reader->frame.data, frame.rawSize))
+  {
+    reader->failed = true;
+    return false;
+  }
+
+  reader->frame.size = frame.rawSize;
+  return true;
+}
+
+size_t readCompressed(void* source, char* buffer, size_t size)
+{
+  CompressedReader* reader = (CompressedReader*)source;
+
+  size_t total = 0;
+  while (total < size && !reader->ended && !reader->failed)
+  {
+    if (reader->pos == reader->frame.size && !readCompressedFrame(reader))
+      break;
+
+    size_t length = reader->frame.size - reader->pos;
+    if (length > size - total)
+      length = size - total;
+    memcpy(buffer + total, reader->frame.data + reader->pos, length);
+    reader->pos += length;
+    total += length;
+  }
+  return total;
+}
+
+void closeCompressedReader(CompressedReader* reader)
+{
+  freeBuffer(&reader->frame);
+  freeBuffer(&reader->input);
+}
@@ -0,0 +1,159 @@
+/**
+ * @file compress.h
+ * @brief Compressione LZ a blocchi e flussi compressi.
+ *
+ * Il formato dei blocchi è simile a LZ4: sequenze di byte letterali
+ * seguite da un riferimento (distanza, lunghezza) a byte già scritti.
+ * La decompressione è solo una serie di copie, quindi è molto più veloce
+ * della lettura dal disco dei dati non compressi.
+ */
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "utils.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief Dimensione massima di un blocco compresso di `size` byte, anche
+ *        se i dati non sono comprimibili.
+ */
+#define COMPRESS_BOUND(size) ((size) + (size) / 255 + 16)
+
+/**
+ * @brief Dimensione dei blocchi in cui vengono divisi i flussi compressi.
+ */
+#define COMPRESSED_FRAME_SIZE 65536
+
+/**
+ * @brief Comprime un blocco di dati.
+ *
+ * @param src Dati da comprimere.
+ * @param size Numero di byte da comprimere.
+ * @param dst Buffer di destinazione.
+ * @param capacity Dimensione del buffer di destinazione (COMPRESS_BOUND
+ *                 garantisce che il blocco ci stia).
+ * @return Numero di byte scritti, 0 se il buffer non è sufficiente.
+ */
+size_t compressBlock(const char* src, size_t size, char* dst, size_t capacity);
+
+/**
+ * @brief Decomprime un blocco creato con compressBlock.
+ *
+ * Tutti gli accessi vengono controllati, quindi un blocco danneggiato
+ * produce un errore e non una lettura fuori dai buffer.
+ *
+ * @param src Dati compressi.
+ * @param size Numero di byte compressi.
+ * @param dst Buffer di destinazione.
+ * @param rawSize Numero esatto di byte che il blocco deve produrre.
+ * @return true se il blocco è valido.
+ */
+bool decompressBlock(const char* src, size_t size, char* dst, size_t rawSize);
+
+/**
+ * @struct CompressedWriter
+ * @brief Scrittura di un flusso compresso su file.
+ *
+ * @var fp
+ * File di destinazione.
+ * @var input
+ * Dati non ancora compressi (al massimo COMPRESSED_FRAME_SIZE byte).
+ * @var output
+ * Buffer per il blocco compresso.
+ * @var failed
+ * true se una scrittura è fallita.
+ */
+typedef struct CompressedWriter
+{
+  FILE* fp;
+  Buffer input;
+  Buffer output;
+  bool failed;
+} CompressedWriter;
+
+/**
+ * @brief Inizia un flusso compresso scrivendo la sua intestazione.
+ *
+ * @return true se l'intestazione è stata scritta.
+ */
+bool openCompressedWriter(CompressedWriter* writer, FILE* fp);
+
+/**
+ * @brief Aggiunge dei dati al flusso; ogni blocco pieno viene compresso
+ *        e scritto.
+ *
+ * @return false se una scrittura è fallita.
+ */
+bool writeCompressed(CompressedWriter* writer, const void* data, size_t size);
+
+/**
+ * @brief Scrive l'ultimo blocco e la fine del flusso e libera i buffer.
+ *
+ * Il file non viene chiuso.
+ *
+ * @return true se tutto il flusso è stato scritto.
+ */
+bool closeCompressedWriter(CompressedWriter* writer);
+
+/**
+ * @struct CompressedReader
+ * @brief Lettura di un flusso compresso da file.
+ *
+ * @var fp
+ * File da leggere.
+ * @var frame
+ * Blocco decompresso corrente.
+ * @var pos
+ * Posizione di lettura nel blocco corrente.
+ * @var input
+ * Buffer per il blocco compresso.
+ * @var ended
+ * true dopo la fine del flusso.
+ * @var failed
+ * true se il flusso è troncato o danneggiato.
+ */
+typedef struct CompressedReader
+{
+  FILE* fp;
+  Buffer frame;
+  size_t pos;
+  Buffer input;
+  bool ended;
+  bool failed;
+} CompressedReader;
+
+/**
+ * @brief Verifica se un file inizia con l'intestazione di un flusso
+ *        compresso. La posizione del file viene riportata all'inizio.
+ */
+bool isCompressedFile(FILE* fp);
+
+/**
+ * @brief Inizia la lettura di un flusso compresso dall'inizio del file.
+ *
+ * @return true se l'intestazione è valida.
+ */
+bool openCompressedReader(CompressedReader* reader, FILE* fp);
+
+/**
+ * @brief Legge dati decompressi dal flusso.
+ *
+ * Ha la firma di JsonStreamRead, quindi un flusso compresso può essere
+ * passato direttamente al parser JSON.
+ *
+ * @param reader Puntatore al CompressedReader.
+ * @param buffer Buffer di destinazione.
+ * @param size Numero massimo di byte da leggere.
+ * @return Numero di byte letti, 0 alla fine del flusso o in caso di errore.
+ */
+size_t readCompressed(void* reader, char* buffer, size_t size);
+
+/**
+ * @brief Libera i buffer del lettore. Il file non viene chiuso.
+ */
+void closeCompressedReader(CompressedReader* reader);
+
+#endif // COMPRESS_H
@@ -1,6 +1,5 @@
 #include "json-parser.h"
 #include <ctype.h>
-#include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -37,10 +36,21 @@ bool matchFileCharacter(FILE* jsonFile, int match, LexError* error, LexErrorType
 }
 TokenManager* lex(FILE* jsonFile, LexError* error)
 {
-  fseek(jsonFile, 0, SEEK_SET);
   if (error)
     error->type = NO_LEX_ERROR;
   TokenManager* manager = createTokenManager();
+  fseek(jsonFile, 0, SEEK_END);
+  if ((unsigned long)ftell(jsonFile) > TOKEN_MAX_POS)
+  {
+    if (error)
+    {
+      error->type = FILE_TOO_LARGE;
+      error->lineCount = 0;
+      error->charCount = 0;
+    }
+    return manager;
+  }
+  fseek(jsonFile, 0, SEEK_SET);
   int c;
   size_t lineCount = 0;
   size_t charCount = 0;
@@ -64,8 +74,6 @@ TokenManager* lex(FILE* jsonFile, LexError* error)
     }
     Token* token = createToken(manager);
     token->startPos = ftell(jsonFile) - 1;
-    token->lineCount = lineCount + 1;
-    token->charCount = charCount;
     error->lineCount = lineCount + 1;
     error->charCount = charCount;
     switch (c)
@@ -87,6 +95,13 @@ TokenManager* lex(FILE* jsonFile, LexError* error)
       {
         c = fgetc(jsonFile);
         charCount++;
+        if (c == '\\')
+        {
+          c = fgetc(jsonFile);
+          charCount++;
+          if (c != EOF)
+            c = '\\';
+        }
       } while (c != '"' && c != EOF);
       if (c == '"')
         token->endPos = ftell(jsonFile) - 1;
@@ -168,6 +183,7 @@ TokenManager* lex(FILE* jsonFile, LexError* error)
     error->charCount = 0;
     error->lineCount = 0;
   }
+  manager->tokens = (Token*)vec_shrink_to_fit(manager->tokens, &manager->capacity, manager->size, sizeof(Token));
   return manager;
 }
 JsonNode* createJsonNode(JsonNodeType type)
@@ -179,6 +195,7 @@ JsonNode* createJsonNode(JsonNodeType type)
   node->isRoot = false;
   node->vCapacity = 0;
   node->vSize = 0;
+  node->index = NULL;
   return node;
 }
 Token* advance(TokenManager* manager)
@@ -196,8 +213,6 @@ JsonNode* parse_helper(FILE* jsonFile, TokenManager* manager, ParserError* error
   if (manager->size == 0 || manager->tokens == NULL)
   {
     error->type = NO_TOKEN_FOUND;
-    error->token.lineCount = 0;
-    error->token.charCount = 0;
     return NULL;
   }
   Token* token = advance(manager);
@@ -227,14 +242,24 @@ JsonNode* parse_helper(FILE* jsonFile, TokenManager* manager, ParserError* error
 JsonNode* parse(FILE* jsonFile, TokenManager* manager, ParserError* error)
 {
   if (error)
+  {
     error->type = NO_PARSER_ERROR;
+    error->token.type = NULL_LEX;
+    error->token.startPos = 0;
+    error->token.endPos = 0;
+    if (manager->size > 0)
+      error->token = manager->tokens[manager->size - 1];
+  }
   JsonNode* root = parse_helper(jsonFile, manager, error);
   if (root != NULL)
     root->isRoot = true;
+  if (error && error->type != NO_PARSER_ERROR)
+    locateParserError(jsonFile, error);
   return root;
 }
 void addObjectPair(JsonNode* node, JsonNode* pairNode)
 {
+  freeJsonObjectIndex(node);
   node->vSize++;
   node->value.v_object = (JsonNode*)vec_alloc(node->value.v_object, &node->vCapacity, node->vSize, sizeof(JsonNode));
   node->value.v_object[node->vSize - 1] = *pairNode;
@@ -281,9 +306,20 @@ JsonNode* parseObject(FILE* jsonFile, TokenManager* manager, ParserError* error)
       return node;
     }
     JsonNode* valueNode = parse_helper(jsonFile, manager, error);
+    if (valueNode == NULL)
+    {
+      if (error && error->type == NO_PARSER_ERROR)
+        error->type = EXPECTED_END_OF_OBJECT_BRACE;
+      free(pairKey);
+      return node;
+    }
     valueNode->key = pairKey;
-    if (valueNode == NULL || (error && error->type != NO_PARSER_ERROR))
+    if (error && error->type != NO_PARSER_ERROR)
+    {
+      freeJsonTree(valueNode);
+      free(valueNode);
       return node;
+    }
     addObjectPair(node, valueNode);
     free(valueNode);
     token = advance(manager);
@@ -334,8 +370,12 @@ JsonNode* parseArray(FILE* jsonFile, TokenManager* manager, ParserError* error)
   while (true)
   {
     JsonNode* elemNode = parse_helper(jsonFile, manager, error);
-    if (elemNode == NULL && error && error->type != NO_PARSER_ERROR)
+    if (elemNode == NULL)
+    {
+      if (error && error->type == NO_PARSER_ERROR)
+        error->type = EXPECTED_END_OF_ARRAY_BRACE;
       return node;
+    }
     addElement(node, elemNode);
     free(elemNode);
     token = advance(manager);
@@ -375,8 +415,114 @@ char* getStringFromToken(FILE* jsonFile, Token* token)
   char* str = (char*)malloc(strLength);
   fseek(jsonFile, startPos, SEEK_SET);
   fgets(str, strLength, jsonFile);
+  if (token->type == STRING_LEX)
+    unescapeJsonString(str);
   return str;
 }
+size_t encodeUtf8(char* dst, unsigned long codePoint)
+{
+  if (codePoint < 0x80)
+  {
+    dst[0] = (char)codePoint;
+    return 1;
+  }
+  if (codePoint < 0x800)
+  {
+    dst[0] = (char)(0xC0 | (codePoint >> 6));
+    dst[1] = (char)(0x80 | (codePoint & 0x3F));
+    return 2;
+  }
+  if (codePoint < 0x10000)
+  {
+    dst[0] = (char)(0xE0 | (codePoint >> 12));
+    dst[1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+    dst[2] = (char)(0x80 | (codePoint & 0x3F));
+    return 3;
+  }
+  dst[0] = (char)(0xF0 | (codePoint >> 18));
+  dst[1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+  dst[2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+  dst[3] = (char)(0x80 | (codePoint & 0x3F));
+  return 4;
+}
+bool parseHex4(const char* str, unsigned long* value)
+{
+  *value = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    if (!isxdigit((unsigned char)str[i]))
+      return false;
+    *value = *value * 16 + (isdigit((unsigned char)str[i]) ? str[i] - '0' : tolower((unsigned char)str[i]) - 'a' + 10);
+  }
+  return true;
+}
+bool isJsonHighSurrogate(unsigned long codePoint)
+{
+  return codePoint >= 0xD800 && codePoint <= 0xDBFF;
+}
+bool isJsonLowSurrogate(unsigned long codePoint)
+{
+  return codePoint >= 0xDC00 && codePoint <= 0xDFFF;
+}
+void unescapeJsonString(char* str)
+{
+  char* dst = str;
+  for (const char* src = str; *src != '\0'; src++)
+  {
+    if (*src != '\\' || src[1] == '\0')
+    {
+      *dst++ = *src;
+      continue;
+    }
+    src++;
+    switch (*src)
+    {
+    case 'b':
+      *dst++ = '\b';
+      break;
+    case 'f':
+      *dst++ = '\f';
+      break;
+    case 'n':
+      *dst++ = '\n';
+      break;
+    case 'r':
+      *dst++ = '\r';
+      break;
+    case 't':
+      *dst++ = '\t';
+      break;
+    case 'u':
+    {
+      unsigned long codePoint;
+      if (!parseHex4(src + 1, &codePoint))
+      {
+        *dst++ = *src;
+        break;
+      }
+      src += 4;
+      unsigned long low;
+      // Unpaired surrogates become U+FFFD, as in readStreamString
+      if (isJsonHighSurrogate(codePoint) && src[1] == '\\' && src[2] == 'u' && parseHex4(src + 3, &low) &&
+          isJsonLowSurrogate(low))
+      {
+        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        src += 6;
+      }
+      else if (isJsonHighSurrogate(codePoint) || isJsonLowSurrogate(codePoint))
+      {
+        codePoint = JSON_REPLACEMENT_CHARACTER;
+      }
+      dst += encodeUtf8(dst, codePoint);
+      break;
+    }
+    default:
+      *dst++ = *src;
+      break;
+    }
+  }
+  *dst = '\0';
+}
 JsonNode* parseString(FILE* jsonFile, Token* token)
 {
   JsonNode* node = createJsonNode(STRING_NODE);
@@ -443,6 +589,7 @@ void freeJsonTree(JsonNode* node)
   case OBJECT_NODE:
   case ARRAY_NODE:
     JsonNode* nodeList;
+    freeJsonObjectIndex(node);
     if (node->type == OBJECT_NODE)
     {
       nodeList = node->value.v_object;
@@ -459,16 +606,160 @@ void freeJsonTree(JsonNode* node)
   if (node->isRoot)
     free(node);
 }
-void* vec_alloc(void* vec, size_t* cap, const size_t size, const size_t elemSize)
+uint32_t hashJsonKey(const char* key, size_t length)
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++)
+  {
+    hash ^= (unsigned char)key[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+JsonKey createJsonKey(const char* name)
+{
+  JsonKey key;
+  key.name = name;
+  key.length = strlen(name);
+  key.hash = hashJsonKey(name, key.length);
+  return key;
+}
+void indexJsonObject(JsonNode* node)
+{
+  if (node->type != OBJECT_NODE || node->index != NULL)
+    return;
+  size_t capacity = 16;
+  while (capacity < node->vSize * 2)
+    capacity *= 2;
+  JsonObjectIndex* index = (JsonObjectIndex*)malloc(sizeof(JsonObjectIndex));
+  index->hashes = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+  index->positions = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+  index->mask = capacity - 1;
+  for (size_t i = 0; i < capacity; i++)
+    index->positions[i] = UINT32_MAX;
+  for (size_t i = 0; i < node->vSize; i++)
+  {
+    const char* key = node->value.v_object[i].key;
+    if (key == NULL)
+      continue;
+    uint32_t hash = hashJsonKey(key, strlen(key));
+    size_t slot = hash & index->mask;
+    while (index->positions[slot] != UINT32_MAX)
+      slot = (slot + 1) & index->mask;
+    index->hashes[slot] = hash;
+    index->positions[slot] = (uint32_t)i;
+  }
+  node->index = index;
+}
+void freeJsonObjectIndex(JsonNode* node)
+{
+  if (node->index == NULL)
+    return;
+  free(node->index->hashes);
+  free(node->index->positions);
+  free(node->index);
+  node->index = NULL;
+}
+JsonNode* getObjectField(JsonNode* node, const JsonKey* key)
+{
+  if (node == NULL || node->type != OBJECT_NODE)
+    return NULL;
+  if (node->vSize < JSON_OBJECT_INDEX_THRESHOLD)
+  {
+    for (size_t i = 0; i < node->vSize; i++)
+    {
+      JsonNode* field = &node->value.v_object[i];
+      // strncmp stops at the end of a shorter key, the terminator check rejects a longer one
+      if (field->key != NULL && strncmp(field->key, key->name, key->length) == 0 && field->key[key->length] == '\0')
+        return field;
+    }
+    return NULL;
+  }
+  indexJsonObject(node);
+  JsonObjectIndex* index = node->index;
+  for (size_t slot = key->hash & index->mask; index->positions[slot] != UINT32_MAX; slot = (slot + 1) & index->mask)
+  {
+    if (index->hashes[slot] != key->hash)
+      continue;
+    JsonNode* field = &node->value.v_object[index->positions[slot]];
+    if (strcmp(field->key, key->name) == 0)
+      return field;
+  }
+  return NULL;
+}
+void* vec_reserve(void* vec, size_t* cap, const size_t capacity, const size_t elemSize)
 {
-  if (size == 0 || elemSize == 0)
+  if (capacity <= *cap || elemSize == 0)
     return vec;
-  *cap = pow(2, floor(log2(size)) + 1);
-  void* newVec = realloc(vec, *cap * elemSize);
+  void* newVec = realloc(vec, capacity * elemSize);
   if (newVec == NULL)
+  {
     free(vec);
+    *cap = 0;
+    return NULL;
+  }
+  *cap = capacity;
   return newVec;
 }
+void* vec_alloc(void* vec, size_t* cap, const size_t size, const size_t elemSize)
+{
+  if (size <= *cap || elemSize == 0)
+    return vec;
+  size_t newCap = *cap > 0 ? *cap : VEC_MIN_CAPACITY;
+  while (newCap < size)
+    newCap *= 2;
+  return vec_reserve(vec, cap, newCap, elemSize);
+}
+void* vec_shrink_to_fit(void* vec, size_t* cap, const size_t size, const size_t elemSize)
+{
+  if (size >= *cap || elemSize == 0)
+    return vec;
+  if (size == 0)
+  {
+    free(vec);
+    *cap = 0;
+    return NULL;
+  }
+  void* newVec = realloc(vec, size * elemSize);
+  if (newVec == NULL)
+    return vec;
+  *cap = size;
+  return newVec;
+}
+void getFilePosition(FILE* jsonFile, size_t offset, size_t* lineCount, size_t* charCount)
+{
+  *lineCount = 1;
+  *charCount = 1;
+  fseek(jsonFile, 0, SEEK_SET);
+  int c;
+  for (size_t pos = 0; pos < offset && (c = fgetc(jsonFile)) != EOF; pos++)
+  {
+    if (c == '\r')
+    {
+      int next = fgetc(jsonFile);
+      if (next == '\n')
+        pos++;
+      else if (next != EOF)
+        ungetc(next, jsonFile);
+    }
+    if (c == '\n' || c == '\r')
+    {
+      (*lineCount)++;
+      *charCount = 1;
+    }
+    else
+    {
+      (*charCount)++;
+    }
+  }
+}
+void locateParserError(FILE* jsonFile, ParserError* error)
+{
+  error->lineCount = 0;
+  error->charCount = 0;
+  if (error->type != NO_TOKEN_FOUND)
+    getFilePosition(jsonFile, error->token.startPos, &error->lineCount, &error->charCount);
+}
 void printError(const char* errorType, size_t lineCount, size_t charCount, const char* message)
 {
   printf("Error: %s at line %ld, column %ld: %s\n", errorType, lineCount, charCount, message);
@@ -495,6 +786,9 @@ void printLexError(LexError* error)
   case UNEXPECTED_CHARACTER:
     printError("Syntax Error", error->lineCount, error->charCount, "Unexpected character");
     break;
+  case FILE_TOO_LARGE:
+    printError("Error", error->lineCount, error->charCount, "File too large for the token table");
+    break;
   }
 }
 void printParseError(ParserError* error)
@@ -502,31 +796,37 @@ void printParseError(ParserError* error)
   switch (error->type)
   {
   case NO_TOKEN_FOUND:
-    printError("Syntax Error", error->token.lineCount, error->token.charCount, "Expected token but none found");
+    printError("Syntax Error", error->lineCount, error->charCount, "Expected token but none found");
     break;
   case INVALID_INTEGER_LITERAL:
-    printError("Syntax Error", error->token.lineCount, error->token.charCount, "Invalid integer literal");
+    printError("Syntax Error", error->lineCount, error->charCount, "Invalid integer literal");
     break;
   case INVALID_DOUBLE_LITERAL:
-    printError("Syntax Error", error->token.lineCount, error->token.charCount, "Invalid double literal");
+    printError("Syntax Error", error->lineCount, error->charCount, "Invalid double literal");
     break;
   case EXPECTED_OBJECT_KEY:
-    printError("Syntax Error", error->token.lineCount, error->token.charCount, "Expected object key");
+    printError("Syntax Error", error->lineCount, error->charCount, "Expected object key");
     break;
   case EXPECTED_END_OF_OBJECT_BRACE:
-    printError("Syntax Error", error->token.lineCount, error->token.charCount, "Expected end-of-object brace");
+    printError("Syntax Error", error->lineCount, error->charCount, "Expected end-of-object brace");
     break;
   case EXPECTED_END_OF_ARRAY_BRACE:
-    printError("Syntax Error", error->token.lineCount, error->token.charCount, "Expected end-of-array brace");
+    printError("Syntax Error", error->lineCount, error->charCount, "Expected end-of-array brace");
     break;
   case EXPECTED_COLON:
-    printError("Syntax Error", error->token.lineCount, error->token.charCount, "Expected colon after object key");
+    printError("Syntax Error", error->lineCount, error->charCount, "Expected colon after object key");
     break;
   case EXPECTED_COMMA:
-    printError("Syntax Error", error->token.lineCount, error->token.charCount, "Expected comma");
+    printError("Syntax Error", error->lineCount, error->charCount, "Expected comma");
     break;
   case UNEXPECTED_TOKEN:
-    printError("Syntax Error", error->token.lineCount, error->token.charCount, "Unexpected token");
+    printError("Syntax Error", error->lineCount, error->charCount, "Unexpected token");
+    break;
+  case MAXIMUM_DEPTH_EXCEEDED:
+    printError("Syntax Error", error->lineCount, error->charCount, "Maximum nesting depth exceeded");
+    break;
+  case HANDLER_ABORTED:
+    printError("Error", error->lineCount, error->charCount, "Parsing aborted by handler");
     break;
   }
 }
@@ -536,7 +836,7 @@ void printTokens(TokenManager* manager)
   {
     const Token* token = &manager->tokens[i];
     printf("Type: ");
-    switch (token->type)
+    switch ((TokenType)token->type)
     {
     case NULL_LEX:
       printf("NULL_LEX");
@@ -656,3 +956,863 @@ void traverse(JsonNode* node, size_t indent, bool isParentArray)
     printWithIndent(indent, "- [[UNKNOWN NODE]]\n");
   }
 }
+typedef struct JsonStreamReader
+{
+  JsonStreamRead read;
+  void* source;
+  char* buffer;
+  size_t size;
+  size_t pos;
+  bool eof;
+  char* string;
+  size_t stringSize;
+  size_t stringCapacity;
+  size_t lineCount;
+  size_t charCount;
+  bool lastWasCarriageReturn;
+  JsonStreamHandler* handler;
+  void* userData;
+  JsonStreamError* error;
+} JsonStreamReader;
+int streamPeek(JsonStreamReader* reader)
+{
+  if (reader->pos >= reader->size)
+  {
+    if (reader->eof)
+      return EOF;
+    reader->size = reader->read(reader->source, reader->buffer, JSON_STREAM_BUFFER_SIZE);
+    reader->pos = 0;
+    if (reader->size == 0)
+    {
+      reader->eof = true;
+      return EOF;
+    }
+  }
+  return (unsigned char)reader->buffer[reader->pos];
+}
+int streamNext(JsonStreamReader* reader)
+{
+  int c = streamPeek(reader);
+  if (c == EOF)
+    return EOF;
+  reader->pos++;
+  if (c == '\n' && reader->lastWasCarriageReturn)
+  {
+    reader->lastWasCarriageReturn = false;
+    return c;
+  }
+  reader->lastWasCarriageReturn = (c == '\r');
+  if (c == '\n' || c == '\r')
+  {
+    reader->lineCount++;
+    reader->charCount = 0;
+  }
+  else
+  {
+    reader->charCount++;
+  }
+  return c;
+}
+void skipStreamSpace(JsonStreamReader* reader)
+{
+  int c;
+  while ((c = streamPeek(reader)) != EOF && isspace(c))
+    streamNext(reader);
+}
+bool setStreamLexError(JsonStreamReader* reader, LexErrorType type)
+{
+  if (reader->error)
+  {
+    reader->error->lexType = type;
+    reader->error->lineCount = reader->lineCount;
+    reader->error->charCount = reader->charCount;
+  }
+  return false;
+}
+bool setStreamParserError(JsonStreamReader* reader, ParserErrorType type)
+{
+  if (reader->error)
+  {
+    reader->error->parserType = type;
+    reader->error->lineCount = reader->lineCount;
+    reader->error->charCount = reader->charCount;
+  }
+  return false;
+}
+void pushStreamChar(JsonStreamReader* reader, char c)
+{
+  if (reader->stringSize + 1 >= reader->stringCapacity)
+  {
+    reader->stringCapacity = reader->stringCapacity > 0 ? reader->stringCapacity * 2 : 64;
+    reader->string = (char*)realloc(reader->string, reader->stringCapacity);
+  }
+  reader->string[reader->stringSize++] = c;
+}
+void pushStreamCodePoint(JsonStreamReader* reader, unsigned long codePoint)
+{
+  char utf8[4];
+  size_t length = encodeUtf8(utf8, codePoint);
+  for (size_t i = 0; i < length; i++)
+    pushStreamChar(reader, utf8[i]);
+}
+bool readStreamHex4(JsonStreamReader* reader, unsigned long* value)
+{
+  *value = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    int c = streamNext(reader);
+    if (c == EOF)
+      return setStreamLexError(reader, EXPECTED_END_OF_STRING);
+    if (!isxdigit(c))
+      return setStreamLexError(reader, UNEXPECTED_CHARACTER);
+    *value = *value * 16 + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+  }
+  return true;
+}
+bool readStreamString(JsonStreamReader* reader)
+{
+  streamNext(reader);
+  reader->stringSize = 0;
+  // A high surrogate is held until the next character shows whether a low
+  // one follows; unpaired surrogates become U+FFFD, as in unescapeJsonString
+  unsigned long high = 0;
+  while (true)
+  {
+    int c = streamNext(reader);
+    if (c == EOF)
+      return setStreamLexError(reader, EXPECTED_END_OF_STRING);
+    if (high != 0 && (c != '\\' || streamPeek(reader) != 'u'))
+    {
+      pushStreamCodePoint(reader, JSON_REPLACEMENT_CHARACTER);
+      high = 0;
+    }
+    if (c == '"')
+      break;
+    if (c != '\\')
+    {
+      pushStreamChar(reader, (char)c);
+      continue;
+    }
+    c = streamNext(reader);
+    switch (c)
+    {
+    case '"':
+    case '\\':
+    case '/':
+      pushStreamChar(reader, (char)c);
+      break;
+    case 'b':
+      pushStreamChar(reader, '\b');
+      break;
+    case 'f':
+      pushStreamChar(reader, '\f');
+      break;
+    case 'n':
+      pushStreamChar(reader, '\n');
+      break;
+    case 'r':
+      pushStreamChar(reader, '\r');
+      break;
+    case 't':
+      pushStreamChar(reader, '\t');
+      break;
+    case 'u':
+    {
+      unsigned long codePoint;
+      if (!readStreamHex4(reader, &codePoint))
+        return false;
+      if (high != 0 && isJsonLowSurrogate(codePoint))
+        codePoint = 0x10000 + ((high - 0xD800) << 10) + (codePoint - 0xDC00);
+      else if (high != 0)
+        pushStreamCodePoint(reader, JSON_REPLACEMENT_CHARACTER);
+      high = 0;
+
+      if (isJsonHighSurrogate(codePoint))
+        high = codePoint;
+      else
+        pushStreamCodePoint(reader, isJsonLowSurrogate(codePoint) ? JSON_REPLACEMENT_CHARACTER : codePoint);
+      break;
+    }
+    case EOF:
+      return setStreamLexError(reader, EXPECTED_END_OF_STRING);
+    default:
+      return setStreamLexError(reader, UNEXPECTED_CHARACTER);
+    }
+  }
+  pushStreamChar(reader, '\0');
+  reader->stringSize--;
+  return true;
+}
+bool matchStreamLiteral(JsonStreamReader* reader, const char* literal, LexErrorType errorType)
+{
+  for (const char* p = literal; *p != '\0'; p++)
+  {
+    if (streamNext(reader) != *p)
+      return setStreamLexError(reader, errorType);
+  }
+  return true;
+}
+bool callStreamHandler(JsonStreamReader* reader, bool result)
+{
+  if (!result)
+    return setStreamParserError(reader, HANDLER_ABORTED);
+  return true;
+}
+bool parseStreamNumber(JsonStreamReader* reader)
+{
+  char number[64];
+  size_t length = 0;
+  bool isDouble = false;
+  int c;
+  while ((c = streamPeek(reader)) != EOF && (isdigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+  {
+    if (length + 1 >= sizeof(number))
+      return setStreamParserError(reader, isDouble ? INVALID_DOUBLE_LITERAL : INVALID_INTEGER_LITERAL);
+    if (c == '.' || c == 'e' || c == 'E')
+      isDouble = true;
+    number[length++] = (char)c;
+    streamNext(reader);
+  }
+  number[length] = '\0';
+  char* endptr;
+  if (isDouble)
+  {
+    double value = strtod(number, &endptr);
+    if (*endptr != '\0')
+      return setStreamParserError(reader, INVALID_DOUBLE_LITERAL);
+    if (reader->handler->onDouble)
+      return callStreamHandler(reader, reader->handler->onDouble(reader->userData, value));
+    return true;
+  }
+  long long value = strtoll(number, &endptr, 10);
+  if (*endptr != '\0')
+    return setStreamParserError(reader, INVALID_INTEGER_LITERAL);
+  if (reader->handler->onInteger)
+    return callStreamHandler(reader, reader->handler->onInteger(reader->userData, value));
+  return true;
+}
+bool parseStreamValue(JsonStreamReader* reader, size_t depth);
+bool parseStreamObject(JsonStreamReader* reader, size_t depth)
+{
+  JsonStreamHandler* handler = reader->handler;
+  streamNext(reader);
+  if (handler->onObjectStart && !callStreamHandler(reader, handler->onObjectStart(reader->userData)))
+    return false;
+  skipStreamSpace(reader);
+  if (streamPeek(reader) == '}')
+  {
+    streamNext(reader);
+    return !handler->onObjectEnd || callStreamHandler(reader, handler->onObjectEnd(reader->userData));
+  }
+  while (true)
+  {
+    skipStreamSpace(reader);
+    int c = streamPeek(reader);
+    if (c == EOF)
+      return setStreamParserError(reader, EXPECTED_END_OF_OBJECT_BRACE);
+    if (c != '"')
+      return setStreamParserError(reader, EXPECTED_OBJECT_KEY);
+    if (!readStreamString(reader))
+      return false;
+    if (handler->onKey && !callStreamHandler(reader, handler->onKey(reader->userData, reader->string, reader->stringSize)))
+      return false;
+    skipStreamSpace(reader);
+    if (streamNext(reader) != ':')
+      return setStreamParserError(reader, EXPECTED_COLON);
+    if (!parseStreamValue(reader, depth))
+      return false;
+    skipStreamSpace(reader);
+    c = streamNext(reader);
+    if (c == '}')
+      return !handler->onObjectEnd || callStreamHandler(reader, handler->onObjectEnd(reader->userData));
+    if (c == EOF)
+      return setStreamParserError(reader, EXPECTED_END_OF_OBJECT_BRACE);
+    if (c != ',')
+      return setStreamParserError(reader, EXPECTED_COMMA);
+  }
+}
+bool parseStreamArray(JsonStreamReader* reader, size_t depth)
+{
+  JsonStreamHandler* handler = reader->handler;
+  streamNext(reader);
+  if (handler->onArrayStart && !callStreamHandler(reader, handler->onArrayStart(reader->userData)))
+    return false;
+  skipStreamSpace(reader);
+  if (streamPeek(reader) == ']')
+  {
+    streamNext(reader);
+    return !handler->onArrayEnd || callStreamHandler(reader, handler->onArrayEnd(reader->userData));
+  }
+  while (true)
+  {
+    if (!parseStreamValue(reader, depth))
+      return false;
+    skipStreamSpace(reader);
+    int c = streamNext(reader);
+    if (c == ']')
+      return !handler->onArrayEnd || callStreamHandler(reader, handler->onArrayEnd(reader->userData));
+    if (c == EOF)
+      return setStreamParserError(reader, EXPECTED_END_OF_ARRAY_BRACE);
+    if (c != ',')
+      return setStreamParserError(reader, EXPECTED_COMMA);
+  }
+}
+bool parseStreamValue(JsonStreamReader* reader, size_t depth)
+{
+  JsonStreamHandler* handler = reader->handler;
+  skipStreamSpace(reader);
+  int c = streamPeek(reader);
+  switch (c)
+  {
+  case EOF:
+    return setStreamLexError(reader, UNEXPECTED_END_OF_INPUT);
+  case '{':
+  case '[':
+    if (depth >= JSON_STREAM_MAX_DEPTH)
+      return setStreamParserError(reader, MAXIMUM_DEPTH_EXCEEDED);
+    if (c == '{')
+      return parseStreamObject(reader, depth + 1);
+    return parseStreamArray(reader, depth + 1);
+  case '"':
+    if (!readStreamString(reader))
+      return false;
+    return !handler->onString || callStreamHandler(reader, handler->onString(reader->userData, reader->string, reader->stringSize));
+  case 't':
+    if (!matchStreamLiteral(reader, "true", INVALID_BOOLEAN_LITERAL))
+      return false;
+    return !handler->onBoolean || callStreamHandler(reader, handler->onBoolean(reader->userData, true));
+  case 'f':
+    if (!matchStreamLiteral(reader, "false", INVALID_BOOLEAN_LITERAL))
+      return false;
+    return !handler->onBoolean || callStreamHandler(reader, handler->onBoolean(reader->userData, false));
+  case 'n':
+    if (!matchStreamLiteral(reader, "null", INVALID_NULL_LITERAL))
+      return false;
+    return !handler->onNull || callStreamHandler(reader, handler->onNull(reader->userData));
+  }
+  if (c == '-' || isdigit(c))
+    return parseStreamNumber(reader);
+  streamNext(reader);
+  return setStreamLexError(reader, UNEXPECTED_CHARACTER);
+}
+bool parseJsonStream(JsonStreamRead read, void* source, JsonStreamHandler* handler, void* userData, JsonStreamError* error)
+{
+  JsonStreamReader reader;
+  reader.read = read;
+  reader.source = source;
+  reader.buffer = (char*)malloc(JSON_STREAM_BUFFER_SIZE);
+  reader.size = 0;
+  reader.pos = 0;
+  reader.eof = false;
+  reader.string = NULL;
+  reader.stringSize = 0;
+  reader.stringCapacity = 0;
+  reader.lineCount = 1;
+  reader.charCount = 0;
+  reader.lastWasCarriageReturn = false;
+  reader.handler = handler;
+  reader.userData = userData;
+  reader.error = error;
+  if (error)
+  {
+    error->lexType = NO_LEX_ERROR;
+    error->parserType = NO_PARSER_ERROR;
+    error->lineCount = 0;
+    error->charCount = 0;
+  }
+  bool success;
+  skipStreamSpace(&reader);
+  if (streamPeek(&reader) == EOF)
+  {
+    success = setStreamLexError(&reader, EMPTY_FILE);
+  }
+  else
+  {
+    success = parseStreamValue(&reader, 0);
+    if (success)
+    {
+      skipStreamSpace(&reader);
+      if (streamPeek(&reader) != EOF)
+        success = setStreamParserError(&reader, UNEXPECTED_TOKEN);
+    }
+  }
+  free(reader.buffer);
+  free(reader.string);
+  return success;
+}
+size_t readJsonFileSource(void* source, char* buffer, size_t size)
+{
+  return fread(buffer, 1, size, (FILE*)source);
+}
+bool parseJsonFileStream(FILE* jsonFile, JsonStreamHandler* handler, void* userData, JsonStreamError* error)
+{
+  fseek(jsonFile, 0, SEEK_SET);
+  return parseJsonStream(readJsonFileSource, jsonFile, handler, userData, error);
+}
+typedef struct JsonBufferSource
+{
+  const char* data;
+  size_t size;
+  size_t pos;
+} JsonBufferSource;
+size_t readJsonBufferSource(void* source, char* buffer, size_t size)
+{
+  JsonBufferSource* bufferSource = (JsonBufferSource*)source;
+  size_t remaining = bufferSource->size - bufferSource->pos;
+  if (size > remaining)
+    size = remaining;
+  memcpy(buffer, bufferSource->data + bufferSource->pos, size);
+  bufferSource->pos += size;
+  return size;
+}
+bool parseJsonBufferStream(const char* data, size_t size, JsonStreamHandler* handler, void* userData, JsonStreamError* error)
+{
+  JsonBufferSource source = {data, size, 0};
+  return parseJsonStream(readJsonBufferSource, &source, handler, userData, error);
+}
+void printJsonStreamError(JsonStreamError* error)
+{
+  if (error->lexType != NO_LEX_ERROR)
+  {
+    LexError lexError;
+    lexError.type = error->lexType;
+    lexError.lineCount = error->lineCount;
+    lexError.charCount = error->charCount;
+    printLexError(&lexError);
+  }
+  else if (error->parserType != NO_PARSER_ERROR)
+  {
+    ParserError parserError;
+    parserError.type = error->parserType;
+    parserError.lineCount = error->lineCount;
+    parserError.charCount = error->charCount;
+    printParseError(&parserError);
+  }
+}
+JsonDocument* openJsonDocument(FILE* jsonFile)
+{
+  JsonDocument* document = (JsonDocument*)malloc(sizeof(JsonDocument));
+  document->jsonFile = jsonFile;
+  document->window = (char*)malloc(JSON_DOCUMENT_WINDOW_SIZE);
+  document->windowStart = 0;
+  document->windowSize = 0;
+  document->matchKeys = NULL;
+  document->matchValues = NULL;
+  document->matchCapacity = 0;
+  document->matchSize = 0;
+  document->indexCount = 0;
+  document->nextIndex = 0;
+  return document;
+}
+void closeJsonDocument(JsonDocument* document)
+{
+  for (size_t i = 0; i < document->indexCount; i++)
+  {
+    free(document->indexes[i].fields);
+    free(document->indexes[i].keys);
+    free(document->indexes[i].slots);
+  }
+  free(document->window);
+  free(document->matchKeys);
+  free(document->matchValues);
+  free(document);
+}
+int peekJsonDocument(JsonDocument* document, size_t pos)
+{
+  if (pos < document->windowStart || pos >= document->windowStart + document->windowSize)
+  {
+    // Reading forwards the window starts at pos; going back it is centered on pos, so
+    // walking backwards through a document doesn't reload it at every step
+    size_t start = pos;
+    if (pos < document->windowStart)
+      start = pos > JSON_DOCUMENT_WINDOW_SIZE / 2 ? pos - JSON_DOCUMENT_WINDOW_SIZE / 2 : 0;
+    fseek(document->jsonFile, start, SEEK_SET);
+    document->windowStart = start;
+    document->windowSize = fread(document->window, sizeof(char), JSON_DOCUMENT_WINDOW_SIZE, document->jsonFile);
+    if (pos >= document->windowStart + document->windowSize)
+      return EOF;
+  }
+  return (unsigned char)document->window[pos - document->windowStart];
+}
+size_t skipJsonDocumentSpace(JsonDocument* document, size_t pos)
+{
+  int c;
+  while ((c = peekJsonDocument(document, pos)) != EOF && isspace(c))
+    pos++;
+  return pos;
+}
+bool findJsonMatch(JsonDocument* document, size_t start, size_t* end)
+{
+  if (document->matchCapacity == 0)
+    return false;
+  size_t mask = document->matchCapacity - 1;
+  for (size_t slot = (start * 0x9E3779B97F4A7C15ull) >> 7 & mask; document->matchKeys[slot] != SIZE_MAX; slot = (slot + 1) & mask)
+  {
+    if (document->matchKeys[slot] == start)
+    {
+      *end = document->matchValues[slot];
+      return true;
+    }
+  }
+  return false;
+}
+void storeJsonMatch(JsonDocument* document, size_t start, size_t end)
+{
+  if ((document->matchSize + 1) * 2 > document->matchCapacity)
+  {
+    size_t* oldKeys = document->matchKeys;
+    size_t* oldValues = document->matchValues;
+    size_t oldCapacity = document->matchCapacity;
+    document->matchCapacity = oldCapacity > 0 ? oldCapacity * 2 : 64;
+    document->matchKeys = (size_t*)malloc(document->matchCapacity * sizeof(size_t));
+    document->matchValues = (size_t*)malloc(document->matchCapacity * sizeof(size_t));
+    for (size_t i = 0; i < document->matchCapacity; i++)
+      document->matchKeys[i] = SIZE_MAX;
+    document->matchSize = 0;
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+      if (oldKeys[i] != SIZE_MAX)
+        storeJsonMatch(document, oldKeys[i], oldValues[i]);
+    }
+    free(oldKeys);
+    free(oldValues);
+  }
+  size_t mask = document->matchCapacity - 1;
+  size_t slot = (start * 0x9E3779B97F4A7C15ull) >> 7 & mask;
+  while (document->matchKeys[slot] != SIZE_MAX)
+    slot = (slot + 1) & mask;
+  document->matchKeys[slot] = start;
+  document->matchValues[slot] = end;
+  document->matchSize++;
+}
+bool skipJsonDocumentString(JsonDocument* document, size_t* pos)
+{
+  size_t p = *pos + 1;
+  while (true)
+  {
+    int c = peekJsonDocument(document, p);
+    if (c == EOF)
+      return false;
+    if (c == '\\')
+      p++;
+    else if (c == '"')
+      break;
+    p++;
+  }
+  *pos = p + 1;
+  return true;
+}
+bool skipJsonDocumentValue(JsonDocument* document, size_t* pos)
+{
+  size_t start = *pos;
+  int c = peekJsonDocument(document, start);
+  if (c == '"')
+    return skipJsonDocumentString(document, pos);
+  if (c != '{' && c != '[')
+  {
+    size_t p = start;
+    while ((c = peekJsonDocument(document, p)) != EOF && c != ',' && c != '}' && c != ']' && !isspace(c))
+      p++;
+    *pos = p;
+    return p > start;
+  }
+  size_t end;
+  if (findJsonMatch(document, start, &end))
+  {
+    *pos = end;
+    return true;
+  }
+  size_t depth = 0;
+  size_t p = start;
+  do
+  {
+    c = peekJsonDocument(document, p);
+    if (c == EOF)
+      return false;
+    if (c == '"')
+    {
+      if (!skipJsonDocumentString(document, &p))
+        return false;
+      continue;
+    }
+    if (c == '{' || c == '[')
+      depth++;
+    else if (c == '}' || c == ']')
+      depth--;
+    p++;
+  } while (depth > 0);
+  storeJsonMatch(document, start, p);
+  *pos = p;
+  return true;
+}
+bool getJsonRoot(JsonDocument* document, JsonCursor* cursor)
+{
+  cursor->document = document;
+  cursor->pos = skipJsonDocumentSpace(document, 0);
+  cursor->inObject = false;
+  return peekJsonDocument(document, cursor->pos) != EOF;
+}
+JsonNodeType getJsonCursorType(const JsonCursor* cursor)
+{
+  int c = peekJsonDocument(cursor->document, cursor->pos);
+  switch (c)
+  {
+  case '{':
+    return OBJECT_NODE;
+  case '[':
+    return ARRAY_NODE;
+  case '"':
+    return STRING_NODE;
+  case 't':
+  case 'f':
+    return BOOLEAN_NODE;
+  case 'n':
+    return NULL_NODE;
+  }
+  size_t pos = cursor->pos;
+  while ((c = peekJsonDocument(cursor->document, pos)) != EOF && (isdigit(c) || c == '-' || c == '+'))
+    pos++;
+  return (c == '.' || c == 'e' || c == 'E') ? DOUBLE_NODE : INTEGER_NODE;
+}
+bool getJsonMemberValue(JsonDocument* document, size_t pos, bool inObject, JsonCursor* member)
+{
+  pos = skipJsonDocumentSpace(document, pos);
+  if (inObject)
+  {
+    if (peekJsonDocument(document, pos) != '"' || !skipJsonDocumentString(document, &pos))
+      return false;
+    pos = skipJsonDocumentSpace(document, pos);
+    if (peekJsonDocument(document, pos) != ':')
+      return false;
+    pos = skipJsonDocumentSpace(document, pos + 1);
+  }
+  member->document = document;
+  member->pos = pos;
+  member->inObject = inObject;
+  return true;
+}
+bool getJsonFirstChild(const JsonCursor* container, JsonCursor* child)
+{
+  JsonDocument* document = container->document;
+  int open = peekJsonDocument(document, container->pos);
+  if (open != '{' && open != '[')
+    return false;
+  size_t pos = skipJsonDocumentSpace(document, container->pos + 1);
+  int c = peekJsonDocument(document, pos);
+  if (c == '}' || c == ']' || c == EOF)
+    return false;
+  return getJsonMemberValue(document, pos, open == '{', child);
+}
+bool getJsonNextSibling(const JsonCursor* child, JsonCursor* next)
+{
+  JsonDocument* document = child->document;
+  size_t pos = child->pos;
+  if (!skipJsonDocumentValue(document, &pos))
+    return false;
+  pos = skipJsonDocumentSpace(document, pos);
+  if (peekJsonDocument(document, pos) != ',')
+    return false;
+  return getJsonMemberValue(document, pos + 1, child->inObject, next);
+}
+// Objects keep an index of the fields scanned so far; the most recent ones are reused round robin
+// An object that already has an index isn't read again, so lookups don't move the window back to it
+JsonDocumentIndex* getJsonDocumentIndex(JsonDocument* document, size_t objectPos)
+{
+  for (size_t i = 0; i < document->indexCount; i++)
+  {
+    if (document->indexes[i].objectPos == objectPos)
+      return &document->indexes[i];
+  }
+  if (peekJsonDocument(document, objectPos) != '{')
+    return NULL;
+  JsonDocumentIndex* index;
+  if (document->indexCount < JSON_DOCUMENT_MAX_INDEXES)
+  {
+    index = &document->indexes[document->indexCount++];
+    index->fieldCapacity = 0;
+    index->fields = NULL;
+    index->keysCapacity = 0;
+    index->keys = NULL;
+    index->slots = (uint32_t*)malloc(16 * sizeof(uint32_t));
+  }
+  else
+  {
+    index = &document->indexes[document->nextIndex];
+    document->nextIndex = (document->nextIndex + 1) % JSON_DOCUMENT_MAX_INDEXES;
+    index->slots = (uint32_t*)realloc(index->slots, 16 * sizeof(uint32_t));
+  }
+  index->objectPos = objectPos;
+  index->resumePos = skipJsonDocumentSpace(document, objectPos + 1);
+  index->resumeInValue = false;
+  index->fieldCount = 0;
+  index->keysSize = 0;
+  index->mask = 15;
+  for (size_t i = 0; i <= index->mask; i++)
+    index->slots[i] = UINT32_MAX;
+  return index;
+}
+void insertJsonDocumentSlot(JsonDocumentIndex* index, uint32_t position)
+{
+  size_t slot = index->fields[position].hash & index->mask;
+  while (index->slots[slot] != UINT32_MAX)
+    slot = (slot + 1) & index->mask;
+  index->slots[slot] = position;
+}
+void addJsonDocumentField(JsonDocumentIndex* index, const JsonDocumentField* field)
+{
+  if ((index->fieldCount + 1) * 2 > index->mask + 1)
+  {
+    index->mask = index->mask * 2 + 1;
+    index->slots = (uint32_t*)realloc(index->slots, (index->mask + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i <= index->mask; i++)
+      index->slots[i] = UINT32_MAX;
+    for (size_t i = 0; i < index->fieldCount; i++)
+      insertJsonDocumentSlot(index, (uint32_t)i);
+  }
+  index->fields = (JsonDocumentField*)vec_alloc(index->fields, &index->fieldCapacity, index->fieldCount + 1, sizeof(JsonDocumentField));
+  index->fields[index->fieldCount] = *field;
+  insertJsonDocumentSlot(index, (uint32_t)index->fieldCount++);
+}
+// Keys are copied into the index and compared without reading the file
+bool isJsonDocumentKey(const JsonDocumentIndex* index, const JsonDocumentField* field, const JsonKey* key)
+{
+  return field->hash == key->hash && field->keyLength == key->length &&
+         memcmp(index->keys + field->keyOffset, key->name, key->length) == 0;
+}
+bool getJsonField(const JsonCursor* object, const JsonKey* key, JsonCursor* field)
+{
+  JsonDocument* document = object->document;
+  JsonDocumentIndex* index = getJsonDocumentIndex(document, object->pos);
+  if (!index)
+    return false;
+
+  // Fields already scanned are found through the hash, in file order for duplicate keys
+  for (size_t slot = key->hash & index->mask; index->slots[slot] != UINT32_MAX; slot = (slot + 1) & index->mask)
+  {
+    const JsonDocumentField* indexed = &index->fields[index->slots[slot]];
+    if (isJsonDocumentKey(index, indexed, key))
+    {
+      field->document = document;
+      field->pos = indexed->valuePos;
+      field->inObject = true;
+      return true;
+    }
+  }
+
+  // The rest of the object is scanned only up to the key, so the value of a field that was
+  // just returned is skipped by the next lookup
+  size_t pos = index->resumePos;
+  while (pos != SIZE_MAX)
+  {
+    if (index->resumeInValue)
+    {
+      index->resumeInValue = false;
+      if (!skipJsonDocumentValue(document, &pos))
+        break;
+      pos = skipJsonDocumentSpace(document, pos);
+      if (peekJsonDocument(document, pos) != ',')
+        break;
+      pos = skipJsonDocumentSpace(document, pos + 1);
+    }
+    if (peekJsonDocument(document, pos) != '"')
+      break;
+
+    JsonDocumentField scanned;
+    size_t keyStart = pos + 1;
+    if (!skipJsonDocumentString(document, &pos))
+      break;
+    scanned.keyLength = pos - 1 - keyStart;
+    scanned.keyOffset = index->keysSize;
+    index->keys = (char*)vec_alloc(index->keys, &index->keysCapacity, index->keysSize + scanned.keyLength + 1, sizeof(char));
+    for (size_t i = 0; i < scanned.keyLength; i++)
+      index->keys[index->keysSize++] = (char)peekJsonDocument(document, keyStart + i);
+    scanned.hash = hashJsonKey(index->keys + scanned.keyOffset, scanned.keyLength);
+    pos = skipJsonDocumentSpace(document, pos);
+    if (peekJsonDocument(document, pos) != ':')
+      break;
+    pos = skipJsonDocumentSpace(document, pos + 1);
+    scanned.valuePos = pos;
+    addJsonDocumentField(index, &scanned);
+    index->resumePos = pos;
+    index->resumeInValue = true;
+
+    if (isJsonDocumentKey(index, &scanned, key))
+    {
+      field->document = document;
+      field->pos = pos;
+      field->inObject = true;
+      return true;
+    }
+  }
+  index->resumePos = SIZE_MAX;
+  return false;
+}
+bool getJsonElement(const JsonCursor* array, size_t index, JsonCursor* element)
+{
+  if (peekJsonDocument(array->document, array->pos) != '[')
+    return false;
+  JsonCursor current;
+  if (!getJsonFirstChild(array, &current))
+    return false;
+  for (size_t i = 0; i < index; i++)
+  {
+    if (!getJsonNextSibling(&current, &current))
+      return false;
+  }
+  *element = current;
+  return true;
+}
+size_t readJsonCursorToken(const JsonCursor* cursor, char* token, size_t size)
+{
+  size_t length = 0;
+  int c;
+  while (length + 1 < size && (c = peekJsonDocument(cursor->document, cursor->pos + length)) != EOF && c != ',' && c != '}' && c != ']' && !isspace(c))
+  {
+    token[length] = (char)c;
+    length++;
+  }
+  token[length] = '\0';
+  return length;
+}
+bool getJsonCursorInteger(const JsonCursor* cursor, long long* value)
+{
+  char token[64];
+  if (readJsonCursorToken(cursor, token, sizeof(token)) == 0)
+    return false;
+  char* endptr;
+  *value = strtoll(token, &endptr, 10);
+  return *endptr == '\0';
+}
+bool getJsonCursorDouble(const JsonCursor* cursor, double* value)
+{
+  char token[64];
+  if (readJsonCursorToken(cursor, token, sizeof(token)) == 0)
+    return false;
+  char* endptr;
+  *value = strtod(token, &endptr);
+  return *endptr == '\0';
+}
+bool getJsonCursorBoolean(const JsonCursor* cursor, bool* value)
+{
+  char token[8];
+  readJsonCursorToken(cursor, token, sizeof(token));
+  if (strcmp(token, "true") != 0 && strcmp(token, "false") != 0)
+    return false;
+  *value = token[0] == 't';
+  return true;
+}
+char* getJsonCursorString(const JsonCursor* cursor)
+{
+  if (peekJsonDocument(cursor->document, cursor->pos) != '"')
+    return NULL;
+  size_t end = cursor->pos;
+  if (!skipJsonDocumentString(cursor->document, &end))
+    return NULL;
+  size_t length = end - cursor->pos - 2;
+  char* str = (char*)malloc(length + 1);
+  for (size_t i = 0; i < length; i++)
+    str[i] = (char)peekJsonDocument(cursor->document, cursor->pos + 1 + i);
+  str[length] = '\0';
+  unescapeJsonString(str);
+  return str;
+}
@@ -7,6 +7,7 @@
 #define JSON_PARSER_C
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 typedef enum TokenType
 {
@@ -24,12 +25,11 @@ typedef enum TokenType
 } TokenType;
 typedef struct Token
 {
-  TokenType type;
-  size_t startPos;
-  size_t endPos;
-  size_t lineCount;
-  size_t charCount;
+  uint32_t startPos;
+  uint32_t endPos;
+  uint8_t type;
 } Token;
+#define TOKEN_MAX_POS UINT32_MAX
 typedef struct TokenManager
 {
   Token* tokens;
@@ -48,7 +48,8 @@ typedef enum LexErrorType
   INVALID_BOOLEAN_LITERAL,
   INVALID_NULL_LITERAL,
   UNEXPECTED_CHARACTER,
-  UNEXPECTED_END_OF_INPUT
+  UNEXPECTED_END_OF_INPUT,
+  FILE_TOO_LARGE
 } LexErrorType;
 typedef struct LexError
 {
@@ -76,6 +77,12 @@ typedef union JsonValue
   double v_double;
   bool v_bool;
 } JsonValue;
+typedef struct JsonObjectIndex
+{
+  uint32_t* hashes;
+  uint32_t* positions;
+  size_t mask;
+} JsonObjectIndex;
 typedef struct JsonNode
 {
   JsonNodeType type;
@@ -84,8 +91,21 @@ typedef struct JsonNode
   bool isRoot;
   size_t vCapacity;
   size_t vSize;
+  JsonObjectIndex* index;
 } JsonNode;
 JsonNode* createJsonNode(JsonNodeType type);
+#define JSON_OBJECT_INDEX_THRESHOLD 8
+typedef struct JsonKey
+{
+  const char* name;
+  size_t length;
+  uint32_t hash;
+} JsonKey;
+uint32_t hashJsonKey(const char* key, size_t length);
+JsonKey createJsonKey(const char* name);
+void indexJsonObject(JsonNode* node);
+void freeJsonObjectIndex(JsonNode* node);
+JsonNode* getObjectField(JsonNode* node, const JsonKey* key);
 typedef enum ParserErrorType
 {
   NO_PARSER_ERROR = 0,
@@ -97,12 +117,16 @@ typedef enum ParserErrorType
   EXPECTED_END_OF_ARRAY_BRACE,
   EXPECTED_COLON,
   EXPECTED_COMMA,
-  UNEXPECTED_TOKEN
+  UNEXPECTED_TOKEN,
+  MAXIMUM_DEPTH_EXCEEDED,
+  HANDLER_ABORTED
 } ParserErrorType;
 typedef struct ParserError
 {
   ParserErrorType type;
   Token token;
+  size_t lineCount;
+  size_t charCount;
 } ParserError;
 Token* advance(TokenManager* manager);
 void addObjectPair(JsonNode* node, JsonNode* pairNode);
@@ -110,17 +134,109 @@ void addElement(JsonNode* node, JsonNode* elemNode);
 JsonNode* parseObject(FILE* jsonFile, TokenManager* manager, ParserError* error);
 JsonNode* parseArray(FILE* jsonFile, TokenManager* manager, ParserError* error);
 JsonNode* parseString(FILE* jsonFile, Token* token);
+#define JSON_REPLACEMENT_CHARACTER 0xFFFD
+bool isJsonHighSurrogate(unsigned long codePoint);
+bool isJsonLowSurrogate(unsigned long codePoint);
+void unescapeJsonString(char* str);
 JsonNode* parseInteger(FILE* jsonFile, Token* token, ParserError* error);
 JsonNode* parseDouble(FILE* jsonFile, Token* token, ParserError* error);
 JsonNode* parseBoolean(FILE* jsonFile, Token* token);
 JsonNode* parseNull(FILE* jsonFile, Token* token);
 JsonNode* parse(FILE* jsonFile, TokenManager* manager, ParserError* error);
 void freeJsonTree(JsonNode* node);
+#define VEC_MIN_CAPACITY 8
 void* vec_alloc(void* vec, size_t* cap, const size_t size, const size_t elemSize);
+void* vec_reserve(void* vec, size_t* cap, const size_t capacity, const size_t elemSize);
+void* vec_shrink_to_fit(void* vec, size_t* cap, const size_t size, const size_t elemSize);
+void getFilePosition(FILE* jsonFile, size_t offset, size_t* lineCount, size_t* charCount);
+void locateParserError(FILE* jsonFile, ParserError* error);
 void printError(const char* errorType, size_t lineCount, size_t charCount, const char* message);
 void printLexError(LexError* error);
 void printParseError(ParserError* error);
 void printTokens(TokenManager* manager);
 void printWithIndent(size_t indent, const char* fmt, ...);
 void traverse(JsonNode* node, size_t indent, bool isArrayNode);
+#define JSON_STREAM_BUFFER_SIZE 65536
+#define JSON_STREAM_MAX_DEPTH 64
+typedef size_t (*JsonStreamRead)(void* source, char* buffer, size_t size);
+typedef struct JsonStreamHandler
+{
+  bool (*onObjectStart)(void* userData);
+  bool (*onObjectEnd)(void* userData);
+  bool (*onArrayStart)(void* userData);
+  bool (*onArrayEnd)(void* userData);
+  bool (*onKey)(void* userData, const char* key, size_t length);
+  bool (*onString)(void* userData, const char* str, size_t length);
+  bool (*onInteger)(void* userData, long long value);
+  bool (*onDouble)(void* userData, double value);
+  bool (*onBoolean)(void* userData, bool value);
+  bool (*onNull)(void* userData);
+} JsonStreamHandler;
+typedef struct JsonStreamError
+{
+  LexErrorType lexType;
+  ParserErrorType parserType;
+  size_t lineCount;
+  size_t charCount;
+} JsonStreamError;
+size_t readJsonFileSource(void* source, char* buffer, size_t size);
+bool parseJsonStream(JsonStreamRead read, void* source, JsonStreamHandler* handler, void* userData, JsonStreamError* error);
+bool parseJsonFileStream(FILE* jsonFile, JsonStreamHandler* handler, void* userData, JsonStreamError* error);
+bool parseJsonBufferStream(const char* data, size_t size, JsonStreamHandler* handler, void* userData, JsonStreamError* error);
+void printJsonStreamError(JsonStreamError* error);
+#define JSON_DOCUMENT_WINDOW_SIZE 65536
+#define JSON_DOCUMENT_MAX_INDEXES 8
+typedef struct JsonDocumentField
+{
+  uint32_t hash;
+  size_t keyOffset;
+  size_t keyLength;
+  size_t valuePos;
+} JsonDocumentField;
+typedef struct JsonDocumentIndex
+{
+  size_t objectPos;
+  size_t resumePos;
+  bool resumeInValue;
+  JsonDocumentField* fields;
+  size_t fieldCount;
+  size_t fieldCapacity;
+  char* keys;
+  size_t keysSize;
+  size_t keysCapacity;
+  uint32_t* slots;
+  size_t mask;
+} JsonDocumentIndex;
+typedef struct JsonDocument
+{
+  FILE* jsonFile;
+  char* window;
+  size_t windowStart;
+  size_t windowSize;
+  size_t* matchKeys;
+  size_t* matchValues;
+  size_t matchCapacity;
+  size_t matchSize;
+  JsonDocumentIndex indexes[JSON_DOCUMENT_MAX_INDEXES];
+  size_t indexCount;
+  size_t nextIndex;
+} JsonDocument;
+typedef struct JsonCursor
+{
+  JsonDocument* document;
+  size_t pos;
+  bool inObject;
+} JsonCursor;
+JsonDocument* openJsonDocument(FILE* jsonFile);
+void closeJsonDocument(JsonDocument* document);
+bool getJsonRoot(JsonDocument* document, JsonCursor* cursor);
+JsonNodeType getJsonCursorType(const JsonCursor* cursor);
+bool getJsonField(const JsonCursor* object, const JsonKey* key, JsonCursor* field);
+bool getJsonElement(const JsonCursor* array, size_t index, JsonCursor* element);
+bool getJsonFirstChild(const JsonCursor* container, JsonCursor* child);
+bool getJsonNextSibling(const JsonCursor* child, JsonCursor* next);
+bool getJsonCursorInteger(const JsonCursor* cursor, long long* value);
+bool getJsonCursorDouble(const JsonCursor* cursor, double* value);
+bool getJsonCursorBoolean(const JsonCursor* cursor, bool* value);
+char* getJsonCursorString(const JsonCursor* cursor);
 #endif // JSON_PARSER_C
@@ -0,0 +1,113 @@
+#include "page-cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+PageCache* createPageCache(size_t size, size_t pageSize)
+{
+  size_t pageCount = size / pageSize;
+  if (pageCount == 0)
+    pageCount = 1;
+
+  void* pages = NULL;
+  if (posix_memalign(&pages, PAGE_CACHE_ALIGNMENT, pageCount * pageSize) != 0)
+    return NULL;
+
+  PageCache* cache = (PageCache*)malloc(sizeof(PageCache));
+  cache->pageSize = pageSize;
+  cache->pageCount = pageCount;
+  cache->pages = (char*)pages;
+  cache->entries = (PageCacheEntry*)calloc(pageCount, sizeof(PageCacheEntry));
+  cache->clock = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+  cache->lastOwner = 0;
+  pthread_mutex_init(&cache->mutex, NULL);
+  return cache;
+}
+
+void destroyPageCache(PageCache* cache)
+{
+  pthread_mutex_destroy(&cache->mutex);
+  free(cache->entries);
+  free(cache->pages);
+  free(cache);
+}
+
+bool isSamePageCacheKey(const PageCacheKey* a, const PageCacheKey* b)
+{
+  return a->device == b->device && a->inode == b->inode && a->modified == b->modified &&
+         a->fileSize == b->fileSize && a->generation == b->generation && a->offset == b->offset;
+}
+
+// The cache holds a few dozen pages, a linear search is cheaper than
+// keeping a hash table in sync
+PageCacheEntry* findPageCacheEntry(PageCache* cache, const PageCacheKey* key)
+{
+  for (size_t i = 0; i < cache->pageCount; i++)
+  {
+    if (cache->entries[i].used && isSamePageCacheKey(&cache->entries[i].key, key))
+      return &cache->entries[i];
+  }
+  return NULL;
+}
+
+bool readPageCache(PageCache* cache, const PageCacheKey* key, uint64_t owner, void* data, size_t* size)
+{
+  pthread_mutex_lock(&cache->mutex);
+  PageCacheEntry* entry = findPageCacheEntry(cache, key);
+  if (entry)
+  {
+    entry->lastUse = ++cache->clock;
+    entry->owner = owner;
+    memcpy(data, cache->pages + (entry - cache->entries) * cache->pageSize, entry->size);
+    *size = entry->size;
+    cache->hits++;
+  }
+  else
+  {
+    cache->misses++;
+  }
+  pthread_mutex_unlock(&cache->mutex);
+  return entry != NULL;
+}
+
+void writePageCache(PageCache* cache, const PageCacheKey* key, uint64_t owner, const void* data, size_t size)
+{
+  pthread_mutex_lock(&cache->mutex);
+  // A page already holding the key, then a free one, otherwise the least
+  // recently used one that this owner has not used yet
+  PageCacheEntry* victim = findPageCacheEntry(cache, key);
+  for (size_t i = 0; !victim && i < cache->pageCount; i++)
+  {
+    if (!cache->entries[i].used)
+      victim = &cache->entries[i];
+  }
+  if (!victim)
+  {
+    for (size_t i = 0; i < cache->pageCount; i++)
+    {
+      PageCacheEntry* entry = &cache->entries[i];
+      if (entry->owner != owner && (!victim || entry->lastUse < victim->lastUse))
+        victim = entry;
+    }
+  }
+
+  if (victim)
+  {
+    victim->key = *key;
+    victim->size = size;
+    victim->lastUse = ++cache->clock;
+    victim->owner = owner;
+    victim->used = true;
+    memcpy(cache->pages + (victim - cache->entries) * cache->pageSize, data, size);
+  }
+  pthread_mutex_unlock(&cache->mutex);
+}
+
+uint64_t newPageCacheOwner(PageCache* cache)
+{
+  pthread_mutex_lock(&cache->mutex);
+  uint64_t owner = ++cache->lastOwner;
+  pthread_mutex_unlock(&cache->mutex);
+  return owner;
+}
@@ -0,0 +1,171 @@
+/**
+ * @file page-cache.h
+ * @brief Piccola cache di pagine di file tenuta dal processo.
+ *
+ * Serve quando i file vengono letti con O_DIRECT e quindi senza la cache
+ * del kernel: la memoria usata è fissata alla creazione e allocata tutta
+ * insieme, allineata per le letture dirette.
+ *
+ * Ogni pagina è identificata dal file (dispositivo e inode), dalla sua
+ * versione (data di modifica e dimensione) e dalla posizione, quindi le
+ * pagine di un file modificato non vengono più restituite. Quando la cache
+ * è piena viene sostituita la pagina usata meno di recente, ma mai una
+ * pagina già usata dallo stesso proprietario (ad esempio la stessa
+ * scansione): una scansione più grande della cache ne conserva l'inizio
+ * invece di sostituire di continuo le proprie pagine.
+ *
+ * Tutte le funzioni possono essere chiamate da più thread.
+ */
+
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Dimensione predefinita della cache in byte.
+ */
+#define PAGE_CACHE_DEFAULT_SIZE (16 << 20)
+
+/**
+ * @brief Allineamento delle pagine in memoria.
+ */
+#define PAGE_CACHE_ALIGNMENT 4096
+
+/**
+ * @struct PageCacheKey
+ * @brief Identità di una pagina.
+ *
+ * @var device
+ * Dispositivo del file.
+ * @var inode
+ * Inode del file.
+ * @var modified
+ * Data di modifica del file in nanosecondi.
+ * @var fileSize
+ * Dimensione del file.
+ * @var generation
+ * Versione del file scritta dal processo; cambia anche quando la data di
+ * modifica e la dimensione restano uguali.
+ * @var offset
+ * Posizione della pagina nel file.
+ */
+typedef struct PageCacheKey
+{
+  uint64_t device;
+  uint64_t inode;
+  uint64_t modified;
+  uint64_t fileSize;
+  uint64_t generation;
+  uint64_t offset;
+} PageCacheKey;
+
+/**
+ * @struct PageCacheEntry
+ * @brief Pagina presente nella cache.
+ *
+ * @var key
+ * Identità della pagina.
+ * @var size
+ * Byte validi della pagina.
+ * @var lastUse
+ * Istante dell'ultimo uso, in numero di accessi alla cache.
+ * @var owner
+ * Ultimo proprietario che ha usato la pagina.
+ * @var used
+ * false se la pagina è libera.
+ */
+typedef struct PageCacheEntry
+{
+  PageCacheKey key;
+  size_t size;
+  uint64_t lastUse;
+  uint64_t owner;
+  bool used;
+} PageCacheEntry;
+
+/**
+ * @struct PageCache
+ * @brief Cache di pagine.
+ *
+ * @var pageSize
+ * Dimensione di una pagina.
+ * @var pageCount
+ * Numero di pagine.
+ * @var pages
+ * Memoria allineata di tutte le pagine.
+ * @var entries
+ * Descrizione di ogni pagina.
+ * @var clock
+ * Numero di accessi alla cache.
+ * @var hits
+ * Letture trovate nella cache.
+ * @var misses
+ * Letture non trovate nella cache.
+ * @var lastOwner
+ * Ultimo identificatore di proprietario assegnato.
+ * @var mutex
+ * Mutex che protegge la cache.
+ */
+typedef struct PageCache
+{
+  size_t pageSize;
+  size_t pageCount;
+  char* pages;
+  PageCacheEntry* entries;
+  uint64_t clock;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t lastOwner;
+  pthread_mutex_t mutex;
+} PageCache;
+
+/**
+ * @brief Crea una cache.
+ * @param size Memoria totale in byte (almeno una pagina).
+ * @param pageSize Dimensione di una pagina, multiplo di PAGE_CACHE_ALIGNMENT.
+ * @return Puntatore alla cache, NULL se la memoria non basta.
+ */
+PageCache* createPageCache(size_t size, size_t pageSize);
+
+/**
+ * @brief Libera una cache.
+ * @param cache Puntatore alla cache.
+ */
+void destroyPageCache(PageCache* cache);
+
+/**
+ * @brief Copia una pagina dalla cache, se presente.
+ * @param cache Puntatore alla cache.
+ * @param key Identità della pagina.
+ * @param owner Proprietario che usa la pagina.
+ * @param data Destinazione, grande almeno una pagina.
+ * @param size Byte copiati.
+ * @return true se la pagina era nella cache.
+ */
+bool readPageCache(PageCache* cache, const PageCacheKey* key, uint64_t owner, void* data, size_t* size);
+
+/**
+ * @brief Copia una pagina nella cache.
+ *
+ * La pagina non viene salvata se tutte quelle presenti sono già state
+ * usate dallo stesso proprietario.
+ *
+ * @param cache Puntatore alla cache.
+ * @param key Identità della pagina.
+ * @param owner Proprietario che salva la pagina.
+ * @param data Contenuto della pagina.
+ * @param size Byte validi, al massimo una pagina.
+ */
+void writePageCache(PageCache* cache, const PageCacheKey* key, uint64_t owner, const void* data, size_t size);
+
+/**
+ * @brief Restituisce un identificatore nuovo per un proprietario.
+ * @param cache Puntatore alla cache.
+ */
+uint64_t newPageCacheOwner(PageCache* cache);
+
+#endif // PAGE_CACHE_H
@@ -0,0 +1,337 @@
+#include "person-aggregate.h"
+#include "person-scan.h"
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void initPersonAggregate(PersonAggregate* aggregate)
+{
+  memset(aggregate, 0, sizeof(PersonAggregate));
+  aggregate->minAge = INT_MAX;
+  aggregate->maxAge = INT_MIN;
+  aggregate->minNameLength = SIZE_MAX;
+}
+
+void mergePersonAggregate(PersonAggregate* aggregate, const PersonAggregate* partial)
+{
+  aggregate->count += partial->count;
+  aggregate->minAge = partial->minAge < aggregate->minAge ? partial->minAge : aggregate->minAge;
+  aggregate->maxAge = partial->maxAge > aggregate->maxAge ? partial->maxAge : aggregate->maxAge;
+  aggregate->ageSum += partial->ageSum;
+  for (size_t i = 0; i < PERSON_AGE_BUCKETS; i++)
+    aggregate->ageHistogram[i] += partial->ageHistogram[i];
+  aggregate->minNameLength = partial->minNameLength < aggregate->minNameLength ? partial->minNameLength : aggregate->minNameLength;
+  aggregate->maxNameLength = partial->maxNameLength > aggregate->maxNameLength ? partial->maxNameLength : aggregate->maxNameLength;
+  aggregate->nameLengthSum += partial->nameLengthSum;
+  aggregate->skippedChunks += partial->skippedChunks;
+}
+
+size_t getAgeBucket(int age)
+{
+  if (age < PERSON_AGE_BUCKET_WIDTH)
+    return 0;
+  size_t bucket = (size_t)(age / PERSON_AGE_BUCKET_WIDTH);
+  return bucket < PERSON_AGE_BUCKETS ? bucket : PERSON_AGE_BUCKETS - 1;
+}
+
+void aggregatePersonRows(PersonAggregate* aggregate, const int32_t* ages, const uint32_t* nameOffsets, size_t first, size_t count, const PersonAgeFilter* filter)
+{
+  for (size_t i = first; i < count; i++)
+  {
+    int age = ages[i];
+    if (age < filter->minAge || age > filter->maxAge)
+      continue;
+
+    size_t nameLength = nameOffsets[i + 1] - nameOffsets[i];
+    aggregate->count++;
+    aggregate->minAge = age < aggregate->minAge ? age : aggregate->minAge;
+    aggregate->maxAge = age > aggregate->maxAge ? age : aggregate->maxAge;
+    aggregate->ageSum += age;
+    aggregate->ageHistogram[getAgeBucket(age)]++;
+    aggregate->minNameLength = nameLength < aggregate->minNameLength ? nameLength : aggregate->minNameLength;
+    aggregate->maxNameLength = nameLength > aggregate->maxNameLength ? nameLength : aggregate->maxNameLength;
+    aggregate->nameLengthSum += nameLength;
+  }
+}
+
+#if defined(__SSE2__)
+// SSE2 has no 32-bit min/max, so they are built from a compare and a blend
+static inline __m128i selectInt32(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline int horizontalMin(__m128i v)
+{
+  int32_t lanes[4];
+  _mm_storeu_si128((__m128i*)lanes, v);
+  int result = lanes[0];
+  for (size_t i = 1; i < 4; i++)
+    result = lanes[i] < result ? lanes[i] : result;
+  return result;
+}
+
+static inline int horizontalMax(__m128i v)
+{
+  int32_t lanes[4];
+  _mm_storeu_si128((__m128i*)lanes, v);
+  int result = lanes[0];
+  for (size_t i = 1; i < 4; i++)
+    result = lanes[i] > result ? lanes[i] : result;
+  return result;
+}
+
+static inline long long horizontalSum64(__m128i v)
+{
+  int64_t lanes[2];
+  _mm_storeu_si128((__m128i*)lanes, v);
+  return lanes[0] + lanes[1];
+}
+
+static inline size_t horizontalSum32(__m128i v)
+{
+  uint32_t lanes[4];
+  _mm_storeu_si128((__m128i*)lanes, v);
+  return (size_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+void aggregatePersonBatch(PersonAggregate* aggregate, const int32_t* ages, const uint32_t* nameOffsets, size_t count, const PersonAgeFilter* filter)
+{
+  const __m128i ones = _mm_set1_epi32(-1);
+  const __m128i minFilter = _mm_set1_epi32(filter->minAge);
+  const __m128i maxFilter = _mm_set1_epi32(filter->maxAge);
+  const __m128i intMax = _mm_set1_epi32(INT_MAX);
+  const __m128i intMin = _mm_set1_epi32(INT_MIN);
+  const __m128i zero = _mm_setzero_si128();
+
+  __m128i counts = zero;
+  __m128i minAges = intMax;
+  __m128i maxAges = intMin;
+  __m128i ageSums = zero;
+  __m128i minLengths = intMax;
+  __m128i maxLengths = zero;
+  __m128i lengthSums = zero;
+
+  // below[k] counts the rows younger than k * PERSON_AGE_BUCKET_WIDTH, the buckets are the differences
+  __m128i below[PERSON_AGE_BUCKETS];
+  __m128i bounds[PERSON_AGE_BUCKETS];
+  for (size_t k = 0; k < PERSON_AGE_BUCKETS; k++)
+  {
+    below[k] = zero;
+    bounds[k] = _mm_set1_epi32((int)(k * PERSON_AGE_BUCKET_WIDTH));
+  }
+
+  // The 32-bit lane counters can't overflow within one column chunk
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128i age = _mm_loadu_si128((const __m128i*)(ages + i));
+    __m128i outside = _mm_or_si128(_mm_cmplt_epi32(age, minFilter), _mm_cmpgt_epi32(age, maxFilter));
+    __m128i inside = _mm_andnot_si128(outside, ones);
+
+    counts = _mm_sub_epi32(counts, inside);
+
+    __m128i masked = _mm_and_si128(inside, age);
+    __m128i sign = _mm_srai_epi32(masked, 31);
+    ageSums = _mm_add_epi64(ageSums, _mm_unpacklo_epi32(masked, sign));
+    ageSums = _mm_add_epi64(ageSums, _mm_unpackhi_epi32(masked, sign));
+
+    __m128i low = selectInt32(inside, age, intMax);
+    minAges = selectInt32(_mm_cmplt_epi32(low, minAges), low, minAges);
+    __m128i high = selectInt32(inside, age, intMin);
+    maxAges = selectInt32(_mm_cmpgt_epi32(high, maxAges), high, maxAges);
+
+    for (size_t k = 1; k < PERSON_AGE_BUCKETS; k++)
+      below[k] = _mm_sub_epi32(below[k], _mm_and_si128(inside, _mm_cmplt_epi32(age, bounds[k])));
+
+    __m128i length = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(nameOffsets + i + 1)), _mm_loadu_si128((const __m128i*)(nameOffsets + i)));
+    lengthSums = _mm_add_epi32(lengthSums, _mm_and_si128(inside, length));
+    __m128i shortest = selectInt32(inside, length, intMax);
+    minLengths = selectInt32(_mm_cmplt_epi32(shortest, minLengths), shortest, minLengths);
+    __m128i longest = _mm_and_si128(inside, length);
+    maxLengths = selectInt32(_mm_cmpgt_epi32(longest, maxLengths), longest, maxLengths);
+  }
+
+  PersonAggregate partial;
+  initPersonAggregate(&partial);
+  partial.count = horizontalSum32(counts);
+  if (partial.count > 0)
+  {
+    partial.minAge = horizontalMin(minAges);
+    partial.maxAge = horizontalMax(maxAges);
+    partial.minNameLength = (size_t)horizontalMin(minLengths);
+    partial.maxNameLength = (size_t)horizontalMax(maxLengths);
+  }
+  partial.ageSum = horizontalSum64(ageSums);
+  partial.nameLengthSum = horizontalSum32(lengthSums);
+
+  size_t previous = 0;
+  for (size_t k = 1; k < PERSON_AGE_BUCKETS; k++)
+  {
+    size_t current = horizontalSum32(below[k]);
+    partial.ageHistogram[k - 1] = current - previous;
+    previous = current;
+  }
+  partial.ageHistogram[PERSON_AGE_BUCKETS - 1] = partial.count - previous;
+
+  mergePersonAggregate(aggregate, &partial);
+  aggregatePersonRows(aggregate, ages, nameOffsets, i, count, filter);
+}
+#else
+void aggregatePersonBatch(PersonAggregate* aggregate, const int32_t* ages, const uint32_t* nameOffsets, size_t count, const PersonAgeFilter* filter)
+{
+  aggregatePersonRows(aggregate, ages, nameOffsets, 0, count, filter);
+}
+#endif
+
+typedef struct PersonAggregateJob
+{
+  const char* filename;
+  const PersonAgeFilter* filter;
+  size_t nextChunk;
+  bool failed;
+  PersonAggregate aggregate;
+  pthread_mutex_t mutex;
+} PersonAggregateJob;
+
+static void* runPersonAggregateWorker(void* arg)
+{
+  PersonAggregateJob* job = (PersonAggregateJob*)arg;
+
+  // Each worker has its own handle, a shared FILE would serialize the seeks
+  PersonColumns* columns = openPersonColumns(job->filename);
+  PersonAggregate aggregate;
+  initPersonAggregate(&aggregate);
+  PersonColumnData data;
+  initPersonColumnData(&data);
+  bool success = columns != NULL;
+
+  while (success)
+  {
+    pthread_mutex_lock(&job->mutex);
+    size_t chunk = job->nextChunk++;
+    pthread_mutex_unlock(&job->mutex);
+
+    if (chunk >= columns->chunkCount)
+      break;
+
+    const PersonColumnChunk* descriptor = &columns->chunks[chunk];
+    if (descriptor->maxAge < job->filter->minAge || descriptor->minAge > job->filter->maxAge)
+    {
+      aggregate.skippedChunks++;
+      continue;
+    }
+
+    success = readPersonColumnChunk(columns, chunk, PERSON_AGE_COLUMN | PERSON_NAME_OFFSETS_COLUMN, &data);
+    if (success)
+      aggregatePersonBatch(&aggregate, (const int32_t*)data.ages.data, (const uint32_t*)data.nameOffsets.data, data.rowCount, job->filter);
+  }
+
+  pthread_mutex_lock(&job->mutex);
+  if (success)
+    mergePersonAggregate(&job->aggregate, &aggregate);
+  else
+    job->failed = true;
+  pthread_mutex_unlock(&job->mutex);
+
+  freePersonColumnData(&data);
+  if (columns)
+    closePersonColumns(columns);
+  return NULL;
+}
+
+bool aggregatePersonColumns(const char* filename, const PersonAgeFilter* filter, size_t threadCount, PersonAggregate* aggregate)
+{
+  if (threadCount == 0)
+    threadCount = 1;
+
+  PersonAggregateJob job;
+  job.filename = filename;
+  job.filter = filter;
+  job.nextChunk = 0;
+  job.failed = false;
+  initPersonAggregate(&job.aggregate);
+  pthread_mutex_init(&job.mutex, NULL);
+
+  pthread_t* workers = (pthread_t*)malloc(threadCount * sizeof(pthread_t));
+  for (size_t i = 0; i < threadCount; i++)
+    pthread_create(&workers[i], NULL, runPersonAggregateWorker, &job);
+  for (size_t i = 0; i < threadCount; i++)
+    pthread_join(workers[i], NULL);
+
+  free(workers);
+  pthread_mutex_destroy(&job.mutex);
+
+  *aggregate = job.aggregate;
+  return !job.failed;
+}
+
+void flushPersonAggregateBatch(PersonAggregate* aggregate, PersonColumnData* data, uint32_t* nameOffset, const PersonAgeFilter* filter)
+{
+  appendBuffer(&data->nameOffsets, nameOffset, sizeof(uint32_t));
+  aggregatePersonBatch(aggregate, (const int32_t*)data->ages.data, (const uint32_t*)data->nameOffsets.data, data->rowCount, filter);
+  clearBuffer(&data->ages);
+  clearBuffer(&data->nameOffsets);
+  data->rowCount = 0;
+  *nameOffset = 0;
+}
+
+void aggregatePersonDb(FILE* fp, const PersonAgeFilter* filter, PersonAggregate* aggregate)
+{
+  initPersonAggregate(aggregate);
+
+  // Rows are decoded into the same column batches the columnar path uses
+  PersonColumnData data;
+  initPersonColumnData(&data);
+
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  uint32_t nameOffset = 0;
+  while (nextPersonScanRecord(&scan, &person))
+  {
+    int32_t age = person.age;
+    appendBuffer(&data.ages, &age, sizeof(int32_t));
+    appendBuffer(&data.nameOffsets, &nameOffset, sizeof(uint32_t));
+    nameOffset += (uint32_t)strlen(person.name);
+    data.rowCount++;
+
+    if (data.rowCount == PERSON_COLUMN_CHUNK_ROWS || nameOffset > UINT32_MAX / 2)
+      flushPersonAggregateBatch(aggregate, &data, &nameOffset, filter);
+  }
+  closePersonScan(&scan);
+  if (data.rowCount > 0)
+    flushPersonAggregateBatch(aggregate, &data, &nameOffset, filter);
+
+  freePersonColumnData(&data);
+}
+
+void printPersonAggregate(const PersonAggregate* aggregate)
+{
+  printf("Persone: %zu\n", aggregate->count);
+  if (aggregate->count == 0)
+    return;
+
+  printf("Et\u00e0 minima: %d\n", aggregate->minAge);
+  printf("Et\u00e0 massima: %d\n", aggregate->maxAge);
+  printf("Et\u00e0 media: %.2f\n", (double)aggregate->ageSum / aggregate->count);
+  printf("Lunghezza dei nomi: min %zu, max %zu, media %.2f\n", aggregate->minNameLength, aggregate->maxNameLength,
+         (double)aggregate->nameLengthSum / aggregate->count);
+
+  printf("\nFasce di et\u00e0:\n");
+  for (size_t i = 0; i < PERSON_AGE_BUCKETS; i++)
+  {
+    if (aggregate->ageHistogram[i] == 0)
+      continue;
+
+    if (i == PERSON_AGE_BUCKETS - 1)
+      printf("%4d+     : %zu\n", (int)(i * PERSON_AGE_BUCKET_WIDTH), aggregate->ageHistogram[i]);
+    else
+      printf("%4d - %3d: %zu\n", (int)(i * PERSON_AGE_BUCKET_WIDTH), (int)((i + 1) * PERSON_AGE_BUCKET_WIDTH - 1), aggregate->ageHistogram[i]);
+  }
+}
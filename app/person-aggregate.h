@@ -0,0 +1,125 @@
+/**
+ * @file person-aggregate.h
+ * @brief Statistiche aggregate sulle persone.
+ *
+ * Calcola conteggio, età minima, massima e media, l'istogramma delle età
+ * e le statistiche sulla lunghezza dei nomi. I calcoli lavorano su blocchi
+ * di colonne (età e offset dei nomi) con istruzioni SSE2 quando sono
+ * disponibili, e possono leggere sia il file colonnare, in parallelo, sia
+ * direttamente il database.
+ */
+
+#ifndef PERSON_AGGREGATE_H
+#define PERSON_AGGREGATE_H
+
+#include "person-columns.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Ampiezza in anni di ogni fascia dell'istogramma.
+ */
+#define PERSON_AGE_BUCKET_WIDTH 10
+
+/**
+ * @brief Numero di fasce dell'istogramma; l'ultima contiene tutte le età
+ *        maggiori o uguali al suo inizio.
+ */
+#define PERSON_AGE_BUCKETS 16
+
+/**
+ * @struct PersonAgeFilter
+ * @brief Intervallo di età (estremi inclusi) delle persone da considerare.
+ */
+typedef struct PersonAgeFilter
+{
+  int minAge;
+  int maxAge;
+} PersonAgeFilter;
+
+/**
+ * @struct PersonAggregate
+ * @brief Risultato di un'aggregazione.
+ *
+ * @var count
+ * Numero di persone considerate.
+ * @var minAge, maxAge, ageSum
+ * Età minima, massima e somma delle età.
+ * @var ageHistogram
+ * Numero di persone per fascia di età.
+ * @var minNameLength, maxNameLength, nameLengthSum
+ * Lunghezza minima, massima e somma delle lunghezze dei nomi.
+ * @var skippedChunks
+ * Blocchi saltati grazie alle statistiche min/max.
+ */
+typedef struct PersonAggregate
+{
+  size_t count;
+  int minAge;
+  int maxAge;
+  long long ageSum;
+  size_t ageHistogram[PERSON_AGE_BUCKETS];
+  size_t minNameLength;
+  size_t maxNameLength;
+  size_t nameLengthSum;
+  size_t skippedChunks;
+} PersonAggregate;
+
+/**
+ * @brief Inizializza un'aggregazione vuota.
+ *
+ * @param aggregate Puntatore all'aggregazione.
+ */
+void initPersonAggregate(PersonAggregate* aggregate);
+
+/**
+ * @brief Unisce un'aggregazione parziale in un'altra.
+ *
+ * @param aggregate Aggregazione da aggiornare.
+ * @param partial Aggregazione parziale da aggiungere.
+ */
+void mergePersonAggregate(PersonAggregate* aggregate, const PersonAggregate* partial);
+
+/**
+ * @brief Aggiunge un blocco di righe all'aggregazione.
+ *
+ * @param aggregate Aggregazione da aggiornare.
+ * @param ages Colonna delle età.
+ * @param nameOffsets Offset dei nomi (count + 1 elementi).
+ * @param count Numero di righe del blocco.
+ * @param filter Intervallo di età delle righe da considerare.
+ */
+void aggregatePersonBatch(PersonAggregate* aggregate, const int32_t* ages, const uint32_t* nameOffsets, size_t count, const PersonAgeFilter* filter);
+
+/**
+ * @brief Aggrega il file colonnare usando più thread.
+ *
+ * I blocchi il cui intervallo di età non interseca il filtro non vengono
+ * letti.
+ *
+ * @param filename Nome del file colonnare.
+ * @param filter Intervallo di età delle persone da considerare.
+ * @param threadCount Numero di thread da usare.
+ * @param aggregate Risultato dell'aggregazione.
+ * @return true se l'aggregazione ha avuto successo.
+ */
+bool aggregatePersonColumns(const char* filename, const PersonAgeFilter* filter, size_t threadCount, PersonAggregate* aggregate);
+
+/**
+ * @brief Aggrega leggendo direttamente il database, riga per riga.
+ *
+ * @param fp Puntatore al file del database.
+ * @param filter Intervallo di età delle persone da considerare.
+ * @param aggregate Risultato dell'aggregazione.
+ */
+void aggregatePersonDb(FILE* fp, const PersonAgeFilter* filter, PersonAggregate* aggregate);
+
+/**
+ * @brief Stampa un'aggregazione.
+ *
+ * @param aggregate Aggregazione da stampare.
+ */
+void printPersonAggregate(const PersonAggregate* aggregate);
+
+#endif // PERSON_AGGREGATE_H
@@ -0,0 +1,166 @@
+#include "person-bloom.h"
+#include "person-scan.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PERSON_BLOOM_MAGIC "PBLM"
+#define PERSON_BLOOM_VERSION 2
+
+typedef struct PersonBloomHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t autoIncrementId;
+  uint64_t count;
+  double falsePositiveRate;
+  uint64_t capacity;
+} PersonBloomHeader;
+
+// Ids and names share one filter, the first byte keeps their keys apart
+void addPersonIdToBloom(PersonBloom* bloom, size_t id)
+{
+  unsigned char key[1 + sizeof(size_t)];
+  key[0] = 'I';
+  memcpy(key + 1, &id, sizeof(size_t));
+  addToBloomFilter(&bloom->filter, key, sizeof(key));
+}
+
+void addPersonNameToBloom(PersonBloom* bloom, const char* name, Buffer* key)
+{
+  clearBuffer(key);
+  appendBuffer(key, "N", 1);
+  appendBuffer(key, name, strlen(name));
+  addToBloomFilter(&bloom->filter, key->data, key->size);
+}
+
+void buildPersonBloom(FILE* fp, double falsePositiveRate, PersonBloom* bloom)
+{
+  loadPersonMeta(fp, &bloom->meta);
+  bloom->falsePositiveRate = falsePositiveRate;
+
+  // Room for twice the current keys (an id and a name per person), so the
+  // filter is only rebuilt after the db has doubled
+  bloom->capacity = bloom->meta.count * 2 * 2;
+  if (bloom->capacity < PERSON_BLOOM_MIN_CAPACITY)
+    bloom->capacity = PERSON_BLOOM_MIN_CAPACITY;
+  initBloomFilter(&bloom->filter, bloom->capacity, falsePositiveRate);
+
+  Buffer key;
+  initBuffer(&key, 64);
+
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (nextPersonScanRecord(&scan, &person))
+  {
+    addPersonIdToBloom(bloom, person.id);
+    addPersonNameToBloom(bloom, person.name, &key);
+  }
+  closePersonScan(&scan);
+
+  freeBuffer(&key);
+}
+
+bool savePersonBloom(const PersonBloom* bloom, const char* filename)
+{
+  FILE* bloomFile = fopen(filename, "wb");
+  if (!bloomFile)
+    return false;
+
+  PersonBloomHeader header;
+  memset(&header, 0, sizeof(PersonBloomHeader));
+  memcpy(header.magic, PERSON_BLOOM_MAGIC, 4);
+  header.version = PERSON_BLOOM_VERSION;
+  header.autoIncrementId = bloom->meta.autoIncrementId;
+  header.count = bloom->meta.count;
+  header.falsePositiveRate = bloom->falsePositiveRate;
+  header.capacity = bloom->capacity;
+
+  bool success = fwrite(&header, sizeof(PersonBloomHeader), 1, bloomFile) == 1 && writeBloomFilter(&bloom->filter, bloomFile);
+  if (fclose(bloomFile) != 0)
+    success = false;
+  if (!success)
+    remove(filename);
+  return success;
+}
+
+bool loadPersonBloom(const PersonMeta* meta, const char* filename, PersonBloom* bloom, double* falsePositiveRate)
+{
+  FILE* bloomFile = fopen(filename, "rb");
+  if (!bloomFile)
+    return false;
+
+  PersonBloomHeader header;
+  bool valid = fread(&header, sizeof(PersonBloomHeader), 1, bloomFile) == 1 &&
+               memcmp(header.magic, PERSON_BLOOM_MAGIC, 4) == 0 &&
+               header.version == PERSON_BLOOM_VERSION;
+
+  // A stale filter is still useful for the rate it was configured with
+  if (valid && header.falsePositiveRate > 0.0 && header.falsePositiveRate < 1.0)
+    *falsePositiveRate = header.falsePositiveRate;
+
+  valid = valid && header.autoIncrementId == meta->autoIncrementId && header.count == meta->count &&
+          header.capacity > 0 && readBloomFilter(&bloom->filter, bloomFile);
+  fclose(bloomFile);
+
+  if (valid)
+  {
+    bloom->meta = *meta;
+    bloom->falsePositiveRate = *falsePositiveRate;
+    bloom->capacity = (size_t)header.capacity;
+  }
+  return valid;
+}
+
+void openPersonBloom(FILE* fp, const PersonMeta* meta, double falsePositiveRate, const char* filename, PersonBloom* bloom)
+{
+  if (loadPersonBloom(meta, filename, bloom, &falsePositiveRate))
+    return;
+
+  buildPersonBloom(fp, falsePositiveRate, bloom);
+  savePersonBloom(bloom, filename);
+}
+
+void freePersonBloom(PersonBloom* bloom)
+{
+  freeBloomFilter(&bloom->filter);
+}
+
+void addPersonToBloom(PersonBloom* bloom, const Person* person)
+{
+  Buffer key;
+  initBuffer(&key, 64);
+  addPersonIdToBloom(bloom, person->id);
+  addPersonNameToBloom(bloom, person->name, &key);
+  freeBuffer(&key);
+}
+
+bool growPersonBloom(FILE* fp, PersonBloom* bloom)
+{
+  if (bloom->filter.itemCount <= bloom->capacity)
+    return false;
+
+  freePersonBloom(bloom);
+  buildPersonBloom(fp, bloom->falsePositiveRate, bloom);
+  return true;
+}
+
+bool personBloomMayContainId(const PersonBloom* bloom, size_t id)
+{
+  unsigned char key[1 + sizeof(size_t)];
+  key[0] = 'I';
+  memcpy(key + 1, &id, sizeof(size_t));
+  return mayContainBloomFilter(&bloom->filter, key, sizeof(key));
+}
+
+bool personBloomMayContainName(const PersonBloom* bloom, const char* name)
+{
+  Buffer key;
+  initBuffer(&key, 64);
+  appendBuffer(&key, "N", 1);
+  appendBuffer(&key, name, strlen(name));
+  bool result = mayContainBloomFilter(&bloom->filter, key.data, key.size);
+  freeBuffer(&key);
+  return result;
+}
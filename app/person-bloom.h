@@ -0,0 +1,133 @@
+/**
+ * @file person-bloom.h
+ * @brief Filtro di Bloom persistente sugli ID e sui nomi delle persone.
+ *
+ * Permette di rispondere "persona non trovata" senza leggere il database
+ * nella quasi totalità dei casi. Il filtro è salvato in un file separato
+ * insieme ai metadati del database da cui è stato creato e viene ricreato
+ * quando questi non corrispondono più.
+ *
+ * Il filtro viene dimensionato con margine per il doppio delle chiavi del
+ * database; quando le chiavi inserite superano questa capacità viene
+ * ricreato più grande (growPersonBloom), così la probabilità di falsi
+ * positivi resta vicina a quella configurata anche se il database cresce.
+ */
+
+#ifndef PERSON_BLOOM_H
+#define PERSON_BLOOM_H
+
+#include "bloom.h"
+#include "person.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * @brief Nome predefinito del file del filtro.
+ */
+#define PERSON_BLOOM_FILENAME "people.bloom"
+
+/**
+ * @brief Probabilità di falsi positivi predefinita.
+ */
+#define PERSON_BLOOM_FALSE_POSITIVE_RATE 0.01
+
+/**
+ * @brief Capacità minima del filtro in chiavi, anche per un database vuoto.
+ */
+#define PERSON_BLOOM_MIN_CAPACITY 1024
+
+/**
+ * @struct PersonBloom
+ * @brief Filtro di Bloom delle persone.
+ *
+ * @var filter
+ * Filtro con una chiave per ogni ID e una per ogni nome.
+ * @var meta
+ * Metadati del database a cui corrisponde il filtro.
+ * @var falsePositiveRate
+ * Probabilità di falsi positivi con cui è stato dimensionato il filtro.
+ * @var capacity
+ * Numero di chiavi per cui è stato dimensionato il filtro.
+ */
+typedef struct PersonBloom
+{
+  BloomFilter filter;
+  PersonMeta meta;
+  double falsePositiveRate;
+  size_t capacity;
+} PersonBloom;
+
+/**
+ * @brief Crea il filtro leggendo tutte le persone del database.
+ *
+ * @param fp Puntatore al file del database.
+ * @param falsePositiveRate Probabilità di falsi positivi desiderata.
+ * @param bloom Filtro da creare.
+ */
+void buildPersonBloom(FILE* fp, double falsePositiveRate, PersonBloom* bloom);
+
+/**
+ * @brief Salva il filtro su file.
+ *
+ * @return true se il salvataggio ha avuto successo.
+ */
+bool savePersonBloom(const PersonBloom* bloom, const char* filename);
+
+/**
+ * @brief Carica il filtro dal file, oppure lo ricrea e lo salva.
+ *
+ * Il filtro viene ricreato se il file manca, non è valido o non corrisponde
+ * ai metadati del database. La probabilità di falsi positivi salvata nel
+ * file ha la precedenza su quella passata, così una configurazione scelta
+ * in precedenza sopravvive anche alla ricreazione.
+ *
+ * @param fp Puntatore al file del database.
+ * @param meta Metadati attuali del database.
+ * @param falsePositiveRate Probabilità di falsi positivi da usare se il
+ *                          file non esiste.
+ * @param filename Nome del file del filtro.
+ * @param bloom Filtro da caricare.
+ */
+void openPersonBloom(FILE* fp, const PersonMeta* meta, double falsePositiveRate, const char* filename, PersonBloom* bloom);
+
+/**
+ * @brief Libera la memoria del filtro.
+ */
+void freePersonBloom(PersonBloom* bloom);
+
+/**
+ * @brief Aggiunge al filtro l'ID e il nome di una persona.
+ *
+ * @param bloom Puntatore al filtro.
+ * @param person Persona inserita nel database.
+ */
+void addPersonToBloom(PersonBloom* bloom, const Person* person);
+
+/**
+ * @brief Ricrea il filtro dal database se contiene più chiavi della sua
+ *        capacità.
+ *
+ * Va chiamata dopo che le persone aggiunte al filtro sono state scritte
+ * nel database, perché il nuovo filtro viene creato leggendo il file.
+ *
+ * @param fp Puntatore al file del database.
+ * @param bloom Puntatore al filtro.
+ * @return true se il filtro è stato ricreato.
+ */
+bool growPersonBloom(FILE* fp, PersonBloom* bloom);
+
+/**
+ * @brief Verifica se un ID può essere nel database.
+ *
+ * @return false se l'ID è sicuramente assente.
+ */
+bool personBloomMayContainId(const PersonBloom* bloom, size_t id);
+
+/**
+ * @brief Verifica se un nome può essere nel database.
+ *
+ * @return false se il nome è sicuramente assente.
+ */
+bool personBloomMayContainName(const PersonBloom* bloom, const char* name);
+
+#endif // PERSON_BLOOM_H
@@ -0,0 +1,215 @@
+#include "person-columns.h"
+#include "person-scan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PERSON_COLUMNS_MAGIC "PCOL"
+#define PERSON_COLUMNS_VERSION 1
+
+typedef struct PersonColumnsHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t autoIncrementId;
+  uint64_t count;
+  uint64_t chunkCount;
+  uint64_t directoryOffset;
+} PersonColumnsHeader;
+
+bool writePersonColumnChunk(FILE* columnsFile, PersonColumnData* data, PersonColumnChunk* chunk)
+{
+  uint32_t namesSize = (uint32_t)data->names.size;
+  appendBuffer(&data->nameOffsets, &namesSize, sizeof(uint32_t));
+
+  chunk->rowCount = data->rowCount;
+  chunk->idsOffset = ftell(columnsFile);
+  chunk->agesOffset = chunk->idsOffset + data->ids.size;
+  chunk->nameOffsetsOffset = chunk->agesOffset + data->ages.size;
+  chunk->namesOffset = chunk->nameOffsetsOffset + data->nameOffsets.size;
+  chunk->namesSize = data->names.size;
+
+  bool success = flushBuffer(&data->ids, columnsFile) && flushBuffer(&data->ages, columnsFile) &&
+                 flushBuffer(&data->nameOffsets, columnsFile) && flushBuffer(&data->names, columnsFile);
+  data->rowCount = 0;
+  return success;
+}
+
+bool buildPersonColumns(FILE* fp, const char* filename)
+{
+  FILE* columnsFile = fopen(filename, "wb");
+  if (!columnsFile)
+    return false;
+
+  PersonMeta meta;
+  loadPersonMeta(fp, &meta);
+
+  // The header is rewritten at the end once the directory is known
+  PersonColumnsHeader header;
+  memset(&header, 0, sizeof(PersonColumnsHeader));
+  memcpy(header.magic, PERSON_COLUMNS_MAGIC, 4);
+  header.version = PERSON_COLUMNS_VERSION;
+  header.autoIncrementId = meta.autoIncrementId;
+  bool success = fwrite(&header, sizeof(PersonColumnsHeader), 1, columnsFile) == 1;
+
+  PersonColumnData data;
+  initPersonColumnData(&data);
+  Buffer directory;
+  initBuffer(&directory, 0);
+
+  PersonColumnChunk chunk;
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (success && nextPersonScanRecord(&scan, &person))
+  {
+    uint64_t id = person.id;
+    int32_t age = person.age;
+    if (data.rowCount == 0)
+    {
+      chunk.minId = chunk.maxId = id;
+      chunk.minAge = chunk.maxAge = age;
+    }
+    else
+    {
+      chunk.minId = id < chunk.minId ? id : chunk.minId;
+      chunk.maxId = id > chunk.maxId ? id : chunk.maxId;
+      chunk.minAge = age < chunk.minAge ? age : chunk.minAge;
+      chunk.maxAge = age > chunk.maxAge ? age : chunk.maxAge;
+    }
+
+    uint32_t nameOffset = (uint32_t)data.names.size;
+    appendBuffer(&data.ids, &id, sizeof(uint64_t));
+    appendBuffer(&data.ages, &age, sizeof(int32_t));
+    appendBuffer(&data.nameOffsets, &nameOffset, sizeof(uint32_t));
+    appendBuffer(&data.names, person.name, strlen(person.name));
+    data.rowCount++;
+    header.count++;
+
+    // Name offsets are 32-bit, so a chunk is also closed before its heap could overflow them
+    if (data.rowCount == PERSON_COLUMN_CHUNK_ROWS || data.names.size > UINT32_MAX / 2)
+    {
+      success = writePersonColumnChunk(columnsFile, &data, &chunk);
+      appendBuffer(&directory, &chunk, sizeof(PersonColumnChunk));
+      header.chunkCount++;
+    }
+  }
+  if (!closePersonScan(&scan))
+    success = false;
+
+  if (success && data.rowCount > 0)
+  {
+    success = writePersonColumnChunk(columnsFile, &data, &chunk);
+    appendBuffer(&directory, &chunk, sizeof(PersonColumnChunk));
+    header.chunkCount++;
+  }
+
+  if (success)
+  {
+    header.directoryOffset = ftell(columnsFile);
+    success = flushBuffer(&directory, columnsFile);
+  }
+  if (success)
+  {
+    fseek(columnsFile, 0, SEEK_SET);
+    success = fwrite(&header, sizeof(PersonColumnsHeader), 1, columnsFile) == 1;
+  }
+
+  freeBuffer(&directory);
+  freePersonColumnData(&data);
+
+  if (fclose(columnsFile) != 0)
+    success = false;
+  if (!success)
+    remove(filename);
+  return success;
+}
+
+PersonColumns* openPersonColumns(const char* filename)
+{
+  FILE* fp = fopen(filename, "rb");
+  if (!fp)
+    return NULL;
+
+  PersonColumnsHeader header;
+  if (fread(&header, sizeof(PersonColumnsHeader), 1, fp) != 1 ||
+      memcmp(header.magic, PERSON_COLUMNS_MAGIC, 4) != 0 ||
+      header.version != PERSON_COLUMNS_VERSION)
+  {
+    fclose(fp);
+    return NULL;
+  }
+
+  PersonColumns* columns = (PersonColumns*)malloc(sizeof(PersonColumns));
+  columns->fp = fp;
+  columns->meta.autoIncrementId = header.autoIncrementId;
+  columns->meta.count = header.count;
+  columns->chunkCount = header.chunkCount;
+  columns->chunks = (PersonColumnChunk*)malloc((header.chunkCount + 1) * sizeof(PersonColumnChunk));
+
+  fseek(fp, header.directoryOffset, SEEK_SET);
+  if (fread(columns->chunks, sizeof(PersonColumnChunk), header.chunkCount, fp) != header.chunkCount)
+  {
+    closePersonColumns(columns);
+    return NULL;
+  }
+
+  return columns;
+}
+
+void closePersonColumns(PersonColumns* columns)
+{
+  fclose(columns->fp);
+  free(columns->chunks);
+  free(columns);
+}
+
+void initPersonColumnData(PersonColumnData* data)
+{
+  data->rowCount = 0;
+  initBuffer(&data->ids, 0);
+  initBuffer(&data->ages, 0);
+  initBuffer(&data->nameOffsets, 0);
+  initBuffer(&data->names, 0);
+}
+
+void freePersonColumnData(PersonColumnData* data)
+{
+  freeBuffer(&data->ids);
+  freeBuffer(&data->ages);
+  freeBuffer(&data->nameOffsets);
+  freeBuffer(&data->names);
+}
+
+bool readPersonColumn(FILE* fp, uint64_t offset, size_t size, Buffer* column)
+{
+  reserveBuffer(column, size);
+  fseek(fp, offset, SEEK_SET);
+  column->size = fread(column->data, sizeof(char), size, fp);
+  return column->size == size;
+}
+
+bool readPersonColumnChunk(PersonColumns* columns, size_t chunk, unsigned int mask, PersonColumnData* data)
+{
+  if (chunk >= columns->chunkCount)
+    return false;
+
+  const PersonColumnChunk* descriptor = &columns->chunks[chunk];
+  const size_t rowCount = descriptor->rowCount;
+  data->rowCount = rowCount;
+  clearBuffer(&data->ids);
+  clearBuffer(&data->ages);
+  clearBuffer(&data->nameOffsets);
+  clearBuffer(&data->names);
+
+  bool success = true;
+  if (mask & PERSON_ID_COLUMN)
+    success = success && readPersonColumn(columns->fp, descriptor->idsOffset, rowCount * sizeof(uint64_t), &data->ids);
+  if (mask & PERSON_AGE_COLUMN)
+    success = success && readPersonColumn(columns->fp, descriptor->agesOffset, rowCount * sizeof(int32_t), &data->ages);
+  if (mask & (PERSON_NAME_COLUMN | PERSON_NAME_OFFSETS_COLUMN))
+    success = success && readPersonColumn(columns->fp, descriptor->nameOffsetsOffset, (rowCount + 1) * sizeof(uint32_t), &data->nameOffsets);
+  if (mask & PERSON_NAME_COLUMN)
+    success = success && readPersonColumn(columns->fp, descriptor->namesOffset, descriptor->namesSize, &data->names);
+
+  return success;
+}
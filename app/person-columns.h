@@ -0,0 +1,166 @@
+/**
+ * @file person-columns.h
+ * @brief Copia colonnare del database delle persone per le analisi.
+ *
+ * Le persone sono divise in blocchi di righe; ogni blocco salva separatamente
+ * la colonna degli ID, quella delle età e quella degli offset dei nomi,
+ * seguite dall'heap dei nomi. Ogni blocco ha le statistiche min/max, quindi
+ * una query legge solo le colonne che le servono e può saltare i blocchi
+ * che non possono contenere risultati.
+ */
+
+#ifndef PERSON_COLUMNS_H
+#define PERSON_COLUMNS_H
+
+#include "person.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Nome predefinito del file colonnare.
+ */
+#define PERSON_COLUMNS_FILENAME "people.col"
+
+/**
+ * @brief Numero massimo di righe per blocco.
+ */
+#define PERSON_COLUMN_CHUNK_ROWS 65536
+
+/**
+ * @brief Colonne che possono essere lette da un blocco.
+ */
+#define PERSON_ID_COLUMN 1u
+#define PERSON_AGE_COLUMN 2u
+#define PERSON_NAME_COLUMN 4u
+#define PERSON_NAME_OFFSETS_COLUMN 8u
+
+/**
+ * @struct PersonColumnChunk
+ * @brief Descrittore di un blocco di righe nel file colonnare.
+ *
+ * @var rowCount
+ * Numero di righe del blocco.
+ * @var minId, maxId
+ * ID minimo e massimo del blocco.
+ * @var minAge, maxAge
+ * Età minima e massima del blocco.
+ * @var idsOffset, agesOffset, nameOffsetsOffset, namesOffset
+ * Posizione nel file di ciascuna colonna del blocco.
+ * @var namesSize
+ * Dimensione in byte dell'heap dei nomi del blocco.
+ */
+typedef struct PersonColumnChunk
+{
+  uint64_t rowCount;
+  uint64_t minId;
+  uint64_t maxId;
+  int32_t minAge;
+  int32_t maxAge;
+  uint64_t idsOffset;
+  uint64_t agesOffset;
+  uint64_t nameOffsetsOffset;
+  uint64_t namesOffset;
+  uint64_t namesSize;
+} PersonColumnChunk;
+
+/**
+ * @struct PersonColumns
+ * @brief File colonnare aperto in lettura.
+ *
+ * @var fp
+ * File colonnare.
+ * @var meta
+ * Metadati del database da cui è stato creato il file.
+ * @var chunks
+ * Descrittori dei blocchi.
+ * @var chunkCount
+ * Numero di blocchi.
+ */
+typedef struct PersonColumns
+{
+  FILE* fp;
+  PersonMeta meta;
+  PersonColumnChunk* chunks;
+  size_t chunkCount;
+} PersonColumns;
+
+/**
+ * @struct PersonColumnData
+ * @brief Colonne lette da un blocco.
+ *
+ * I buffer vengono riutilizzati tra una lettura e l'altra. Le colonne non
+ * richieste restano vuote.
+ *
+ * @var rowCount
+ * Numero di righe lette.
+ * @var ids
+ * Colonna degli ID (uint64_t).
+ * @var ages
+ * Colonna delle età (int32_t).
+ * @var nameOffsets
+ * Offset dei nomi nell'heap (uint32_t, rowCount + 1 elementi).
+ * @var names
+ * Heap dei nomi, senza terminatori.
+ */
+typedef struct PersonColumnData
+{
+  size_t rowCount;
+  Buffer ids;
+  Buffer ages;
+  Buffer nameOffsets;
+  Buffer names;
+} PersonColumnData;
+
+/**
+ * @brief Crea il file colonnare a partire dal database.
+ *
+ * @param fp Puntatore al file del database.
+ * @param filename Nome del file colonnare da creare.
+ * @return true se il file è stato creato, false in caso di errore.
+ */
+bool buildPersonColumns(FILE* fp, const char* filename);
+
+/**
+ * @brief Apre un file colonnare e ne legge i descrittori dei blocchi.
+ *
+ * @param filename Nome del file colonnare.
+ * @return Puntatore al file aperto, NULL se manca o non è valido.
+ */
+PersonColumns* openPersonColumns(const char* filename);
+
+/**
+ * @brief Chiude un file colonnare e libera la memoria.
+ *
+ * @param columns Puntatore al file colonnare.
+ */
+void closePersonColumns(PersonColumns* columns);
+
+/**
+ * @brief Inizializza dei buffer vuoti per le colonne.
+ *
+ * @param data Puntatore alle colonne.
+ */
+void initPersonColumnData(PersonColumnData* data);
+
+/**
+ * @brief Libera la memoria delle colonne.
+ *
+ * @param data Puntatore alle colonne.
+ */
+void freePersonColumnData(PersonColumnData* data);
+
+/**
+ * @brief Legge le colonne richieste di un blocco.
+ *
+ * @param columns Puntatore al file colonnare.
+ * @param chunk Indice del blocco.
+ * @param mask Combinazione di PERSON_ID_COLUMN, PERSON_AGE_COLUMN,
+ *             PERSON_NAME_COLUMN e PERSON_NAME_OFFSETS_COLUMN (solo gli
+ *             offset, sufficienti per le lunghezze dei nomi).
+ * @param data Colonne in cui leggere.
+ * @return true se la lettura ha avuto successo.
+ */
+bool readPersonColumnChunk(PersonColumns* columns, size_t chunk, unsigned int mask, PersonColumnData* data);
+
+#endif // PERSON_COLUMNS_H
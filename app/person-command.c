@@ -0,0 +1,796 @@
+#include "person-command.h"
+#include "person-scan.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define PERSON_COMMAND_LOOKUP_BATCH 4096
+
+typedef enum PersonCommandField
+{
+  OTHER_COMMAND_FIELD,
+  OP_COMMAND_FIELD,
+  ID_COMMAND_FIELD,
+  AGE_COMMAND_FIELD,
+  NAME_COMMAND_FIELD
+} PersonCommandField;
+
+typedef struct PersonCommandJson
+{
+  PersonCommand* command;
+  PersonCommandField field;
+  size_t depth;
+  bool hasType;
+  bool hasId;
+  bool hasAge;
+  const char* error;
+} PersonCommandJson;
+
+typedef struct PersonLookup
+{
+  size_t id;
+  size_t index;
+  bool found;
+  Person person;
+} PersonLookup;
+
+typedef struct PersonCommandName
+{
+  const char* name;
+  PersonCommandType type;
+} PersonCommandName;
+
+static const PersonCommandName personCommandNames[] = {
+    {"insert", PERSON_COMMAND_INSERT},
+    {"get", PERSON_COMMAND_GET},
+    {"find", PERSON_COMMAND_FIND},
+    {"update", PERSON_COMMAND_UPDATE},
+    {"delete", PERSON_COMMAND_DELETE},
+    {"count", PERSON_COMMAND_COUNT},
+};
+
+bool findPersonCommandType(const char* name, size_t length, PersonCommandType* type)
+{
+  for (size_t i = 0; i < sizeof(personCommandNames) / sizeof(personCommandNames[0]); i++)
+  {
+    if (strlen(personCommandNames[i].name) == length && memcmp(personCommandNames[i].name, name, length) == 0)
+    {
+      *type = personCommandNames[i].type;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char* getPersonCommandName(PersonCommandType type)
+{
+  for (size_t i = 0; i < sizeof(personCommandNames) / sizeof(personCommandNames[0]); i++)
+  {
+    if (personCommandNames[i].type == type)
+      return personCommandNames[i].name;
+  }
+  return "";
+}
+
+char* copyPersonCommandName(const char* name, size_t length)
+{
+  char* copy = (char*)malloc(length + 1);
+  memcpy(copy, name, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+// Each command needs a different set of fields
+const char* checkPersonCommand(const PersonCommand* command, bool hasId, bool hasAge)
+{
+  bool needsId = command->type == PERSON_COMMAND_GET || command->type == PERSON_COMMAND_UPDATE || command->type == PERSON_COMMAND_DELETE;
+  bool needsAge = command->type == PERSON_COMMAND_INSERT || command->type == PERSON_COMMAND_UPDATE;
+  bool needsName = needsAge || command->type == PERSON_COMMAND_FIND;
+
+  if (needsId && !hasId)
+    return "missing id";
+  if (needsAge && !hasAge)
+    return "missing age";
+  if (needsAge && (command->age < PERSON_COMMAND_MIN_AGE || command->age > PERSON_COMMAND_MAX_AGE))
+    return "invalid age";
+  if (needsName && (!command->name || command->name[0] == '\0'))
+    return "missing name";
+  return NULL;
+}
+
+bool failPersonCommandJson(PersonCommandJson* json, const char* error)
+{
+  json->error = error;
+  return false;
+}
+
+bool onPersonCommandObjectStart(void* userData)
+{
+  PersonCommandJson* json = (PersonCommandJson*)userData;
+  if (json->depth++ > 0)
+    return failPersonCommandJson(json, "unexpected object");
+  return true;
+}
+
+bool onPersonCommandObjectEnd(void* userData)
+{
+  ((PersonCommandJson*)userData)->depth--;
+  return true;
+}
+
+bool onPersonCommandArrayStart(void* userData)
+{
+  return failPersonCommandJson((PersonCommandJson*)userData, "unexpected array");
+}
+
+bool onPersonCommandKey(void* userData, const char* key, size_t length)
+{
+  PersonCommandJson* json = (PersonCommandJson*)userData;
+  json->field = OTHER_COMMAND_FIELD;
+  if (length == 2 && memcmp(key, "op", 2) == 0)
+    json->field = OP_COMMAND_FIELD;
+  else if (length == 2 && memcmp(key, "id", 2) == 0)
+    json->field = ID_COMMAND_FIELD;
+  else if (length == 3 && memcmp(key, "age", 3) == 0)
+    json->field = AGE_COMMAND_FIELD;
+  else if (length == 4 && memcmp(key, "name", 4) == 0)
+    json->field = NAME_COMMAND_FIELD;
+  return true;
+}
+
+bool onPersonCommandString(void* userData, const char* str, size_t length)
+{
+  PersonCommandJson* json = (PersonCommandJson*)userData;
+  if (json->depth == 0)
+    return failPersonCommandJson(json, "expected an object");
+
+  switch (json->field)
+  {
+  case OP_COMMAND_FIELD:
+    if (!findPersonCommandType(str, length, &json->command->type))
+      return failPersonCommandJson(json, "unknown op");
+    json->hasType = true;
+    return true;
+  case NAME_COMMAND_FIELD:
+    free(json->command->name);
+    json->command->name = copyPersonCommandName(str, length);
+    return true;
+  case OTHER_COMMAND_FIELD:
+    return true;
+  default:
+    return failPersonCommandJson(json, "expected an integer");
+  }
+}
+
+bool onPersonCommandInteger(void* userData, long long value)
+{
+  PersonCommandJson* json = (PersonCommandJson*)userData;
+  if (json->depth == 0)
+    return failPersonCommandJson(json, "expected an object");
+
+  switch (json->field)
+  {
+  case ID_COMMAND_FIELD:
+    if (value < 0)
+      return failPersonCommandJson(json, "invalid id");
+    json->command->id = (size_t)value;
+    json->hasId = true;
+    return true;
+  case AGE_COMMAND_FIELD:
+    if (value < PERSON_COMMAND_MIN_AGE || value > PERSON_COMMAND_MAX_AGE)
+      return failPersonCommandJson(json, "invalid age");
+    json->command->age = (int)value;
+    json->hasAge = true;
+    return true;
+  case OTHER_COMMAND_FIELD:
+    return true;
+  default:
+    return failPersonCommandJson(json, "expected a string");
+  }
+}
+
+bool onPersonCommandOtherValue(PersonCommandJson* json)
+{
+  if (json->depth == 0 || json->field != OTHER_COMMAND_FIELD)
+    return failPersonCommandJson(json, "unexpected value");
+  return true;
+}
+
+bool onPersonCommandDouble(void* userData, double value)
+{
+  (void)value;
+  return onPersonCommandOtherValue((PersonCommandJson*)userData);
+}
+
+bool onPersonCommandBoolean(void* userData, bool value)
+{
+  (void)value;
+  return onPersonCommandOtherValue((PersonCommandJson*)userData);
+}
+
+bool onPersonCommandNull(void* userData)
+{
+  return onPersonCommandOtherValue((PersonCommandJson*)userData);
+}
+
+const char* parsePersonCommandJson(const char* line, size_t length, PersonCommand* command)
+{
+  PersonCommandJson json;
+  memset(&json, 0, sizeof(PersonCommandJson));
+  json.command = command;
+
+  JsonStreamHandler handler;
+  memset(&handler, 0, sizeof(JsonStreamHandler));
+  handler.onObjectStart = onPersonCommandObjectStart;
+  handler.onObjectEnd = onPersonCommandObjectEnd;
+  handler.onArrayStart = onPersonCommandArrayStart;
+  handler.onKey = onPersonCommandKey;
+  handler.onString = onPersonCommandString;
+  handler.onInteger = onPersonCommandInteger;
+  handler.onDouble = onPersonCommandDouble;
+  handler.onBoolean = onPersonCommandBoolean;
+  handler.onNull = onPersonCommandNull;
+
+  JsonStreamError error;
+  if (!parseJsonBufferStream(line, length, &handler, &json, &error))
+    return json.error ? json.error : "invalid JSON";
+  if (!json.hasType)
+    return "missing op";
+  return checkPersonCommand(command, json.hasId, json.hasAge);
+}
+
+// Reads an unsigned number followed by a space or the end of the line
+bool parsePersonCommandNumber(const char** pos, const char* end, size_t* value)
+{
+  const char* p = *pos;
+  if (p >= end || *p < '0' || *p > '9')
+    return false;
+
+  size_t number = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+  {
+    size_t digit = (size_t)(*p - '0');
+    if (number > ((size_t)-1 - digit) / 10)
+      return false;
+    number = number * 10 + digit;
+    p++;
+  }
+  if (p < end && *p != ' ')
+    return false;
+
+  while (p < end && *p == ' ')
+    p++;
+  *pos = p;
+  *value = number;
+  return true;
+}
+
+const char* parsePersonCommandText(const char* line, size_t length, PersonCommand* command)
+{
+  const char* end = line + length;
+  const char* p = line;
+  while (p < end && *p != ' ')
+    p++;
+  if (!findPersonCommandType(line, p - line, &command->type))
+    return "unknown command";
+  while (p < end && *p == ' ')
+    p++;
+
+  bool hasId = false;
+  bool hasAge = false;
+  if (command->type == PERSON_COMMAND_GET || command->type == PERSON_COMMAND_UPDATE || command->type == PERSON_COMMAND_DELETE)
+  {
+    if (!parsePersonCommandNumber(&p, end, &command->id))
+      return "invalid id";
+    hasId = true;
+  }
+  if (command->type == PERSON_COMMAND_INSERT || command->type == PERSON_COMMAND_UPDATE)
+  {
+    size_t age;
+    if (!parsePersonCommandNumber(&p, end, &age) || age > PERSON_COMMAND_MAX_AGE)
+      return "invalid age";
+    command->age = (int)age;
+    hasAge = true;
+  }
+
+  // The name is the rest of the line and may contain spaces
+  if (command->type == PERSON_COMMAND_INSERT || command->type == PERSON_COMMAND_UPDATE || command->type == PERSON_COMMAND_FIND)
+    command->name = copyPersonCommandName(p, end - p);
+  else if (p != end)
+    return "unexpected arguments";
+
+  return checkPersonCommand(command, hasId, hasAge);
+}
+
+const char* parsePersonCommand(const char* line, size_t length, PersonCommand* command)
+{
+  command->type = PERSON_COMMAND_COUNT;
+  command->id = 0;
+  command->age = 0;
+  command->name = NULL;
+
+  if (length > 0 && line[0] == '{')
+    return parsePersonCommandJson(line, length, command);
+  return parsePersonCommandText(line, length, command);
+}
+
+void freePersonCommand(PersonCommand* command)
+{
+  free(command->name);
+  command->name = NULL;
+}
+
+// The table is only trusted when it was written after the last db change
+PersonTable* openCurrentPersonTable(const PersonMeta* meta)
+{
+  PersonTable* table = openPersonTable(PERSON_TABLE_FILENAME, PERSON_TABLE_HEAP_FILENAME);
+  if (!table)
+    return NULL;
+
+  struct stat tableStat;
+  struct stat dbStat;
+  bool current = table->meta.count == meta->count && table->meta.autoIncrementId == meta->autoIncrementId &&
+                 stat(PERSON_TABLE_FILENAME, &tableStat) == 0 && stat(getPersonDbFilename(), &dbStat) == 0 &&
+                 tableStat.st_mtime > dbStat.st_mtime;
+  if (!current)
+  {
+    closePersonTable(table);
+    return NULL;
+  }
+  return table;
+}
+
+void initPersonCommandContext(PersonCommandContext* context, FILE** fpPtr, PersonMeta* meta, PersonBloom* bloom, const char* bloomFilename, PersonLog* log, void (*onChange)())
+{
+  context->fpPtr = fpPtr;
+  context->meta = meta;
+  context->bloom = bloom;
+  context->bloomFilename = bloomFilename;
+  context->log = log;
+  context->onChange = onChange;
+  initBuffer(&context->inserts, PERSON_IMPORT_BATCH_SIZE + 4096);
+  context->insertCount = 0;
+  initBuffer(&context->lookups, 64 * sizeof(size_t));
+  context->lookupCount = 0;
+  context->bloomChanged = false;
+  context->table = openCurrentPersonTable(meta);
+}
+
+void appendPersonCommandResult(Buffer* output, PersonCommandType type)
+{
+  appendStringToBuffer(output, "{\"ok\":true,\"op\":\"");
+  appendStringToBuffer(output, getPersonCommandName(type));
+  appendStringToBuffer(output, "\"");
+}
+
+void appendPersonCommandError(Buffer* output, const char* op, const char* error)
+{
+  appendStringToBuffer(output, "{\"ok\":false");
+  if (op)
+  {
+    appendStringToBuffer(output, ",\"op\":\"");
+    appendStringToBuffer(output, op);
+    appendStringToBuffer(output, "\"");
+  }
+  appendStringToBuffer(output, ",\"error\":");
+  appendJsonStringToBuffer(output, error);
+  appendStringToBuffer(output, "}\n");
+}
+
+// The filter is only saved at the end, so the copy on disk is removed before
+// the first change; if the process dies the filter is rebuilt at the next start
+void invalidatePersonCommandBloom(PersonCommandContext* context)
+{
+  if (context->bloomChanged)
+    return;
+  remove(context->bloomFilename);
+  context->bloomChanged = true;
+}
+
+void markPersonCommandChange(PersonCommandContext* context)
+{
+  // Every person added to the filter is in the db by now, so it can be rebuilt from it
+  context->bloomChanged = true;
+  growPersonBloom(*context->fpPtr, context->bloom);
+  context->bloom->meta = *context->meta;
+  if (context->table)
+  {
+    closePersonTable(context->table);
+    context->table = NULL;
+  }
+  if (context->onChange)
+    context->onChange();
+}
+
+void flushPersonInserts(PersonCommandContext* context, Buffer* output)
+{
+  if (context->insertCount == 0)
+    return;
+
+  // The whole run of inserts costs one db write, one metadata update and
+  // one log write
+  size_t firstId = context->meta->autoIncrementId;
+  insertEncodedPeople(*context->fpPtr, context->inserts.data, context->inserts.size);
+  context->meta->autoIncrementId += context->insertCount;
+  context->meta->count += context->insertCount;
+  updatePersonMeta(*context->fpPtr, context->meta);
+  fflush(*context->fpPtr);
+  if (context->log)
+    logPersonInserts(context->log, context->inserts.data, context->inserts.size, context->insertCount, context->meta);
+  markPersonCommandChange(context);
+
+  for (size_t i = 0; i < context->insertCount; i++)
+  {
+    appendPersonCommandResult(output, PERSON_COMMAND_INSERT);
+    appendStringToBuffer(output, ",\"id\":");
+    appendSize_tToBuffer(output, firstId + i);
+    appendStringToBuffer(output, "}\n");
+  }
+
+  clearBuffer(&context->inserts);
+  context->insertCount = 0;
+}
+
+int comparePersonLookupIds(const void* a, const void* b)
+{
+  size_t idA = ((const PersonLookup*)a)->id;
+  size_t idB = ((const PersonLookup*)b)->id;
+  return idA < idB ? -1 : idA > idB;
+}
+
+int comparePersonLookupIndexes(const void* a, const void* b)
+{
+  size_t indexA = ((const PersonLookup*)a)->index;
+  size_t indexB = ((const PersonLookup*)b)->index;
+  return indexA < indexB ? -1 : indexA > indexB;
+}
+
+void copyPersonLookup(PersonLookup* lookup, const Person* person)
+{
+  size_t nameLength = strlen(person->name) + 1;
+  lookup->found = true;
+  lookup->person = *person;
+  lookup->person.name = (char*)malloc(nameLength);
+  memcpy(lookup->person.name, person->name, nameLength);
+}
+
+// A run of gets is answered with a single scan of the db
+void scanPersonLookups(PersonCommandContext* context, PersonLookup* lookups, size_t count)
+{
+  size_t pending = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (personBloomMayContainId(context->bloom, lookups[i].id))
+      pending++;
+  }
+  qsort(lookups, count, sizeof(PersonLookup), comparePersonLookupIds);
+
+  if (pending == 0)
+    return;
+
+  PersonScan scan;
+  openPersonScan(&scan, *context->fpPtr);
+  Person person;
+  while (pending > 0 && nextPersonScanRecord(&scan, &person))
+  {
+    size_t low = 0;
+    size_t high = count;
+    while (low < high)
+    {
+      size_t middle = low + (high - low) / 2;
+      if (lookups[middle].id < person.id)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+    // The same id may have been asked for more than once
+    for (size_t i = low; i < count && lookups[i].id == person.id && !lookups[i].found; i++)
+    {
+      copyPersonLookup(&lookups[i], &person);
+      if (pending > 0)
+        pending--;
+    }
+  }
+  closePersonScan(&scan);
+}
+
+// With a current table the gets become binary searches whose page reads
+// are in flight together instead of a full scan
+void findPersonLookupsInTable(PersonCommandContext* context, PersonLookup* lookups, size_t count)
+{
+  uint64_t* ids = (uint64_t*)malloc(count * sizeof(uint64_t));
+  PersonRecord* records = (PersonRecord*)malloc(count * sizeof(PersonRecord));
+  bool* found = (bool*)malloc(count * sizeof(bool));
+  for (size_t i = 0; i < count; i++)
+    ids[i] = lookups[i].id;
+
+  findPersonTableRecords(context->table, ids, count, records, found);
+
+  Buffer overflow;
+  initBuffer(&overflow, 64);
+  for (size_t i = 0; i < count; i++)
+  {
+    if (!found[i])
+      continue;
+
+    Person person;
+    person.id = records[i].id;
+    person.age = records[i].age;
+    person.name = (char*)getPersonRecordName(context->table, &records[i], &overflow);
+    copyPersonLookup(&lookups[i], &person);
+  }
+
+  freeBuffer(&overflow);
+  free(found);
+  free(records);
+  free(ids);
+}
+
+void flushPersonLookups(PersonCommandContext* context, Buffer* output)
+{
+  size_t count = context->lookupCount;
+  if (count == 0)
+    return;
+
+  const size_t* ids = (const size_t*)context->lookups.data;
+  PersonLookup* lookups = (PersonLookup*)malloc(count * sizeof(PersonLookup));
+  for (size_t i = 0; i < count; i++)
+  {
+    lookups[i].id = ids[i];
+    lookups[i].index = i;
+    lookups[i].found = false;
+  }
+
+  if (context->table)
+    findPersonLookupsInTable(context, lookups, count);
+  else
+    scanPersonLookups(context, lookups, count);
+
+  qsort(lookups, count, sizeof(PersonLookup), comparePersonLookupIndexes);
+  for (size_t i = 0; i < count; i++)
+  {
+    if (!lookups[i].found)
+    {
+      appendPersonCommandError(output, getPersonCommandName(PERSON_COMMAND_GET), "not found");
+      continue;
+    }
+
+    appendPersonCommandResult(output, PERSON_COMMAND_GET);
+    appendStringToBuffer(output, ",\"person\":");
+    appendPersonJson(output, &lookups[i].person);
+    appendStringToBuffer(output, "}\n");
+    freePerson(&lookups[i].person);
+  }
+
+  free(lookups);
+  clearBuffer(&context->lookups);
+  context->lookupCount = 0;
+}
+
+void flushPersonCommands(PersonCommandContext* context, Buffer* output)
+{
+  flushPersonInserts(context, output);
+  flushPersonLookups(context, output);
+}
+
+void initPersonCommandReader(PersonCommandContext* reader, const PersonCommandContext* context)
+{
+  *reader = *context;
+  initBuffer(&reader->inserts, 0);
+  reader->insertCount = 0;
+  initBuffer(&reader->lookups, 64 * sizeof(size_t));
+  reader->lookupCount = 0;
+  reader->bloomChanged = false;
+}
+
+void finishPersonCommandReader(PersonCommandContext* reader, Buffer* output)
+{
+  flushPersonLookups(reader, output);
+  freeBuffer(&reader->lookups);
+  freeBuffer(&reader->inserts);
+}
+
+bool isPersonCommandLineRead(const char* line, size_t length)
+{
+  if (length > 0 && line[length - 1] == '\r')
+    length--;
+  if (length == 0 || line[0] == '#')
+    return true;
+
+  PersonCommand command;
+  bool read = parsePersonCommand(line, length, &command) != NULL || command.type == PERSON_COMMAND_GET ||
+              command.type == PERSON_COMMAND_FIND || command.type == PERSON_COMMAND_COUNT;
+  freePersonCommand(&command);
+  return read;
+}
+
+void findPeopleForCommand(PersonCommandContext* context, const char* name, Buffer* output)
+{
+  appendPersonCommandResult(output, PERSON_COMMAND_FIND);
+  appendStringToBuffer(output, ",\"people\":[");
+  if (personBloomMayContainName(context->bloom, name))
+  {
+    bool first = true;
+    PersonScan scan;
+    openPersonScan(&scan, *context->fpPtr);
+    Person person;
+    while (nextPersonScanRecord(&scan, &person))
+    {
+      if (strcmp(person.name, name) != 0)
+        continue;
+
+      if (!first)
+        appendBuffer(output, ",", 1);
+      appendPersonJson(output, &person);
+      first = false;
+    }
+    closePersonScan(&scan);
+  }
+  appendStringToBuffer(output, "]}\n");
+}
+
+void executePersonCommand(PersonCommandContext* context, const PersonCommand* command, Buffer* output)
+{
+  // Only one kind of command is queued at a time, so answers stay in order
+  if (command->type != PERSON_COMMAND_INSERT)
+    flushPersonInserts(context, output);
+  if (command->type != PERSON_COMMAND_GET)
+    flushPersonLookups(context, output);
+
+  if (command->type == PERSON_COMMAND_UPDATE || command->type == PERSON_COMMAND_DELETE ||
+      command->type == PERSON_COMMAND_INSERT)
+    invalidatePersonCommandBloom(context);
+
+  if (command->type == PERSON_COMMAND_INSERT)
+  {
+    Person person = {context->meta->autoIncrementId + context->insertCount, command->age, command->name};
+    encodePerson(&context->inserts, &person);
+    addPersonToBloom(context->bloom, &person);
+    context->insertCount++;
+    if (context->inserts.size >= PERSON_IMPORT_BATCH_SIZE)
+      flushPersonInserts(context, output);
+    return;
+  }
+
+  if (command->type == PERSON_COMMAND_GET)
+  {
+    appendBuffer(&context->lookups, &command->id, sizeof(size_t));
+    context->lookupCount++;
+    if (context->lookupCount >= PERSON_COMMAND_LOOKUP_BATCH)
+      flushPersonLookups(context, output);
+    return;
+  }
+
+  const char* op = getPersonCommandName(command->type);
+  switch (command->type)
+  {
+  case PERSON_COMMAND_FIND:
+    findPeopleForCommand(context, command->name, output);
+    break;
+  case PERSON_COMMAND_UPDATE:
+  {
+    Person person = {command->id, command->age, command->name};
+    if (!personBloomMayContainId(context->bloom, command->id) || !updatePerson(context->fpPtr, context->meta, command->id, &person))
+    {
+      appendPersonCommandError(output, op, "not found");
+      break;
+    }
+
+    if (context->log)
+      logPersonUpdate(context->log, &person, context->meta);
+    addPersonToBloom(context->bloom, &person);
+    markPersonCommandChange(context);
+    appendPersonCommandResult(output, command->type);
+    appendStringToBuffer(output, ",\"id\":");
+    appendSize_tToBuffer(output, command->id);
+    appendStringToBuffer(output, "}\n");
+    break;
+  }
+  case PERSON_COMMAND_DELETE:
+  {
+    if (!personBloomMayContainId(context->bloom, command->id) || !deletePerson(context->fpPtr, context->meta, command->id))
+    {
+      appendPersonCommandError(output, op, "not found");
+      break;
+    }
+
+    if (context->log)
+      logPersonDelete(context->log, command->id, context->meta);
+    markPersonCommandChange(context);
+    appendPersonCommandResult(output, command->type);
+    appendStringToBuffer(output, ",\"id\":");
+    appendSize_tToBuffer(output, command->id);
+    appendStringToBuffer(output, "}\n");
+    break;
+  }
+  case PERSON_COMMAND_COUNT:
+    appendPersonCommandResult(output, command->type);
+    appendStringToBuffer(output, ",\"count\":");
+    appendSize_tToBuffer(output, context->meta->count);
+    appendStringToBuffer(output, ",\"autoIncrementId\":");
+    appendSize_tToBuffer(output, context->meta->autoIncrementId);
+    appendStringToBuffer(output, "}\n");
+    break;
+  default:
+    break;
+  }
+}
+
+void rejectPersonCommand(PersonCommandContext* context, const char* error, Buffer* output)
+{
+  // Queued commands are answered first so that responses stay in order
+  flushPersonCommands(context, output);
+  appendPersonCommandError(output, NULL, error);
+}
+
+void finishPersonCommands(PersonCommandContext* context, Buffer* output)
+{
+  flushPersonCommands(context, output);
+
+  // The filter is saved once at the end instead of after every change
+  if (context->bloomChanged)
+    savePersonBloom(context->bloom, context->bloomFilename);
+  if (context->table)
+    closePersonTable(context->table);
+  context->table = NULL;
+  freeBuffer(&context->lookups);
+  freeBuffer(&context->inserts);
+}
+
+bool executePersonCommandLine(PersonCommandContext* context, const char* line, size_t length, Buffer* output)
+{
+  if (length > 0 && line[length - 1] == '\r')
+    length--;
+  if (length == 0 || line[0] == '#')
+    return false;
+
+  PersonCommand command;
+  const char* error = parsePersonCommand(line, length, &command);
+  if (error)
+    rejectPersonCommand(context, error, output);
+  else
+    executePersonCommand(context, &command, output);
+  freePersonCommand(&command);
+  return true;
+}
+
+size_t runPersonCommands(PersonCommandContext* context, FILE* input, FILE* output)
+{
+  Buffer line;
+  initBuffer(&line, 256);
+  Buffer responses;
+  initBuffer(&responses, PERSON_EXPORT_BUFFER_SIZE + 4096);
+
+  size_t commandCount = 0;
+  int c = 0;
+  while (c != EOF)
+  {
+    clearBuffer(&line);
+    while ((c = getc(input)) != EOF && c != '\n')
+    {
+      char ch = (char)c;
+      appendBuffer(&line, &ch, 1);
+    }
+    if (!executePersonCommandLine(context, line.data, line.size, &responses))
+      continue;
+    commandCount++;
+
+    // Answers are sent as soon as nothing is queued, so a caller waiting
+    // for one is not blocked behind the buffer
+    bool queued = context->insertCount > 0 || context->lookupCount > 0;
+    if (responses.size > 0 && (!queued || responses.size >= PERSON_EXPORT_BUFFER_SIZE))
+    {
+      flushBuffer(&responses, output);
+      fflush(output);
+    }
+  }
+
+  finishPersonCommands(context, &responses);
+  flushBuffer(&responses, output);
+  fflush(output);
+
+  freeBuffer(&responses);
+  freeBuffer(&line);
+  return commandCount;
+}
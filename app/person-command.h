@@ -0,0 +1,256 @@
+/**
+ * @file person-command.h
+ * @brief Esecuzione di comandi testuali sul database, senza menu.
+ *
+ * Ogni comando è una riga, in forma testuale o come oggetto JSON:
+ *
+ *     insert <età> <nome>            {"op":"insert","age":30,"name":"Anna"}
+ *     get <id>                       {"op":"get","id":5}
+ *     find <nome>                    {"op":"find","name":"Anna"}
+ *     update <id> <età> <nome>       {"op":"update","id":5,"age":31,"name":"Anna"}
+ *     delete <id>                    {"op":"delete","id":5}
+ *     count                          {"op":"count"}
+ *
+ * Ogni comando produce una riga NDJSON con `ok`, `op` e il risultato.
+ * Gli inserimenti consecutivi vengono accumulati e scritti insieme (db,
+ * registro e filtro di Bloom), mentre le ricerche per ID consecutive
+ * vengono risolte con una sola scansione del database, oppure con ricerche
+ * binarie asincrone sulla tabella a record fissi (person-table.h) se questa
+ * corrisponde ancora al database. In entrambi i casi
+ * le risposte arrivano al primo comando di altro tipo, quando il gruppo è
+ * pieno o alla fine dei comandi.
+ */
+
+#ifndef PERSON_COMMAND_H
+#define PERSON_COMMAND_H
+
+#include "person-bloom.h"
+#include "person-log.h"
+#include "person-table.h"
+#include "person.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * @brief Età minima accettata dai comandi.
+ */
+#define PERSON_COMMAND_MIN_AGE 1
+
+/**
+ * @brief Età massima accettata dai comandi.
+ */
+#define PERSON_COMMAND_MAX_AGE 999
+
+/**
+ * @enum PersonCommandType
+ * @brief Tipo di un comando.
+ */
+typedef enum PersonCommandType
+{
+  PERSON_COMMAND_INSERT = 1,
+  PERSON_COMMAND_GET,
+  PERSON_COMMAND_FIND,
+  PERSON_COMMAND_UPDATE,
+  PERSON_COMMAND_DELETE,
+  PERSON_COMMAND_COUNT
+} PersonCommandType;
+
+/**
+ * @struct PersonCommand
+ * @brief Comando letto da una riga.
+ *
+ * @var type
+ * Tipo del comando.
+ * @var id
+ * ID della persona (get, update, delete).
+ * @var age
+ * Età della persona (insert, update).
+ * @var name
+ * Nome della persona (insert, find, update), NULL per gli altri comandi.
+ */
+typedef struct PersonCommand
+{
+  PersonCommandType type;
+  size_t id;
+  int age;
+  char* name;
+} PersonCommand;
+
+/**
+ * @struct PersonCommandContext
+ * @brief Database su cui vengono eseguiti i comandi.
+ *
+ * @var fpPtr
+ * Puntatore al puntatore del file del database.
+ * @var meta
+ * Metadati del database.
+ * @var bloom
+ * Filtro di Bloom del database.
+ * @var bloomFilename
+ * File in cui salvare il filtro di Bloom.
+ * @var log
+ * Registro delle modifiche (può essere NULL).
+ * @var onChange
+ * Funzione chiamata dopo ogni modifica del database (può essere NULL).
+ * @var inserts
+ * Record degli inserimenti non ancora scritti.
+ * @var insertCount
+ * Numero di inserimenti non ancora scritti.
+ * @var lookups
+ * ID delle ricerche non ancora eseguite.
+ * @var lookupCount
+ * Numero di ricerche non ancora eseguite.
+ * @var bloomChanged
+ * true se il filtro di Bloom va salvato; il suo file viene eliminato prima
+ * della prima modifica, così un filtro non aggiornato non resta su disco se
+ * il processo termina senza salvarlo.
+ * @var table
+ * Tabella a record fissi usata per le ricerche per ID, NULL se non esiste
+ * o non corrisponde più al database.
+ */
+typedef struct PersonCommandContext
+{
+  FILE** fpPtr;
+  PersonMeta* meta;
+  PersonBloom* bloom;
+  const char* bloomFilename;
+  PersonLog* log;
+  void (*onChange)();
+  Buffer inserts;
+  size_t insertCount;
+  Buffer lookups;
+  size_t lookupCount;
+  bool bloomChanged;
+  PersonTable* table;
+} PersonCommandContext;
+
+/**
+ * @brief Legge un comando da una riga.
+ *
+ * Le righe che iniziano con '{' sono lette come oggetti JSON, le altre
+ * come comandi testuali.
+ *
+ * @param line Riga da leggere (senza '\n').
+ * @param length Lunghezza della riga.
+ * @param command Comando letto; il nome va liberato con freePersonCommand.
+ * @return Messaggio di errore, NULL se il comando è valido.
+ */
+const char* parsePersonCommand(const char* line, size_t length, PersonCommand* command);
+
+/**
+ * @brief Libera la memoria di un comando.
+ */
+void freePersonCommand(PersonCommand* command);
+
+/**
+ * @brief Prepara l'esecuzione dei comandi su un database.
+ *
+ * @param context Contesto da inizializzare.
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Metadati del database.
+ * @param bloom Filtro di Bloom del database.
+ * @param bloomFilename File in cui salvare il filtro di Bloom.
+ * @param log Registro delle modifiche (può essere NULL).
+ * @param onChange Funzione chiamata dopo ogni modifica (può essere NULL).
+ */
+void initPersonCommandContext(PersonCommandContext* context, FILE** fpPtr, PersonMeta* meta, PersonBloom* bloom, const char* bloomFilename, PersonLog* log, void (*onChange)());
+
+/**
+ * @brief Prepara un contesto che esegue solo comandi di lettura.
+ *
+ * Il database, il filtro di Bloom e la tabella sono quelli di `context`,
+ * mentre le ricerche accumulate sono del nuovo contesto: più lettori
+ * possono eseguire comandi nello stesso momento, purché nessuno modifichi
+ * il database.
+ *
+ * @param reader Contesto da inizializzare.
+ * @param context Contesto di cui condividere il database.
+ */
+void initPersonCommandReader(PersonCommandContext* reader, const PersonCommandContext* context);
+
+/**
+ * @brief Esegue le ricerche accumulate da un lettore e lo libera.
+ *
+ * @param reader Contesto preparato con initPersonCommandReader.
+ * @param output Buffer a cui aggiungere le ultime risposte.
+ */
+void finishPersonCommandReader(PersonCommandContext* reader, Buffer* output);
+
+/**
+ * @brief Indica se una riga contiene solo una lettura del database.
+ *
+ * Sono letture get, find e count; lo sono anche le righe ignorate e
+ * quelle non valide, che ricevono solo una risposta di errore.
+ *
+ * @param line Riga da controllare (senza '\n').
+ * @param length Lunghezza della riga.
+ * @return true se la riga può essere eseguita da un lettore.
+ */
+bool isPersonCommandLineRead(const char* line, size_t length);
+
+/**
+ * @brief Esegue un comando.
+ *
+ * @param context Contesto dei comandi.
+ * @param command Comando da eseguire.
+ * @param output Buffer a cui aggiungere le righe NDJSON delle risposte;
+ *               le risposte di inserimenti e ricerche per ID arrivano
+ *               quando il loro gruppo viene eseguito.
+ */
+void executePersonCommand(PersonCommandContext* context, const PersonCommand* command, Buffer* output);
+
+/**
+ * @brief Legge ed esegue il comando di una riga.
+ *
+ * Le righe vuote e quelle che iniziano con '#' vengono ignorate; una riga
+ * non valida riceve una risposta di errore.
+ *
+ * @param context Contesto dei comandi.
+ * @param line Riga da eseguire (senza '\n').
+ * @param length Lunghezza della riga.
+ * @param output Buffer a cui aggiungere le risposte.
+ * @return false se la riga è stata ignorata.
+ */
+bool executePersonCommandLine(PersonCommandContext* context, const char* line, size_t length, Buffer* output);
+
+/**
+ * @brief Aggiunge la risposta a una riga che non contiene un comando valido.
+ *
+ * @param context Contesto dei comandi.
+ * @param error Messaggio di errore.
+ * @param output Buffer a cui aggiungere la risposta.
+ */
+void rejectPersonCommand(PersonCommandContext* context, const char* error, Buffer* output);
+
+/**
+ * @brief Esegue gli inserimenti e le ricerche accumulati e ne aggiunge le
+ *        risposte.
+ *
+ * @param context Contesto dei comandi.
+ * @param output Buffer a cui aggiungere le risposte.
+ */
+void flushPersonCommands(PersonCommandContext* context, Buffer* output);
+
+/**
+ * @brief Esegue i comandi accumulati, salva il filtro di Bloom e
+ *        libera il contesto.
+ *
+ * @param context Contesto dei comandi.
+ * @param output Buffer a cui aggiungere le ultime risposte.
+ */
+void finishPersonCommands(PersonCommandContext* context, Buffer* output);
+
+/**
+ * @brief Esegue tutti i comandi di un file e scrive le risposte su un
+ *        altro file.
+ *
+ * Le righe vuote e quelle che iniziano con '#' vengono ignorate.
+ *
+ * @param context Contesto dei comandi.
+ * @param input File dei comandi.
+ * @param output File delle risposte.
+ * @return Numero di comandi eseguiti.
+ */
+size_t runPersonCommands(PersonCommandContext* context, FILE* input, FILE* output);
+
+#endif // PERSON_COMMAND_H
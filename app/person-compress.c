@@ -0,0 +1,365 @@
+#include "person-compress.h"
+#include "compress.h"
+#include "person-scan.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PERSON_COMPRESSED_MAGIC "PDBZ"
+#define PERSON_COMPRESSED_VERSION 1
+
+typedef struct PersonCompressedHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t autoIncrementId;
+  uint64_t count;
+  uint64_t blockCount;
+} PersonCompressedHeader;
+
+// A block is stored raw when compressing doesn't make it smaller
+typedef struct PersonBlockHeader
+{
+  uint32_t personCount;
+  uint32_t rawSize;
+  uint32_t storedSize;
+} PersonBlockHeader;
+
+bool writePersonBlock(FILE* compressedFile, const Buffer* block, size_t personCount, Buffer* output)
+{
+  PersonBlockHeader blockHeader;
+  blockHeader.personCount = (uint32_t)personCount;
+  blockHeader.rawSize = (uint32_t)block->size;
+
+  reserveBuffer(output, COMPRESS_BOUND(block->size));
+  size_t storedSize = compressBlock(block->data, block->size, output->data, output->capacity);
+  const char* stored = output->data;
+  if (storedSize == 0 || storedSize >= block->size)
+  {
+    storedSize = block->size;
+    stored = block->data;
+  }
+  blockHeader.storedSize = (uint32_t)storedSize;
+
+  return fwrite(&blockHeader, sizeof(PersonBlockHeader), 1, compressedFile) == 1 &&
+         fwrite(stored, sizeof(char), storedSize, compressedFile) == storedSize;
+}
+
+bool compressPersonDb(FILE* fp, const char* filename)
+{
+  FILE* compressedFile = fopen(filename, "wb");
+  if (!compressedFile)
+    return false;
+
+  PersonMeta meta;
+  loadPersonMeta(fp, &meta);
+
+  PersonCompressedHeader header;
+  memset(&header, 0, sizeof(PersonCompressedHeader));
+  memcpy(header.magic, PERSON_COMPRESSED_MAGIC, 4);
+  header.version = PERSON_COMPRESSED_VERSION;
+  header.autoIncrementId = meta.autoIncrementId;
+  header.count = meta.count;
+  bool success = fwrite(&header, sizeof(PersonCompressedHeader), 1, compressedFile) == 1;
+
+  Buffer block;
+  initBuffer(&block, PERSON_COMPRESSED_BLOCK_SIZE + 4096);
+  Buffer output;
+  initBuffer(&output, COMPRESS_BOUND(PERSON_COMPRESSED_BLOCK_SIZE + 4096));
+
+  size_t personCount = 0;
+  size_t previousId = 0;
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (success && nextPersonScanRecord(&scan, &person))
+  {
+    // Ids are deltas within the block so every block decodes on its own
+    size_t nameLength = strlen(person.name);
+    appendVarintToBuffer(&block, zigzagEncode((int64_t)(person.id - previousId)));
+    appendVarintToBuffer(&block, zigzagEncode(person.age));
+    appendVarintToBuffer(&block, nameLength);
+    appendBuffer(&block, person.name, nameLength);
+    previousId = person.id;
+    personCount++;
+
+    if (block.size >= PERSON_COMPRESSED_BLOCK_SIZE)
+    {
+      success = writePersonBlock(compressedFile, &block, personCount, &output);
+      header.blockCount++;
+      clearBuffer(&block);
+      personCount = 0;
+      previousId = 0;
+    }
+  }
+  if (!closePersonScan(&scan))
+    success = false;
+  if (success && personCount > 0)
+  {
+    success = writePersonBlock(compressedFile, &block, personCount, &output);
+    header.blockCount++;
+  }
+
+  if (success)
+  {
+    fseek(compressedFile, 0, SEEK_SET);
+    success = fwrite(&header, sizeof(PersonCompressedHeader), 1, compressedFile) == 1;
+  }
+
+  freeBuffer(&output);
+  freeBuffer(&block);
+
+  if (fclose(compressedFile) != 0)
+    success = false;
+  if (!success)
+    remove(filename);
+  return success;
+}
+
+FILE* openCompressedPersonDb(const char* filename, PersonCompressedHeader* header)
+{
+  FILE* compressedFile = fopen(filename, "rb");
+  if (!compressedFile)
+    return NULL;
+
+  if (fread(header, sizeof(PersonCompressedHeader), 1, compressedFile) != 1 ||
+      memcmp(header->magic, PERSON_COMPRESSED_MAGIC, 4) != 0 ||
+      header->version != PERSON_COMPRESSED_VERSION)
+  {
+    fclose(compressedFile);
+    return NULL;
+  }
+  return compressedFile;
+}
+
+bool readCompressedPersonDbMeta(const char* filename, PersonMeta* meta, size_t* storedSize)
+{
+  PersonCompressedHeader header;
+  FILE* compressedFile = openCompressedPersonDb(filename, &header);
+  if (!compressedFile)
+    return false;
+
+  meta->autoIncrementId = header.autoIncrementId;
+  meta->count = header.count;
+  if (storedSize)
+  {
+    fseek(compressedFile, 0, SEEK_END);
+    *storedSize = ftell(compressedFile);
+  }
+  fclose(compressedFile);
+  return true;
+}
+
+// Returns the decoded size of one record, 0 if the block is corrupted
+size_t decodePersonBlockRecord(const char* data, size_t size, size_t* previousId, Person* person, Buffer* name)
+{
+  uint64_t idDelta, age, nameLength;
+  size_t pos = 0;
+  size_t read = decodeVarint(data, size, &idDelta);
+  if (read == 0)
+    return 0;
+  pos += read;
+  read = decodeVarint(data + pos, size - pos, &age);
+  if (read == 0)
+    return 0;
+  pos += read;
+  read = decodeVarint(data + pos, size - pos, &nameLength);
+  if (read == 0 || nameLength > size - pos - read)
+    return 0;
+  pos += read;
+
+  clearBuffer(name);
+  appendBuffer(name, data + pos, nameLength);
+  appendBuffer(name, "", 1);
+  pos += nameLength;
+
+  *previousId += (size_t)zigzagDecode(idDelta);
+  person->id = *previousId;
+  person->age = (int)zigzagDecode(age);
+  person->name = name->data;
+  return pos;
+}
+
+bool scanCompressedPersonDb(const char* filename, PersonCompressedVisit visit, void* context)
+{
+  PersonCompressedHeader header;
+  FILE* compressedFile = openCompressedPersonDb(filename, &header);
+  if (!compressedFile)
+    return false;
+
+  Buffer stored;
+  initBuffer(&stored, COMPRESS_BOUND(PERSON_COMPRESSED_BLOCK_SIZE + 4096));
+  Buffer block;
+  initBuffer(&block, PERSON_COMPRESSED_BLOCK_SIZE + 4096);
+  Buffer name;
+  initBuffer(&name, 64);
+
+  bool success = true;
+  size_t personTotal = 0;
+  for (uint64_t i = 0; success && i < header.blockCount; i++)
+  {
+    PersonBlockHeader blockHeader;
+    success = fread(&blockHeader, sizeof(PersonBlockHeader), 1, compressedFile) == 1 &&
+              blockHeader.storedSize <= blockHeader.rawSize;
+    if (!success)
+      break;
+
+    reserveBuffer(&block, blockHeader.rawSize);
+    if (blockHeader.storedSize == blockHeader.rawSize)
+    {
+      success = fread(block.data, sizeof(char), blockHeader.rawSize, compressedFile) == blockHeader.rawSize;
+    }
+    else
+    {
+      reserveBuffer(&stored, blockHeader.storedSize);
+      success = fread(stored.data, sizeof(char), blockHeader.storedSize, compressedFile) == blockHeader.storedSize &&
+                decompressBlock(stored.data, blockHeader.storedSize, block.data, blockHeader.rawSize);
+    }
+
+    size_t previousId = 0;
+    size_t pos = 0;
+    for (uint32_t j = 0; success && j < blockHeader.personCount; j++)
+    {
+      Person person;
+      size_t read = decodePersonBlockRecord(block.data + pos, blockHeader.rawSize - pos, &previousId, &person, &name);
+      success = read > 0 && visit(context, &person);
+      pos += read;
+    }
+    personTotal += blockHeader.personCount;
+  }
+
+  freeBuffer(&name);
+  freeBuffer(&block);
+  freeBuffer(&stored);
+  fclose(compressedFile);
+
+  return success && personTotal == header.count;
+}
+
+typedef struct PersonCompressedRestore
+{
+  FILE* fp;
+  Buffer batch;
+} PersonCompressedRestore;
+
+bool restoreCompressedPerson(void* context, const Person* person)
+{
+  PersonCompressedRestore* restore = (PersonCompressedRestore*)context;
+  encodePerson(&restore->batch, person);
+  if (restore->batch.size >= PERSON_IMPORT_BATCH_SIZE)
+  {
+    insertEncodedPeople(restore->fp, restore->batch.data, restore->batch.size);
+    clearBuffer(&restore->batch);
+  }
+  return true;
+}
+
+bool compressedPersonDbToDb(const char* filename, FILE** fpPtr, PersonMeta* meta)
+{
+  PersonMeta newMeta;
+  if (!readCompressedPersonDbMeta(filename, &newMeta, NULL))
+    return false;
+
+  FILE* newFp = fopen(getPersonDbTempFilename(), "w+b");
+  if (!newFp)
+    return false;
+
+  updatePersonMeta(newFp, &newMeta);
+  fseek(newFp, 0, SEEK_END);
+
+  PersonCompressedRestore restore;
+  restore.fp = newFp;
+  initBuffer(&restore.batch, PERSON_IMPORT_BATCH_SIZE + 4096);
+
+  bool success = scanCompressedPersonDb(filename, restoreCompressedPerson, &restore);
+  if (success)
+    insertEncodedPeople(newFp, restore.batch.data, restore.batch.size);
+  freeBuffer(&restore.batch);
+
+  if (!success)
+  {
+    fclose(newFp);
+    remove(getPersonDbTempFilename());
+    return false;
+  }
+
+  fclose(*fpPtr);
+  *fpPtr = newFp;
+  *meta = newMeta;
+  remove(getPersonDbFilename());
+  rename(getPersonDbTempFilename(), getPersonDbFilename());
+  markPersonDbWrite();
+
+  return true;
+}
+
+bool personDbToCompressedJson(FILE* fp, const char* filename)
+{
+  PersonMeta meta;
+  loadPersonMeta(fp, &meta);
+
+  FILE* compressedFile = fopen(filename, "wb");
+  if (!compressedFile)
+    return false;
+
+  CompressedWriter writer;
+  bool success = openCompressedWriter(&writer, compressedFile);
+
+  Buffer output;
+  initBuffer(&output, PERSON_EXPORT_BUFFER_SIZE + 4096);
+
+  appendStringToBuffer(&output, "{\"metadata\":{\"autoIncrementId\":");
+  appendSize_tToBuffer(&output, meta.autoIncrementId);
+  appendStringToBuffer(&output, ",\"count\":");
+  appendSize_tToBuffer(&output, meta.count);
+  appendStringToBuffer(&output, "},\"people\":[");
+
+  bool isFirst = true;
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (success && nextPersonScanRecord(&scan, &person))
+  {
+    if (!isFirst)
+      appendBuffer(&output, ",", 1);
+    isFirst = false;
+    appendPersonJson(&output, &person);
+
+    if (output.size >= PERSON_EXPORT_BUFFER_SIZE)
+    {
+      success = writeCompressed(&writer, output.data, output.size);
+      clearBuffer(&output);
+    }
+  }
+  if (!closePersonScan(&scan))
+    success = false;
+
+  appendStringToBuffer(&output, "]}");
+  if (success)
+    success = writeCompressed(&writer, output.data, output.size);
+  if (!closeCompressedWriter(&writer))
+    success = false;
+
+  freeBuffer(&output);
+
+  if (fclose(compressedFile) != 0)
+    success = false;
+  if (!success)
+    remove(filename);
+  return success;
+}
+
+PersonJsonError loadPersonDbFromCompressedJson(FILE** fpPtr, PersonMeta* meta, FILE* compressedFile, JsonStreamError* streamError)
+{
+  CompressedReader reader;
+  if (!openCompressedReader(&reader, compressedFile))
+  {
+    closeCompressedReader(&reader);
+    return EXPECTED_JSON_OBJECT;
+  }
+
+  // A truncated or corrupted stream ends early and fails as invalid JSON
+  PersonJsonError errorCode = loadPersonDbFromJsonSource(fpPtr, meta, readCompressed, &reader, streamError);
+  closeCompressedReader(&reader);
+  return errorCode;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file person-compress.h
+ * @brief Copia compressa a blocchi del database ed esportazione JSON
+ *        compressa.
+ *
+ * Le persone vengono raggruppate in blocchi di circa
+ * PERSON_COMPRESSED_BLOCK_SIZE byte. In ogni blocco l'ID è salvato come
+ * differenza dal precedente, e ID, età e lunghezza del nome come varint;
+ * il blocco viene poi compresso con compressBlock. Ogni blocco si
+ * decomprime da solo, quindi una scansione legge dal disco solo i byte
+ * compressi.
+ */
+
+#ifndef PERSON_COMPRESS_H
+#define PERSON_COMPRESS_H
+
+#include "json-parser.h"
+#include "person.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * @brief Nome predefinito della copia compressa del database.
+ */
+#define PERSON_COMPRESSED_FILENAME "people.dbz"
+
+/**
+ * @brief Dimensione dei blocchi prima della compressione.
+ */
+#define PERSON_COMPRESSED_BLOCK_SIZE 65536
+
+/**
+ * @brief Funzione chiamata per ogni persona durante una scansione.
+ *
+ * @return false per interrompere la scansione.
+ */
+typedef bool (*PersonCompressedVisit)(void* context, const Person* person);
+
+/**
+ * @brief Crea la copia compressa del database.
+ *
+ * @param fp Puntatore al file del database.
+ * @param filename Nome del file da creare.
+ * @return true se il file è stato creato, false in caso di errore.
+ */
+bool compressPersonDb(FILE* fp, const char* filename);
+
+/**
+ * @brief Legge i metadati di una copia compressa.
+ *
+ * @param filename Nome del file.
+ * @param meta Metadati del database da cui è stato creato il file.
+ * @param storedSize Numero di byte del file (può essere NULL).
+ * @return true se il file esiste ed è valido.
+ */
+bool readCompressedPersonDbMeta(const char* filename, PersonMeta* meta, size_t* storedSize);
+
+/**
+ * @brief Scansiona tutte le persone di una copia compressa.
+ *
+ * @param filename Nome del file.
+ * @param visit Funzione chiamata per ogni persona; il nome è valido solo
+ *              durante la chiamata.
+ * @param context Puntatore passato a `visit`.
+ * @return true se la scansione è arrivata alla fine.
+ */
+bool scanCompressedPersonDb(const char* filename, PersonCompressedVisit visit, void* context);
+
+/**
+ * @brief Sostituisce il database con il contenuto di una copia compressa.
+ *
+ * @param filename Nome del file.
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Puntatore ai metadati (aggiornati solo in caso di successo).
+ * @return true se il database è stato sostituito, false in caso di errore.
+ */
+bool compressedPersonDbToDb(const char* filename, FILE** fpPtr, PersonMeta* meta);
+
+/**
+ * @brief Salva il database in un file JSON compresso.
+ *
+ * Il JSON è lo stesso di personDbToJson, scritto come flusso compresso.
+ *
+ * @param fp Puntatore al file del database.
+ * @param filename Nome del file da creare.
+ * @return true se il salvataggio ha avuto successo.
+ */
+bool personDbToCompressedJson(FILE* fp, const char* filename);
+
+/**
+ * @brief Carica il database da un file JSON compresso.
+ *
+ * Il flusso viene decompresso mentre viene analizzato, senza file
+ * temporanei.
+ *
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Puntatore ai metadati (aggiornati solo in caso di successo).
+ * @param compressedFile File creato con personDbToCompressedJson.
+ * @param streamError Puntatore in cui salvare l'eventuale errore di
+ *                    sintassi (può essere NULL).
+ * @return Un valore della enumerazione PersonJsonError.
+ */
+PersonJsonError loadPersonDbFromCompressedJson(FILE** fpPtr, PersonMeta* meta, FILE* compressedFile, JsonStreamError* streamError);
+
+#endif // PERSON_COMPRESS_H
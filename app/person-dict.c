@@ -0,0 +1,382 @@
+#include "person-dict.h"
+#include "person-scan.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PERSON_DICT_MAGIC "PDIC"
+#define PERSON_DICT_VERSION 1
+
+typedef struct PersonDictHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t autoIncrementId;
+  uint64_t count;
+  uint64_t wordCount;
+  uint64_t dictionarySize;
+  uint64_t recordsSize;
+} PersonDictHeader;
+
+void initPersonDictionary(PersonDictionary* dictionary)
+{
+  initBuffer(&dictionary->words, 0);
+  initBuffer(&dictionary->offsets, 0);
+  uint32_t start = 0;
+  appendBuffer(&dictionary->offsets, &start, sizeof(uint32_t));
+  dictionary->wordCount = 0;
+  dictionary->mask = 1023;
+  dictionary->slots = (uint32_t*)calloc(dictionary->mask + 1, sizeof(uint32_t));
+}
+
+void freePersonDictionary(PersonDictionary* dictionary)
+{
+  freeBuffer(&dictionary->words);
+  freeBuffer(&dictionary->offsets);
+  free(dictionary->slots);
+}
+
+const char* getPersonDictionaryWord(const PersonDictionary* dictionary, uint32_t code, size_t* length)
+{
+  const uint32_t* offsets = (const uint32_t*)dictionary->offsets.data;
+  *length = offsets[code + 1] - offsets[code];
+  return dictionary->words.data + offsets[code];
+}
+
+size_t findPersonDictionarySlot(const PersonDictionary* dictionary, const char* word, size_t length)
+{
+  size_t slot = hashJsonKey(word, length) & dictionary->mask;
+  while (dictionary->slots[slot] != 0)
+  {
+    size_t wordLength;
+    const char* candidate = getPersonDictionaryWord(dictionary, dictionary->slots[slot] - 1, &wordLength);
+    if (wordLength == length && memcmp(candidate, word, length) == 0)
+      break;
+    slot = (slot + 1) & dictionary->mask;
+  }
+  return slot;
+}
+
+uint32_t findPersonDictionaryWord(const PersonDictionary* dictionary, const char* word, size_t length)
+{
+  size_t slot = findPersonDictionarySlot(dictionary, word, length);
+  return dictionary->slots[slot] != 0 ? dictionary->slots[slot] - 1 : UINT32_MAX;
+}
+
+uint32_t addPersonDictionaryWord(PersonDictionary* dictionary, const char* word, size_t length)
+{
+  size_t slot = findPersonDictionarySlot(dictionary, word, length);
+  if (dictionary->slots[slot] != 0)
+    return dictionary->slots[slot] - 1;
+
+  uint32_t code = (uint32_t)dictionary->wordCount++;
+  appendBuffer(&dictionary->words, word, length);
+  uint32_t end = (uint32_t)dictionary->words.size;
+  appendBuffer(&dictionary->offsets, &end, sizeof(uint32_t));
+  dictionary->slots[slot] = code + 1;
+
+  // Keep the table at most half full
+  if (dictionary->wordCount * 2 > dictionary->mask)
+  {
+    free(dictionary->slots);
+    dictionary->mask = dictionary->mask * 2 + 1;
+    dictionary->slots = (uint32_t*)calloc(dictionary->mask + 1, sizeof(uint32_t));
+    for (uint32_t i = 0; i < dictionary->wordCount; i++)
+    {
+      size_t wordLength;
+      const char* existing = getPersonDictionaryWord(dictionary, i, &wordLength);
+      dictionary->slots[findPersonDictionarySlot(dictionary, existing, wordLength)] = i + 1;
+    }
+  }
+  return code;
+}
+
+// Appends the word count and codes of a name, or returns false if a word isn't in the dictionary
+bool encodePersonDictName(const PersonDictionary* dictionary, const char* name, Buffer* codes)
+{
+  size_t wordCount = 1;
+  for (const char* p = name; *p != '\0'; p++)
+    wordCount += *p == ' ';
+  appendVarintToBuffer(codes, wordCount);
+
+  const char* word = name;
+  while (true)
+  {
+    const char* space = strchr(word, ' ');
+    size_t length = space ? (size_t)(space - word) : strlen(word);
+    uint32_t code = findPersonDictionaryWord(dictionary, word, length);
+    if (code == UINT32_MAX)
+      return false;
+    appendVarintToBuffer(codes, code);
+
+    if (!space)
+      return true;
+    word = space + 1;
+  }
+}
+
+// Skips the codes of a name without decoding them, only the last byte of a varint lacks the high bit
+size_t skipPersonDictName(const char* data, size_t size)
+{
+  uint64_t wordCount;
+  size_t pos = decodeVarint(data, size, &wordCount);
+  if (pos == 0)
+    return 0;
+
+  while (wordCount > 0 && pos < size)
+  {
+    if (!(data[pos] & 0x80))
+      wordCount--;
+    pos++;
+  }
+  return wordCount == 0 ? pos : 0;
+}
+
+typedef struct PersonDictWordCount
+{
+  uint64_t count;
+  uint32_t code;
+} PersonDictWordCount;
+
+int comparePersonDictWordCounts(const void* a, const void* b)
+{
+  const PersonDictWordCount* countA = (const PersonDictWordCount*)a;
+  const PersonDictWordCount* countB = (const PersonDictWordCount*)b;
+  if (countA->count != countB->count)
+    return countA->count > countB->count ? -1 : 1;
+  return (countA->code > countB->code) - (countA->code < countB->code);
+}
+
+bool buildPersonDict(FILE* fp, const char* filename)
+{
+  PersonMeta meta;
+  loadPersonMeta(fp, &meta);
+
+  // First pass: collect the words and how often they appear
+  PersonDictionary collected;
+  initPersonDictionary(&collected);
+  Buffer counts;
+  initBuffer(&counts, 0);
+
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (nextPersonScanRecord(&scan, &person))
+  {
+    const char* word = person.name;
+    while (true)
+    {
+      const char* space = strchr(word, ' ');
+      size_t length = space ? (size_t)(space - word) : strlen(word);
+      uint32_t code = addPersonDictionaryWord(&collected, word, length);
+      if (code * sizeof(PersonDictWordCount) >= counts.size)
+      {
+        PersonDictWordCount count = {0, code};
+        appendBuffer(&counts, &count, sizeof(PersonDictWordCount));
+      }
+      ((PersonDictWordCount*)counts.data)[code].count++;
+
+      if (!space)
+        break;
+      word = space + 1;
+    }
+  }
+  bool success = closePersonScan(&scan);
+
+  // The most frequent words get the smallest codes, so they encode in one byte
+  qsort(counts.data, collected.wordCount, sizeof(PersonDictWordCount), comparePersonDictWordCounts);
+  PersonDictionary dictionary;
+  initPersonDictionary(&dictionary);
+  Buffer serialized;
+  initBuffer(&serialized, 0);
+  for (size_t i = 0; i < collected.wordCount; i++)
+  {
+    size_t length;
+    const char* word = getPersonDictionaryWord(&collected, ((PersonDictWordCount*)counts.data)[i].code, &length);
+    addPersonDictionaryWord(&dictionary, word, length);
+    appendVarintToBuffer(&serialized, length);
+    appendBuffer(&serialized, word, length);
+  }
+  freeBuffer(&counts);
+  freePersonDictionary(&collected);
+
+  FILE* dictFile = success ? fopen(filename, "wb") : NULL;
+  if (!dictFile)
+  {
+    freeBuffer(&serialized);
+    freePersonDictionary(&dictionary);
+    return false;
+  }
+
+  PersonDictHeader header;
+  memset(&header, 0, sizeof(PersonDictHeader));
+  memcpy(header.magic, PERSON_DICT_MAGIC, 4);
+  header.version = PERSON_DICT_VERSION;
+  header.autoIncrementId = meta.autoIncrementId;
+  header.count = meta.count;
+  header.wordCount = dictionary.wordCount;
+  header.dictionarySize = serialized.size;
+  success = fwrite(&header, sizeof(PersonDictHeader), 1, dictFile) == 1 && flushBuffer(&serialized, dictFile);
+
+  // Second pass: encode the records
+  Buffer records;
+  initBuffer(&records, PERSON_EXPORT_BUFFER_SIZE + 4096);
+  size_t previousId = 0;
+  openPersonScan(&scan, fp);
+  while (success && nextPersonScanRecord(&scan, &person))
+  {
+    appendVarintToBuffer(&records, zigzagEncode((int64_t)(person.id - previousId)));
+    appendVarintToBuffer(&records, zigzagEncode(person.age));
+    encodePersonDictName(&dictionary, person.name, &records);
+    previousId = person.id;
+
+    if (records.size >= PERSON_EXPORT_BUFFER_SIZE)
+      success = flushBuffer(&records, dictFile);
+  }
+  if (!closePersonScan(&scan))
+    success = false;
+  if (success)
+    success = flushBuffer(&records, dictFile);
+
+  if (success)
+  {
+    header.recordsSize = ftell(dictFile) - sizeof(PersonDictHeader) - header.dictionarySize;
+    fseek(dictFile, 0, SEEK_SET);
+    success = fwrite(&header, sizeof(PersonDictHeader), 1, dictFile) == 1;
+  }
+
+  freeBuffer(&records);
+  freeBuffer(&serialized);
+  freePersonDictionary(&dictionary);
+
+  if (fclose(dictFile) != 0)
+    success = false;
+  if (!success)
+    remove(filename);
+  return success;
+}
+
+PersonDict* openPersonDict(const char* filename)
+{
+  FILE* dictFile = fopen(filename, "rb");
+  if (!dictFile)
+    return NULL;
+
+  PersonDictHeader header;
+  if (fread(&header, sizeof(PersonDictHeader), 1, dictFile) != 1 ||
+      memcmp(header.magic, PERSON_DICT_MAGIC, 4) != 0 ||
+      header.version != PERSON_DICT_VERSION)
+  {
+    fclose(dictFile);
+    return NULL;
+  }
+
+  Buffer serialized;
+  initBuffer(&serialized, header.dictionarySize);
+  serialized.size = fread(serialized.data, sizeof(char), header.dictionarySize, dictFile);
+
+  PersonDict* dict = (PersonDict*)malloc(sizeof(PersonDict));
+  dict->meta.autoIncrementId = header.autoIncrementId;
+  dict->meta.count = header.count;
+  initPersonDictionary(&dict->dictionary);
+  initBuffer(&dict->records, header.recordsSize);
+  dict->records.size = fread(dict->records.data, sizeof(char), header.recordsSize, dictFile);
+  fclose(dictFile);
+
+  bool valid = serialized.size == header.dictionarySize && dict->records.size == header.recordsSize;
+  size_t pos = 0;
+  for (uint64_t i = 0; valid && i < header.wordCount; i++)
+  {
+    uint64_t length;
+    size_t read = decodeVarint(serialized.data + pos, serialized.size - pos, &length);
+    valid = read > 0 && pos + read + length <= serialized.size;
+    if (valid)
+    {
+      addPersonDictionaryWord(&dict->dictionary, serialized.data + pos + read, length);
+      pos += read + length;
+    }
+  }
+  freeBuffer(&serialized);
+
+  if (!valid || dict->dictionary.wordCount != header.wordCount)
+  {
+    closePersonDict(dict);
+    return NULL;
+  }
+  return dict;
+}
+
+void closePersonDict(PersonDict* dict)
+{
+  freePersonDictionary(&dict->dictionary);
+  freeBuffer(&dict->records);
+  free(dict);
+}
+
+// Reads the id and age of the record at pos, returning the size of those two fields
+size_t decodePersonDictFields(const PersonDict* dict, size_t pos, size_t* id, int* age)
+{
+  uint64_t delta;
+  uint64_t encodedAge;
+  size_t read = decodeVarint(dict->records.data + pos, dict->records.size - pos, &delta);
+  if (read == 0)
+    return 0;
+  size_t readAge = decodeVarint(dict->records.data + pos + read, dict->records.size - pos - read, &encodedAge);
+  if (readAge == 0)
+    return 0;
+
+  *id += (size_t)zigzagDecode(delta);
+  *age = (int)zigzagDecode(encodedAge);
+  return read + readAge;
+}
+
+Person* findPeopleInDict(const PersonDict* dict, const char* name, size_t* count)
+{
+  *count = 0;
+  Buffer query;
+  initBuffer(&query, 64);
+  if (!encodePersonDictName(&dict->dictionary, name, &query))
+  {
+    freeBuffer(&query);
+    return NULL;
+  }
+
+  Buffer matches;
+  initBuffer(&matches, 0);
+  size_t id = 0;
+  size_t pos = 0;
+  while (pos < dict->records.size)
+  {
+    int age;
+    size_t read = decodePersonDictFields(dict, pos, &id, &age);
+    if (read == 0)
+      break;
+    pos += read;
+
+    // Codes are prefix-free and start with the word count, so a prefix match is an exact match
+    const char* codes = dict->records.data + pos;
+    size_t available = dict->records.size - pos;
+    if (available >= query.size && memcmp(codes, query.data, query.size) == 0)
+    {
+      Person person;
+      person.id = id;
+      person.age = age;
+      person.name = (char*)malloc(strlen(name) + 1);
+      strcpy(person.name, name);
+      appendBuffer(&matches, &person, sizeof(Person));
+    }
+
+    size_t skipped = skipPersonDictName(codes, available);
+    if (skipped == 0)
+      break;
+    pos += skipped;
+  }
+
+  freeBuffer(&query);
+  *count = matches.size / sizeof(Person);
+  if (*count == 0)
+  {
+    freeBuffer(&matches);
+    return NULL;
+  }
+  return (Person*)matches.data;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file person-dict.h
+ * @brief Copia del database con i nomi codificati tramite dizionario.
+ *
+ * I nomi vengono divisi in parole (separate da uno spazio) e ogni parola
+ * distinta viene salvata una sola volta in un dizionario; i codici sono
+ * assegnati in ordine di frequenza, quindi le parole più comuni occupano
+ * un solo byte. Ogni record contiene l'ID (come differenza dal precedente),
+ * l'età e la sequenza di codici, tutti come varint. Due nomi sono uguali
+ * se e solo se le loro sequenze di codici sono uguali byte per byte, quindi
+ * la ricerca per nome confronta i codici invece delle stringhe.
+ *
+ * Il file è solo un indice per la ricerca per nome: il database resta
+ * people.db con i nomi interi, e tutte le altre letture e scritture
+ * continuano a usarlo. La copia viene ricreata da people.db quando non
+ * corrisponde più, e ogni scrittura del menu la elimina.
+ */
+
+#ifndef PERSON_DICT_H
+#define PERSON_DICT_H
+
+#include "person.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Nome predefinito del file con i nomi codificati.
+ */
+#define PERSON_DICT_FILENAME "people.dict"
+
+/**
+ * @struct PersonDictionary
+ * @brief Dizionario delle parole dei nomi.
+ *
+ * @var words
+ * Parole concatenate, senza separatori.
+ * @var offsets
+ * Inizio di ogni parola in `words` (wordCount + 1 elementi).
+ * @var wordCount
+ * Numero di parole.
+ * @var slots
+ * Tabella hash da parola a codice (codice + 1, 0 se vuota).
+ * @var mask
+ * Numero di slot meno uno.
+ */
+typedef struct PersonDictionary
+{
+  Buffer words;
+  Buffer offsets;
+  size_t wordCount;
+  uint32_t* slots;
+  size_t mask;
+} PersonDictionary;
+
+/**
+ * @struct PersonDict
+ * @brief File con i nomi codificati, caricato in memoria.
+ *
+ * @var meta
+ * Metadati del database da cui è stato creato il file.
+ * @var dictionary
+ * Dizionario delle parole.
+ * @var records
+ * Record codificati.
+ */
+typedef struct PersonDict
+{
+  PersonMeta meta;
+  PersonDictionary dictionary;
+  Buffer records;
+} PersonDict;
+
+/**
+ * @brief Crea il file con i nomi codificati a partire dal database.
+ *
+ * @param fp Puntatore al file del database.
+ * @param filename Nome del file da creare.
+ * @return true se il file è stato creato, false in caso di errore.
+ */
+bool buildPersonDict(FILE* fp, const char* filename);
+
+/**
+ * @brief Carica in memoria un file creato con buildPersonDict.
+ *
+ * @param filename Nome del file.
+ * @return Puntatore al file caricato, NULL se manca o non è valido.
+ */
+PersonDict* openPersonDict(const char* filename);
+
+/**
+ * @brief Libera la memoria di un file caricato.
+ */
+void closePersonDict(PersonDict* dict);
+
+/**
+ * @brief Trova tutte le persone con un certo nome.
+ *
+ * Il nome viene codificato una volta; se contiene una parola che non è nel
+ * dizionario la risposta è immediata.
+ *
+ * @param dict Puntatore al file caricato.
+ * @param name Nome da cercare.
+ * @param count Numero di persone trovate.
+ * @return Array delle persone trovate (da liberare con freePeople e free),
+ *         NULL se nessuna.
+ */
+Person* findPeopleInDict(const PersonDict* dict, const char* name, size_t* count);
+
+#endif // PERSON_DICT_H
@@ -0,0 +1,458 @@
+#include "person-log.h"
+#include "person-scan.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PERSON_LOG_MAGIC "PLOG"
+#define PERSON_LOG_VERSION 2
+#define PERSON_LOG_MAX_ENTRY_SIZE (1 << 30)
+
+typedef struct PersonLogHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t firstLsn;
+  uint64_t epoch;
+} PersonLogHeader;
+
+// The checksum covers this header (with checksum set to 0) and the payload
+typedef struct PersonLogEntryHeader
+{
+  uint64_t lsn;
+  uint64_t autoIncrementId;
+  uint64_t count;
+  uint32_t operation;
+  uint32_t size;
+  uint32_t checksum;
+  uint32_t reserved;
+} PersonLogEntryHeader;
+
+void appendPersonLogEntry(PersonLog* log, Buffer* output, PersonLogOperation operation, const PersonMeta* meta, const char* payload, size_t size)
+{
+  PersonLogEntryHeader header;
+  memset(&header, 0, sizeof(PersonLogEntryHeader));
+  header.lsn = ++log->lastLsn;
+  header.autoIncrementId = meta->autoIncrementId;
+  header.count = meta->count;
+  header.operation = operation;
+  header.size = (uint32_t)size;
+  header.checksum = updateCrc32(updateCrc32(0, &header, sizeof(PersonLogEntryHeader)), payload, size);
+
+  appendBuffer(output, &header, sizeof(PersonLogEntryHeader));
+  appendBuffer(output, payload, size);
+}
+
+bool writePersonLogEntry(PersonLog* log, PersonLogOperation operation, const PersonMeta* meta, const char* payload, size_t size)
+{
+  Buffer output;
+  initBuffer(&output, sizeof(PersonLogEntryHeader) + size);
+  appendPersonLogEntry(log, &output, operation, meta, payload, size);
+
+  fseek(log->fp, 0, SEEK_END);
+  bool success = flushBuffer(&output, log->fp) && fflush(log->fp) == 0;
+  freeBuffer(&output);
+  return success;
+}
+
+// Any non-zero value works, it only has to differ from the epochs of earlier logs
+uint64_t createPersonLogEpoch()
+{
+  uint64_t epoch = 0;
+  FILE* randomFile = fopen("/dev/urandom", "rb");
+  if (randomFile)
+  {
+    if (fread(&epoch, sizeof(uint64_t), 1, randomFile) != 1)
+      epoch = 0;
+    fclose(randomFile);
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  epoch ^= (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+  return epoch != 0 ? epoch : 1;
+}
+
+bool readPersonLogHeader(FILE* logFile, PersonLogHeader* header)
+{
+  return fread(header, sizeof(PersonLogHeader), 1, logFile) == 1 && memcmp(header->magic, PERSON_LOG_MAGIC, 4) == 0 &&
+         header->version == PERSON_LOG_VERSION && header->firstLsn > 0 && header->epoch != 0;
+}
+
+bool readPersonLogEntryHeader(FILE* logFile, PersonLogEntryHeader* header)
+{
+  return fread(header, sizeof(PersonLogEntryHeader), 1, logFile) == 1 && header->size <= PERSON_LOG_MAX_ENTRY_SIZE;
+}
+
+// Returns false on a torn or corrupted entry
+bool readPersonLogEntryPayload(FILE* logFile, const PersonLogEntryHeader* header, Buffer* payload)
+{
+  clearBuffer(payload);
+  reserveBuffer(payload, header->size);
+  if (fread(payload->data, sizeof(char), header->size, logFile) != header->size)
+    return false;
+  payload->size = header->size;
+
+  PersonLogEntryHeader unchecked = *header;
+  unchecked.checksum = 0;
+  return updateCrc32(updateCrc32(0, &unchecked, sizeof(PersonLogEntryHeader)), payload->data, payload->size) == header->checksum;
+}
+
+bool decodePersonLogEntry(const PersonLogEntryHeader* header, const Buffer* payload, PersonLogEntry* entry)
+{
+  entry->lsn = header->lsn;
+  entry->operation = (PersonLogOperation)header->operation;
+  entry->meta.autoIncrementId = header->autoIncrementId;
+  entry->meta.count = header->count;
+  entry->person.id = 0;
+  entry->person.age = 0;
+  entry->person.name = NULL;
+
+  switch (entry->operation)
+  {
+  case PERSON_LOG_RESET:
+    return payload->size == 0;
+  case PERSON_LOG_DELETE:
+    if (payload->size != sizeof(size_t))
+      return false;
+    memcpy(&entry->person.id, payload->data, sizeof(size_t));
+    return true;
+  case PERSON_LOG_INSERT:
+  case PERSON_LOG_UPDATE:
+  {
+    // Same layout as a db record
+    const size_t fixedSize = sizeof(size_t) + sizeof(int) + sizeof(size_t);
+    size_t nameLength;
+    if (payload->size < fixedSize)
+      return false;
+    memcpy(&entry->person.id, payload->data, sizeof(size_t));
+    memcpy(&entry->person.age, payload->data + sizeof(size_t), sizeof(int));
+    memcpy(&nameLength, payload->data + sizeof(size_t) + sizeof(int), sizeof(size_t));
+    if (nameLength == 0 || payload->size != fixedSize + nameLength || payload->data[payload->size - 1] != '\0')
+      return false;
+    entry->person.name = payload->data + fixedSize;
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+PersonLog* openPersonLog(const char* filename, FILE* dbFp)
+{
+  PersonLog* log = (PersonLog*)malloc(sizeof(PersonLog));
+  log->filename = (char*)malloc(strlen(filename) + 1);
+  strcpy(log->filename, filename);
+  log->firstLsn = 1;
+  log->lastLsn = 0;
+  log->epoch = 0;
+  log->fp = fopen(filename, "r+b");
+
+  // Without a readable header the last LSN is unknown, so the reset below
+  // starts a new epoch and LSNs start over from 1
+  bool valid = false;
+  PersonLogHeader header;
+  if (log->fp && readPersonLogHeader(log->fp, &header))
+  {
+    log->firstLsn = header.firstLsn;
+    log->lastLsn = header.firstLsn - 1;
+    log->epoch = header.epoch;
+
+    Buffer payload;
+    initBuffer(&payload, 256);
+    PersonLogEntryHeader entry;
+    PersonMeta lastMeta = {0, 0};
+    bool hasEntries = false;
+    bool ordered = true;
+    long validEnd = ftell(log->fp);
+    while (ordered && readPersonLogEntryHeader(log->fp, &entry) && readPersonLogEntryPayload(log->fp, &entry, &payload))
+    {
+      ordered = entry.lsn == log->lastLsn + 1;
+      if (!ordered)
+        break;
+      log->lastLsn = entry.lsn;
+      lastMeta.autoIncrementId = entry.autoIncrementId;
+      lastMeta.count = entry.count;
+      hasEntries = true;
+      validEnd = ftell(log->fp);
+    }
+    freeBuffer(&payload);
+
+    // A torn entry at the end or a db that moved on without the log both
+    // mean the log can't be trusted any more
+    fseek(log->fp, 0, SEEK_END);
+    PersonMeta dbMeta;
+    loadPersonMeta(dbFp, &dbMeta);
+    valid = ordered && hasEntries && ftell(log->fp) == validEnd &&
+            lastMeta.autoIncrementId == dbMeta.autoIncrementId && lastMeta.count == dbMeta.count;
+  }
+
+  if (!valid && !logPersonReset(log, dbFp))
+  {
+    closePersonLog(log);
+    return NULL;
+  }
+  return log;
+}
+
+void closePersonLog(PersonLog* log)
+{
+  if (log->fp)
+    fclose(log->fp);
+  free(log->filename);
+  free(log);
+}
+
+bool logPersonInsert(PersonLog* log, const Person* person, const PersonMeta* meta)
+{
+  Buffer payload;
+  initBuffer(&payload, 64);
+  encodePerson(&payload, person);
+  bool success = writePersonLogEntry(log, PERSON_LOG_INSERT, meta, payload.data, payload.size);
+  freeBuffer(&payload);
+  return success;
+}
+
+bool logPersonInserts(PersonLog* log, const char* records, size_t size, size_t recordCount, const PersonMeta* meta)
+{
+  Buffer output;
+  initBuffer(&output, size + recordCount * sizeof(PersonLogEntryHeader));
+
+  // Each entry gets the metadata the db had right after that insert
+  size_t offset = 0;
+  for (size_t i = 0; i < recordCount; i++)
+  {
+    size_t id;
+    size_t nameLength;
+    memcpy(&id, records + offset, sizeof(size_t));
+    memcpy(&nameLength, records + offset + sizeof(size_t) + sizeof(int), sizeof(size_t));
+    size_t recordSize = sizeof(size_t) + sizeof(int) + sizeof(size_t) + nameLength;
+
+    PersonMeta entryMeta = {id + 1, meta->count - (recordCount - 1 - i)};
+    appendPersonLogEntry(log, &output, PERSON_LOG_INSERT, &entryMeta, records + offset, recordSize);
+    offset += recordSize;
+  }
+
+  fseek(log->fp, 0, SEEK_END);
+  bool success = offset == size && flushBuffer(&output, log->fp) && fflush(log->fp) == 0;
+  freeBuffer(&output);
+  return success;
+}
+
+bool logPersonUpdate(PersonLog* log, const Person* person, const PersonMeta* meta)
+{
+  Buffer payload;
+  initBuffer(&payload, 64);
+  encodePerson(&payload, person);
+  bool success = writePersonLogEntry(log, PERSON_LOG_UPDATE, meta, payload.data, payload.size);
+  freeBuffer(&payload);
+  return success;
+}
+
+bool logPersonDelete(PersonLog* log, size_t id, const PersonMeta* meta)
+{
+  return writePersonLogEntry(log, PERSON_LOG_DELETE, meta, (const char*)&id, sizeof(size_t));
+}
+
+bool logPersonReset(PersonLog* log, FILE* dbFp)
+{
+  // Nothing before a reset is needed to rebuild the db, so the new log is
+  // written to a temporary file that replaces the old one only when it is
+  // complete; an interrupted reset leaves the old log as it was
+  Buffer tempFilename;
+  initBuffer(&tempFilename, 64);
+  appendStringToBuffer(&tempFilename, log->filename);
+  appendStringToBuffer(&tempFilename, ".tmp");
+  appendBuffer(&tempFilename, "", 1);
+  FILE* tempFp = fopen(tempFilename.data, "w+b");
+  if (!tempFp)
+  {
+    freeBuffer(&tempFilename);
+    return false;
+  }
+
+  PersonMeta meta;
+  loadPersonMeta(dbFp, &meta);
+
+  const uint64_t lastLsn = log->lastLsn;
+  PersonLogHeader header;
+  memset(&header, 0, sizeof(PersonLogHeader));
+  memcpy(header.magic, PERSON_LOG_MAGIC, 4);
+  header.version = PERSON_LOG_VERSION;
+  header.firstLsn = lastLsn + 1;
+  header.epoch = log->epoch != 0 ? log->epoch : createPersonLogEpoch();
+  bool success = fwrite(&header, sizeof(PersonLogHeader), 1, tempFp) == 1;
+
+  Buffer output;
+  initBuffer(&output, PERSON_EXPORT_BUFFER_SIZE + 4096);
+  Buffer payload;
+  initBuffer(&payload, 64);
+
+  // Each entry carries the metadata of the rows written so far, so a reader
+  // that stops in the middle of the reset still has a consistent db; only
+  // the last entry gets the real metadata, whose next id may be higher.
+  // The scan is one record ahead to know which entry is the last
+  PersonScan scan;
+  openPersonScan(&scan, dbFp);
+  Person person;
+  bool hasPerson = nextPersonScanRecord(&scan, &person);
+  PersonMeta entryMeta = {0, 0};
+  appendPersonLogEntry(log, &output, PERSON_LOG_RESET, hasPerson ? &entryMeta : &meta, "", 0);
+
+  while (success && hasPerson)
+  {
+    clearBuffer(&payload);
+    encodePerson(&payload, &person);
+    if (person.id + 1 > entryMeta.autoIncrementId)
+      entryMeta.autoIncrementId = person.id + 1;
+    entryMeta.count++;
+    hasPerson = nextPersonScanRecord(&scan, &person);
+    appendPersonLogEntry(log, &output, PERSON_LOG_INSERT, hasPerson ? &entryMeta : &meta, payload.data, payload.size);
+
+    if (output.size >= PERSON_EXPORT_BUFFER_SIZE)
+      success = flushBuffer(&output, tempFp);
+  }
+  if (!closePersonScan(&scan))
+    success = false;
+  if (success)
+    success = flushBuffer(&output, tempFp) && fflush(tempFp) == 0 && rename(tempFilename.data, log->filename) == 0;
+
+  if (success)
+  {
+    if (log->fp)
+      fclose(log->fp);
+    log->fp = tempFp;
+    log->firstLsn = header.firstLsn;
+    log->epoch = header.epoch;
+  }
+  else
+  {
+    fclose(tempFp);
+    remove(tempFilename.data);
+    log->lastLsn = lastLsn;
+  }
+
+  freeBuffer(&tempFilename);
+  freeBuffer(&payload);
+  freeBuffer(&output);
+  return success;
+}
+
+bool scanPersonLogEntries(FILE* logFile, uint64_t epoch, uint64_t afterLsn, PersonLogVisit visit, void* context)
+{
+  Buffer payload;
+  initBuffer(&payload, 256);
+
+  bool success = true;
+  PersonLogEntryHeader header;
+  while (success && readPersonLogEntryHeader(logFile, &header))
+  {
+    // Entries up to afterLsn are skipped without reading their payload
+    if (header.lsn <= afterLsn)
+    {
+      success = fseek(logFile, header.size, SEEK_CUR) == 0;
+      continue;
+    }
+
+    PersonLogEntry entry;
+    entry.epoch = epoch;
+    success = readPersonLogEntryPayload(logFile, &header, &payload) && decodePersonLogEntry(&header, &payload, &entry) &&
+              visit(context, &entry);
+  }
+
+  freeBuffer(&payload);
+  return success;
+}
+
+bool scanPersonLog(PersonLog* log, uint64_t afterLsn, PersonLogVisit visit, void* context)
+{
+  fseek(log->fp, sizeof(PersonLogHeader), SEEK_SET);
+  bool success = scanPersonLogEntries(log->fp, log->epoch, afterLsn, visit, context);
+  fseek(log->fp, 0, SEEK_END);
+  return success;
+}
+
+bool scanPersonLogFile(const char* filename, uint64_t epoch, uint64_t afterLsn, PersonLogVisit visit, void* context)
+{
+  FILE* logFile = fopen(filename, "rb");
+  if (!logFile)
+    return false;
+
+  // LSNs of another epoch say nothing about what was already processed
+  PersonLogHeader header;
+  bool success = readPersonLogHeader(logFile, &header);
+  if (success)
+    success = scanPersonLogEntries(logFile, header.epoch, header.epoch == epoch ? afterLsn : 0, visit, context);
+
+  fclose(logFile);
+  return success;
+}
+
+typedef struct PersonLogExport
+{
+  FILE* ndjsonFile;
+  Buffer output;
+  size_t entryCount;
+  bool failed;
+} PersonLogExport;
+
+bool exportPersonLogEntry(void* context, const PersonLogEntry* entry)
+{
+  static const char* operations[] = {"", "reset", "insert", "update", "delete"};
+  PersonLogExport* logExport = (PersonLogExport*)context;
+  Buffer* output = &logExport->output;
+
+  appendStringToBuffer(output, "{\"lsn\":");
+  appendSize_tToBuffer(output, entry->lsn);
+  appendStringToBuffer(output, ",\"op\":\"");
+  appendStringToBuffer(output, operations[entry->operation]);
+  appendBuffer(output, "\"", 1);
+
+  switch (entry->operation)
+  {
+  case PERSON_LOG_RESET:
+    appendStringToBuffer(output, ",\"metadata\":{\"autoIncrementId\":");
+    appendSize_tToBuffer(output, entry->meta.autoIncrementId);
+    appendStringToBuffer(output, ",\"count\":");
+    appendSize_tToBuffer(output, entry->meta.count);
+    appendBuffer(output, "}", 1);
+    break;
+  case PERSON_LOG_DELETE:
+    appendStringToBuffer(output, ",\"id\":");
+    appendSize_tToBuffer(output, entry->person.id);
+    break;
+  default:
+    appendStringToBuffer(output, ",\"person\":");
+    appendPersonJson(output, &entry->person);
+    break;
+  }
+  appendStringToBuffer(output, "}\n");
+  logExport->entryCount++;
+
+  if (output->size >= PERSON_EXPORT_BUFFER_SIZE && !flushBuffer(output, logExport->ndjsonFile))
+    logExport->failed = true;
+  return !logExport->failed;
+}
+
+bool exportPersonLogToNdjson(PersonLog* log, uint64_t afterLsn, const char* filename, size_t* entryCount)
+{
+  PersonLogExport logExport;
+  logExport.ndjsonFile = fopen(filename, "w");
+  if (!logExport.ndjsonFile)
+    return false;
+  initBuffer(&logExport.output, PERSON_EXPORT_BUFFER_SIZE + 4096);
+  logExport.entryCount = 0;
+  logExport.failed = false;
+
+  bool success = scanPersonLog(log, afterLsn, exportPersonLogEntry, &logExport) &&
+                 flushBuffer(&logExport.output, logExport.ndjsonFile);
+  freeBuffer(&logExport.output);
+
+  if (fclose(logExport.ndjsonFile) != 0)
+    success = false;
+  if (!success)
+    remove(filename);
+
+  *entryCount = logExport.entryCount;
+  return success;
+}
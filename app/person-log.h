@@ -0,0 +1,226 @@
+/**
+ * @file person-log.h
+ * @brief Registro delle modifiche del database con numeri di sequenza (LSN).
+ *
+ * Ogni inserimento, aggiornamento ed eliminazione viene aggiunto in coda al
+ * registro con un LSN crescente, così si possono esportare solo le
+ * modifiche successive a un LSN già elaborato. Quando il database viene
+ * sostituito per intero (caricamento di un JSON, ripristino, ...) il
+ * registro viene riscritto con un azzeramento seguito dall'inserimento di
+ * tutte le persone: le voci precedenti non servono più e gli LSN continuano
+ * dall'ultimo usato. Il nuovo registro viene scritto in un file temporaneo
+ * che sostituisce il vecchio solo quando è completo.
+ *
+ * Ogni registro ha un'epoca, un numero casuale scritto nell'intestazione.
+ * Gli LSN crescono sempre all'interno della stessa epoca; se il registro va
+ * perso o non è leggibile ne viene creato uno nuovo, con una nuova epoca e
+ * gli LSN di nuovo da 1. Chi ha elaborato le voci di un'altra epoca deve
+ * ripartire dall'azzeramento iniziale.
+ */
+
+#ifndef PERSON_LOG_H
+#define PERSON_LOG_H
+
+#include "person.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Nome predefinito del registro delle modifiche.
+ */
+#define PERSON_LOG_FILENAME "people.log"
+
+/**
+ * @enum PersonLogOperation
+ * @brief Tipo di una voce del registro.
+ *
+ * Dopo PERSON_LOG_RESET il database è vuoto; seguono gli inserimenti del
+ * nuovo contenuto.
+ */
+typedef enum PersonLogOperation
+{
+  PERSON_LOG_RESET = 1,
+  PERSON_LOG_INSERT,
+  PERSON_LOG_UPDATE,
+  PERSON_LOG_DELETE
+} PersonLogOperation;
+
+/**
+ * @struct PersonLogEntry
+ * @brief Voce del registro letta dal file.
+ *
+ * @var lsn
+ * Numero di sequenza della voce.
+ * @var epoch
+ * Epoca del registro da cui viene la voce.
+ * @var operation
+ * Tipo della voce.
+ * @var meta
+ * Metadati del database dopo la voce. Dopo un azzeramento ogni voce ha i
+ * metadati delle persone inserite fino a lei; solo l'ultima ha quelli
+ * finali del database, il cui prossimo ID può essere più alto.
+ * @var person
+ * Persona inserita o aggiornata; per un'eliminazione è valido solo l'ID.
+ */
+typedef struct PersonLogEntry
+{
+  uint64_t lsn;
+  uint64_t epoch;
+  PersonLogOperation operation;
+  PersonMeta meta;
+  Person person;
+} PersonLogEntry;
+
+/**
+ * @struct PersonLog
+ * @brief Registro delle modifiche aperto in scrittura.
+ *
+ * @var fp
+ * File del registro.
+ * @var filename
+ * Nome del file del registro.
+ * @var firstLsn
+ * LSN della prima voce nel file.
+ * @var lastLsn
+ * LSN dell'ultima voce scritta.
+ * @var epoch
+ * Epoca del registro.
+ */
+typedef struct PersonLog
+{
+  FILE* fp;
+  char* filename;
+  uint64_t firstLsn;
+  uint64_t lastLsn;
+  uint64_t epoch;
+} PersonLog;
+
+/**
+ * @brief Funzione chiamata per ogni voce durante una scansione.
+ *
+ * @return false per interrompere la scansione.
+ */
+typedef bool (*PersonLogVisit)(void* context, const PersonLogEntry* entry);
+
+/**
+ * @brief Apre il registro, creandolo se non esiste.
+ *
+ * Se il file manca, non è valido, termina con una voce incompleta o non
+ * corrisponde ai metadati del database (per esempio dopo un'interruzione
+ * tra la scrittura nel database e quella nel registro) il registro viene
+ * riscritto con un azzeramento.
+ *
+ * @param filename Nome del file del registro.
+ * @param dbFp Puntatore al file del database.
+ * @return Puntatore al registro, NULL se il file non può essere creato.
+ */
+PersonLog* openPersonLog(const char* filename, FILE* dbFp);
+
+/**
+ * @brief Chiude il registro e ne libera la memoria.
+ */
+void closePersonLog(PersonLog* log);
+
+/**
+ * @brief Registra l'inserimento di una persona.
+ *
+ * @param log Puntatore al registro.
+ * @param person Persona inserita (con il suo ID).
+ * @param meta Metadati del database dopo l'inserimento.
+ * @return true se la voce è stata scritta.
+ */
+bool logPersonInsert(PersonLog* log, const Person* person, const PersonMeta* meta);
+
+/**
+ * @brief Registra una serie di inserimenti con una sola scrittura.
+ *
+ * @param log Puntatore al registro.
+ * @param records Record codificati con encodePerson, con ID crescenti.
+ * @param size Dimensione in byte dei record.
+ * @param recordCount Numero di record.
+ * @param meta Metadati del database dopo l'ultimo inserimento.
+ * @return true se le voci sono state scritte.
+ */
+bool logPersonInserts(PersonLog* log, const char* records, size_t size, size_t recordCount, const PersonMeta* meta);
+
+/**
+ * @brief Registra l'aggiornamento di una persona.
+ *
+ * @param log Puntatore al registro.
+ * @param person Persona aggiornata.
+ * @param meta Metadati del database dopo l'aggiornamento.
+ * @return true se la voce è stata scritta.
+ */
+bool logPersonUpdate(PersonLog* log, const Person* person, const PersonMeta* meta);
+
+/**
+ * @brief Registra l'eliminazione di una persona.
+ *
+ * @param log Puntatore al registro.
+ * @param id ID della persona eliminata.
+ * @param meta Metadati del database dopo l'eliminazione.
+ * @return true se la voce è stata scritta.
+ */
+bool logPersonDelete(PersonLog* log, size_t id, const PersonMeta* meta);
+
+/**
+ * @brief Riscrive il registro con un azzeramento e l'inserimento di tutte
+ *        le persone del database.
+ *
+ * Va chiamata dopo ogni sostituzione del database.
+ *
+ * @param log Puntatore al registro.
+ * @param dbFp Puntatore al file del database.
+ * @return true se il registro è stato riscritto.
+ */
+bool logPersonReset(PersonLog* log, FILE* dbFp);
+
+/**
+ * @brief Scansiona le voci con LSN maggiore di `afterLsn`.
+ *
+ * Se le voci richieste sono state eliminate da un azzeramento, la
+ * scansione parte dall'azzeramento, che basta a ricostruire il database.
+ *
+ * @param log Puntatore al registro.
+ * @param afterLsn Ultimo LSN già elaborato (0 per tutte le voci).
+ * @param visit Funzione chiamata per ogni voce; il nome è valido solo
+ *              durante la chiamata.
+ * @param context Puntatore passato a `visit`.
+ * @return true se la scansione è arrivata alla fine.
+ */
+bool scanPersonLog(PersonLog* log, uint64_t afterLsn, PersonLogVisit visit, void* context);
+
+/**
+ * @brief Come scanPersonLog, ma legge un registro scritto da un altro
+ *        processo senza aprirlo in scrittura.
+ *
+ * Il registro può essere in corso di scrittura: la scansione si ferma alla
+ * prima voce incompleta. Se l'epoca del registro non è `epoch`, `afterLsn`
+ * non vale più e la scansione parte dalla prima voce.
+ *
+ * @param filename Nome del file del registro.
+ * @param epoch Epoca dell'ultimo LSN già elaborato (0 se nessuna).
+ * @param afterLsn Ultimo LSN già elaborato.
+ * @param visit Funzione chiamata per ogni voce.
+ * @param context Puntatore passato a `visit`.
+ * @return true se la scansione è arrivata alla fine del file.
+ */
+bool scanPersonLogFile(const char* filename, uint64_t epoch, uint64_t afterLsn, PersonLogVisit visit, void* context);
+
+/**
+ * @brief Esporta in NDJSON le voci con LSN maggiore di `afterLsn`.
+ *
+ * Ogni riga è un oggetto con `lsn`, `op` ("reset", "insert", "update",
+ * "delete") e i dati della voce: `person` per inserimenti e aggiornamenti,
+ * `id` per le eliminazioni e `metadata` per gli azzeramenti.
+ *
+ * @param log Puntatore al registro.
+ * @param afterLsn Ultimo LSN già elaborato.
+ * @param filename Nome del file da creare.
+ * @param entryCount Numero di voci esportate.
+ * @return true se il file è stato creato.
+ */
+bool exportPersonLogToNdjson(PersonLog* log, uint64_t afterLsn, const char* filename, size_t* entryCount);
+
+#endif // PERSON_LOG_H
@@ -0,0 +1,213 @@
+#include "person-replica.h"
+#include "person-log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PERSON_REPLICA_MAGIC "PRPL"
+#define PERSON_REPLICA_VERSION 2
+
+// Saved next to the replica db as "<db>.state"
+typedef struct PersonReplicaState
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t logEpoch;
+  uint64_t appliedLsn;
+  uint64_t autoIncrementId;
+  uint64_t count;
+} PersonReplicaState;
+
+void getPersonReplicaStateFilename(Buffer* filename)
+{
+  clearBuffer(filename);
+  appendStringToBuffer(filename, getPersonDbFilename());
+  appendStringToBuffer(filename, ".state");
+  appendBuffer(filename, "", 1);
+}
+
+void savePersonReplicaState(const PersonReplica* replica)
+{
+  PersonReplicaState state;
+  memset(&state, 0, sizeof(PersonReplicaState));
+  memcpy(state.magic, PERSON_REPLICA_MAGIC, 4);
+  state.version = PERSON_REPLICA_VERSION;
+  state.logEpoch = replica->logEpoch;
+  state.appliedLsn = replica->appliedLsn;
+  state.autoIncrementId = replica->meta.autoIncrementId;
+  state.count = replica->meta.count;
+
+  Buffer filename;
+  initBuffer(&filename, 64);
+  getPersonReplicaStateFilename(&filename);
+  FILE* stateFile = fopen(filename.data, "wb");
+  if (stateFile)
+  {
+    fwrite(&state, sizeof(PersonReplicaState), 1, stateFile);
+    fclose(stateFile);
+  }
+  freeBuffer(&filename);
+}
+
+// The saved position is only trusted if the db still has the metadata it was saved with
+void loadPersonReplicaState(PersonReplica* replica)
+{
+  replica->logEpoch = 0;
+  replica->appliedLsn = 0;
+
+  Buffer filename;
+  initBuffer(&filename, 64);
+  getPersonReplicaStateFilename(&filename);
+  FILE* stateFile = fopen(filename.data, "rb");
+  freeBuffer(&filename);
+  if (!stateFile)
+    return;
+
+  PersonReplicaState state;
+  bool valid = fread(&state, sizeof(PersonReplicaState), 1, stateFile) == 1 &&
+               memcmp(state.magic, PERSON_REPLICA_MAGIC, 4) == 0 && state.version == PERSON_REPLICA_VERSION &&
+               state.autoIncrementId == replica->meta.autoIncrementId && state.count == replica->meta.count;
+  fclose(stateFile);
+  if (valid)
+  {
+    replica->logEpoch = state.logEpoch;
+    replica->appliedLsn = state.appliedLsn;
+  }
+}
+
+void flushPersonReplicaInserts(PersonReplica* replica)
+{
+  insertEncodedPeople(replica->fp, replica->inserts.data, replica->inserts.size);
+  clearBuffer(&replica->inserts);
+}
+
+bool applyPersonReplicaEntry(void* context, const PersonLogEntry* entry)
+{
+  PersonReplica* replica = (PersonReplica*)context;
+
+  // Only a reset may jump ahead or start a new epoch, anything else out of
+  // order means the log was being rewritten while it was read and is picked
+  // up on the next poll
+  if (entry->operation != PERSON_LOG_RESET && (entry->epoch != replica->logEpoch || entry->lsn != replica->appliedLsn + 1))
+    return false;
+
+  if (entry->operation != PERSON_LOG_INSERT)
+    flushPersonReplicaInserts(replica);
+
+  Person person = entry->person;
+  switch (entry->operation)
+  {
+  case PERSON_LOG_RESET:
+  {
+    FILE* newFp = fopen(getPersonDbTempFilename(), "w+b");
+    if (!newFp)
+      return false;
+
+    PersonMeta empty = {0, 0};
+    updatePersonMeta(newFp, &empty);
+    fclose(replica->fp);
+    replica->fp = newFp;
+    remove(getPersonDbFilename());
+    rename(getPersonDbTempFilename(), getPersonDbFilename());
+    markPersonDbWrite();
+    break;
+  }
+  case PERSON_LOG_INSERT:
+    encodePerson(&replica->inserts, &person);
+    if (replica->inserts.size >= PERSON_IMPORT_BATCH_SIZE)
+      flushPersonReplicaInserts(replica);
+    break;
+  case PERSON_LOG_UPDATE:
+    updatePerson(&replica->fp, &replica->meta, person.id, &person);
+    break;
+  case PERSON_LOG_DELETE:
+    deletePerson(&replica->fp, &replica->meta, person.id);
+    break;
+  }
+
+  // The primary's metadata is authoritative, including autoIncrementId
+  replica->meta = entry->meta;
+  replica->logEpoch = entry->epoch;
+  replica->appliedLsn = entry->lsn;
+  return true;
+}
+
+size_t pollPersonReplica(PersonReplica* replica)
+{
+  // A log of another epoch has been started over, so the replica is rebuilt
+  // from its first reset
+  uint64_t previousEpoch = replica->logEpoch;
+  uint64_t previousLsn = replica->appliedLsn;
+  scanPersonLogFile(replica->logFilename, replica->logEpoch, replica->appliedLsn, applyPersonReplicaEntry, replica);
+
+  if (replica->logEpoch == previousEpoch && replica->appliedLsn == previousLsn)
+    return 0;
+
+  flushPersonReplicaInserts(replica);
+  updatePersonMeta(replica->fp, &replica->meta);
+  fflush(replica->fp);
+  savePersonReplicaState(replica);
+  return replica->logEpoch == previousEpoch ? (size_t)(replica->appliedLsn - previousLsn) : (size_t)replica->appliedLsn;
+}
+
+static void* runPersonReplica(void* arg)
+{
+  PersonReplica* replica = (PersonReplica*)arg;
+
+  pthread_mutex_lock(&replica->mutex);
+  while (replica->running)
+  {
+    pollPersonReplica(replica);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long)PERSON_REPLICA_POLL_INTERVAL_MS * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    if (replica->running)
+      pthread_cond_timedwait(&replica->changed, &replica->mutex, &deadline);
+  }
+  pthread_mutex_unlock(&replica->mutex);
+
+  return NULL;
+}
+
+PersonReplica* startPersonReplica(const char* logFilename)
+{
+  PersonReplica* replica = (PersonReplica*)malloc(sizeof(PersonReplica));
+  replica->meta.autoIncrementId = 0;
+  replica->meta.count = 0;
+  replica->fp = initPersonDB(&replica->meta);
+  if (!replica->fp)
+  {
+    free(replica);
+    return NULL;
+  }
+
+  replica->logFilename = (char*)malloc(strlen(logFilename) + 1);
+  strcpy(replica->logFilename, logFilename);
+  loadPersonReplicaState(replica);
+  initBuffer(&replica->inserts, PERSON_IMPORT_BATCH_SIZE + 4096);
+  pthread_mutex_init(&replica->mutex, NULL);
+  pthread_cond_init(&replica->changed, NULL);
+  replica->running = true;
+  pthread_create(&replica->thread, NULL, runPersonReplica, replica);
+
+  return replica;
+}
+
+void stopPersonReplica(PersonReplica* replica)
+{
+  pthread_mutex_lock(&replica->mutex);
+  replica->running = false;
+  pthread_cond_broadcast(&replica->changed);
+  pthread_mutex_unlock(&replica->mutex);
+  pthread_join(replica->thread, NULL);
+
+  pthread_cond_destroy(&replica->changed);
+  pthread_mutex_destroy(&replica->mutex);
+  freeBuffer(&replica->inserts);
+  free(replica->logFilename);
+  fclose(replica->fp);
+  free(replica);
+}
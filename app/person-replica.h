@@ -0,0 +1,100 @@
+/**
+ * @file person-replica.h
+ * @brief Replica in sola lettura alimentata dal registro delle modifiche.
+ *
+ * Un processo replica ha il suo file del database e legge il registro del
+ * database principale (sulla stessa macchina o su un percorso montato).
+ * Un thread applica di continuo le nuove voci, mentre il processo risponde
+ * alle letture; più repliche permettono di distribuire le letture su più
+ * file e processi.
+ */
+
+#ifndef PERSON_REPLICA_H
+#define PERSON_REPLICA_H
+
+#include "person.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Nome predefinito del file del database di una replica.
+ */
+#define PERSON_REPLICA_FILENAME "people_replica.db"
+
+/**
+ * @brief Intervallo in millisecondi tra due letture del registro.
+ */
+#define PERSON_REPLICA_POLL_INTERVAL_MS 200
+
+/**
+ * @struct PersonReplica
+ * @brief Stato di una replica.
+ *
+ * @var fp
+ * File del database della replica.
+ * @var meta
+ * Metadati del database della replica.
+ * @var logFilename
+ * Registro del database principale.
+ * @var logEpoch
+ * Epoca del registro dell'ultima voce applicata, 0 se nessuna.
+ * @var appliedLsn
+ * LSN dell'ultima voce applicata.
+ * @var inserts
+ * Inserimenti consecutivi non ancora scritti nel database.
+ * @var mutex
+ * Protegge tutti i campi; va tenuto durante ogni lettura del database.
+ * @var changed
+ * Segnala al thread la richiesta di fermarsi.
+ * @var thread
+ * Thread che applica il registro.
+ * @var running
+ * false quando il thread deve fermarsi.
+ */
+typedef struct PersonReplica
+{
+  FILE* fp;
+  PersonMeta meta;
+  char* logFilename;
+  uint64_t logEpoch;
+  uint64_t appliedLsn;
+  Buffer inserts;
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+  pthread_t thread;
+  bool running;
+} PersonReplica;
+
+/**
+ * @brief Apre il database della replica e avvia il thread che applica il
+ *        registro.
+ *
+ * Il database della replica è quello di getPersonDbFilename, quindi va
+ * scelto prima con setPersonDbFilename. L'ultimo LSN applicato e la sua
+ * epoca vengono salvati accanto al database, così al riavvio la replica
+ * riparte da lì; se il registro ha cambiato epoca la replica viene
+ * ricostruita dal suo azzeramento iniziale.
+ *
+ * @param logFilename Registro del database principale.
+ * @return Puntatore alla replica, NULL se il database non può essere aperto.
+ */
+PersonReplica* startPersonReplica(const char* logFilename);
+
+/**
+ * @brief Applica subito le nuove voci del registro.
+ *
+ * Il thread la chiama a ogni intervallo; va chiamata con il mutex preso.
+ *
+ * @param replica Puntatore alla replica.
+ * @return Numero di voci applicate.
+ */
+size_t pollPersonReplica(PersonReplica* replica);
+
+/**
+ * @brief Ferma il thread, chiude il database e libera la replica.
+ */
+void stopPersonReplica(PersonReplica* replica);
+
+#endif // PERSON_REPLICA_H
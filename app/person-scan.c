@@ -0,0 +1,268 @@
+#include "person-scan.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define PERSON_SCAN_RECORD_HEADER_SIZE (sizeof(size_t) + sizeof(int) + sizeof(size_t))
+
+size_t personScanBlockSize = PERSON_SCAN_DEFAULT_BLOCK_SIZE;
+PageCache* personScanCache = NULL;
+
+void setPersonScanBlockSize(size_t blockSize)
+{
+  if (blockSize < PERSON_SCAN_ALIGNMENT)
+    blockSize = PERSON_SCAN_ALIGNMENT;
+  personScanBlockSize = (blockSize + PERSON_SCAN_ALIGNMENT - 1) / PERSON_SCAN_ALIGNMENT * PERSON_SCAN_ALIGNMENT;
+}
+
+size_t getPersonScanBlockSize()
+{
+  return personScanBlockSize;
+}
+
+bool setPersonDirectIo(bool enabled, size_t cacheSize)
+{
+  if (personScanCache)
+    destroyPageCache(personScanCache);
+  personScanCache = NULL;
+  if (!enabled)
+    return true;
+
+  personScanCache = createPageCache(cacheSize, personScanBlockSize);
+  return personScanCache != NULL;
+}
+
+const PageCache* getPersonScanCache()
+{
+  return personScanCache;
+}
+
+void requestPersonScanBlock(PersonScan* scan, size_t index)
+{
+  AsyncIoRequest* request = &scan->requests[index];
+  request->fd = scan->directFd >= 0 ? scan->directFd : scan->fd;
+  request->write = false;
+  request->buffer = scan->buffers[index];
+  request->size = scan->blockSize;
+  request->offset = scan->nextOffset;
+  request->context = scan;
+  scan->ready[index] = false;
+  scan->cached[index] = false;
+  scan->nextOffset += scan->blockSize;
+
+  if (scan->directFd >= 0)
+  {
+    size_t size;
+    scan->cacheKey.offset = request->offset;
+    if (readPageCache(personScanCache, &scan->cacheKey, scan->cacheOwner, request->buffer, &size))
+    {
+      request->result = (long)size;
+      scan->ready[index] = true;
+      scan->cached[index] = true;
+      return;
+    }
+  }
+
+  if (scan->io)
+  {
+    submitAsyncIo(scan->io, request);
+    return;
+  }
+
+  // Scans of the same file may run on several threads at once
+  flockfile(scan->fp);
+  fseek(scan->fp, (long)request->offset, SEEK_SET);
+  request->result = (long)fread(request->buffer, sizeof(char), request->size, scan->fp);
+  funlockfile(scan->fp);
+  scan->ready[index] = true;
+}
+
+void openPersonScan(PersonScan* scan, FILE* fp)
+{
+  flockfile(fp);
+  fflush(fp);
+  fseek(fp, 0, SEEK_END);
+  scan->end = (uint64_t)ftell(fp);
+  funlockfile(fp);
+
+  scan->fp = fp;
+  scan->fd = fileno(fp);
+  scan->directFd = -1;
+  scan->io = getThreadAsyncIo();
+  scan->blockSize = personScanBlockSize;
+  scan->current = PERSON_SCAN_BUFFERS - 1;
+  scan->nextOffset = 0;
+  scan->data = NULL;
+  scan->size = 0;
+  scan->pos = 0;
+  scan->remaining = scan->end > sizeof(PersonMeta) ? scan->end - sizeof(PersonMeta) : 0;
+  initBuffer(&scan->carry, 64);
+  scan->failed = false;
+
+  // The cache key changes with every write, so pages of an older version
+  // of the file are never returned: the write generation covers the writes
+  // of this process that keep size and mtime, the rest covers other writers
+  struct stat fileStat;
+  if (personScanCache && scan->io && fstat(scan->fd, &fileStat) == 0)
+    scan->directFd = openDirectDescriptor(scan->fd);
+  if (scan->directFd >= 0)
+  {
+    scan->blockSize = personScanCache->pageSize;
+    scan->cacheKey.device = (uint64_t)fileStat.st_dev;
+    scan->cacheKey.inode = (uint64_t)fileStat.st_ino;
+    scan->cacheKey.modified = (uint64_t)fileStat.st_mtim.tv_sec * 1000000000u + (uint64_t)fileStat.st_mtim.tv_nsec;
+    scan->cacheKey.fileSize = (uint64_t)fileStat.st_size;
+    scan->cacheKey.generation = getPersonDbGeneration();
+    scan->cacheKey.offset = 0;
+    scan->cacheOwner = newPageCacheOwner(personScanCache);
+  }
+  else
+  {
+    posix_fadvise(scan->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  // Blocks always start on a page boundary, so the first one also holds
+  // the metadata that is skipped when it is decoded
+  for (size_t i = 0; i < PERSON_SCAN_BUFFERS; i++)
+  {
+    void* buffer = NULL;
+    if (posix_memalign(&buffer, PERSON_SCAN_ALIGNMENT, scan->blockSize) != 0)
+      buffer = NULL;
+    scan->buffers[i] = (char*)buffer;
+    scan->ready[i] = true;
+    scan->cached[i] = false;
+    if (!buffer)
+      scan->failed = true;
+  }
+  for (size_t i = 0; !scan->failed && i < PERSON_SCAN_BUFFERS && scan->nextOffset < scan->end; i++)
+    requestPersonScanBlock(scan, i);
+}
+
+bool advancePersonScan(PersonScan* scan)
+{
+  if (scan->remaining == 0 || scan->failed)
+    return false;
+
+  // The block just decoded is refilled while the next one is being read
+  if (scan->data && scan->nextOffset < scan->end)
+    requestPersonScanBlock(scan, scan->current);
+  scan->current = (scan->current + 1) % PERSON_SCAN_BUFFERS;
+
+  AsyncIoRequest* request = &scan->requests[scan->current];
+  if (!scan->ready[scan->current])
+  {
+    if (!waitAsyncIoRequest(scan->io, request))
+    {
+      scan->failed = true;
+      return false;
+    }
+    scan->ready[scan->current] = true;
+  }
+
+  uint64_t expected = scan->end - request->offset;
+  if (expected > scan->blockSize)
+    expected = scan->blockSize;
+  if (request->result < 0 || (uint64_t)request->result < expected)
+  {
+    scan->failed = true;
+    return false;
+  }
+
+  if (scan->directFd >= 0 && !scan->cached[scan->current])
+  {
+    scan->cacheKey.offset = request->offset;
+    writePageCache(personScanCache, &scan->cacheKey, scan->cacheOwner, scan->buffers[scan->current], (size_t)expected);
+  }
+
+  scan->data = scan->buffers[scan->current];
+  scan->size = (size_t)expected;
+  scan->pos = request->offset == 0 ? sizeof(PersonMeta) : 0;
+  scan->remaining -= scan->size - scan->pos;
+  return true;
+}
+
+// Copies the rest of a record that continues in the following blocks
+bool fillPersonScanCarry(PersonScan* scan, size_t size)
+{
+  while (scan->carry.size < size)
+  {
+    if (scan->pos == scan->size && !advancePersonScan(scan))
+    {
+      scan->failed = true;
+      return false;
+    }
+
+    size_t take = size - scan->carry.size;
+    if (take > scan->size - scan->pos)
+      take = scan->size - scan->pos;
+    appendBuffer(&scan->carry, scan->data + scan->pos, take);
+    scan->pos += take;
+  }
+  return true;
+}
+
+bool nextPersonScanRecord(PersonScan* scan, Person* person)
+{
+  if (scan->pos == scan->size && !advancePersonScan(scan))
+    return false;
+
+  const char* record = scan->data + scan->pos;
+  size_t available = scan->size - scan->pos;
+  size_t nameLength = 0;
+  if (available >= PERSON_SCAN_RECORD_HEADER_SIZE)
+    memcpy(&nameLength, record + sizeof(size_t) + sizeof(int), sizeof(size_t));
+
+  if (available >= PERSON_SCAN_RECORD_HEADER_SIZE && available - PERSON_SCAN_RECORD_HEADER_SIZE >= nameLength)
+  {
+    scan->pos += PERSON_SCAN_RECORD_HEADER_SIZE + nameLength;
+  }
+  else
+  {
+    clearBuffer(&scan->carry);
+    appendBuffer(&scan->carry, record, available);
+    scan->pos = scan->size;
+    if (!fillPersonScanCarry(scan, PERSON_SCAN_RECORD_HEADER_SIZE))
+      return false;
+    memcpy(&nameLength, scan->carry.data + sizeof(size_t) + sizeof(int), sizeof(size_t));
+    if (!fillPersonScanCarry(scan, PERSON_SCAN_RECORD_HEADER_SIZE + nameLength))
+      return false;
+    record = scan->carry.data;
+  }
+
+  memcpy(&person->id, record, sizeof(size_t));
+  memcpy(&person->age, record + sizeof(size_t), sizeof(int));
+  person->name = (char*)record + PERSON_SCAN_RECORD_HEADER_SIZE;
+  return true;
+}
+
+size_t appendPersonScanRecords(PersonScan* scan, Buffer* records, size_t size)
+{
+  size_t count = 0;
+  Person person;
+  while ((count == 0 || records->size < size) && nextPersonScanRecord(scan, &person))
+  {
+    encodePerson(records, &person);
+    count++;
+  }
+  return count;
+}
+
+bool closePersonScan(PersonScan* scan)
+{
+  // The queue belongs to the thread, only the reads of this scan are waited for
+  for (size_t i = 0; i < PERSON_SCAN_BUFFERS; i++)
+  {
+    if (!scan->ready[i])
+      waitAsyncIoRequest(scan->io, &scan->requests[i]);
+    free(scan->buffers[i]);
+  }
+  freeBuffer(&scan->carry);
+
+  if (scan->directFd >= 0)
+    closeDirectDescriptor(scan->directFd);
+  else
+    posix_fadvise(scan->fd, 0, 0, POSIX_FADV_NORMAL);
+  fseek(scan->fp, 0, SEEK_END);
+  return !scan->failed;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file person-scan.h
+ * @brief Lettura sequenziale del database con lettura anticipata.
+ *
+ * Invece di tante piccole fread, il file viene letto a blocchi grandi e
+ * allineati alla pagina, con due buffer: mentre i record di un blocco
+ * vengono decodificati, il blocco successivo è già in lettura (vedi
+ * async-io.h). Il kernel viene avvisato con posix_fadvise che l'accesso è
+ * sequenziale, così anche la sua lettura anticipata si allarga.
+ *
+ * In modalità diretta (setPersonDirectIo) i blocchi vengono letti con
+ * O_DIRECT, senza passare dalla cache del kernel: una scansione grande non
+ * toglie dalla memoria i file degli altri processi. Al loro posto i blocchi
+ * letti vengono tenuti in una cache del processo di dimensione fissa (vedi
+ * page-cache.h), condivisa da tutte le scansioni.
+ *
+ * Tutte le letture complete del database passano da qui: ricerche,
+ * esportazioni, indici, copie, partizioni, statistiche, ordinamento e il
+ * reset del registro delle modifiche. Restano fuori dalla modalità diretta
+ * solo le letture di pochi record, come quelli appena aggiunti da un file
+ * NDJSON, e i file di record senza metadati prodotti dall'ordinamento.
+ *
+ * Più scansioni dello stesso file possono essere eseguite da thread
+ * diversi, purché nessuno stia scrivendo sul database.
+ */
+
+#ifndef PERSON_SCAN_H
+#define PERSON_SCAN_H
+
+#include "async-io.h"
+#include "page-cache.h"
+#include "person.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Allineamento di buffer, dimensioni e posizioni delle letture.
+ */
+#define PERSON_SCAN_ALIGNMENT 4096
+
+/**
+ * @brief Dimensione predefinita di un blocco letto in anticipo.
+ */
+#define PERSON_SCAN_DEFAULT_BLOCK_SIZE (1 << 20)
+
+/**
+ * @brief Numero di blocchi letti contemporaneamente.
+ */
+#define PERSON_SCAN_BUFFERS 2
+
+/**
+ * @struct PersonScan
+ * @brief Scansione in corso dei record di un database.
+ *
+ * @var fp
+ * File del database.
+ * @var fd
+ * Descrittore del file del database.
+ * @var directFd
+ * Descrittore aperto con O_DIRECT, -1 fuori dalla modalità diretta.
+ * @var io
+ * Coda del thread (getThreadAsyncIo) per le letture anticipate, NULL se si
+ * legge con fread.
+ * @var blockSize
+ * Dimensione di un blocco.
+ * @var buffers
+ * Buffer allineati dei blocchi.
+ * @var requests
+ * Letture dei blocchi.
+ * @var ready
+ * Per ogni buffer, true se la sua lettura è terminata.
+ * @var cached
+ * Per ogni buffer, true se il blocco viene dalla cache del processo.
+ * @var current
+ * Buffer del blocco che si sta decodificando.
+ * @var nextOffset
+ * Posizione del primo blocco non ancora richiesto.
+ * @var end
+ * Fine dei record nel file.
+ * @var data
+ * Inizio dei dati del blocco corrente.
+ * @var size
+ * Byte validi del blocco corrente.
+ * @var pos
+ * Posizione nel blocco corrente.
+ * @var remaining
+ * Byte di record nei blocchi successivi a quello corrente.
+ * @var carry
+ * Copia di un record diviso tra due blocchi.
+ * @var failed
+ * true se una lettura non è riuscita.
+ * @var cacheKey
+ * Identità del file nella cache del processo.
+ * @var cacheOwner
+ * Proprietario delle pagine usate da questa scansione.
+ */
+typedef struct PersonScan
+{
+  FILE* fp;
+  int fd;
+  int directFd;
+  AsyncIo* io;
+  size_t blockSize;
+  char* buffers[PERSON_SCAN_BUFFERS];
+  AsyncIoRequest requests[PERSON_SCAN_BUFFERS];
+  bool ready[PERSON_SCAN_BUFFERS];
+  bool cached[PERSON_SCAN_BUFFERS];
+  size_t current;
+  uint64_t nextOffset;
+  uint64_t end;
+  const char* data;
+  size_t size;
+  size_t pos;
+  uint64_t remaining;
+  Buffer carry;
+  bool failed;
+  PageCacheKey cacheKey;
+  uint64_t cacheOwner;
+} PersonScan;
+
+/**
+ * @brief Imposta la dimensione dei blocchi delle scansioni aperte da ora
+ *        in poi.
+ * @param blockSize Dimensione in byte, arrotondata a un multiplo di
+ *                  PERSON_SCAN_ALIGNMENT.
+ */
+void setPersonScanBlockSize(size_t blockSize);
+
+/**
+ * @brief Restituisce la dimensione dei blocchi delle nuove scansioni.
+ */
+size_t getPersonScanBlockSize();
+
+/**
+ * @brief Attiva o disattiva la modalità diretta per le scansioni aperte da
+ *        ora in poi.
+ *
+ * La dimensione dei blocchi in uso diventa quella delle pagine della
+ * cache. Se il file system non supporta O_DIRECT le scansioni continuano a
+ * usare la cache del kernel.
+ *
+ * @param enabled true per attivare la modalità diretta.
+ * @param cacheSize Memoria della cache del processo in byte.
+ * @return false se la memoria della cache non può essere allocata.
+ */
+bool setPersonDirectIo(bool enabled, size_t cacheSize);
+
+/**
+ * @brief Restituisce la cache della modalità diretta, NULL se non è attiva.
+ */
+const PageCache* getPersonScanCache();
+
+/**
+ * @brief Inizia la scansione di tutti i record di un database.
+ *
+ * Le scritture ancora nel buffer di `fp` vengono prima scaricate sul file.
+ *
+ * @param scan Scansione da inizializzare.
+ * @param fp Puntatore al file del database.
+ */
+void openPersonScan(PersonScan* scan, FILE* fp);
+
+/**
+ * @brief Legge il prossimo record.
+ * @param scan Scansione in corso.
+ * @param person Persona letta; il nome resta valido fino alla prossima
+ *               chiamata.
+ * @return false alla fine dei record o in caso di errore.
+ */
+bool nextPersonScanRecord(PersonScan* scan, Person* person);
+
+/**
+ * @brief Copia i prossimi record, codificati come in encodePerson, finché
+ *        il buffer non raggiunge una dimensione.
+ *
+ * Vengono copiati solo record interi, e almeno uno se ce ne sono ancora.
+ *
+ * @param scan Scansione in corso.
+ * @param records Buffer a cui aggiungere i record.
+ * @param size Dimensione da raggiungere in byte.
+ * @return Numero di record copiati, 0 alla fine dei record o in caso di
+ *         errore.
+ */
+size_t appendPersonScanRecords(PersonScan* scan, Buffer* records, size_t size);
+
+/**
+ * @brief Termina una scansione, anche prima della fine dei record.
+ *
+ * Il file resta posizionato alla fine, come dopo una lettura completa.
+ *
+ * @param scan Scansione da chiudere.
+ * @return false se una lettura non è riuscita.
+ */
+bool closePersonScan(PersonScan* scan);
+
+#endif // PERSON_SCAN_H
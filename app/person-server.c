@@ -0,0 +1,422 @@
+#include "person-server.h"
+#include "unix-server.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define PERSON_SERVER_READ_SIZE 65536
+#define PERSON_SERVER_MAX_EVENTS 64
+
+// While a worker owns a client (busy) only the worker touches jobInput and
+// jobOutput, everything else belongs to the event loop
+typedef struct PersonServerClient
+{
+  int fd;
+  Buffer input;
+  Buffer output;
+  size_t outputSent;
+  Buffer jobInput;
+  Buffer jobOutput;
+  uint32_t events;
+  bool registered;
+  bool busy;
+  bool readClosed;
+  bool writeFailed;
+  struct PersonServerClient* next;
+} PersonServerClient;
+
+typedef struct PersonServer
+{
+  int epollFd;
+  int wakeFd;
+  int listener;
+  PersonCommandContext* context;
+  pthread_rwlock_t dbLock;
+  pthread_mutex_t mutex;
+  pthread_cond_t jobReady;
+  PersonServerClient* firstJob;
+  PersonServerClient* lastJob;
+  PersonServerClient* done;
+  bool stopping;
+  Buffer clients;
+  PersonServerClient* closed;
+} PersonServer;
+
+bool isPersonServerJobRead(const PersonServerClient* client)
+{
+  const char* line = client->jobInput.data;
+  const char* end = line + client->jobInput.size;
+  while (line < end)
+  {
+    const char* newline = (const char*)memchr(line, '\n', end - line);
+    if (!isPersonCommandLineRead(line, newline - line))
+      return false;
+    line = newline + 1;
+  }
+  return true;
+}
+
+void executePersonServerLines(PersonCommandContext* context, PersonServerClient* client)
+{
+  const char* line = client->jobInput.data;
+  const char* end = line + client->jobInput.size;
+  while (line < end)
+  {
+    const char* newline = (const char*)memchr(line, '\n', end - line);
+    executePersonCommandLine(context, line, newline - line, &client->jobOutput);
+    line = newline + 1;
+  }
+}
+
+// Every line the client had sent is executed under one lock, so runs of
+// inserts or gets are grouped and the answers come back complete. Jobs that
+// only read share the lock, each with its own queue of gets
+void executePersonServerJob(PersonServer* server, PersonServerClient* client)
+{
+  if (isPersonServerJobRead(client))
+  {
+    pthread_rwlock_rdlock(&server->dbLock);
+    PersonCommandContext reader;
+    initPersonCommandReader(&reader, server->context);
+    executePersonServerLines(&reader, client);
+    finishPersonCommandReader(&reader, &client->jobOutput);
+    pthread_rwlock_unlock(&server->dbLock);
+    return;
+  }
+
+  pthread_rwlock_wrlock(&server->dbLock);
+  executePersonServerLines(server->context, client);
+  flushPersonCommands(server->context, &client->jobOutput);
+  pthread_rwlock_unlock(&server->dbLock);
+}
+
+static void* runPersonServerWorker(void* arg)
+{
+  PersonServer* server = (PersonServer*)arg;
+
+  pthread_mutex_lock(&server->mutex);
+  while (true)
+  {
+    while (!server->firstJob && !server->stopping)
+      pthread_cond_wait(&server->jobReady, &server->mutex);
+    if (!server->firstJob)
+      break;
+
+    PersonServerClient* client = server->firstJob;
+    server->firstJob = client->next;
+    if (!server->firstJob)
+      server->lastJob = NULL;
+    pthread_mutex_unlock(&server->mutex);
+
+    executePersonServerJob(server, client);
+
+    pthread_mutex_lock(&server->mutex);
+    client->next = server->done;
+    server->done = client;
+    eventfd_write(server->wakeFd, 1);
+  }
+  pthread_mutex_unlock(&server->mutex);
+
+  return NULL;
+}
+
+void queuePersonServerJob(PersonServer* server, PersonServerClient* client)
+{
+  // Complete lines go to the worker, a partial one waits for more bytes
+  size_t length = client->input.size;
+  while (length > 0 && client->input.data[length - 1] != '\n')
+    length--;
+
+  clearBuffer(&client->jobInput);
+  appendBuffer(&client->jobInput, client->input.data, length);
+  memmove(client->input.data, client->input.data + length, client->input.size - length);
+  client->input.size -= length;
+  client->busy = true;
+
+  pthread_mutex_lock(&server->mutex);
+  client->next = NULL;
+  if (server->lastJob)
+    server->lastJob->next = client;
+  else
+    server->firstJob = client;
+  server->lastJob = client;
+  pthread_cond_signal(&server->jobReady);
+  pthread_mutex_unlock(&server->mutex);
+}
+
+// The memory is only released by freeClosedPersonServerClients, so events
+// already returned by epoll_wait can still look at the client
+void closePersonServerClient(PersonServer* server, PersonServerClient* client)
+{
+  if (client->registered)
+    epoll_ctl(server->epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+  closeDescriptor(client->fd);
+  client->fd = -1;
+
+  PersonServerClient** clients = (PersonServerClient**)server->clients.data;
+  size_t count = server->clients.size / sizeof(PersonServerClient*);
+  for (size_t i = 0; i < count; i++)
+  {
+    if (clients[i] == client)
+    {
+      clients[i] = clients[count - 1];
+      server->clients.size -= sizeof(PersonServerClient*);
+      break;
+    }
+  }
+
+  client->next = server->closed;
+  server->closed = client;
+}
+
+void freeClosedPersonServerClients(PersonServer* server)
+{
+  while (server->closed)
+  {
+    PersonServerClient* client = server->closed;
+    server->closed = client->next;
+    freeBuffer(&client->input);
+    freeBuffer(&client->output);
+    freeBuffer(&client->jobInput);
+    freeBuffer(&client->jobOutput);
+    free(client);
+  }
+}
+
+// Sends what it can, hands new lines to the workers and decides which
+// events the client still needs
+void updatePersonServerClient(PersonServer* server, PersonServerClient* client)
+{
+  if (client->outputSent < client->output.size && !client->writeFailed)
+  {
+    client->outputSent += writeUnixSocket(client->fd, client->output.data + client->outputSent,
+                                          client->output.size - client->outputSent, &client->writeFailed);
+  }
+  if (client->outputSent == client->output.size || client->writeFailed)
+  {
+    clearBuffer(&client->output);
+    client->outputSent = 0;
+  }
+
+  bool hasLine = memchr(client->input.data, '\n', client->input.size) != NULL;
+  if (!client->busy && !client->writeFailed && hasLine)
+    queuePersonServerJob(server, client);
+
+  // A line that never ends can't be answered, so the client is dropped
+  if (!hasLine && client->input.size > PERSON_SERVER_MAX_LINE)
+  {
+    clearBuffer(&client->input);
+    client->readClosed = true;
+  }
+
+  if (client->writeFailed)
+    client->readClosed = true;
+  if (client->readClosed && !client->busy && client->output.size == 0)
+  {
+    closePersonServerClient(server, client);
+    return;
+  }
+
+  // Reading pauses while too many bytes are waiting for the worker
+  uint32_t events = 0;
+  if (!client->readClosed && client->input.size <= PERSON_SERVER_MAX_LINE)
+    events |= EPOLLIN;
+  if (client->output.size > 0)
+    events |= EPOLLOUT;
+
+  // A closed client that is only waiting for its job is left out of the
+  // loop, otherwise its hang-up would be reported over and over
+  struct epoll_event event;
+  event.events = events;
+  event.data.ptr = client;
+  if (events == 0 && client->registered)
+  {
+    epoll_ctl(server->epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+    client->registered = false;
+  }
+  else if (events != 0 && !client->registered)
+  {
+    client->registered = epoll_ctl(server->epollFd, EPOLL_CTL_ADD, client->fd, &event) == 0;
+  }
+  else if (events != 0 && events != client->events)
+  {
+    epoll_ctl(server->epollFd, EPOLL_CTL_MOD, client->fd, &event);
+  }
+  client->events = events;
+}
+
+void acceptPersonServerClients(PersonServer* server)
+{
+  int fd;
+  while ((fd = acceptUnixClient(server->listener)) >= 0)
+  {
+    PersonServerClient* client = (PersonServerClient*)malloc(sizeof(PersonServerClient));
+    memset(client, 0, sizeof(PersonServerClient));
+    client->fd = fd;
+    initBuffer(&client->input, PERSON_SERVER_READ_SIZE);
+    initBuffer(&client->output, PERSON_SERVER_READ_SIZE);
+    initBuffer(&client->jobInput, PERSON_SERVER_READ_SIZE);
+    initBuffer(&client->jobOutput, PERSON_SERVER_READ_SIZE);
+    appendBuffer(&server->clients, &client, sizeof(PersonServerClient*));
+    updatePersonServerClient(server, client);
+  }
+}
+
+void readPersonServerClient(PersonServerClient* client)
+{
+  while (!client->readClosed && client->input.size <= PERSON_SERVER_MAX_LINE)
+  {
+    reserveBuffer(&client->input, client->input.size + PERSON_SERVER_READ_SIZE);
+    size_t count = readUnixSocket(client->fd, client->input.data + client->input.size, PERSON_SERVER_READ_SIZE, &client->readClosed);
+    client->input.size += count;
+    if (count < PERSON_SERVER_READ_SIZE)
+      break;
+  }
+
+  // A last command without its newline still counts once the client is done
+  if (client->readClosed && client->input.size > 0 && client->input.data[client->input.size - 1] != '\n')
+    appendBuffer(&client->input, "\n", 1);
+}
+
+void finishPersonServerJobs(PersonServer* server)
+{
+  eventfd_t value;
+  eventfd_read(server->wakeFd, &value);
+
+  pthread_mutex_lock(&server->mutex);
+  PersonServerClient* client = server->done;
+  server->done = NULL;
+  pthread_mutex_unlock(&server->mutex);
+
+  while (client)
+  {
+    PersonServerClient* next = client->next;
+    appendBuffer(&client->output, client->jobOutput.data, client->jobOutput.size);
+    clearBuffer(&client->jobOutput);
+    client->busy = false;
+    updatePersonServerClient(server, client);
+    client = next;
+  }
+}
+
+bool runPersonServer(const char* path, PersonCommandContext* context, size_t workerCount)
+{
+  PersonServer server;
+  memset(&server, 0, sizeof(PersonServer));
+  server.context = context;
+  server.listener = openUnixListener(path);
+  if (server.listener < 0)
+    return false;
+
+  server.epollFd = epoll_create1(EPOLL_CLOEXEC);
+  server.wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (server.epollFd < 0 || server.wakeFd < 0)
+  {
+    if (server.epollFd >= 0)
+      closeDescriptor(server.epollFd);
+    if (server.wakeFd >= 0)
+      closeDescriptor(server.wakeFd);
+    closeDescriptor(server.listener);
+    remove(path);
+    return false;
+  }
+
+  // The listener is told apart by a NULL pointer and the wake-up descriptor
+  // by the server itself, every other event belongs to a client
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+  epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.listener, &event);
+  event.data.ptr = &server;
+  epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.wakeFd, &event);
+
+  pthread_rwlock_init(&server.dbLock, NULL);
+  pthread_mutex_init(&server.mutex, NULL);
+  pthread_cond_init(&server.jobReady, NULL);
+  initBuffer(&server.clients, 16 * sizeof(PersonServerClient*));
+
+  // Workers never see SIGINT/SIGTERM, so the signal always interrupts
+  // epoll_wait in this thread
+  watchStopSignals();
+  blockStopSignals(true);
+
+  if (workerCount == 0)
+    workerCount = 1;
+  pthread_t* workers = (pthread_t*)malloc(workerCount * sizeof(pthread_t));
+  size_t startedWorkers = 0;
+  for (size_t i = 0; i < workerCount; i++)
+  {
+    if (pthread_create(&workers[startedWorkers], NULL, runPersonServerWorker, &server) == 0)
+      startedWorkers++;
+  }
+  blockStopSignals(false);
+
+  struct epoll_event events[PERSON_SERVER_MAX_EVENTS];
+  while (startedWorkers > 0 && !isStopRequested())
+  {
+    int count = epoll_wait(server.epollFd, events, PERSON_SERVER_MAX_EVENTS, -1);
+    if (count < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+      if (events[i].data.ptr == NULL)
+      {
+        acceptPersonServerClients(&server);
+        continue;
+      }
+      if (events[i].data.ptr == &server)
+      {
+        finishPersonServerJobs(&server);
+        continue;
+      }
+
+      // A client may already be closed by an earlier event of this batch
+      PersonServerClient* client = (PersonServerClient*)events[i].data.ptr;
+      if (client->fd < 0)
+        continue;
+
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        readPersonServerClient(client);
+      updatePersonServerClient(&server, client);
+    }
+    freeClosedPersonServerClients(&server);
+  }
+
+  // Queued jobs are completed before the workers stop
+  pthread_mutex_lock(&server.mutex);
+  server.stopping = true;
+  pthread_cond_broadcast(&server.jobReady);
+  pthread_mutex_unlock(&server.mutex);
+  for (size_t i = 0; i < startedWorkers; i++)
+    pthread_join(workers[i], NULL);
+  free(workers);
+  finishPersonServerJobs(&server);
+
+  while (server.clients.size > 0)
+    closePersonServerClient(&server, *(PersonServerClient**)server.clients.data);
+  freeClosedPersonServerClients(&server);
+  freeBuffer(&server.clients);
+
+  Buffer output;
+  initBuffer(&output, 0);
+  finishPersonCommands(context, &output);
+  freeBuffer(&output);
+
+  restoreStopSignals();
+  pthread_cond_destroy(&server.jobReady);
+  pthread_mutex_destroy(&server.mutex);
+  pthread_rwlock_destroy(&server.dbLock);
+  closeDescriptor(server.wakeFd);
+  closeDescriptor(server.epollFd);
+  closeDescriptor(server.listener);
+  remove(path);
+  return startedWorkers > 0;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file person-server.h
+ * @brief Server del database su un socket di dominio Unix.
+ *
+ * Un solo processo tiene aperti il database, il filtro di Bloom e il
+ * registro delle modifiche e li condivide con tutti i client locali. Il
+ * protocollo è quello di person-command.h: il client invia una riga per
+ * comando e riceve una riga NDJSON per risposta, nello stesso ordine. Un
+ * client può inviare più comandi senza aspettare le risposte.
+ *
+ * Un ciclo di eventi (epoll) accetta le connessioni, legge e scrive sui
+ * socket senza mai bloccarsi; i comandi vengono eseguiti da un gruppo di
+ * worker. Le righe già arrivate da un client vengono eseguite insieme,
+ * quindi anche gli inserimenti e le ricerche inviati in sequenza vengono
+ * raggruppati. Un gruppo di sole letture (get, find, count) viene eseguito
+ * insieme a quelli degli altri lettori; uno che contiene una modifica ha il
+ * database tutto per sé.
+ */
+
+#ifndef PERSON_SERVER_H
+#define PERSON_SERVER_H
+
+#include "person-command.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Percorso predefinito del socket del server.
+ */
+#define PERSON_SERVER_SOCKET "people.sock"
+
+/**
+ * @brief Lunghezza massima di una riga di comando; un client che la supera
+ *        viene disconnesso.
+ */
+#define PERSON_SERVER_MAX_LINE (1 << 20)
+
+/**
+ * @brief Esegue il server finché il processo non riceve SIGINT o SIGTERM.
+ *
+ * Alla chiusura i comandi in corso vengono completati e il contesto viene
+ * chiuso con finishPersonCommands.
+ *
+ * @param path Percorso del socket.
+ * @param context Contesto dei comandi, usato solo dai worker.
+ * @param workerCount Numero di worker.
+ * @return false se il socket non può essere creato.
+ */
+bool runPersonServer(const char* path, PersonCommandContext* context, size_t workerCount);
+
+#endif // PERSON_SERVER_H
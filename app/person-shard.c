@@ -0,0 +1,510 @@
+#include "person-shard.h"
+#include "person-scan.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PERSON_SHARD_MAGIC "PSHD"
+#define PERSON_SHARD_VERSION 1
+#define PERSON_SHARD_COPY_BUFFER_SIZE (1 << 20)
+
+// The next id is also kept by every shard, the manifest only needs it when
+// the shards are still empty
+typedef struct PersonShardManifest
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t shardCount;
+  uint64_t autoIncrementId;
+} PersonShardManifest;
+
+// Ids are mixed first so that strided ids still spread over every shard
+size_t getPersonShardIndex(size_t shardCount, size_t id)
+{
+  uint64_t hash = (uint64_t)id;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return (size_t)(hash % shardCount);
+}
+
+char* formatPersonShardFilename(const char* format, size_t index)
+{
+  char* filename = (char*)malloc(64);
+  snprintf(filename, 64, format, index);
+  return filename;
+}
+
+bool splitPersonDb(FILE* fp, size_t shardCount)
+{
+  if (shardCount == 0 || shardCount > PERSON_SHARD_MAX_COUNT)
+    return false;
+
+  // Without a manifest a half-written split is never opened
+  remove(PERSON_SHARD_MANIFEST_FILENAME);
+
+  PersonMeta meta;
+  loadPersonMeta(fp, &meta);
+
+  FILE** shardFps = (FILE**)calloc(shardCount, sizeof(FILE*));
+  PersonMeta* shardMetas = (PersonMeta*)malloc(shardCount * sizeof(PersonMeta));
+  Buffer* records = (Buffer*)malloc(shardCount * sizeof(Buffer));
+  bool success = true;
+  for (size_t i = 0; i < shardCount; i++)
+  {
+    shardMetas[i].autoIncrementId = meta.autoIncrementId;
+    shardMetas[i].count = 0;
+    initBuffer(&records[i], 4096);
+
+    char* filename = formatPersonShardFilename(PERSON_SHARD_FILENAME_FORMAT, i);
+    shardFps[i] = fopen(filename, "w+b");
+    free(filename);
+    if (!shardFps[i])
+    {
+      success = false;
+      continue;
+    }
+    updatePersonMeta(shardFps[i], &shardMetas[i]);
+  }
+
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (success && nextPersonScanRecord(&scan, &person))
+  {
+    size_t index = getPersonShardIndex(shardCount, person.id);
+    encodePerson(&records[index], &person);
+    shardMetas[index].count++;
+    if (records[index].size >= PERSON_IMPORT_BATCH_SIZE)
+    {
+      insertEncodedPeople(shardFps[index], records[index].data, records[index].size);
+      clearBuffer(&records[index]);
+    }
+  }
+  if (!closePersonScan(&scan))
+    success = false;
+
+  for (size_t i = 0; i < shardCount; i++)
+  {
+    if (success)
+    {
+      insertEncodedPeople(shardFps[i], records[i].data, records[i].size);
+      updatePersonMeta(shardFps[i], &shardMetas[i]);
+
+      // Every shard gets its own index sized for its share of the people
+      PersonBloom bloom;
+      buildPersonBloom(shardFps[i], PERSON_BLOOM_FALSE_POSITIVE_RATE, &bloom);
+      char* bloomFilename = formatPersonShardFilename(PERSON_SHARD_BLOOM_FILENAME_FORMAT, i);
+      success = savePersonBloom(&bloom, bloomFilename);
+      free(bloomFilename);
+      freePersonBloom(&bloom);
+    }
+
+    freeBuffer(&records[i]);
+    if (shardFps[i] && fclose(shardFps[i]) != 0)
+      success = false;
+  }
+  free(records);
+  free(shardMetas);
+  free(shardFps);
+
+  if (!success)
+    return false;
+
+  PersonShardManifest manifest;
+  memset(&manifest, 0, sizeof(PersonShardManifest));
+  memcpy(manifest.magic, PERSON_SHARD_MAGIC, 4);
+  manifest.version = PERSON_SHARD_VERSION;
+  manifest.shardCount = shardCount;
+  manifest.autoIncrementId = meta.autoIncrementId;
+
+  FILE* manifestFile = fopen(PERSON_SHARD_MANIFEST_FILENAME, "wb");
+  if (!manifestFile)
+    return false;
+  success = fwrite(&manifest, sizeof(PersonShardManifest), 1, manifestFile) == 1;
+  if (fclose(manifestFile) != 0)
+    success = false;
+  if (!success)
+    remove(PERSON_SHARD_MANIFEST_FILENAME);
+  return success;
+}
+
+bool hasPersonShards()
+{
+  FILE* manifestFile = fopen(PERSON_SHARD_MANIFEST_FILENAME, "rb");
+  if (!manifestFile)
+    return false;
+  fclose(manifestFile);
+  return true;
+}
+
+PersonShardSet* openPersonShards()
+{
+  FILE* manifestFile = fopen(PERSON_SHARD_MANIFEST_FILENAME, "rb");
+  if (!manifestFile)
+    return NULL;
+
+  PersonShardManifest manifest;
+  bool valid = fread(&manifest, sizeof(PersonShardManifest), 1, manifestFile) == 1 &&
+               memcmp(manifest.magic, PERSON_SHARD_MAGIC, 4) == 0 && manifest.version == PERSON_SHARD_VERSION &&
+               manifest.shardCount > 0 && manifest.shardCount <= PERSON_SHARD_MAX_COUNT;
+  fclose(manifestFile);
+  if (!valid)
+    return NULL;
+
+  PersonShardSet* set = (PersonShardSet*)malloc(sizeof(PersonShardSet));
+  set->shardCount = 0;
+  set->shards = (PersonShard*)malloc(manifest.shardCount * sizeof(PersonShard));
+  set->meta.autoIncrementId = manifest.autoIncrementId;
+  set->meta.count = 0;
+
+  for (size_t i = 0; i < manifest.shardCount; i++)
+  {
+    PersonShard* shard = &set->shards[i];
+    shard->filename = formatPersonShardFilename(PERSON_SHARD_FILENAME_FORMAT, i);
+    shard->fp = fopen(shard->filename, "r+b");
+    if (!shard->fp)
+    {
+      free(shard->filename);
+      closePersonShards(set);
+      return NULL;
+    }
+
+    loadPersonMeta(shard->fp, &shard->meta);
+    shard->bloomFilename = formatPersonShardFilename(PERSON_SHARD_BLOOM_FILENAME_FORMAT, i);
+    openPersonBloom(shard->fp, &shard->meta, PERSON_BLOOM_FALSE_POSITIVE_RATE, shard->bloomFilename, &shard->bloom);
+    set->shardCount++;
+
+    set->meta.count += shard->meta.count;
+    if (shard->meta.autoIncrementId > set->meta.autoIncrementId)
+      set->meta.autoIncrementId = shard->meta.autoIncrementId;
+  }
+
+  return set;
+}
+
+void closePersonShards(PersonShardSet* set)
+{
+  for (size_t i = 0; i < set->shardCount; i++)
+  {
+    fclose(set->shards[i].fp);
+    freePersonBloom(&set->shards[i].bloom);
+    free(set->shards[i].filename);
+    free(set->shards[i].bloomFilename);
+  }
+  free(set->shards);
+  free(set);
+}
+
+PersonShard* getPersonShard(PersonShardSet* set, size_t id)
+{
+  return &set->shards[getPersonShardIndex(set->shardCount, id)];
+}
+
+void savePersonShardBloom(PersonShard* shard)
+{
+  growPersonBloom(shard->fp, &shard->bloom);
+  shard->bloom.meta = shard->meta;
+  savePersonBloom(&shard->bloom, shard->bloomFilename);
+}
+
+void insertShardedPerson(PersonShardSet* set, Person* person)
+{
+  // Shards share one id sequence, so the shard's own counter is moved up to it
+  PersonShard* shard = getPersonShard(set, set->meta.autoIncrementId);
+  shard->meta.autoIncrementId = set->meta.autoIncrementId;
+  insertPerson(shard->fp, person, &shard->meta);
+  set->meta.autoIncrementId++;
+  set->meta.count++;
+
+  addPersonToBloom(&shard->bloom, person);
+  savePersonShardBloom(shard);
+}
+
+Person* findShardedPersonById(PersonShardSet* set, size_t id)
+{
+  PersonShard* shard = getPersonShard(set, id);
+  return personBloomMayContainId(&shard->bloom, id) ? findPersonById(shard->fp, id) : NULL;
+}
+
+// deletePerson and updatePerson replace the file named by getPersonDbFilename
+void selectPersonShardFile(const PersonShard* shard, Buffer* previous)
+{
+  initBuffer(previous, 64);
+  appendStringToBuffer(previous, getPersonDbFilename());
+  appendBuffer(previous, "", 1);
+  setPersonDbFilename(shard->filename);
+}
+
+void restorePersonDbFilename(Buffer* previous)
+{
+  setPersonDbFilename(previous->data);
+  freeBuffer(previous);
+}
+
+bool deleteShardedPerson(PersonShardSet* set, size_t id)
+{
+  PersonShard* shard = getPersonShard(set, id);
+  if (!personBloomMayContainId(&shard->bloom, id))
+    return false;
+
+  Buffer previous;
+  selectPersonShardFile(shard, &previous);
+  bool deleted = deletePerson(&shard->fp, &shard->meta, id);
+  restorePersonDbFilename(&previous);
+  if (!deleted)
+    return false;
+
+  // Deleted keys stay in the filter, they can only cause false positives
+  set->meta.count--;
+  savePersonShardBloom(shard);
+  return true;
+}
+
+bool updateShardedPerson(PersonShardSet* set, size_t id, Person* updatedPerson)
+{
+  PersonShard* shard = getPersonShard(set, id);
+  if (!personBloomMayContainId(&shard->bloom, id))
+    return false;
+
+  Buffer previous;
+  selectPersonShardFile(shard, &previous);
+  bool updated = updatePerson(&shard->fp, &shard->meta, id, updatedPerson);
+  restorePersonDbFilename(&previous);
+  if (!updated)
+    return false;
+
+  addPersonToBloom(&shard->bloom, updatedPerson);
+  savePersonShardBloom(shard);
+  return true;
+}
+
+typedef void (*PersonShardJob)(PersonShard* shard, size_t index, void* context, void* result);
+
+typedef struct PersonShardTask
+{
+  PersonShard* shard;
+  size_t index;
+  PersonShardJob job;
+  void* context;
+  void* result;
+} PersonShardTask;
+
+static void* runPersonShardTask(void* arg)
+{
+  PersonShardTask* task = (PersonShardTask*)arg;
+  task->job(task->shard, task->index, task->context, task->result);
+  return NULL;
+}
+
+// One thread per shard, each one only touches its own file; `results` holds
+// one element of `resultSize` bytes per shard
+void runOnPersonShards(PersonShardSet* set, PersonShardJob job, void* context, void* results, size_t resultSize)
+{
+  PersonShardTask* tasks = (PersonShardTask*)malloc(set->shardCount * sizeof(PersonShardTask));
+  pthread_t* threads = (pthread_t*)malloc(set->shardCount * sizeof(pthread_t));
+  bool* started = (bool*)calloc(set->shardCount, sizeof(bool));
+
+  for (size_t i = 0; i < set->shardCount; i++)
+  {
+    tasks[i].shard = &set->shards[i];
+    tasks[i].index = i;
+    tasks[i].job = job;
+    tasks[i].context = context;
+    tasks[i].result = (char*)results + i * resultSize;
+    started[i] = pthread_create(&threads[i], NULL, runPersonShardTask, &tasks[i]) == 0;
+    if (!started[i])
+      runPersonShardTask(&tasks[i]);
+  }
+
+  for (size_t i = 0; i < set->shardCount; i++)
+  {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+  }
+
+  free(started);
+  free(threads);
+  free(tasks);
+}
+
+typedef struct PersonShardPeople
+{
+  Person* people;
+  size_t count;
+} PersonShardPeople;
+
+int comparePersonIds(const void* a, const void* b)
+{
+  size_t idA = ((const Person*)a)->id;
+  size_t idB = ((const Person*)b)->id;
+  return idA < idB ? -1 : idA > idB;
+}
+
+// Shards are concatenated and then put back in id order
+Person* mergeShardPeople(PersonShardSet* set, PersonShardPeople* results, size_t* count)
+{
+  size_t total = 0;
+  for (size_t i = 0; i < set->shardCount; i++)
+    total += results[i].count;
+
+  Person* people = (Person*)malloc((total > 0 ? total : 1) * sizeof(Person));
+  size_t offset = 0;
+  for (size_t i = 0; i < set->shardCount; i++)
+  {
+    if (results[i].count > 0)
+      memcpy(people + offset, results[i].people, results[i].count * sizeof(Person));
+    offset += results[i].count;
+    free(results[i].people);
+  }
+
+  qsort(people, total, sizeof(Person), comparePersonIds);
+  *count = total;
+  return people;
+}
+
+void readPersonShard(PersonShard* shard, size_t index, void* context, void* result)
+{
+  (void)index;
+  (void)context;
+  PersonShardPeople* people = (PersonShardPeople*)result;
+  people->count = shard->meta.count;
+  people->people = shard->meta.count > 0 ? readPeople(shard->fp) : NULL;
+}
+
+Person* readShardedPeople(PersonShardSet* set, size_t* count)
+{
+  PersonShardPeople* results = (PersonShardPeople*)malloc(set->shardCount * sizeof(PersonShardPeople));
+  runOnPersonShards(set, readPersonShard, NULL, results, sizeof(PersonShardPeople));
+  Person* people = mergeShardPeople(set, results, count);
+  free(results);
+  return people;
+}
+
+void findPeopleInShard(PersonShard* shard, size_t index, void* context, void* result)
+{
+  (void)index;
+  const char* name = (const char*)context;
+  PersonShardPeople* found = (PersonShardPeople*)result;
+  found->people = NULL;
+  found->count = 0;
+  if (!personBloomMayContainName(&shard->bloom, name))
+    return;
+
+  Buffer matches;
+  initBuffer(&matches, 4 * sizeof(Person));
+
+  PersonScan scan;
+  openPersonScan(&scan, shard->fp);
+  Person person;
+  while (nextPersonScanRecord(&scan, &person))
+  {
+    if (strcmp(person.name, name) != 0)
+      continue;
+
+    size_t nameLength = strlen(person.name) + 1;
+    char* copy = (char*)malloc(nameLength);
+    memcpy(copy, person.name, nameLength);
+    person.name = copy;
+    appendBuffer(&matches, &person, sizeof(Person));
+    found->count++;
+  }
+  closePersonScan(&scan);
+
+  if (found->count > 0)
+    found->people = (Person*)matches.data;
+  else
+    freeBuffer(&matches);
+}
+
+Person* findShardedPeopleByName(PersonShardSet* set, const char* name, size_t* count)
+{
+  PersonShardPeople* results = (PersonShardPeople*)malloc(set->shardCount * sizeof(PersonShardPeople));
+  runOnPersonShards(set, findPeopleInShard, (void*)name, results, sizeof(PersonShardPeople));
+  Person* people = mergeShardPeople(set, results, count);
+  free(results);
+
+  if (*count == 0)
+  {
+    free(people);
+    return NULL;
+  }
+  return people;
+}
+
+void aggregatePersonShard(PersonShard* shard, size_t index, void* context, void* result)
+{
+  (void)index;
+  aggregatePersonDb(shard->fp, (const PersonAgeFilter*)context, (PersonAggregate*)result);
+}
+
+void aggregateShardedPeople(PersonShardSet* set, const PersonAgeFilter* filter, PersonAggregate* aggregate)
+{
+  PersonAggregate* results = (PersonAggregate*)malloc(set->shardCount * sizeof(PersonAggregate));
+  runOnPersonShards(set, aggregatePersonShard, (void*)filter, results, sizeof(PersonAggregate));
+
+  initPersonAggregate(aggregate);
+  for (size_t i = 0; i < set->shardCount; i++)
+    mergePersonAggregate(aggregate, &results[i]);
+  free(results);
+}
+
+void getPersonShardPartFilename(const char* filename, size_t index, Buffer* partFilename)
+{
+  clearBuffer(partFilename);
+  appendStringToBuffer(partFilename, filename);
+  appendStringToBuffer(partFilename, ".part");
+  appendSize_tToBuffer(partFilename, index);
+  appendBuffer(partFilename, "", 1);
+}
+
+void exportPersonShard(PersonShard* shard, size_t index, void* context, void* result)
+{
+  Buffer partFilename;
+  initBuffer(&partFilename, 64);
+  getPersonShardPartFilename((const char*)context, index, &partFilename);
+  *(bool*)result = personDbToNdjson(shard->fp, partFilename.data);
+  freeBuffer(&partFilename);
+}
+
+bool shardedPeopleToNdjson(PersonShardSet* set, const char* filename)
+{
+  bool* results = (bool*)malloc(set->shardCount * sizeof(bool));
+  runOnPersonShards(set, exportPersonShard, (void*)filename, results, sizeof(bool));
+
+  bool success = true;
+  for (size_t i = 0; i < set->shardCount; i++)
+    success = success && results[i];
+  free(results);
+
+  FILE* ndjsonFile = success ? fopen(filename, "wb") : NULL;
+  success = ndjsonFile != NULL;
+
+  Buffer partFilename;
+  initBuffer(&partFilename, 64);
+  char* chunk = (char*)malloc(PERSON_SHARD_COPY_BUFFER_SIZE);
+  for (size_t i = 0; i < set->shardCount; i++)
+  {
+    getPersonShardPartFilename(filename, i, &partFilename);
+    FILE* partFile = success ? fopen(partFilename.data, "rb") : NULL;
+    if (success && !partFile)
+      success = false;
+
+    size_t size;
+    while (partFile && success && (size = fread(chunk, sizeof(char), PERSON_SHARD_COPY_BUFFER_SIZE, partFile)) > 0)
+      success = fwrite(chunk, sizeof(char), size, ndjsonFile) == size;
+
+    if (partFile)
+      fclose(partFile);
+    remove(partFilename.data);
+  }
+  free(chunk);
+  freeBuffer(&partFilename);
+
+  if (ndjsonFile && fclose(ndjsonFile) != 0)
+    success = false;
+  if (!success && ndjsonFile)
+    remove(filename);
+  return success;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file person-shard.h
+ * @brief Database partizionato per ID su più file.
+ *
+ * Le persone sono distribuite tra N file (partizioni) in base a un hash
+ * dell'ID. Ogni partizione è un normale file del database, con i suoi
+ * metadati e il suo filtro di Bloom come indice. Le operazioni su un solo
+ * ID leggono o riscrivono solo la sua partizione, mentre scansioni,
+ * statistiche ed esportazioni lavorano su tutte le partizioni in parallelo.
+ * Il numero di partizioni è scelto alla creazione e salvato nel manifesto.
+ */
+
+#ifndef PERSON_SHARD_H
+#define PERSON_SHARD_H
+
+#include "person-aggregate.h"
+#include "person-bloom.h"
+#include "person.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * @brief Nome del manifesto delle partizioni.
+ */
+#define PERSON_SHARD_MANIFEST_FILENAME "people.shards"
+
+/**
+ * @brief Formato del nome del file di una partizione.
+ */
+#define PERSON_SHARD_FILENAME_FORMAT "people_shard%zu.db"
+
+/**
+ * @brief Formato del nome del filtro di Bloom di una partizione.
+ */
+#define PERSON_SHARD_BLOOM_FILENAME_FORMAT "people_shard%zu.bloom"
+
+/**
+ * @brief Numero predefinito di partizioni.
+ */
+#define PERSON_SHARD_DEFAULT_COUNT 4
+
+/**
+ * @brief Numero massimo di partizioni.
+ */
+#define PERSON_SHARD_MAX_COUNT 64
+
+/**
+ * @struct PersonShard
+ * @brief Una partizione aperta.
+ *
+ * @var fp
+ * File della partizione.
+ * @var meta
+ * Metadati della partizione.
+ * @var bloom
+ * Filtro di Bloom della partizione.
+ * @var filename
+ * Nome del file della partizione.
+ * @var bloomFilename
+ * Nome del file del filtro di Bloom.
+ */
+typedef struct PersonShard
+{
+  FILE* fp;
+  PersonMeta meta;
+  PersonBloom bloom;
+  char* filename;
+  char* bloomFilename;
+} PersonShard;
+
+/**
+ * @struct PersonShardSet
+ * @brief Insieme delle partizioni del database.
+ *
+ * @var shardCount
+ * Numero di partizioni.
+ * @var shards
+ * Partizioni, nell'ordine del manifesto.
+ * @var meta
+ * Metadati dell'intero database: il prossimo ID e il totale delle persone.
+ */
+typedef struct PersonShardSet
+{
+  size_t shardCount;
+  PersonShard* shards;
+  PersonMeta meta;
+} PersonShardSet;
+
+/**
+ * @brief Divide un database in partizioni e scrive il manifesto.
+ *
+ * Le partizioni e i filtri di Bloom già esistenti vengono sovrascritti.
+ *
+ * @param fp Puntatore al file del database da dividere.
+ * @param shardCount Numero di partizioni (da 1 a PERSON_SHARD_MAX_COUNT).
+ * @return true se le partizioni sono state create.
+ */
+bool splitPersonDb(FILE* fp, size_t shardCount);
+
+/**
+ * @brief Verifica se il database è diviso in partizioni.
+ *
+ * Finché il manifesto esiste le modifiche arrivano solo alle partizioni,
+ * quindi il file del database non partizionato non va più usato.
+ *
+ * @return true se il manifesto delle partizioni esiste.
+ */
+bool hasPersonShards();
+
+/**
+ * @brief Apre le partizioni elencate nel manifesto.
+ *
+ * @return Puntatore alle partizioni, NULL se il manifesto manca o una
+ *         partizione non può essere aperta.
+ */
+PersonShardSet* openPersonShards();
+
+/**
+ * @brief Chiude le partizioni e ne libera la memoria.
+ */
+void closePersonShards(PersonShardSet* set);
+
+/**
+ * @brief Restituisce la partizione che contiene un ID.
+ *
+ * @param set Puntatore alle partizioni.
+ * @param id ID della persona.
+ * @return Puntatore alla partizione.
+ */
+PersonShard* getPersonShard(PersonShardSet* set, size_t id);
+
+/**
+ * @brief Inserisce una persona con il prossimo ID nella sua partizione.
+ *
+ * @param set Puntatore alle partizioni.
+ * @param person Persona da inserire; il suo ID viene assegnato.
+ */
+void insertShardedPerson(PersonShardSet* set, Person* person);
+
+/**
+ * @brief Trova una persona per ID leggendo solo la sua partizione.
+ *
+ * @return Puntatore alla persona (da liberare), NULL se non esiste.
+ */
+Person* findShardedPersonById(PersonShardSet* set, size_t id);
+
+/**
+ * @brief Elimina una persona riscrivendo solo la sua partizione.
+ *
+ * @return true se la persona è stata eliminata.
+ */
+bool deleteShardedPerson(PersonShardSet* set, size_t id);
+
+/**
+ * @brief Aggiorna una persona riscrivendo solo la sua partizione.
+ *
+ * @param set Puntatore alle partizioni.
+ * @param id ID della persona.
+ * @param updatedPerson Nuovi dati della persona.
+ * @return true se la persona è stata aggiornata.
+ */
+bool updateShardedPerson(PersonShardSet* set, size_t id, Person* updatedPerson);
+
+/**
+ * @brief Legge tutte le persone di tutte le partizioni in parallelo.
+ *
+ * @param set Puntatore alle partizioni.
+ * @param count Numero di persone lette.
+ * @return Array delle persone ordinate per ID (da liberare).
+ */
+Person* readShardedPeople(PersonShardSet* set, size_t* count);
+
+/**
+ * @brief Trova tutte le persone con un nome, cercando in parallelo nelle
+ *        partizioni che secondo il loro filtro di Bloom possono contenerlo.
+ *
+ * @param set Puntatore alle partizioni.
+ * @param name Nome da cercare.
+ * @param count Numero di persone trovate.
+ * @return Array delle persone trovate ordinate per ID (da liberare), NULL
+ *         se non ce ne sono.
+ */
+Person* findShardedPeopleByName(PersonShardSet* set, const char* name, size_t* count);
+
+/**
+ * @brief Calcola le statistiche su tutte le partizioni in parallelo.
+ *
+ * @param set Puntatore alle partizioni.
+ * @param filter Intervallo di età da considerare.
+ * @param aggregate Risultato dell'aggregazione.
+ */
+void aggregateShardedPeople(PersonShardSet* set, const PersonAgeFilter* filter, PersonAggregate* aggregate);
+
+/**
+ * @brief Esporta tutte le partizioni in un unico file NDJSON.
+ *
+ * Ogni partizione viene esportata in parallelo in un file temporaneo; i
+ * file vengono poi uniti nell'ordine delle partizioni.
+ *
+ * @param set Puntatore alle partizioni.
+ * @param filename Nome del file da creare.
+ * @return true se il file è stato creato.
+ */
+bool shardedPeopleToNdjson(PersonShardSet* set, const char* filename);
+
+#endif // PERSON_SHARD_H
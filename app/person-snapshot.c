@@ -0,0 +1,321 @@
+#include "person-snapshot.h"
+#include "async-io.h"
+#include "compress.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PERSON_SNAPSHOT_MAGIC "PSNP"
+#define PERSON_SNAPSHOT_VERSION 1
+#define PERSON_SNAPSHOT_DB_SECTION "people.db"
+
+typedef struct PersonSnapshotHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t autoIncrementId;
+  uint64_t count;
+  uint64_t sectionCount;
+} PersonSnapshotHeader;
+
+typedef struct PersonSnapshotSection
+{
+  char name[PERSON_SNAPSHOT_NAME_SIZE];
+  uint64_t size;
+  uint64_t blockCount;
+} PersonSnapshotSection;
+
+// The checksum covers the original bytes, so it also catches a bad decoder
+typedef struct PersonSnapshotBlock
+{
+  uint32_t rawSize;
+  uint32_t storedSize;
+  uint32_t checksum;
+} PersonSnapshotBlock;
+
+bool writeSnapshotSection(AsyncIoWriter* writer, const char* name, FILE* source, size_t size, Buffer* raw, Buffer* stored)
+{
+  PersonSnapshotSection section;
+  memset(&section, 0, sizeof(PersonSnapshotSection));
+  strncpy(section.name, name, PERSON_SNAPSHOT_NAME_SIZE - 1);
+  section.size = size;
+  section.blockCount = (size + PERSON_SNAPSHOT_BLOCK_SIZE - 1) / PERSON_SNAPSHOT_BLOCK_SIZE;
+  if (!writeAsyncIoWriter(writer, &section, sizeof(PersonSnapshotSection)))
+    return false;
+
+  size_t remaining = size;
+  while (remaining > 0)
+  {
+    size_t length = remaining < PERSON_SNAPSHOT_BLOCK_SIZE ? remaining : PERSON_SNAPSHOT_BLOCK_SIZE;
+    if (fread(raw->data, sizeof(char), length, source) != length)
+      return false;
+
+    PersonSnapshotBlock block;
+    block.rawSize = (uint32_t)length;
+    block.checksum = updateCrc32(0, raw->data, length);
+
+    size_t storedSize = compressBlock(raw->data, length, stored->data, stored->capacity);
+    const char* data = stored->data;
+    if (storedSize == 0 || storedSize >= length)
+    {
+      storedSize = length;
+      data = raw->data;
+    }
+    block.storedSize = (uint32_t)storedSize;
+
+    if (!writeAsyncIoWriter(writer, &block, sizeof(PersonSnapshotBlock)) ||
+        !writeAsyncIoWriter(writer, data, storedSize))
+      return false;
+    remaining -= length;
+  }
+  return true;
+}
+
+bool savePersonSnapshot(FILE* fp, const char* filename, const char* const* indexFilenames, size_t indexCount, PersonSnapshotInfo* info)
+{
+  FILE* snapshotFile = fopen(filename, "wb");
+  if (!snapshotFile)
+    return false;
+
+  PersonMeta meta;
+  loadPersonMeta(fp, &meta);
+
+  PersonSnapshotHeader header;
+  memset(&header, 0, sizeof(PersonSnapshotHeader));
+  memcpy(header.magic, PERSON_SNAPSHOT_MAGIC, 4);
+  header.version = PERSON_SNAPSHOT_VERSION;
+  header.autoIncrementId = meta.autoIncrementId;
+  header.count = meta.count;
+
+  Buffer raw;
+  initBuffer(&raw, PERSON_SNAPSHOT_BLOCK_SIZE);
+  Buffer stored;
+  initBuffer(&stored, COMPRESS_BOUND(PERSON_SNAPSHOT_BLOCK_SIZE));
+
+  fseek(fp, 0, SEEK_END);
+  size_t rawSize = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  // Blocks are written in the background while the next ones are compressed
+  AsyncIoWriter writer;
+  openAsyncIoWriter(&writer, fileno(snapshotFile), 0, 0);
+  bool success = writeAsyncIoWriter(&writer, &header, sizeof(PersonSnapshotHeader)) &&
+                 writeSnapshotSection(&writer, PERSON_SNAPSHOT_DB_SECTION, fp, rawSize, &raw, &stored);
+  header.sectionCount = 1;
+
+  for (size_t i = 0; success && i < indexCount; i++)
+  {
+    if (strlen(indexFilenames[i]) >= PERSON_SNAPSHOT_NAME_SIZE)
+      continue;
+
+    // Derived files that were never built are simply not part of the snapshot
+    FILE* indexFile = fopen(indexFilenames[i], "rb");
+    if (!indexFile)
+      continue;
+
+    fseek(indexFile, 0, SEEK_END);
+    size_t size = ftell(indexFile);
+    fseek(indexFile, 0, SEEK_SET);
+    success = writeSnapshotSection(&writer, indexFilenames[i], indexFile, size, &raw, &stored);
+    fclose(indexFile);
+
+    header.sectionCount++;
+    rawSize += size;
+  }
+
+  size_t storedSize = getAsyncIoWriterOffset(&writer);
+  if (!closeAsyncIoWriter(&writer))
+    success = false;
+  if (success)
+  {
+    fseek(snapshotFile, 0, SEEK_SET);
+    success = fwrite(&header, sizeof(PersonSnapshotHeader), 1, snapshotFile) == 1;
+  }
+
+  freeBuffer(&stored);
+  freeBuffer(&raw);
+
+  if (fclose(snapshotFile) != 0)
+    success = false;
+  if (!success)
+  {
+    remove(filename);
+    return false;
+  }
+
+  if (info)
+  {
+    info->meta = meta;
+    info->sectionCount = header.sectionCount;
+    info->rawSize = rawSize;
+    info->storedSize = storedSize;
+  }
+  return true;
+}
+
+// Without a target the section is skipped, otherwise every block is checked
+// and written to it
+bool restoreSnapshotSection(FILE* snapshotFile, const PersonSnapshotSection* section, FILE* target, Buffer* raw, Buffer* stored)
+{
+  size_t total = 0;
+  for (uint64_t i = 0; i < section->blockCount; i++)
+  {
+    PersonSnapshotBlock block;
+    if (fread(&block, sizeof(PersonSnapshotBlock), 1, snapshotFile) != 1 ||
+        block.rawSize > PERSON_SNAPSHOT_BLOCK_SIZE || block.storedSize > block.rawSize)
+      return false;
+    total += block.rawSize;
+
+    if (!target)
+    {
+      if (fseek(snapshotFile, block.storedSize, SEEK_CUR) != 0)
+        return false;
+      continue;
+    }
+
+    bool valid;
+    if (block.storedSize == block.rawSize)
+    {
+      valid = fread(raw->data, sizeof(char), block.rawSize, snapshotFile) == block.rawSize;
+    }
+    else
+    {
+      valid = fread(stored->data, sizeof(char), block.storedSize, snapshotFile) == block.storedSize &&
+              decompressBlock(stored->data, block.storedSize, raw->data, block.rawSize);
+    }
+
+    if (!valid || updateCrc32(0, raw->data, block.rawSize) != block.checksum ||
+        fwrite(raw->data, sizeof(char), block.rawSize, target) != block.rawSize)
+      return false;
+  }
+  return total == section->size;
+}
+
+void getSnapshotTempName(const char* name, Buffer* tempName)
+{
+  clearBuffer(tempName);
+  appendStringToBuffer(tempName, name);
+  appendStringToBuffer(tempName, ".restore");
+  appendBuffer(tempName, "", 1);
+}
+
+bool restorePersonSnapshot(const char* filename, FILE** fpPtr, PersonMeta* meta, const char* const* indexFilenames, size_t indexCount, PersonSnapshotInfo* info)
+{
+  FILE* snapshotFile = fopen(filename, "rb");
+  if (!snapshotFile)
+    return false;
+
+  PersonSnapshotHeader header;
+  if (fread(&header, sizeof(PersonSnapshotHeader), 1, snapshotFile) != 1 ||
+      memcmp(header.magic, PERSON_SNAPSHOT_MAGIC, 4) != 0 ||
+      header.version != PERSON_SNAPSHOT_VERSION)
+  {
+    fclose(snapshotFile);
+    return false;
+  }
+
+  Buffer raw;
+  initBuffer(&raw, PERSON_SNAPSHOT_BLOCK_SIZE);
+  Buffer stored;
+  initBuffer(&stored, COMPRESS_BOUND(PERSON_SNAPSHOT_BLOCK_SIZE));
+  Buffer tempName;
+  initBuffer(&tempName, 64);
+
+  // Every file is written next to its target first and only moved into
+  // place once the whole snapshot has been checked
+  bool* restored = (bool*)calloc(indexCount + 1, sizeof(bool));
+  FILE* newFp = NULL;
+  size_t rawSize = 0;
+  bool success = true;
+  for (uint64_t i = 0; success && i < header.sectionCount; i++)
+  {
+    PersonSnapshotSection section;
+    success = fread(&section, sizeof(PersonSnapshotSection), 1, snapshotFile) == 1;
+    if (!success)
+      break;
+    section.name[PERSON_SNAPSHOT_NAME_SIZE - 1] = '\0';
+    rawSize += section.size;
+
+    if (strcmp(section.name, PERSON_SNAPSHOT_DB_SECTION) == 0 && !newFp)
+    {
+      newFp = fopen(getPersonDbTempFilename(), "w+b");
+      success = newFp && restoreSnapshotSection(snapshotFile, &section, newFp, &raw, &stored);
+      continue;
+    }
+
+    size_t index = 0;
+    while (index < indexCount && strcmp(section.name, indexFilenames[index]) != 0)
+      index++;
+    if (index == indexCount || restored[index])
+    {
+      success = restoreSnapshotSection(snapshotFile, &section, NULL, &raw, &stored);
+      continue;
+    }
+
+    getSnapshotTempName(section.name, &tempName);
+    FILE* indexFile = fopen(tempName.data, "wb");
+    success = indexFile && restoreSnapshotSection(snapshotFile, &section, indexFile, &raw, &stored);
+    if (indexFile && fclose(indexFile) != 0)
+      success = false;
+    restored[index] = true;
+  }
+  size_t storedSize = ftell(snapshotFile);
+  fclose(snapshotFile);
+
+  // The restored db must be the one described by the header
+  PersonMeta newMeta = {0, 0};
+  if (success && newFp)
+  {
+    fflush(newFp);
+    loadPersonMeta(newFp, &newMeta);
+    success = newMeta.autoIncrementId == header.autoIncrementId && newMeta.count == header.count;
+  }
+  else
+  {
+    success = false;
+  }
+
+  for (size_t i = 0; i < indexCount; i++)
+  {
+    getSnapshotTempName(indexFilenames[i], &tempName);
+    if (!success)
+    {
+      if (restored[i])
+        remove(tempName.data);
+      continue;
+    }
+
+    remove(indexFilenames[i]);
+    if (restored[i])
+      rename(tempName.data, indexFilenames[i]);
+  }
+
+  free(restored);
+  freeBuffer(&tempName);
+  freeBuffer(&stored);
+  freeBuffer(&raw);
+
+  if (!success)
+  {
+    if (newFp)
+      fclose(newFp);
+    remove(getPersonDbTempFilename());
+    return false;
+  }
+
+  fclose(*fpPtr);
+  *fpPtr = newFp;
+  *meta = newMeta;
+  remove(getPersonDbFilename());
+  rename(getPersonDbTempFilename(), getPersonDbFilename());
+  markPersonDbWrite();
+
+  if (info)
+  {
+    info->meta = newMeta;
+    info->sectionCount = header.sectionCount;
+    info->rawSize = rawSize;
+    info->storedSize = storedSize;
+  }
+  return true;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file person-snapshot.h
+ * @brief Backup binario del database insieme ai suoi file derivati.
+ *
+ * Uno snapshot contiene un'intestazione con versione e metadati, seguita
+ * da una sezione per ogni file salvato: il database e, se presenti, le
+ * immagini dei file derivati (filtro di Bloom, file colonnare, dizionario
+ * dei nomi). Ogni sezione è divisa in blocchi compressi con compressBlock,
+ * ognuno con il CRC-32 dei dati originali. Il ripristino copia i file così
+ * come sono, senza reinserire le persone e senza ricreare i file derivati.
+ */
+
+#ifndef PERSON_SNAPSHOT_H
+#define PERSON_SNAPSHOT_H
+
+#include "person.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * @brief Estensione dei file di snapshot.
+ */
+#define PERSON_SNAPSHOT_EXTENSION ".snap"
+
+/**
+ * @brief Dimensione dei blocchi di una sezione prima della compressione.
+ */
+#define PERSON_SNAPSHOT_BLOCK_SIZE (1 << 20)
+
+/**
+ * @brief Lunghezza massima del nome di un file salvato in uno snapshot.
+ */
+#define PERSON_SNAPSHOT_NAME_SIZE 32
+
+/**
+ * @struct PersonSnapshotInfo
+ * @brief Contenuto di uno snapshot.
+ *
+ * @var meta
+ * Metadati del database salvato.
+ * @var sectionCount
+ * Numero di file salvati, database compreso.
+ * @var rawSize
+ * Dimensione totale dei file salvati.
+ * @var storedSize
+ * Dimensione dello snapshot.
+ */
+typedef struct PersonSnapshotInfo
+{
+  PersonMeta meta;
+  size_t sectionCount;
+  size_t rawSize;
+  size_t storedSize;
+} PersonSnapshotInfo;
+
+/**
+ * @brief Salva uno snapshot del database e dei file derivati.
+ *
+ * I file derivati che non esistono vengono saltati; devono corrispondere
+ * al database attuale.
+ *
+ * @param fp Puntatore al file del database.
+ * @param filename Nome dello snapshot da creare.
+ * @param indexFilenames Nomi dei file derivati da includere.
+ * @param indexCount Numero di file derivati.
+ * @param info Contenuto dello snapshot creato (può essere NULL).
+ * @return true se lo snapshot è stato creato, false in caso di errore.
+ */
+bool savePersonSnapshot(FILE* fp, const char* filename, const char* const* indexFilenames, size_t indexCount, PersonSnapshotInfo* info);
+
+/**
+ * @brief Ripristina il database e i file derivati da uno snapshot.
+ *
+ * Tutti i blocchi vengono verificati prima di sostituire qualsiasi file.
+ * Ogni file derivato della lista viene sostituito dalla sua immagine nello
+ * snapshot oppure eliminato se lo snapshot non lo contiene, così non
+ * rimangono file che corrispondono al database precedente. Le sezioni con
+ * nomi che non sono nella lista vengono ignorate.
+ *
+ * @param filename Nome dello snapshot.
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Puntatore ai metadati (aggiornati solo in caso di successo).
+ * @param indexFilenames Nomi dei file derivati gestiti dal chiamante.
+ * @param indexCount Numero di file derivati.
+ * @param info Contenuto dello snapshot ripristinato (può essere NULL).
+ * @return true se il database è stato ripristinato, false se lo snapshot
+ *         manca, non è valido o è danneggiato.
+ */
+bool restorePersonSnapshot(const char* filename, FILE** fpPtr, PersonMeta* meta, const char* const* indexFilenames, size_t indexCount, PersonSnapshotInfo* info);
+
+#endif // PERSON_SNAPSHOT_H
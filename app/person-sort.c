@@ -0,0 +1,400 @@
+#include "person-sort.h"
+#include "person-scan.h"
+#include "pipeline.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define PERSON_SORT_MIN_RUN_SIZE (64 << 10)
+
+int comparePeople(const Person* a, const Person* b, const PersonSortOrder* order)
+{
+  int result = 0;
+  switch (order->key)
+  {
+  case SORT_BY_NAME:
+    result = strcmp(a->name, b->name);
+    break;
+  case SORT_BY_AGE:
+    result = (a->age > b->age) - (a->age < b->age);
+    break;
+  case SORT_BY_ID:
+    break;
+  }
+
+  if (result == 0)
+    result = (a->id > b->id) - (a->id < b->id);
+  return order->descending ? -result : result;
+}
+
+// The root is the worst of the kept people, so it is the one to replace
+void siftDownWorstPerson(Person* heap, size_t size, size_t i, const PersonSortOrder* order)
+{
+  while (true)
+  {
+    size_t worst = i;
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    if (left < size && comparePeople(&heap[left], &heap[worst], order) > 0)
+      worst = left;
+    if (right < size && comparePeople(&heap[right], &heap[worst], order) > 0)
+      worst = right;
+    if (worst == i)
+      return;
+
+    Person tmp = heap[i];
+    heap[i] = heap[worst];
+    heap[worst] = tmp;
+    i = worst;
+  }
+}
+
+void siftUpWorstPerson(Person* heap, size_t i, const PersonSortOrder* order)
+{
+  while (i > 0)
+  {
+    size_t parent = (i - 1) / 2;
+    if (comparePeople(&heap[i], &heap[parent], order) <= 0)
+      return;
+
+    Person tmp = heap[i];
+    heap[i] = heap[parent];
+    heap[parent] = tmp;
+    i = parent;
+  }
+}
+
+Person* findTopPeople(FILE* fp, const PersonSortOrder* order, size_t k, size_t* count)
+{
+  Person* heap = (Person*)malloc((k > 0 ? k : 1) * sizeof(Person));
+  size_t size = 0;
+
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (k > 0 && nextPersonScanRecord(&scan, &person))
+  {
+    // Only people that make it into the heap get their own copy of the name
+    size_t nameLength = strlen(person.name) + 1;
+    if (size < k)
+    {
+      heap[size] = person;
+      heap[size].name = (char*)malloc(nameLength);
+      memcpy(heap[size].name, person.name, nameLength);
+      siftUpWorstPerson(heap, size, order);
+      size++;
+    }
+    else if (comparePeople(&person, &heap[0], order) < 0)
+    {
+      free(heap[0].name);
+      heap[0] = person;
+      heap[0].name = (char*)malloc(nameLength);
+      memcpy(heap[0].name, person.name, nameLength);
+      siftDownWorstPerson(heap, size, 0, order);
+    }
+  }
+  closePersonScan(&scan);
+
+  // Popping the worst to the back leaves the heap sorted best first
+  for (size_t last = size; last > 1; last--)
+  {
+    Person tmp = heap[0];
+    heap[0] = heap[last - 1];
+    heap[last - 1] = tmp;
+    siftDownWorstPerson(heap, last - 1, 0, order);
+  }
+
+  *count = size;
+  return heap;
+}
+
+typedef struct PersonSortEntry
+{
+  Person person;
+  const char* record;
+  size_t recordSize;
+  const PersonSortOrder* order;
+} PersonSortEntry;
+
+int comparePersonSortEntries(const void* a, const void* b)
+{
+  const PersonSortEntry* entryA = (const PersonSortEntry*)a;
+  const PersonSortEntry* entryB = (const PersonSortEntry*)b;
+  return comparePeople(&entryA->person, &entryB->person, entryA->order);
+}
+
+typedef struct PersonSortJob
+{
+  PersonScan scan;
+  const PersonSortOrder* order;
+  size_t runSize;
+  size_t runCount;
+} PersonSortJob;
+
+void formatPersonSortRunFilename(char* filename, size_t size, size_t run)
+{
+  snprintf(filename, size, PERSON_SORT_RUN_FILENAME, run);
+}
+
+void removePersonSortRuns(size_t first, size_t last)
+{
+  char filename[64];
+  for (size_t run = first; run < last; run++)
+  {
+    formatPersonSortRunFilename(filename, sizeof(filename), run);
+    remove(filename);
+  }
+}
+
+bool producePersonSortRun(void* context, PipelineChunk* chunk)
+{
+  PersonSortJob* job = (PersonSortJob*)context;
+  return appendPersonScanRecords(&job->scan, &chunk->input, job->runSize) > 0;
+}
+
+bool sortPersonRun(void* context, PipelineChunk* chunk)
+{
+  PersonSortJob* job = (PersonSortJob*)context;
+  const size_t headerSize = sizeof(size_t) + sizeof(int) + sizeof(size_t);
+
+  // The entries point into the input, so only the record order is sorted, not the bytes
+  Buffer entries;
+  initBuffer(&entries, 0);
+  size_t pos = 0;
+  while (pos < chunk->input.size)
+  {
+    PersonSortEntry entry;
+    size_t nameLength;
+    memcpy(&entry.person.id, chunk->input.data + pos, sizeof(size_t));
+    memcpy(&entry.person.age, chunk->input.data + pos + sizeof(size_t), sizeof(int));
+    memcpy(&nameLength, chunk->input.data + pos + sizeof(size_t) + sizeof(int), sizeof(size_t));
+    entry.person.name = chunk->input.data + pos + headerSize;
+    entry.record = chunk->input.data + pos;
+    entry.recordSize = headerSize + nameLength;
+    entry.order = job->order;
+    appendBuffer(&entries, &entry, sizeof(PersonSortEntry));
+    pos += entry.recordSize;
+  }
+
+  PersonSortEntry* sorted = (PersonSortEntry*)entries.data;
+  size_t count = entries.size / sizeof(PersonSortEntry);
+  qsort(sorted, count, sizeof(PersonSortEntry), comparePersonSortEntries);
+
+  reserveBuffer(&chunk->output, chunk->input.size);
+  for (size_t i = 0; i < count; i++)
+    appendBuffer(&chunk->output, sorted[i].record, sorted[i].recordSize);
+
+  freeBuffer(&entries);
+  return true;
+}
+
+bool consumePersonSortRun(void* context, PipelineChunk* chunk)
+{
+  PersonSortJob* job = (PersonSortJob*)context;
+
+  char filename[64];
+  formatPersonSortRunFilename(filename, sizeof(filename), chunk->index);
+  FILE* runFile = fopen(filename, "wb");
+  if (!runFile)
+    return false;
+
+  bool success = fwrite(chunk->output.data, sizeof(char), chunk->output.size, runFile) == chunk->output.size;
+  if (fclose(runFile) != 0)
+    success = false;
+
+  job->runCount = chunk->index + 1;
+  return success;
+}
+
+typedef struct PersonSortRun
+{
+  FILE* fp;
+  size_t remaining;
+  Person person;
+  Buffer name;
+} PersonSortRun;
+
+bool advancePersonSortRun(PersonSortRun* run)
+{
+  if (run->remaining == 0)
+    return false;
+
+  size_t size = readPersonRecord(run->fp, &run->person, &run->name);
+  run->remaining = size < run->remaining ? run->remaining - size : 0;
+  return true;
+}
+
+void siftDownPersonSortRun(PersonSortRun** heap, size_t size, size_t i, const PersonSortOrder* order)
+{
+  while (true)
+  {
+    size_t best = i;
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    if (left < size && comparePeople(&heap[left]->person, &heap[best]->person, order) < 0)
+      best = left;
+    if (right < size && comparePeople(&heap[right]->person, &heap[best]->person, order) < 0)
+      best = right;
+    if (best == i)
+      return;
+
+    PersonSortRun* tmp = heap[i];
+    heap[i] = heap[best];
+    heap[best] = tmp;
+    i = best;
+  }
+}
+
+bool mergePersonSortRuns(size_t first, size_t last, const PersonSortOrder* order, size_t memoryBudget, const char* filename)
+{
+  FILE* output = fopen(filename, "wb");
+  if (!output)
+    return false;
+
+  const size_t runCount = last - first;
+  size_t bufferSize = memoryBudget / (runCount + 1);
+  if (bufferSize < PERSON_SORT_MIN_RUN_SIZE)
+    bufferSize = PERSON_SORT_MIN_RUN_SIZE;
+
+  PersonSortRun* runs = (PersonSortRun*)malloc(runCount * sizeof(PersonSortRun));
+  PersonSortRun** heap = (PersonSortRun**)malloc(runCount * sizeof(PersonSortRun*));
+  size_t heapSize = 0;
+  bool success = true;
+
+  char runFilename[64];
+  for (size_t i = 0; i < runCount; i++)
+  {
+    PersonSortRun* run = &runs[i];
+    initBuffer(&run->name, 64);
+    formatPersonSortRunFilename(runFilename, sizeof(runFilename), first + i);
+    run->fp = fopen(runFilename, "rb");
+    if (!run->fp)
+    {
+      success = false;
+      run->remaining = 0;
+      continue;
+    }
+
+    setvbuf(run->fp, NULL, _IOFBF, bufferSize);
+    fseek(run->fp, 0, SEEK_END);
+    run->remaining = ftell(run->fp);
+    fseek(run->fp, 0, SEEK_SET);
+    if (advancePersonSortRun(run))
+      heap[heapSize++] = run;
+  }
+
+  for (size_t i = heapSize; i > 0; i--)
+    siftDownPersonSortRun(heap, heapSize, i - 1, order);
+
+  Buffer batch;
+  initBuffer(&batch, bufferSize + 4096);
+  while (success && heapSize > 0)
+  {
+    encodePerson(&batch, &heap[0]->person);
+    if (batch.size >= bufferSize)
+      success = flushBuffer(&batch, output);
+
+    if (!advancePersonSortRun(heap[0]))
+      heap[0] = heap[--heapSize];
+    siftDownPersonSortRun(heap, heapSize, 0, order);
+  }
+  if (success)
+    success = flushBuffer(&batch, output);
+  freeBuffer(&batch);
+
+  for (size_t i = 0; i < runCount; i++)
+  {
+    if (runs[i].fp)
+      fclose(runs[i].fp);
+    freeBuffer(&runs[i].name);
+  }
+  free(heap);
+  free(runs);
+
+  if (fclose(output) != 0)
+    success = false;
+  return success;
+}
+
+bool sortPersonDb(FILE* fp, const PersonSortOrder* order, size_t memoryBudget, size_t threadCount, const char* filename)
+{
+  if (threadCount == 0)
+    threadCount = 1;
+
+  // Every chunk in flight holds its records, the sorted copy and the entries
+  size_t runSize = memoryBudget / (threadCount * PIPELINE_CHUNKS_PER_WORKER * 3);
+  if (runSize < PERSON_SORT_MIN_RUN_SIZE)
+    runSize = PERSON_SORT_MIN_RUN_SIZE;
+
+  PersonSortJob job;
+  job.order = order;
+  job.runSize = runSize;
+  job.runCount = 0;
+  openPersonScan(&job.scan, fp);
+
+  bool success = runPipeline(&job, threadCount, producePersonSortRun, sortPersonRun, consumePersonSortRun);
+  if (!closePersonScan(&job.scan))
+    success = false;
+
+  if (!success)
+  {
+    removePersonSortRuns(0, job.runCount);
+    return false;
+  }
+
+  // Runs are merged in groups until the last merge can write the output directly
+  size_t first = 0;
+  size_t last = job.runCount;
+  while (success && last - first > PERSON_SORT_MAX_FAN_IN)
+  {
+    size_t next = last;
+    for (size_t group = first; success && group < last; group += PERSON_SORT_MAX_FAN_IN)
+    {
+      size_t groupEnd = group + PERSON_SORT_MAX_FAN_IN < last ? group + PERSON_SORT_MAX_FAN_IN : last;
+      char runFilename[64];
+      formatPersonSortRunFilename(runFilename, sizeof(runFilename), next++);
+      success = mergePersonSortRuns(group, groupEnd, order, memoryBudget, runFilename);
+    }
+
+    removePersonSortRuns(first, last);
+    if (!success)
+    {
+      removePersonSortRuns(last, next);
+      return false;
+    }
+    first = last;
+    last = next;
+  }
+
+  if (success)
+    success = mergePersonSortRuns(first, last, order, memoryBudget, filename);
+
+  removePersonSortRuns(first, last);
+  return success;
+}
+
+bool printPersonRecordsFile(const char* filename)
+{
+  FILE* fp = fopen(filename, "rb");
+  if (!fp)
+    return false;
+
+  fseek(fp, 0, SEEK_END);
+  const size_t end = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  Buffer name;
+  initBuffer(&name, 64);
+
+  printPeopleHeader();
+  size_t pos = 0;
+  while (pos < end)
+  {
+    Person person;
+    pos += readPersonRecord(fp, &person, &name);
+    printPersonRow(&person);
+  }
+
+  freeBuffer(&name);
+  fclose(fp);
+  return true;
+}
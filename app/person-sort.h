@@ -0,0 +1,105 @@
+/**
+ * @file person-sort.h
+ * @brief Ordinamento delle persone e ricerca delle prime K.
+ *
+ * Le prime K persone vengono trovate con un heap limitato a K elementi.
+ * L'ordinamento completo è esterno: il database viene diviso in run che
+ * stanno nel budget di memoria, ordinate in parallelo e salvate in file
+ * temporanei, poi unite con un merge a più vie. Funziona quindi anche
+ * con database più grandi della memoria disponibile.
+ */
+
+#ifndef PERSON_SORT_H
+#define PERSON_SORT_H
+
+#include "person.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+/**
+ * @brief Budget di memoria predefinito per l'ordinamento esterno.
+ */
+#define PERSON_SORT_MEMORY_BUDGET (64 << 20)
+
+/**
+ * @brief Numero massimo di run unite in un solo passaggio di merge.
+ */
+#define PERSON_SORT_MAX_FAN_IN 64
+
+/**
+ * @brief Nome del file temporaneo di una run (parametro: indice della run).
+ */
+#define PERSON_SORT_RUN_FILENAME "people_sort_%zu.run"
+
+/**
+ * @enum PersonSortKey
+ * @brief Campo su cui ordinare.
+ */
+typedef enum PersonSortKey
+{
+  SORT_BY_ID = 0,
+  SORT_BY_NAME,
+  SORT_BY_AGE
+} PersonSortKey;
+
+/**
+ * @struct PersonSortOrder
+ * @brief Criterio di ordinamento.
+ *
+ * @var key
+ * Campo su cui ordinare; a parità l'ordine è per ID crescente.
+ * @var descending
+ * true per l'ordine decrescente.
+ */
+typedef struct PersonSortOrder
+{
+  PersonSortKey key;
+  bool descending;
+} PersonSortOrder;
+
+/**
+ * @brief Confronta due persone secondo un criterio di ordinamento.
+ *
+ * @return Un valore negativo se `a` viene prima di `b`, positivo se viene
+ *         dopo, 0 se sono equivalenti.
+ */
+int comparePeople(const Person* a, const Person* b, const PersonSortOrder* order);
+
+/**
+ * @brief Trova le prime K persone secondo un criterio di ordinamento.
+ *
+ * Il database viene letto una sola volta tenendo in memoria solo K persone.
+ *
+ * @param fp Puntatore al file del database.
+ * @param order Criterio di ordinamento.
+ * @param k Numero di persone da trovare.
+ * @param count Numero di persone trovate (al massimo K).
+ * @return Array ordinato delle persone trovate, da liberare con freePeople
+ *         e free.
+ */
+Person* findTopPeople(FILE* fp, const PersonSortOrder* order, size_t k, size_t* count);
+
+/**
+ * @brief Ordina tutte le persone del database in un file.
+ *
+ * Il file di output contiene solo i record, senza metadati, nello stesso
+ * formato del database.
+ *
+ * @param fp Puntatore al file del database.
+ * @param order Criterio di ordinamento.
+ * @param memoryBudget Memoria massima in byte usata per le run.
+ * @param threadCount Numero di thread che ordinano le run.
+ * @param filename Nome del file di output.
+ * @return true se l'ordinamento ha avuto successo, false in caso di errore.
+ */
+bool sortPersonDb(FILE* fp, const PersonSortOrder* order, size_t memoryBudget, size_t threadCount, const char* filename);
+
+/**
+ * @brief Stampa le persone di un file di record senza metadati.
+ *
+ * @param filename Nome del file prodotto da sortPersonDb.
+ * @return true se il file è stato letto, false in caso di errore.
+ */
+bool printPersonRecordsFile(const char* filename);
+
+#endif // PERSON_SORT_H
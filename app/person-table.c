@@ -0,0 +1,602 @@
+#include "person-table.h"
+#include "async-io.h"
+#include "person-scan.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PERSON_TABLE_MAGIC "PTBL"
+#define PERSON_TABLE_VERSION 1
+
+typedef struct PersonTableHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint64_t autoIncrementId;
+  uint64_t count;
+  uint64_t sortedIds;
+} PersonTableHeader;
+
+typedef struct PersonTableBlock
+{
+  AsyncIoRequest request;
+  PersonRecord* records;
+  size_t count;
+  bool done;
+} PersonTableBlock;
+
+typedef struct PersonTableLookup
+{
+  uint64_t id;
+  size_t index;
+  size_t low;
+  size_t high;
+  bool done;
+} PersonTableLookup;
+
+// One page read shared by the lookups [begin, end) of the current step
+typedef struct PersonTablePageRead
+{
+  size_t first;
+  size_t begin;
+  size_t end;
+} PersonTablePageRead;
+
+typedef struct PersonTablePage
+{
+  AsyncIoRequest request;
+  PersonRecord records[PERSON_TABLE_LOOKUP_RECORDS];
+  size_t count;
+  const PersonTablePageRead* read;
+} PersonTablePage;
+
+typedef struct PersonTableLookupScan
+{
+  PersonTableLookup* lookups;
+  size_t count;
+  size_t pending;
+  PersonRecord* records;
+  bool* found;
+} PersonTableLookupScan;
+
+bool buildPersonTable(FILE* fp, const char* tableFilename, const char* heapFilename)
+{
+  FILE* tableFile = fopen(tableFilename, "wb");
+  if (!tableFile)
+    return false;
+
+  FILE* heapFile = fopen(heapFilename, "wb");
+  if (!heapFile)
+  {
+    fclose(tableFile);
+    remove(tableFilename);
+    return false;
+  }
+
+  PersonMeta meta;
+  loadPersonMeta(fp, &meta);
+
+  // The header is rewritten at the end once the count and order are known
+  PersonTableHeader header;
+  memset(&header, 0, sizeof(PersonTableHeader));
+  memcpy(header.magic, PERSON_TABLE_MAGIC, 4);
+  header.version = PERSON_TABLE_VERSION;
+  header.autoIncrementId = meta.autoIncrementId;
+  header.sortedIds = 1;
+
+  // Records and names are written in the background while the db is read
+  AsyncIoWriter records;
+  openAsyncIoWriter(&records, fileno(tableFile), 0, 0);
+  AsyncIoWriter heap;
+  openAsyncIoWriter(&heap, fileno(heapFile), 0, 0);
+  bool success = writeAsyncIoWriter(&records, &header, sizeof(PersonTableHeader));
+
+  uint64_t heapSize = 0;
+  uint64_t previousId = 0;
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (success && nextPersonScanRecord(&scan, &person))
+  {
+    PersonRecord record;
+    memset(&record, 0, sizeof(PersonRecord));
+    record.id = person.id;
+    record.age = person.age;
+    record.nameLength = (uint32_t)strlen(person.name);
+    if (record.nameLength < PERSON_TABLE_INLINE_NAME_SIZE)
+    {
+      memcpy(record.name.inlineName, person.name, record.nameLength);
+    }
+    else
+    {
+      record.name.overflowOffset = heapSize;
+      success = writeAsyncIoWriter(&heap, person.name, record.nameLength);
+      heapSize += record.nameLength;
+    }
+
+    if (header.count > 0 && record.id <= previousId)
+      header.sortedIds = 0;
+    previousId = record.id;
+    header.count++;
+
+    if (success)
+      success = writeAsyncIoWriter(&records, &record, sizeof(PersonRecord));
+  }
+  if (!closePersonScan(&scan))
+    success = false;
+  if (!closeAsyncIoWriter(&records) || !closeAsyncIoWriter(&heap))
+    success = false;
+
+  if (success)
+  {
+    fseek(tableFile, 0, SEEK_SET);
+    success = fwrite(&header, sizeof(PersonTableHeader), 1, tableFile) == 1;
+  }
+
+  if (fclose(tableFile) != 0)
+    success = false;
+  if (fclose(heapFile) != 0)
+    success = false;
+
+  if (!success)
+  {
+    remove(tableFilename);
+    remove(heapFilename);
+  }
+  return success;
+}
+
+PersonTable* openPersonTable(const char* tableFilename, const char* heapFilename)
+{
+  FILE* records = fopen(tableFilename, "rb");
+  if (!records)
+    return NULL;
+
+  FILE* heap = fopen(heapFilename, "rb");
+  if (!heap)
+  {
+    fclose(records);
+    return NULL;
+  }
+
+  PersonTableHeader header;
+  bool valid = fread(&header, sizeof(PersonTableHeader), 1, records) == 1 &&
+               memcmp(header.magic, PERSON_TABLE_MAGIC, 4) == 0 &&
+               header.version == PERSON_TABLE_VERSION;
+
+  // A truncated table would make index arithmetic read past the end
+  if (valid)
+  {
+    fseek(records, 0, SEEK_END);
+    valid = (uint64_t)ftell(records) == sizeof(PersonTableHeader) + header.count * sizeof(PersonRecord);
+  }
+
+  if (!valid)
+  {
+    fclose(records);
+    fclose(heap);
+    return NULL;
+  }
+
+  PersonTable* table = (PersonTable*)malloc(sizeof(PersonTable));
+  table->records = records;
+  table->heap = heap;
+  table->meta.autoIncrementId = header.autoIncrementId;
+  table->meta.count = header.count;
+  table->sortedIds = header.sortedIds != 0;
+  return table;
+}
+
+void closePersonTable(PersonTable* table)
+{
+  fclose(table->records);
+  fclose(table->heap);
+  free(table);
+}
+
+size_t readPersonTableRecords(PersonTable* table, size_t first, PersonRecord* records, size_t count)
+{
+  if (first >= table->meta.count)
+    return 0;
+  if (count > table->meta.count - first)
+    count = table->meta.count - first;
+
+  // The table may be read by several threads at once
+  flockfile(table->records);
+  fseek(table->records, sizeof(PersonTableHeader) + first * sizeof(PersonRecord), SEEK_SET);
+  count = fread(records, sizeof(PersonRecord), count, table->records);
+  funlockfile(table->records);
+  return count;
+}
+
+const char* getPersonRecordName(PersonTable* table, const PersonRecord* record, Buffer* overflow)
+{
+  if (record->nameLength < PERSON_TABLE_INLINE_NAME_SIZE)
+    return record->name.inlineName;
+
+  reserveBuffer(overflow, record->nameLength + 1);
+  flockfile(table->heap);
+  fseek(table->heap, record->name.overflowOffset, SEEK_SET);
+  overflow->size = fread(overflow->data, sizeof(char), record->nameLength, table->heap);
+  funlockfile(table->heap);
+  overflow->data[overflow->size] = '\0';
+  return overflow->data;
+}
+
+bool scanPersonTableInOrder(PersonTable* table, PersonTableVisit visit, void* context)
+{
+  PersonRecord* records = (PersonRecord*)malloc(PERSON_TABLE_SCAN_RECORDS * sizeof(PersonRecord));
+  bool completed = true;
+
+  size_t first = 0;
+  size_t count;
+  while ((count = readPersonTableRecords(table, first, records, PERSON_TABLE_SCAN_RECORDS)) > 0)
+  {
+    if (!visit(context, records, count))
+    {
+      completed = false;
+      break;
+    }
+    first += count;
+  }
+
+  free(records);
+  return completed;
+}
+
+void readPersonTableBlock(PersonTable* table, AsyncIo* io, PersonTableBlock* block, size_t first)
+{
+  block->count = table->meta.count - first;
+  if (block->count > PERSON_TABLE_SCAN_RECORDS)
+    block->count = PERSON_TABLE_SCAN_RECORDS;
+  block->done = false;
+  block->request.fd = fileno(table->records);
+  block->request.write = false;
+  block->request.buffer = block->records;
+  block->request.size = block->count * sizeof(PersonRecord);
+  block->request.offset = sizeof(PersonTableHeader) + first * sizeof(PersonRecord);
+  block->request.context = block;
+  submitAsyncIo(io, &block->request);
+}
+
+bool waitPersonTableBlock(AsyncIo* io, PersonTableBlock* block)
+{
+  // Blocks may complete out of order, the scan still visits them in order
+  if (!block->done)
+  {
+    if (!waitAsyncIoRequest(io, &block->request))
+      return false;
+    block->done = true;
+  }
+  return block->request.result == (long)block->request.size;
+}
+
+bool scanPersonTable(PersonTable* table, PersonTableVisit visit, void* context)
+{
+  AsyncIo* io = getThreadAsyncIo();
+  if (!io)
+    return scanPersonTableInOrder(table, visit, context);
+
+  PersonTableBlock blocks[PERSON_TABLE_SCAN_AHEAD];
+  size_t next = 0;
+  for (size_t i = 0; i < PERSON_TABLE_SCAN_AHEAD; i++)
+  {
+    blocks[i].records = (PersonRecord*)malloc(PERSON_TABLE_SCAN_RECORDS * sizeof(PersonRecord));
+    blocks[i].done = true;
+    if (next < table->meta.count)
+    {
+      readPersonTableBlock(table, io, &blocks[i], next);
+      next += blocks[i].count;
+    }
+  }
+
+  bool completed = true;
+  size_t visited = 0;
+  while (visited < table->meta.count)
+  {
+    PersonTableBlock* block = &blocks[(visited / PERSON_TABLE_SCAN_RECORDS) % PERSON_TABLE_SCAN_AHEAD];
+    if (!waitPersonTableBlock(io, block) || !visit(context, block->records, block->count))
+    {
+      completed = false;
+      break;
+    }
+    visited += block->count;
+
+    // The block just visited is reused for the first one not yet requested
+    if (next < table->meta.count)
+    {
+      readPersonTableBlock(table, io, block, next);
+      next += block->count;
+    }
+  }
+
+  // A visit that stops early leaves reads in flight into the blocks
+  for (size_t i = 0; i < PERSON_TABLE_SCAN_AHEAD; i++)
+  {
+    if (!blocks[i].done)
+      waitAsyncIoRequest(io, &blocks[i].request);
+    free(blocks[i].records);
+  }
+  return completed;
+}
+
+bool findPersonTableRecord(PersonTable* table, const size_t id, PersonRecord* record)
+{
+  if (table->sortedIds)
+  {
+    size_t low = 0;
+    size_t high = table->meta.count;
+    while (low < high)
+    {
+      size_t middle = low + (high - low) / 2;
+      if (readPersonTableRecords(table, middle, record, 1) != 1)
+        return false;
+
+      if (record->id == id)
+        return true;
+      if (record->id < id)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    return false;
+  }
+
+  PersonRecord* records = (PersonRecord*)malloc(PERSON_TABLE_SCAN_RECORDS * sizeof(PersonRecord));
+  bool found = false;
+
+  size_t first = 0;
+  size_t count;
+  while (!found && (count = readPersonTableRecords(table, first, records, PERSON_TABLE_SCAN_RECORDS)) > 0)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      if (records[i].id == id)
+      {
+        *record = records[i];
+        found = true;
+        break;
+      }
+    }
+    first += count;
+  }
+
+  free(records);
+  return found;
+}
+
+Person* findPersonInTable(PersonTable* table, const size_t id)
+{
+  PersonRecord record;
+  if (!findPersonTableRecord(table, id, &record))
+    return NULL;
+
+  Buffer overflow;
+  initBuffer(&overflow, 0);
+  const char* name = getPersonRecordName(table, &record, &overflow);
+
+  Person* person = (Person*)malloc(sizeof(Person));
+  person->id = record.id;
+  person->age = record.age;
+  person->name = (char*)malloc(record.nameLength + 1);
+  memcpy(person->name, name, record.nameLength + 1);
+
+  freeBuffer(&overflow);
+  return person;
+}
+
+int comparePersonTableLookupIds(const void* a, const void* b)
+{
+  uint64_t idA = ((const PersonTableLookup*)a)->id;
+  uint64_t idB = ((const PersonTableLookup*)b)->id;
+  return idA < idB ? -1 : idA > idB;
+}
+
+bool visitPersonTableLookupScan(void* context, const PersonRecord* records, size_t count)
+{
+  PersonTableLookupScan* scan = (PersonTableLookupScan*)context;
+  for (size_t i = 0; i < count; i++)
+  {
+    size_t low = 0;
+    size_t high = scan->count;
+    while (low < high)
+    {
+      size_t middle = low + (high - low) / 2;
+      if (scan->lookups[middle].id < records[i].id)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+    for (size_t j = low; j < scan->count && scan->lookups[j].id == records[i].id && !scan->lookups[j].done; j++)
+    {
+      scan->lookups[j].done = true;
+      scan->records[scan->lookups[j].index] = records[i];
+      scan->found[scan->lookups[j].index] = true;
+      scan->pending--;
+    }
+  }
+  return scan->pending > 0;
+}
+
+void readPersonTablePage(PersonTable* table, AsyncIo* io, PersonTablePage* page, const PersonTablePageRead* read)
+{
+  page->count = table->meta.count - read->first;
+  if (page->count > PERSON_TABLE_LOOKUP_RECORDS)
+    page->count = PERSON_TABLE_LOOKUP_RECORDS;
+  page->read = read;
+  page->request.fd = fileno(table->records);
+  page->request.write = false;
+  page->request.buffer = page->records;
+  page->request.size = page->count * sizeof(PersonRecord);
+  page->request.offset = sizeof(PersonTableHeader) + read->first * sizeof(PersonRecord);
+  page->request.context = page;
+  submitAsyncIo(io, &page->request);
+}
+
+// Narrows every lookup that read the page; a lookup whose id falls inside
+// the page is finished either way
+void applyPersonTablePage(PersonTablePage* page, PersonTableLookup* lookups, PersonRecord* records, bool* found)
+{
+  const PersonRecord* pageRecords = page->records;
+  size_t first = page->read->first;
+  for (size_t i = page->read->begin; i < page->read->end; i++)
+  {
+    PersonTableLookup* lookup = &lookups[i];
+    if (lookup->id < pageRecords[0].id)
+    {
+      if (lookup->high > first)
+        lookup->high = first;
+    }
+    else if (lookup->id > pageRecords[page->count - 1].id)
+    {
+      if (lookup->low < first + page->count)
+        lookup->low = first + page->count;
+    }
+    else
+    {
+      size_t low = 0;
+      size_t high = page->count;
+      while (low < high)
+      {
+        size_t middle = low + (high - low) / 2;
+        if (pageRecords[middle].id < lookup->id)
+          low = middle + 1;
+        else
+          high = middle;
+      }
+      if (low < page->count && pageRecords[low].id == lookup->id)
+      {
+        records[lookup->index] = pageRecords[low];
+        found[lookup->index] = true;
+      }
+      lookup->done = true;
+    }
+
+    if (lookup->low >= lookup->high)
+      lookup->done = true;
+  }
+}
+
+// Runs one step of all active binary searches; false on an I/O error
+bool stepPersonTableLookups(PersonTable* table, AsyncIo* io, PersonTablePage* pages, PersonTablePageRead* reads, PersonTableLookup* lookups, size_t count, PersonRecord* records, bool* found)
+{
+  // Lookups are sorted by id, so the ones reading the same page are adjacent
+  size_t readCount = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    size_t middle = lookups[i].low + (lookups[i].high - lookups[i].low) / 2;
+    size_t first = middle - middle % PERSON_TABLE_LOOKUP_RECORDS;
+    if (readCount > 0 && reads[readCount - 1].first == first)
+    {
+      reads[readCount - 1].end = i + 1;
+      continue;
+    }
+    reads[readCount].first = first;
+    reads[readCount].begin = i;
+    reads[readCount].end = i + 1;
+    readCount++;
+  }
+
+  size_t next = 0;
+  size_t pageCount = 0;
+  while (pageCount < PERSON_TABLE_LOOKUP_DEPTH && next < readCount)
+    readPersonTablePage(table, io, &pages[pageCount++], &reads[next++]);
+
+  // The queue is shared with the other reads of the thread, so the pages are
+  // waited for in the order they were requested; the rest stay in flight
+  bool success = true;
+  size_t inFlight = pageCount;
+  for (size_t i = 0; inFlight > 0; i = (i + 1) % pageCount)
+  {
+    PersonTablePage* page = &pages[i];
+    if (!page->read)
+      continue;
+    if (!waitAsyncIoRequest(io, &page->request))
+      return false;
+
+    if (page->request.result != (long)page->request.size)
+      success = false;
+    if (success)
+      applyPersonTablePage(page, lookups, records, found);
+    page->read = NULL;
+    inFlight--;
+
+    if (success && next < readCount)
+    {
+      readPersonTablePage(table, io, page, &reads[next++]);
+      inFlight++;
+    }
+  }
+
+  return success && next == readCount;
+}
+
+size_t findPersonTableRecords(PersonTable* table, const uint64_t* ids, size_t count, PersonRecord* records, bool* found)
+{
+  if (count == 0)
+    return 0;
+
+  PersonTableLookup* lookups = (PersonTableLookup*)malloc(count * sizeof(PersonTableLookup));
+  for (size_t i = 0; i < count; i++)
+  {
+    lookups[i].id = ids[i];
+    lookups[i].index = i;
+    lookups[i].low = 0;
+    lookups[i].high = table->meta.count;
+    lookups[i].done = table->meta.count == 0;
+    found[i] = false;
+  }
+  qsort(lookups, count, sizeof(PersonTableLookup), comparePersonTableLookupIds);
+
+  if (!table->sortedIds)
+  {
+    PersonTableLookupScan scan = {lookups, count, count, records, found};
+    scanPersonTable(table, visitPersonTableLookupScan, &scan);
+    free(lookups);
+    return count - scan.pending;
+  }
+
+  AsyncIo* io = getThreadAsyncIo();
+  PersonTablePage* pages = io ? (PersonTablePage*)malloc(PERSON_TABLE_LOOKUP_DEPTH * sizeof(PersonTablePage)) : NULL;
+  PersonTablePageRead* reads = io ? (PersonTablePageRead*)malloc(count * sizeof(PersonTablePageRead)) : NULL;
+
+  // Page reads jump around the file, read-ahead around them is wasted
+  posix_fadvise(fileno(table->records), 0, 0, POSIX_FADV_RANDOM);
+
+  // Finished lookups are dropped after every step, keeping the order by id
+  size_t active = count;
+  bool success = io != NULL;
+  while (success && active > 0)
+  {
+    size_t kept = 0;
+    for (size_t i = 0; i < active; i++)
+    {
+      if (!lookups[i].done)
+        lookups[kept++] = lookups[i];
+    }
+    active = kept;
+    if (active > 0)
+      success = stepPersonTableLookups(table, io, pages, reads, lookups, active, records, found);
+  }
+
+  // Without async I/O, or after an error, the rest is looked up one by one
+  for (size_t i = 0; i < active; i++)
+  {
+    if (!lookups[i].done)
+      found[lookups[i].index] = findPersonTableRecord(table, lookups[i].id, &records[lookups[i].index]);
+  }
+
+  posix_fadvise(fileno(table->records), 0, 0, POSIX_FADV_NORMAL);
+  free(reads);
+  free(pages);
+  free(lookups);
+
+  size_t foundCount = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (found[i])
+      foundCount++;
+  }
+  return foundCount;
+}
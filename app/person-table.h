@@ -0,0 +1,206 @@
+/**
+ * @file person-table.h
+ * @brief Tabella delle persone a record di lunghezza fissa.
+ *
+ * Formato alternativo al database people.db: ogni persona occupa un record
+ * di 40 byte, quindi il record i si trova con un semplice calcolo
+ * dell'offset e le scansioni leggono memoria contigua. I nomi corti sono
+ * salvati dentro il record, quelli lunghi in un file heap di overflow.
+ *
+ * Una tabella aperta può essere letta da più thread contemporaneamente.
+ */
+
+#ifndef PERSON_TABLE_H
+#define PERSON_TABLE_H
+
+#include "person.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Nome predefinito del file dei record.
+ */
+#define PERSON_TABLE_FILENAME "people.tbl"
+
+/**
+ * @brief Nome predefinito del file heap dei nomi lunghi.
+ */
+#define PERSON_TABLE_HEAP_FILENAME "people.heap"
+
+/**
+ * @brief Spazio per il nome dentro il record, terminatore incluso.
+ *
+ * I nomi lunghi fino a PERSON_TABLE_INLINE_NAME_SIZE - 1 caratteri non
+ * usano l'heap di overflow.
+ */
+#define PERSON_TABLE_INLINE_NAME_SIZE 24
+
+/**
+ * @brief Numero di record letti per ogni blocco durante una scansione.
+ */
+#define PERSON_TABLE_SCAN_RECORDS 4096
+
+/**
+ * @brief Numero di blocchi letti in anticipo durante una scansione.
+ */
+#define PERSON_TABLE_SCAN_AHEAD 4
+
+/**
+ * @brief Numero di record letti a ogni passo di una ricerca per ID; circa
+ *        una pagina da 4 KiB.
+ */
+#define PERSON_TABLE_LOOKUP_RECORDS 102
+
+/**
+ * @brief Numero massimo di letture in corso contemporaneamente durante le
+ *        ricerche per ID di un gruppo.
+ */
+#define PERSON_TABLE_LOOKUP_DEPTH 64
+
+/**
+ * @struct PersonRecord
+ * @brief Record di lunghezza fissa (40 byte) di una persona.
+ *
+ * @var id
+ * Identificatore unico della persona.
+ * @var age
+ * Età della persona.
+ * @var nameLength
+ * Lunghezza del nome senza terminatore.
+ * @var inlineName
+ * Nome terminato da '\0', se più corto di PERSON_TABLE_INLINE_NAME_SIZE.
+ * @var overflowOffset
+ * Posizione del nome nel file heap, altrimenti.
+ */
+typedef struct PersonRecord
+{
+  uint64_t id;
+  int32_t age;
+  uint32_t nameLength;
+  union
+  {
+    char inlineName[PERSON_TABLE_INLINE_NAME_SIZE];
+    uint64_t overflowOffset;
+  } name;
+} PersonRecord;
+
+/**
+ * @struct PersonTable
+ * @brief Tabella aperta in lettura.
+ *
+ * @var records
+ * File dei record.
+ * @var heap
+ * File heap dei nomi lunghi.
+ * @var meta
+ * Metadati del database da cui è stata creata la tabella.
+ * @var sortedIds
+ * true se i record sono ordinati per ID crescente.
+ */
+typedef struct PersonTable
+{
+  FILE* records;
+  FILE* heap;
+  PersonMeta meta;
+  bool sortedIds;
+} PersonTable;
+
+/**
+ * @brief Funzione chiamata per ogni blocco di record durante una scansione.
+ *
+ * @return false per interrompere la scansione.
+ */
+typedef bool (*PersonTableVisit)(void* context, const PersonRecord* records, size_t count);
+
+/**
+ * @brief Crea una tabella a record fissi a partire dal database.
+ *
+ * @param fp Puntatore al file del database.
+ * @param tableFilename Nome del file dei record da creare.
+ * @param heapFilename Nome del file heap da creare.
+ * @return true se la tabella è stata creata, false in caso di errore.
+ */
+bool buildPersonTable(FILE* fp, const char* tableFilename, const char* heapFilename);
+
+/**
+ * @brief Apre una tabella creata con buildPersonTable.
+ *
+ * @param tableFilename Nome del file dei record.
+ * @param heapFilename Nome del file heap.
+ * @return Puntatore alla tabella, NULL se i file mancano o non sono validi.
+ */
+PersonTable* openPersonTable(const char* tableFilename, const char* heapFilename);
+
+/**
+ * @brief Chiude una tabella e libera la memoria.
+ *
+ * @param table Puntatore alla tabella.
+ */
+void closePersonTable(PersonTable* table);
+
+/**
+ * @brief Legge dei record consecutivi a partire dal record `first`.
+ *
+ * @param table Puntatore alla tabella.
+ * @param first Indice del primo record da leggere.
+ * @param records Destinazione dei record.
+ * @param count Numero massimo di record da leggere.
+ * @return Numero di record letti.
+ */
+size_t readPersonTableRecords(PersonTable* table, size_t first, PersonRecord* records, size_t count);
+
+/**
+ * @brief Restituisce il nome di un record.
+ *
+ * @param table Puntatore alla tabella.
+ * @param record Record di cui leggere il nome.
+ * @param overflow Buffer usato per i nomi salvati nell'heap.
+ * @return Puntatore al nome, valido finché il record e il buffer non cambiano.
+ */
+const char* getPersonRecordName(PersonTable* table, const PersonRecord* record, Buffer* overflow);
+
+/**
+ * @brief Scansiona tutti i record della tabella a blocchi.
+ *
+ * Mentre `visit` lavora su un blocco, i PERSON_TABLE_SCAN_AHEAD blocchi
+ * successivi vengono già letti in modo asincrono (vedi async-io.h).
+ *
+ * @param table Puntatore alla tabella.
+ * @param visit Funzione chiamata per ogni blocco.
+ * @param context Puntatore passato a `visit`.
+ * @return true se la scansione è arrivata alla fine.
+ */
+bool scanPersonTable(PersonTable* table, PersonTableVisit visit, void* context);
+
+/**
+ * @brief Trova una persona per ID nella tabella.
+ *
+ * Se i record sono ordinati per ID la ricerca è binaria, altrimenti
+ * lineare.
+ *
+ * @param table Puntatore alla tabella.
+ * @param id ID della persona da trovare.
+ * @return Puntatore alla persona trovata, NULL se non esiste.
+ */
+Person* findPersonInTable(PersonTable* table, const size_t id);
+
+/**
+ * @brief Trova un gruppo di record per ID con letture asincrone.
+ *
+ * Se i record sono ordinati per ID tutte le ricerche binarie avanzano
+ * insieme: a ogni passo ogni ricerca legge una pagina di record e le
+ * letture di tutte le ricerche sono in corso contemporaneamente; le
+ * ricerche che cadono nella stessa pagina la leggono una volta sola.
+ * Altrimenti il gruppo viene risolto con una sola scansione.
+ *
+ * @param table Puntatore alla tabella.
+ * @param ids ID da cercare, anche ripetuti e in un ordine qualsiasi.
+ * @param count Numero di ID.
+ * @param records Destinazione dei record, nello stesso ordine di `ids`.
+ * @param found Per ogni ID, true se il record è stato trovato.
+ * @return Numero di record trovati.
+ */
+size_t findPersonTableRecords(PersonTable* table, const uint64_t* ids, size_t count, PersonRecord* records, bool* found);
+
+#endif // PERSON_TABLE_H
@@ -1,19 +1,62 @@
 #include "person.h"
 #include "json-parser.h"
+#include "person-scan.h"
+#include "pipeline.h"
 #include "utils.h"
+#include <ctype.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
+char personDbFilename[256] = PERSON_DB_FILENAME;
+char personDbTempFilename[256 + 8] = "people_temp.db";
+uint64_t personDbGeneration = 0;
+
+bool setPersonDbFilename(const char* filename)
+{
+  size_t length = strlen(filename);
+  if (length == 0 || length >= sizeof(personDbFilename))
+    return false;
+
+  // people.db keeps its people_temp.db, other names get the same suffix
+  strcpy(personDbFilename, filename);
+  if (length > 3 && strcmp(filename + length - 3, ".db") == 0)
+    sprintf(personDbTempFilename, "%.*s_temp.db", (int)(length - 3), filename);
+  else
+    sprintf(personDbTempFilename, "%s_temp", filename);
+  return true;
+}
+
+const char* getPersonDbFilename()
+{
+  return personDbFilename;
+}
+
+const char* getPersonDbTempFilename()
+{
+  return personDbTempFilename;
+}
+
+void markPersonDbWrite()
+{
+  personDbGeneration++;
+}
+
+uint64_t getPersonDbGeneration()
+{
+  return personDbGeneration;
+}
+
 FILE* initPersonDB(PersonMeta* meta)
 {
-  FILE* fp = fopen("people.db", "r+b");
+  FILE* fp = fopen(personDbFilename, "r+b");
 
   if (!fp)
   {
-    fp = fopen("people.db", "w+b");
+    fp = fopen(personDbFilename, "w+b");
     if (!fp)
     {
-      perror("Impossibile aprire/creare people.db");
+      perror("Impossibile aprire/creare il file del database");
       return fp;
     }
   }
@@ -38,6 +81,7 @@ void updatePersonMeta(FILE* fp, PersonMeta* meta)
 {
   size_t oldCursor = ftell(fp);
 
+  markPersonDbWrite();
   fseek(fp, 0, SEEK_SET);
   fwrite(meta, sizeof(PersonMeta), 1, fp);
 
@@ -84,14 +128,35 @@ void loadPerson(FILE* fp, Person* person)
   person->name = getPersonName(fp);
 }
 
+size_t readPersonRecord(FILE* fp, Person* person, Buffer* name)
+{
+  size_t nameLength;
+  fread(&person->id, sizeof(size_t), 1, fp);
+  fread(&person->age, sizeof(int), 1, fp);
+  fread(&nameLength, sizeof(size_t), 1, fp);
+  reserveBuffer(name, nameLength);
+  fread(name->data, sizeof(char), nameLength, fp);
+  name->size = nameLength;
+  person->name = name->data;
+  return sizeof(size_t) + sizeof(int) + sizeof(size_t) + nameLength;
+}
+
 Person* readPeople(FILE* fp)
 {
   const size_t end = getEndAndSeekToFirstPerson(fp);
   Person* people = (Person*)malloc(end - ftell(fp));
-  for (size_t i = 0; ftell(fp) < end; i++)
+
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  for (size_t i = 0; nextPersonScanRecord(&scan, &person); i++)
   {
-    loadPerson(fp, &people[i]);
+    size_t nameLength = strlen(person.name) + 1;
+    people[i] = person;
+    people[i].name = (char*)malloc(nameLength);
+    memcpy(people[i].name, person.name, nameLength);
   }
+  closePersonScan(&scan);
 
   return people;
 }
@@ -106,6 +171,7 @@ void insertPerson(FILE* fp, Person* person, PersonMeta* meta)
     updatePersonMeta(fp, meta);
   }
 
+  markPersonDbWrite();
   fseek(fp, 0, SEEK_END);
 
   fwrite(&person->id, sizeof(size_t), 1, fp);
@@ -118,40 +184,99 @@ void insertPerson(FILE* fp, Person* person, PersonMeta* meta)
   fwrite(person->name, sizeof(char), nameLength, fp);
 }
 
+void encodePerson(Buffer* buffer, const Person* person)
+{
+  size_t nameLength = strlen(person->name) + 1; // +1 because of '\0'
+  reserveBuffer(buffer, buffer->size + sizeof(size_t) + sizeof(int) + sizeof(size_t) + nameLength);
+  appendBuffer(buffer, &person->id, sizeof(size_t));
+  appendBuffer(buffer, &person->age, sizeof(int));
+  appendBuffer(buffer, &nameLength, sizeof(size_t));
+  appendBuffer(buffer, person->name, nameLength);
+}
+
+void insertEncodedPeople(FILE* fp, const char* records, size_t size)
+{
+  markPersonDbWrite();
+  fseek(fp, 0, SEEK_END);
+  fwrite(records, sizeof(char), size, fp);
+}
+
 Person* findPersonById(FILE* fp, const size_t id)
 {
-  const size_t end = getEndAndSeekToFirstPerson(fp);
-  while (ftell(fp) < end)
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+
+  Person* found = NULL;
+  Person person;
+  while (nextPersonScanRecord(&scan, &person))
   {
-    Person* person = (Person*)malloc(sizeof(Person));
-    loadPerson(fp, person);
-    if (person->id == id)
+    if (person.id == id)
     {
-      return person;
+      size_t nameLength = strlen(person.name) + 1;
+      found = (Person*)malloc(sizeof(Person));
+      *found = person;
+      found->name = (char*)malloc(nameLength);
+      memcpy(found->name, person.name, nameLength);
+      break;
     }
-    freePerson(person);
-    free(person);
   }
 
-  return NULL;
+  closePersonScan(&scan);
+  return found;
 }
 
 Person* findPerson(FILE* fp, const char* name)
 {
-  const size_t end = getEndAndSeekToFirstPerson(fp);
-  while (ftell(fp) < end)
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+
+  Person* found = NULL;
+  Person person;
+  while (nextPersonScanRecord(&scan, &person))
+  {
+    if (strcmp(person.name, name) == 0)
+    {
+      size_t nameLength = strlen(person.name) + 1;
+      found = (Person*)malloc(sizeof(Person));
+      *found = person;
+      found->name = (char*)malloc(nameLength);
+      memcpy(found->name, person.name, nameLength);
+      break;
+    }
+  }
+
+  closePersonScan(&scan);
+  return found;
+}
+
+Person* findPeopleByName(FILE* fp, const char* name, size_t* count)
+{
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+
+  Person* people = NULL;
+  size_t capacity = 0;
+  *count = 0;
+  Person person;
+  while (nextPersonScanRecord(&scan, &person))
   {
-    Person* person = (Person*)malloc(sizeof(Person));
-    loadPerson(fp, person);
-    if (strcmp(person->name, name) == 0)
+    if (strcmp(person.name, name) != 0)
+      continue;
+
+    if (*count == capacity)
     {
-      return person;
+      capacity = capacity > 0 ? capacity * 2 : 8;
+      people = (Person*)realloc(people, capacity * sizeof(Person));
     }
-    freePerson(person);
-    free(person);
+    size_t nameLength = strlen(person.name) + 1;
+    people[*count] = person;
+    people[*count].name = (char*)malloc(nameLength);
+    memcpy(people[*count].name, person.name, nameLength);
+    (*count)++;
   }
 
-  return NULL;
+  closePersonScan(&scan);
+  return people;
 }
 
 bool deletePerson(FILE** fpPtr, PersonMeta* meta, const size_t id)
@@ -159,16 +284,16 @@ bool deletePerson(FILE** fpPtr, PersonMeta* meta, const size_t id)
   FILE* fp = *fpPtr;
 
   // Check first if it exists before creating a new file to delete
-  Person* person = findPersonById(fp, id);
-  if (person == NULL)
+  Person* existing = findPersonById(fp, id);
+  if (existing == NULL)
   {
     return false;
   }
 
-  freePerson(person);
-  free(person);
+  freePerson(existing);
+  free(existing);
 
-  FILE* newFp = fopen("people_temp.db", "w+b");
+  FILE* newFp = fopen(getPersonDbTempFilename(), "w+b");
   if (!newFp)
   {
     perror("Impossibile creare un nuovo file per rimuovere un elemento");
@@ -177,23 +302,42 @@ bool deletePerson(FILE** fpPtr, PersonMeta* meta, const size_t id)
 
   meta->count--;
   updatePersonMeta(newFp, meta);
-
-  const size_t end = getEndAndSeekToFirstPerson(fp);
-  while (ftell(fp) < end)
+  fseek(newFp, 0, SEEK_END);
+
+  // Kept records are copied in large writes, like an import
+  Buffer batch;
+  initBuffer(&batch, PERSON_IMPORT_BATCH_SIZE + 4096);
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (nextPersonScanRecord(&scan, &person))
   {
-    Person person;
-    loadPerson(fp, &person);
-    if (person.id != id)
+    if (person.id == id)
+      continue;
+
+    encodePerson(&batch, &person);
+    if (batch.size >= PERSON_IMPORT_BATCH_SIZE)
     {
-      insertPerson(newFp, &person, NULL);
+      insertEncodedPeople(newFp, batch.data, batch.size);
+      clearBuffer(&batch);
     }
-    freePerson(&person);
+  }
+  insertEncodedPeople(newFp, batch.data, batch.size);
+  freeBuffer(&batch);
+
+  if (!closePersonScan(&scan))
+  {
+    meta->count++;
+    fclose(newFp);
+    remove(getPersonDbTempFilename());
+    return false;
   }
 
   fclose(fp);
   *fpPtr = newFp;
-  remove("people.db");
-  rename("people_temp.db", "people.db");
+  remove(getPersonDbFilename());
+  rename(getPersonDbTempFilename(), getPersonDbFilename());
+  markPersonDbWrite();
 
   return true;
 }
@@ -208,9 +352,21 @@ bool updatePerson(FILE** fpPtr, PersonMeta* meta, const size_t id, Person* updat
 
   insertPerson(*fpPtr, updatedPerson, NULL);
   meta->count++;
+  updatePersonMeta(*fpPtr, meta);
   return true;
 }
 
+void appendPersonJson(Buffer* buffer, const Person* person)
+{
+  appendStringToBuffer(buffer, "{\"id\":");
+  appendSize_tToBuffer(buffer, person->id);
+  appendStringToBuffer(buffer, ",\"age\":");
+  appendIntToBuffer(buffer, person->age);
+  appendStringToBuffer(buffer, ",\"name\":");
+  appendJsonStringToBuffer(buffer, person->name);
+  appendBuffer(buffer, "}", 1);
+}
+
 bool personDbToJson(FILE* fp, const char* filename)
 {
   PersonMeta meta;
@@ -220,174 +376,1162 @@ bool personDbToJson(FILE* fp, const char* filename)
   if (!jsonFile)
     return false;
 
-  fputc('{', jsonFile); // start root object
+  Buffer output;
+  initBuffer(&output, PERSON_EXPORT_BUFFER_SIZE + 4096);
+
+  appendStringToBuffer(&output, "{\"metadata\":{\"autoIncrementId\":");
+  appendSize_tToBuffer(&output, meta.autoIncrementId);
+  appendStringToBuffer(&output, ",\"count\":");
+  appendSize_tToBuffer(&output, meta.count);
+  appendStringToBuffer(&output, "},\"people\":[");
+
+  // Names point into the scan's blocks instead of a malloc per person
+  bool success = true;
+  bool isFirst = true;
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (success && nextPersonScanRecord(&scan, &person))
+  {
+    if (!isFirst)
+      appendBuffer(&output, ",", 1);
+    isFirst = false;
+    appendPersonJson(&output, &person);
+
+    if (output.size >= PERSON_EXPORT_BUFFER_SIZE)
+      success = flushBuffer(&output, jsonFile);
+  }
+  if (!closePersonScan(&scan))
+    success = false;
 
-  fputs("\"metadata\":{", jsonFile);
-  fputs("\"autoIncrementId\":", jsonFile);
+  appendStringToBuffer(&output, "]}");
+  if (success)
+    success = flushBuffer(&output, jsonFile);
 
-  char* autoIdStr = size_tToString(meta.autoIncrementId);
-  fputs(autoIdStr, jsonFile);
-  free(autoIdStr);
+  freeBuffer(&output);
 
-  fputc(',', jsonFile);
+  if (fclose(jsonFile) != 0)
+    success = false;
+  return success;
+}
 
-  fputs("\"count\":", jsonFile);
-  char* countStr = size_tToString(meta.count);
-  fputs(countStr, jsonFile);
-  free(countStr);
+typedef struct PersonJsonExport
+{
+  PersonScan scan;
+  FILE* jsonFile;
+  bool hasPeople;
+} PersonJsonExport;
 
-  fputc('}', jsonFile); // end metadata object
-  fputc(',', jsonFile);
+bool producePersonRecordsChunk(void* context, PipelineChunk* chunk)
+{
+  // Records come through PersonScan, so the export also gets its read-ahead and direct mode
+  PersonJsonExport* jsonExport = (PersonJsonExport*)context;
+  return appendPersonScanRecords(&jsonExport->scan, &chunk->input, PERSON_EXPORT_BUFFER_SIZE) > 0;
+}
 
-  fputs("\"people\":[", jsonFile);
+bool processPersonRecordsChunk(void* context, PipelineChunk* chunk)
+{
+  const size_t headerSize = sizeof(size_t) + sizeof(int) + sizeof(size_t);
+  reserveBuffer(&chunk->output, chunk->input.size * 2);
 
-  const size_t end = getEndAndSeekToFirstPerson(fp);
-  while (ftell(fp) < end)
+  size_t pos = 0;
+  while (pos < chunk->input.size)
   {
     Person person;
-    loadPerson(fp, &person);
+    size_t nameLength;
+    memcpy(&person.id, chunk->input.data + pos, sizeof(size_t));
+    memcpy(&person.age, chunk->input.data + pos + sizeof(size_t), sizeof(int));
+    memcpy(&nameLength, chunk->input.data + pos + sizeof(size_t) + sizeof(int), sizeof(size_t));
+    person.name = chunk->input.data + pos + headerSize;
+
+    if (chunk->count > 0)
+      appendBuffer(&chunk->output, ",", 1);
+    appendPersonJson(&chunk->output, &person);
+    chunk->count++;
+
+    pos += headerSize + nameLength;
+  }
 
-    fputc('{', jsonFile); // start person object
+  return true;
+}
+
+bool consumePersonJsonExportChunk(void* context, PipelineChunk* chunk)
+{
+  PersonJsonExport* jsonExport = (PersonJsonExport*)context;
 
-    fputs("\"id\":", jsonFile);
-    char* idStr = size_tToString(person.id);
-    fputs(idStr, jsonFile);
-    free(idStr);
-    fputc(',', jsonFile);
+  // Chunks are serialized independently so the separator between them is added here
+  if (jsonExport->hasPeople && chunk->count > 0 && fputc(',', jsonExport->jsonFile) == EOF)
+    return false;
+  if (chunk->count > 0)
+    jsonExport->hasPeople = true;
 
-    fputs("\"age\":", jsonFile);
-    char* ageStr = intToString(person.age);
-    fputs(ageStr, jsonFile);
-    free(ageStr);
-    fputc(',', jsonFile);
+  return fwrite(chunk->output.data, sizeof(char), chunk->output.size, jsonExport->jsonFile) == chunk->output.size;
+}
 
-    fputs("\"name\":", jsonFile);
-    fputc('"', jsonFile);
-    fputs(person.name, jsonFile);
-    fputc('"', jsonFile);
+bool personDbToJsonParallel(FILE* fp, const char* filename, size_t threadCount)
+{
+  if (threadCount <= 1)
+    return personDbToJson(fp, filename);
 
-    fputc('}', jsonFile); // end person object
+  PersonMeta meta;
+  loadPersonMeta(fp, &meta);
 
-    freePerson(&person);
-  }
+  FILE* jsonFile = fopen(filename, "w");
+  if (!jsonFile)
+    return false;
 
-  fputc(']', jsonFile); // end people array
+  fprintf(jsonFile, "{\"metadata\":{\"autoIncrementId\":%zu,\"count\":%zu},\"people\":[", meta.autoIncrementId, meta.count);
 
-  fputc('}', jsonFile); // end root object
+  PersonJsonExport jsonExport;
+  jsonExport.jsonFile = jsonFile;
+  jsonExport.hasPeople = false;
+  openPersonScan(&jsonExport.scan, fp);
 
-  fclose(jsonFile);
-  return true;
+  bool success = runPipeline(&jsonExport, threadCount, producePersonRecordsChunk, processPersonRecordsChunk, consumePersonJsonExportChunk);
+  if (!closePersonScan(&jsonExport.scan))
+    success = false;
+
+  fputs("]}", jsonFile);
+
+  if (fclose(jsonFile) != 0)
+    success = false;
+  return success;
 }
 
-PersonJsonError loadPersonDbFromJson(FILE** fpPtr, PersonMeta* meta, JsonNode* rootNode)
+PersonJsonError failPersonJsonLoad(FILE* newFp, PersonJsonError error)
 {
-  FILE* fp = *fpPtr;
-  FILE* newFp = fopen("people_temp.db", "w+b");
-  if (!newFp)
-    return CANNOT_CREATE_PERSON_DB_FILE;
+  fclose(newFp);
+  return error;
+}
 
+PersonJsonError loadPersonDbFromJson(FILE** fpPtr, PersonMeta* meta, JsonNode* rootNode)
+{
   if (rootNode == NULL)
     return EXPECTED_JSON_OBJECT;
 
-  if (rootNode->type != OBJECT_NODE || rootNode->vSize < 2)
+  if (rootNode->type != OBJECT_NODE)
     return INVALID_PERSON_JSON_OBJECT;
 
-  // read metadata
-  JsonNode* metadataNode = &rootNode->value.v_object[0];
+  // Keys are hashed once here instead of for every person
+  const JsonKey metadataKey = createJsonKey("metadata");
+  const JsonKey autoIdKey = createJsonKey("autoIncrementId");
+  const JsonKey countKey = createJsonKey("count");
+  const JsonKey peopleKey = createJsonKey("people");
+  const JsonKey idKey = createJsonKey("id");
+  const JsonKey ageKey = createJsonKey("age");
+  const JsonKey nameKey = createJsonKey("name");
 
-  if (metadataNode->type != OBJECT_NODE)
-    return EXPECTED_METADATA_OBJECT;
-  if (strcmp(metadataNode->key, "metadata") != 0)
+  // read metadata
+  JsonNode* metadataNode = getObjectField(rootNode, &metadataKey);
+  if (metadataNode == NULL || metadataNode->type != OBJECT_NODE)
     return EXPECTED_METADATA_OBJECT;
 
-  if (metadataNode->vSize < 1)
-    return EXPECTED_METADATA_AUTO_ID;
+  PersonMeta newMeta;
 
-  JsonNode* autoIdNode = &metadataNode->value.v_object[0];
-  if (autoIdNode->type != INTEGER_NODE)
+  JsonNode* autoIdNode = getObjectField(metadataNode, &autoIdKey);
+  if (autoIdNode == NULL || autoIdNode->type != INTEGER_NODE)
     return EXPECTED_METADATA_AUTO_ID;
-  if (strcmp(autoIdNode->key, "autoIncrementId") != 0)
-    return EXPECTED_METADATA_AUTO_ID;
-  meta->autoIncrementId = (size_t)autoIdNode->value.v_int;
+  newMeta.autoIncrementId = (size_t)autoIdNode->value.v_int;
 
-  if (metadataNode->vSize < 2)
+  JsonNode* countNode = getObjectField(metadataNode, &countKey);
+  if (countNode == NULL || countNode->type != INTEGER_NODE)
     return EXPECTED_METADATA_COUNT;
+  newMeta.count = (size_t)countNode->value.v_int;
 
-  JsonNode* countNode = &metadataNode->value.v_object[1];
-  if (countNode->type != INTEGER_NODE)
-    return EXPECTED_METADATA_COUNT;
-  if (strcmp(countNode->key, "count") != 0)
-    return EXPECTED_METADATA_COUNT;
-  meta->count = (size_t)countNode->value.v_int;
+  JsonNode* peopleArrayNode = getObjectField(rootNode, &peopleKey);
+  if (peopleArrayNode == NULL || peopleArrayNode->type != ARRAY_NODE)
+    return EXPECTED_PEOPLE_ARRAY;
 
-  updatePersonMeta(newFp, meta);
+  FILE* newFp = fopen(getPersonDbTempFilename(), "w+b");
+  if (!newFp)
+    return CANNOT_CREATE_PERSON_DB_FILE;
 
-  // read people
-  JsonNode* peopleArrayNode = &rootNode->value.v_object[1];
-  if (peopleArrayNode->type != ARRAY_NODE)
-    return EXPECTED_PEOPLE_ARRAY;
-  if (strcmp(peopleArrayNode->key, "people") != 0)
-    return EXPECTED_PEOPLE_ARRAY;
+  updatePersonMeta(newFp, &newMeta);
 
+  // read people
+  Buffer batch;
+  initBuffer(&batch, PERSON_IMPORT_BATCH_SIZE);
   for (size_t i = 0; i < peopleArrayNode->vSize; i++)
   {
     JsonNode* personNode = &peopleArrayNode->value.v_array[i];
     if (personNode->type != OBJECT_NODE)
-      return EXPECTED_PERSON_OBJECT;
+    {
+      freeBuffer(&batch);
+      return failPersonJsonLoad(newFp, EXPECTED_PERSON_OBJECT);
+    }
 
-    Person person;
+    JsonNode* idNode = getObjectField(personNode, &idKey);
+    JsonNode* ageNode = getObjectField(personNode, &ageKey);
+    JsonNode* nameNode = getObjectField(personNode, &nameKey);
+
+    PersonJsonError errorCode = NO_PERSON_JSON_ERROR;
+    if (idNode == NULL || idNode->type != INTEGER_NODE)
+      errorCode = EXPECTED_PERSON_ID;
+    else if (ageNode == NULL || ageNode->type != INTEGER_NODE)
+      errorCode = EXPECTED_PERSON_AGE;
+    else if (nameNode == NULL || nameNode->type != STRING_NODE)
+      errorCode = EXPECTED_PERSON_NAME;
 
-    JsonNode* idNode = NULL;
-    JsonNode* ageNode = NULL;
-    JsonNode* nameNode = NULL;
-    for (size_t j = 0; j < personNode->vSize; j++)
+    if (errorCode != NO_PERSON_JSON_ERROR)
     {
-      JsonNode* propNode = &personNode->value.v_object[j];
-      if (propNode->key == NULL)
-        continue;
-      else if (strcmp(propNode->key, "id") == 0)
-        idNode = propNode;
-      else if (strcmp(propNode->key, "age") == 0)
-        ageNode = propNode;
-      else if (strcmp(propNode->key, "name") == 0)
-        nameNode = propNode;
+      freeBuffer(&batch);
+      return failPersonJsonLoad(newFp, errorCode);
     }
 
-    if (idNode->type != INTEGER_NODE)
-      return EXPECTED_PERSON_ID;
-    if (ageNode->type != INTEGER_NODE)
-      return EXPECTED_PERSON_AGE;
-    if (nameNode->type != STRING_NODE)
-      return EXPECTED_PERSON_NAME;
-
+    Person person;
     person.id = idNode->value.v_int;
     person.age = ageNode->value.v_int;
     person.name = nameNode->value.v_string;
+    encodePerson(&batch, &person);
 
-    insertPerson(newFp, &person, NULL);
+    if (batch.size >= PERSON_IMPORT_BATCH_SIZE)
+    {
+      insertEncodedPeople(newFp, batch.data, batch.size);
+      clearBuffer(&batch);
+    }
   }
 
-  fclose(fp);
+  insertEncodedPeople(newFp, batch.data, batch.size);
+  freeBuffer(&batch);
+
+  fclose(*fpPtr);
   *fpPtr = newFp;
-  remove("people.db");
-  rename("people_temp.db", "people.db");
+  *meta = newMeta;
+  remove(getPersonDbFilename());
+  rename(getPersonDbTempFilename(), getPersonDbFilename());
+  markPersonDbWrite();
 
   return NO_PERSON_JSON_ERROR;
 }
 
-void printPeople(Person* people, size_t size)
+typedef enum PersonJsonField
+{
+  OTHER_JSON_FIELD = 0,
+  METADATA_JSON_FIELD,
+  PEOPLE_JSON_FIELD,
+  AUTO_ID_JSON_FIELD,
+  COUNT_JSON_FIELD,
+  ID_JSON_FIELD,
+  AGE_JSON_FIELD,
+  NAME_JSON_FIELD
+} PersonJsonField;
+
+typedef struct PersonJsonStream
+{
+  FILE* fp;
+  PersonMeta meta;
+  PersonJsonError error;
+  size_t depth;
+  size_t ignoredDepth;
+  PersonJsonField field;
+  bool inMetadata;
+  bool inPeople;
+  bool hasMetadata;
+  bool hasAutoId;
+  bool hasCount;
+  bool hasPeople;
+  bool hasId;
+  bool hasAge;
+  bool hasName;
+  Person person;
+  Buffer name;
+  Buffer batch;
+  size_t count;
+  bool renumber;
+  size_t nextId;
+  size_t renumbered;
+} PersonJsonStream;
+
+bool failPersonJsonStream(PersonJsonStream* stream, PersonJsonError error)
+{
+  stream->error = error;
+  return false;
+}
+
+// Error to report when a value of the wrong kind is found for the current field
+PersonJsonError getPersonJsonFieldError(PersonJsonStream* stream)
+{
+  switch (stream->field)
+  {
+  case METADATA_JSON_FIELD:
+    return EXPECTED_METADATA_OBJECT;
+  case PEOPLE_JSON_FIELD:
+    return EXPECTED_PEOPLE_ARRAY;
+  case AUTO_ID_JSON_FIELD:
+    return EXPECTED_METADATA_AUTO_ID;
+  case COUNT_JSON_FIELD:
+    return EXPECTED_METADATA_COUNT;
+  case ID_JSON_FIELD:
+    return EXPECTED_PERSON_ID;
+  case AGE_JSON_FIELD:
+    return EXPECTED_PERSON_AGE;
+  case NAME_JSON_FIELD:
+    return EXPECTED_PERSON_NAME;
+  default:
+    return INVALID_PERSON_JSON_OBJECT;
+  }
+}
+
+// Handles a value that is not what the current field expects, ignoring it if the field is unknown
+bool skipPersonJsonValue(PersonJsonStream* stream, bool isContainer)
+{
+  if (stream->depth == 0)
+    return failPersonJsonStream(stream, EXPECTED_JSON_OBJECT);
+  if (stream->depth == 2 && stream->inPeople)
+    return failPersonJsonStream(stream, EXPECTED_PERSON_OBJECT);
+  if (stream->field != OTHER_JSON_FIELD)
+    return failPersonJsonStream(stream, getPersonJsonFieldError(stream));
+  if (isContainer)
+    stream->ignoredDepth = 1;
+  return true;
+}
+
+bool onPersonJsonObjectStart(void* userData)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  if (stream->ignoredDepth > 0)
+  {
+    stream->ignoredDepth++;
+    return true;
+  }
+
+  if (stream->depth == 0)
+  {
+    stream->depth = 1;
+    return true;
+  }
+
+  if (stream->depth == 1 && stream->field == METADATA_JSON_FIELD)
+  {
+    stream->depth = 2;
+    stream->inMetadata = true;
+    stream->hasMetadata = true;
+    stream->field = OTHER_JSON_FIELD;
+    return true;
+  }
+
+  if (stream->depth == 2 && stream->inPeople)
+  {
+    stream->depth = 3;
+    stream->hasId = false;
+    stream->hasAge = false;
+    stream->hasName = false;
+    stream->field = OTHER_JSON_FIELD;
+    return true;
+  }
+
+  return skipPersonJsonValue(stream, true);
+}
+
+bool onPersonJsonObjectEnd(void* userData)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  if (stream->ignoredDepth > 0)
+  {
+    stream->ignoredDepth--;
+    return true;
+  }
+
+  if (stream->depth == 3)
+  {
+    if (!stream->hasId)
+      return failPersonJsonStream(stream, EXPECTED_PERSON_ID);
+    if (!stream->hasAge)
+      return failPersonJsonStream(stream, EXPECTED_PERSON_AGE);
+    if (!stream->hasName)
+      return failPersonJsonStream(stream, EXPECTED_PERSON_NAME);
+
+    // Appended ids must keep growing, so an id that is already taken gets the next free one
+    if (stream->renumber)
+    {
+      if (stream->person.id < stream->nextId)
+      {
+        stream->person.id = stream->nextId;
+        stream->renumbered++;
+      }
+      stream->nextId = stream->person.id + 1;
+    }
+
+    stream->person.name = stream->name.data;
+    encodePerson(&stream->batch, &stream->person);
+    stream->count++;
+    if (stream->fp && stream->batch.size >= PERSON_IMPORT_BATCH_SIZE)
+    {
+      insertEncodedPeople(stream->fp, stream->batch.data, stream->batch.size);
+      clearBuffer(&stream->batch);
+    }
+  }
+  else if (stream->depth == 2)
+  {
+    stream->inMetadata = false;
+  }
+
+  stream->depth--;
+  stream->field = OTHER_JSON_FIELD;
+  return true;
+}
+
+bool onPersonJsonArrayStart(void* userData)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  if (stream->ignoredDepth > 0)
+  {
+    stream->ignoredDepth++;
+    return true;
+  }
+
+  if (stream->depth == 1 && stream->field == PEOPLE_JSON_FIELD)
+  {
+    stream->depth = 2;
+    stream->inPeople = true;
+    stream->hasPeople = true;
+    return true;
+  }
+
+  return skipPersonJsonValue(stream, true);
+}
+
+bool onPersonJsonArrayEnd(void* userData)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  if (stream->ignoredDepth > 0)
+  {
+    stream->ignoredDepth--;
+    return true;
+  }
+
+  stream->inPeople = false;
+  stream->depth--;
+  stream->field = OTHER_JSON_FIELD;
+  return true;
+}
+
+bool onPersonJsonKey(void* userData, const char* key, size_t length)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  if (stream->ignoredDepth > 0)
+    return true;
+
+  stream->field = OTHER_JSON_FIELD;
+  if (stream->depth == 1)
+  {
+    if (strcmp(key, "metadata") == 0)
+      stream->field = METADATA_JSON_FIELD;
+    else if (strcmp(key, "people") == 0)
+      stream->field = PEOPLE_JSON_FIELD;
+  }
+  else if (stream->depth == 2 && stream->inMetadata)
+  {
+    if (strcmp(key, "autoIncrementId") == 0)
+      stream->field = AUTO_ID_JSON_FIELD;
+    else if (strcmp(key, "count") == 0)
+      stream->field = COUNT_JSON_FIELD;
+  }
+  else if (stream->depth == 3)
+  {
+    if (strcmp(key, "id") == 0)
+      stream->field = ID_JSON_FIELD;
+    else if (strcmp(key, "age") == 0)
+      stream->field = AGE_JSON_FIELD;
+    else if (strcmp(key, "name") == 0)
+      stream->field = NAME_JSON_FIELD;
+  }
+
+  return true;
+}
+
+bool onPersonJsonInteger(void* userData, long long value)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  if (stream->ignoredDepth > 0)
+    return true;
+
+  switch (stream->field)
+  {
+  case AUTO_ID_JSON_FIELD:
+    stream->meta.autoIncrementId = (size_t)value;
+    stream->hasAutoId = true;
+    return true;
+  case COUNT_JSON_FIELD:
+    stream->meta.count = (size_t)value;
+    stream->hasCount = true;
+    return true;
+  case ID_JSON_FIELD:
+    stream->person.id = (size_t)value;
+    stream->hasId = true;
+    return true;
+  case AGE_JSON_FIELD:
+    stream->person.age = (int)value;
+    stream->hasAge = true;
+    return true;
+  default:
+    return skipPersonJsonValue(stream, false);
+  }
+}
+
+bool onPersonJsonString(void* userData, const char* str, size_t length)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  if (stream->ignoredDepth > 0)
+    return true;
+
+  if (stream->field != NAME_JSON_FIELD)
+    return skipPersonJsonValue(stream, false);
+
+  clearBuffer(&stream->name);
+  appendBuffer(&stream->name, str, length + 1);
+  stream->hasName = true;
+  return true;
+}
+
+bool onPersonJsonDouble(void* userData, double value)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  return stream->ignoredDepth > 0 || skipPersonJsonValue(stream, false);
+}
+
+bool onPersonJsonBoolean(void* userData, bool value)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  return stream->ignoredDepth > 0 || skipPersonJsonValue(stream, false);
+}
+
+bool onPersonJsonNull(void* userData)
+{
+  PersonJsonStream* stream = (PersonJsonStream*)userData;
+  return stream->ignoredDepth > 0 || skipPersonJsonValue(stream, false);
+}
+
+void initPersonJsonStreamHandler(JsonStreamHandler* handler)
+{
+  handler->onObjectStart = onPersonJsonObjectStart;
+  handler->onObjectEnd = onPersonJsonObjectEnd;
+  handler->onArrayStart = onPersonJsonArrayStart;
+  handler->onArrayEnd = onPersonJsonArrayEnd;
+  handler->onKey = onPersonJsonKey;
+  handler->onString = onPersonJsonString;
+  handler->onInteger = onPersonJsonInteger;
+  handler->onDouble = onPersonJsonDouble;
+  handler->onBoolean = onPersonJsonBoolean;
+  handler->onNull = onPersonJsonNull;
+}
+
+PersonJsonError loadPersonDbFromJsonStream(FILE** fpPtr, PersonMeta* meta, FILE* jsonFile, JsonStreamError* streamError)
+{
+  fseek(jsonFile, 0, SEEK_SET);
+  return loadPersonDbFromJsonSource(fpPtr, meta, readJsonFileSource, jsonFile, streamError);
+}
+
+PersonJsonError loadPersonDbFromJsonSource(FILE** fpPtr, PersonMeta* meta, JsonStreamRead read, void* source, JsonStreamError* streamError)
+{
+  FILE* newFp = fopen(getPersonDbTempFilename(), "w+b");
+  if (!newFp)
+    return CANNOT_CREATE_PERSON_DB_FILE;
+
+  PersonJsonStream stream = {0};
+  stream.fp = newFp;
+  stream.error = NO_PERSON_JSON_ERROR;
+  initBuffer(&stream.name, 64);
+  initBuffer(&stream.batch, PERSON_IMPORT_BATCH_SIZE);
+
+  // Reserve space for the metadata, it's written once the whole file is read
+  updatePersonMeta(newFp, &stream.meta);
+
+  JsonStreamHandler handler;
+  initPersonJsonStreamHandler(&handler);
+
+  JsonStreamError error;
+  bool parsed = parseJsonStream(read, source, &handler, &stream, &error);
+  if (streamError)
+    *streamError = error;
+
+  PersonJsonError errorCode = stream.error;
+  if (!parsed && errorCode == NO_PERSON_JSON_ERROR)
+    errorCode = INVALID_JSON_SYNTAX;
+  else if (errorCode == NO_PERSON_JSON_ERROR && !stream.hasMetadata)
+    errorCode = EXPECTED_METADATA_OBJECT;
+  else if (errorCode == NO_PERSON_JSON_ERROR && !stream.hasAutoId)
+    errorCode = EXPECTED_METADATA_AUTO_ID;
+  else if (errorCode == NO_PERSON_JSON_ERROR && !stream.hasCount)
+    errorCode = EXPECTED_METADATA_COUNT;
+  else if (errorCode == NO_PERSON_JSON_ERROR && !stream.hasPeople)
+    errorCode = EXPECTED_PEOPLE_ARRAY;
+
+  if (errorCode == NO_PERSON_JSON_ERROR)
+  {
+    insertEncodedPeople(newFp, stream.batch.data, stream.batch.size);
+    updatePersonMeta(newFp, &stream.meta);
+  }
+
+  freeBuffer(&stream.name);
+  freeBuffer(&stream.batch);
+
+  if (errorCode != NO_PERSON_JSON_ERROR)
+  {
+    fclose(newFp);
+    return errorCode;
+  }
+
+  fclose(*fpPtr);
+  *fpPtr = newFp;
+  *meta = stream.meta;
+  remove(getPersonDbFilename());
+  rename(getPersonDbTempFilename(), getPersonDbFilename());
+  markPersonDbWrite();
+
+  return NO_PERSON_JSON_ERROR;
+}
+
+typedef enum PersonJsonCapture
+{
+  SKELETON_JSON_CAPTURE = 0,
+  PEOPLE_JSON_CAPTURE
+} PersonJsonCapture;
+
+typedef struct PersonJsonScanner
+{
+  FILE* jsonFile;
+  char* block;
+  size_t blockSize;
+  size_t blockPos;
+  size_t depth;
+  char brackets[JSON_STREAM_MAX_DEPTH];
+  bool inString;
+  bool escape;
+  bool expectingKey;
+  bool readingKey;
+  char key[16];
+  size_t keyLength;
+  PersonJsonField rootField;
+  PersonJsonCapture capture;
+  bool chunkHasValue;
+  bool needsSeparator;
+  bool droppedSeparator;
+  bool rootClosed;
+  bool failed;
+  Buffer skeleton;
+} PersonJsonScanner;
+
+// Finds the next run of whole person objects of at least chunkSize bytes without parsing them.
+// Everything else in the file is copied to the skeleton, with the people array left empty,
+// so the skeleton can be parsed as a whole document afterwards
+bool scanPersonJsonChunk(PersonJsonScanner* scanner, Buffer* chunk, size_t chunkSize)
+{
+  size_t captureStart = scanner->blockPos;
+  while (!scanner->failed)
+  {
+    if (scanner->blockPos >= scanner->blockSize)
+    {
+      if (scanner->capture == PEOPLE_JSON_CAPTURE)
+        appendBuffer(chunk, scanner->block + captureStart, scanner->blockPos - captureStart);
+      else
+        appendBuffer(&scanner->skeleton, scanner->block + captureStart, scanner->blockPos - captureStart);
+
+      scanner->blockSize = fread(scanner->block, sizeof(char), PERSON_IMPORT_BATCH_SIZE, scanner->jsonFile);
+      scanner->blockPos = 0;
+      captureStart = 0;
+      if (scanner->blockSize == 0)
+      {
+        if (scanner->depth != 0 || scanner->inString)
+          scanner->failed = true;
+        break;
+      }
+    }
+
+    char c = scanner->block[scanner->blockPos++];
+    if (scanner->inString)
+    {
+      if (scanner->escape)
+        scanner->escape = false;
+      else if (c == '\\')
+        scanner->escape = true;
+      else if (c == '"')
+        scanner->inString = scanner->readingKey = false;
+      else if (scanner->readingKey && scanner->keyLength < sizeof(scanner->key) - 1)
+        scanner->key[scanner->keyLength++] = c;
+      continue;
+    }
+
+    // Outside the root object only whitespace is allowed, and only one root
+    if (scanner->depth == 0 && !isspace((unsigned char)c) && (scanner->rootClosed || c != '{'))
+    {
+      scanner->failed = true;
+      break;
+    }
+
+    if (scanner->capture == PEOPLE_JSON_CAPTURE && scanner->depth == 2 && !scanner->chunkHasValue && !isspace((unsigned char)c))
+    {
+      // Drop the separator between the previous chunk and this one. The chunk parser never
+      // sees it, so a missing, doubled or trailing comma is caught here
+      if (c == ',' && scanner->needsSeparator)
+      {
+        scanner->needsSeparator = false;
+        scanner->droppedSeparator = true;
+        chunk->size = 1;
+        captureStart = scanner->blockPos;
+        continue;
+      }
+      if (c == ',' || (c == ']' && scanner->droppedSeparator) || (c != ']' && scanner->needsSeparator))
+      {
+        scanner->failed = true;
+        break;
+      }
+      if (c != ']')
+        scanner->chunkHasValue = true;
+      scanner->droppedSeparator = false;
+    }
+
+    switch (c)
+    {
+    case '"':
+      scanner->inString = true;
+      if (scanner->depth == 1 && scanner->expectingKey)
+      {
+        scanner->readingKey = true;
+        scanner->keyLength = 0;
+      }
+      break;
+    case ':':
+      if (scanner->depth == 1)
+      {
+        scanner->key[scanner->keyLength] = '\0';
+        scanner->expectingKey = false;
+        if (strcmp(scanner->key, "metadata") == 0)
+          scanner->rootField = METADATA_JSON_FIELD;
+        else if (strcmp(scanner->key, "people") == 0)
+          scanner->rootField = PEOPLE_JSON_FIELD;
+        else
+          scanner->rootField = OTHER_JSON_FIELD;
+      }
+      break;
+    case ',':
+      if (scanner->depth == 1)
+        scanner->expectingKey = true;
+      break;
+    case '{':
+    case '[':
+      if (scanner->depth >= JSON_STREAM_MAX_DEPTH)
+      {
+        scanner->failed = true;
+        break;
+      }
+      scanner->brackets[scanner->depth++] = c;
+      if (scanner->depth == 1)
+      {
+        scanner->expectingKey = true;
+      }
+      else if (scanner->depth == 2 && scanner->rootField == PEOPLE_JSON_FIELD && c == '[')
+      {
+        appendBuffer(&scanner->skeleton, scanner->block + captureStart, scanner->blockPos - captureStart);
+        scanner->capture = PEOPLE_JSON_CAPTURE;
+        scanner->chunkHasValue = false;
+        scanner->needsSeparator = false;
+        scanner->droppedSeparator = false;
+        captureStart = scanner->blockPos;
+      }
+      break;
+    case '}':
+    case ']':
+      if (scanner->depth == 0 || scanner->brackets[scanner->depth - 1] != (c == '}' ? '{' : '['))
+      {
+        scanner->failed = true;
+        break;
+      }
+      scanner->depth--;
+      if (scanner->depth == 0)
+        scanner->rootClosed = true;
+      else if (scanner->depth == 1 && scanner->capture == PEOPLE_JSON_CAPTURE)
+      {
+        appendBuffer(chunk, scanner->block + captureStart, scanner->blockPos - 1 - captureStart);
+        scanner->capture = SKELETON_JSON_CAPTURE;
+        // The closing bracket goes to the skeleton, leaving an empty people array there
+        appendBuffer(&scanner->skeleton, "]", 1);
+        if (scanner->chunkHasValue)
+          return true;
+        chunk->size = 1;
+        captureStart = scanner->blockPos;
+      }
+      else if (scanner->depth == 2 && scanner->capture == PEOPLE_JSON_CAPTURE && c == '}' &&
+               chunk->size + scanner->blockPos - captureStart >= chunkSize)
+      {
+        appendBuffer(chunk, scanner->block + captureStart, scanner->blockPos - captureStart);
+        scanner->chunkHasValue = false;
+        scanner->needsSeparator = true;
+        return true;
+      }
+      break;
+    }
+  }
+
+  return false;
+}
+
+typedef struct PersonJsonImport
+{
+  PersonJsonScanner scanner;
+  FILE* fp;
+  size_t count;
+  PersonJsonError error;
+  pthread_mutex_t errorMutex;
+} PersonJsonImport;
+
+bool producePersonJsonChunk(void* context, PipelineChunk* chunk)
+{
+  PersonJsonImport* import = (PersonJsonImport*)context;
+
+  // Each chunk is parsed as a standalone array of person objects
+  appendBuffer(&chunk->input, "[", 1);
+  if (!scanPersonJsonChunk(&import->scanner, &chunk->input, PERSON_IMPORT_CHUNK_SIZE))
+    return false;
+  appendBuffer(&chunk->input, "]", 1);
+  return true;
+}
+
+bool processPersonJsonChunk(void* context, PipelineChunk* chunk)
+{
+  PersonJsonImport* import = (PersonJsonImport*)context;
+
+  PersonJsonStream stream = {0};
+  stream.depth = 1;
+  stream.field = PEOPLE_JSON_FIELD;
+  stream.error = NO_PERSON_JSON_ERROR;
+  stream.batch = chunk->output;
+  initBuffer(&stream.name, 64);
+
+  JsonStreamHandler handler;
+  initPersonJsonStreamHandler(&handler);
+
+  bool parsed = parseJsonBufferStream(chunk->input.data, chunk->input.size, &handler, &stream, NULL);
+  chunk->output = stream.batch;
+  chunk->count = stream.count;
+  freeBuffer(&stream.name);
+
+  if (!parsed)
+  {
+    pthread_mutex_lock(&import->errorMutex);
+    if (import->error == NO_PERSON_JSON_ERROR)
+      import->error = stream.error != NO_PERSON_JSON_ERROR ? stream.error : INVALID_JSON_SYNTAX;
+    pthread_mutex_unlock(&import->errorMutex);
+  }
+
+  return parsed;
+}
+
+bool consumePersonJsonChunk(void* context, PipelineChunk* chunk)
+{
+  PersonJsonImport* import = (PersonJsonImport*)context;
+  insertEncodedPeople(import->fp, chunk->output.data, chunk->output.size);
+  import->count += chunk->count;
+  return true;
+}
+
+PersonJsonError loadPersonDbFromJsonParallel(FILE** fpPtr, PersonMeta* meta, FILE* jsonFile, size_t threadCount, JsonStreamError* streamError)
+{
+  if (threadCount <= 1)
+    return loadPersonDbFromJsonStream(fpPtr, meta, jsonFile, streamError);
+
+  FILE* newFp = fopen(getPersonDbTempFilename(), "w+b");
+  if (!newFp)
+    return CANNOT_CREATE_PERSON_DB_FILE;
+
+  PersonJsonImport import = {0};
+  import.fp = newFp;
+  import.error = NO_PERSON_JSON_ERROR;
+  import.scanner.jsonFile = jsonFile;
+  import.scanner.block = (char*)malloc(PERSON_IMPORT_BATCH_SIZE);
+  initBuffer(&import.scanner.skeleton, 256);
+  pthread_mutex_init(&import.errorMutex, NULL);
+
+  PersonMeta newMeta = {0};
+  updatePersonMeta(newFp, &newMeta);
+
+  fseek(jsonFile, 0, SEEK_SET);
+  runPipeline(&import, threadCount, producePersonJsonChunk, processPersonJsonChunk, consumePersonJsonChunk);
+
+  PersonJsonError errorCode = import.error;
+  if (errorCode == NO_PERSON_JSON_ERROR && import.scanner.failed)
+    errorCode = INVALID_JSON_SYNTAX;
+
+  // The skeleton is checked by the same handler as the sequential loader, so the root object,
+  // the metadata and the text around the people array follow the same rules
+  PersonJsonStream stream = {0};
+  stream.error = NO_PERSON_JSON_ERROR;
+  if (errorCode == NO_PERSON_JSON_ERROR)
+  {
+    JsonStreamHandler handler;
+    initPersonJsonStreamHandler(&handler);
+    if (!parseJsonBufferStream(import.scanner.skeleton.data, import.scanner.skeleton.size, &handler, &stream, NULL))
+      errorCode = stream.error != NO_PERSON_JSON_ERROR ? stream.error : INVALID_JSON_SYNTAX;
+  }
+
+  if (errorCode == NO_PERSON_JSON_ERROR && !stream.hasMetadata)
+    errorCode = EXPECTED_METADATA_OBJECT;
+  else if (errorCode == NO_PERSON_JSON_ERROR && !stream.hasAutoId)
+    errorCode = EXPECTED_METADATA_AUTO_ID;
+  else if (errorCode == NO_PERSON_JSON_ERROR && !stream.hasCount)
+    errorCode = EXPECTED_METADATA_COUNT;
+  else if (errorCode == NO_PERSON_JSON_ERROR && !stream.hasPeople)
+    errorCode = EXPECTED_PEOPLE_ARRAY;
+
+  free(import.scanner.block);
+  freeBuffer(&import.scanner.skeleton);
+  pthread_mutex_destroy(&import.errorMutex);
+
+  if (errorCode != NO_PERSON_JSON_ERROR)
+  {
+    // Chunks lose their position in the file, so rerun sequentially to report the first
+    // error in file order with its exact diagnostic
+    fclose(newFp);
+    return loadPersonDbFromJsonStream(fpPtr, meta, jsonFile, streamError);
+  }
+
+  updatePersonMeta(newFp, &stream.meta);
+
+  fclose(*fpPtr);
+  *fpPtr = newFp;
+  *meta = stream.meta;
+  remove(getPersonDbFilename());
+  rename(getPersonDbTempFilename(), getPersonDbFilename());
+  markPersonDbWrite();
+
+  return NO_PERSON_JSON_ERROR;
+}
+
+bool personDbToNdjson(FILE* fp, const char* filename)
+{
+  FILE* ndjsonFile = fopen(filename, "w");
+  if (!ndjsonFile)
+    return false;
+
+  Buffer output;
+  initBuffer(&output, PERSON_EXPORT_BUFFER_SIZE + 4096);
+
+  bool success = true;
+  PersonScan scan;
+  openPersonScan(&scan, fp);
+  Person person;
+  while (success && nextPersonScanRecord(&scan, &person))
+  {
+    appendPersonJson(&output, &person);
+    appendBuffer(&output, "\n", 1);
+
+    if (output.size >= PERSON_EXPORT_BUFFER_SIZE)
+      success = flushBuffer(&output, ndjsonFile);
+  }
+  if (!closePersonScan(&scan))
+    success = false;
+
+  if (success)
+    success = flushBuffer(&output, ndjsonFile);
+
+  freeBuffer(&output);
+
+  if (fclose(ndjsonFile) != 0)
+    success = false;
+  return success;
+}
+
+typedef struct PersonNdjsonImport
+{
+  FILE* fp;
+  PersonJsonStream stream;
+  JsonStreamHandler handler;
+  size_t count;
+  size_t nextId;
+  size_t lineCount;
+} PersonNdjsonImport;
+
+PersonJsonError importNdjsonLine(PersonNdjsonImport* import, const char* line, size_t length, JsonStreamError* streamError)
+{
+  import->lineCount++;
+
+  if (length > 0 && line[length - 1] == '\r')
+    length--;
+
+  size_t start = 0;
+  while (start < length && isspace((unsigned char)line[start]))
+    start++;
+  if (start == length)
+    return NO_PERSON_JSON_ERROR;
+
+  // Each line is parsed as if it were an element of the people array
+  PersonJsonStream* stream = &import->stream;
+  stream->depth = 2;
+  stream->inPeople = true;
+  stream->ignoredDepth = 0;
+  stream->field = PEOPLE_JSON_FIELD;
+  stream->error = NO_PERSON_JSON_ERROR;
+
+  size_t previousCount = stream->count;
+  size_t previousBatchSize = stream->batch.size;
+  size_t previousNextId = stream->nextId;
+  size_t previousRenumbered = stream->renumbered;
+  JsonStreamError error;
+  if (!parseJsonBufferStream(line, length, &import->handler, stream, &error))
+  {
+    // A person completed before the error on the same line is dropped with the line
+    stream->count = previousCount;
+    stream->batch.size = previousBatchSize;
+    stream->nextId = previousNextId;
+    stream->renumbered = previousRenumbered;
+    if (streamError)
+    {
+      *streamError = error;
+      streamError->lineCount = import->lineCount;
+    }
+    return stream->error != NO_PERSON_JSON_ERROR ? stream->error : INVALID_JSON_SYNTAX;
+  }
+
+  if (stream->count == previousCount)
+    return NO_PERSON_JSON_ERROR;
+
+  import->count++;
+  if (stream->person.id + 1 > import->nextId)
+    import->nextId = stream->person.id + 1;
+  if (stream->batch.size >= PERSON_IMPORT_BATCH_SIZE)
+  {
+    insertEncodedPeople(import->fp, stream->batch.data, stream->batch.size);
+    clearBuffer(&stream->batch);
+  }
+  return NO_PERSON_JSON_ERROR;
+}
+
+// Imports the lines from *offset onwards; *offset is left at the first line that wasn't imported
+PersonJsonError importNdjsonPeople(FILE* fp, FILE* ndjsonFile, size_t* offset, bool requireNewline, PersonNdjsonImport* import, JsonStreamError* streamError)
+{
+  // The batch is written by importNdjsonLine, so a line that fails can be taken back out of it
+  initPersonJsonStreamHandler(&import->handler);
+  import->fp = fp;
+  initBuffer(&import->stream.name, 64);
+  initBuffer(&import->stream.batch, PERSON_IMPORT_BATCH_SIZE);
+
+  Buffer line;
+  initBuffer(&line, 256);
+  char* block = (char*)malloc(PERSON_IMPORT_BATCH_SIZE);
+
+  PersonJsonError errorCode = NO_PERSON_JSON_ERROR;
+  size_t lineStart = *offset;
+  fseek(ndjsonFile, *offset, SEEK_SET);
+
+  size_t blockSize;
+  while (errorCode == NO_PERSON_JSON_ERROR && (blockSize = fread(block, sizeof(char), PERSON_IMPORT_BATCH_SIZE, ndjsonFile)) > 0)
+  {
+    size_t pos = 0;
+    while (errorCode == NO_PERSON_JSON_ERROR && pos < blockSize)
+    {
+      const char* newline = (const char*)memchr(block + pos, '\n', blockSize - pos);
+      if (newline == NULL)
+      {
+        appendBuffer(&line, block + pos, blockSize - pos);
+        break;
+      }
+
+      size_t length = newline - (block + pos);
+      const char* data = block + pos;
+      if (line.size > 0)
+      {
+        appendBuffer(&line, data, length);
+        data = line.data;
+        length = line.size;
+      }
+
+      errorCode = importNdjsonLine(import, data, length, streamError);
+      if (errorCode == NO_PERSON_JSON_ERROR)
+        lineStart += length + 1;
+
+      clearBuffer(&line);
+      pos = newline - block + 1;
+    }
+  }
+
+  if (errorCode == NO_PERSON_JSON_ERROR && line.size > 0 && !requireNewline)
+  {
+    errorCode = importNdjsonLine(import, line.data, line.size, streamError);
+    if (errorCode == NO_PERSON_JSON_ERROR)
+      lineStart += line.size;
+  }
+
+  // Lines imported before an error are kept so that the import can be resumed from *offset
+  insertEncodedPeople(fp, import->stream.batch.data, import->stream.batch.size);
+  *offset = lineStart;
+
+  free(block);
+  freeBuffer(&line);
+  freeBuffer(&import->stream.name);
+  freeBuffer(&import->stream.batch);
+
+  return errorCode;
+}
+
+PersonJsonError loadPersonDbFromNdjson(FILE** fpPtr, PersonMeta* meta, FILE* ndjsonFile, JsonStreamError* streamError)
+{
+  FILE* newFp = fopen(getPersonDbTempFilename(), "w+b");
+  if (!newFp)
+    return CANNOT_CREATE_PERSON_DB_FILE;
+
+  PersonMeta newMeta = {0};
+  updatePersonMeta(newFp, &newMeta);
+
+  PersonNdjsonImport import = {0};
+  size_t offset = 0;
+  PersonJsonError errorCode = importNdjsonPeople(newFp, ndjsonFile, &offset, false, &import, streamError);
+  if (errorCode != NO_PERSON_JSON_ERROR)
+  {
+    fclose(newFp);
+    return errorCode;
+  }
+
+  newMeta.autoIncrementId = import.nextId;
+  newMeta.count = import.count;
+  updatePersonMeta(newFp, &newMeta);
+
+  fclose(*fpPtr);
+  *fpPtr = newFp;
+  *meta = newMeta;
+  remove(getPersonDbFilename());
+  rename(getPersonDbTempFilename(), getPersonDbFilename());
+  markPersonDbWrite();
+
+  return NO_PERSON_JSON_ERROR;
+}
+
+PersonJsonError appendPeopleFromNdjson(FILE* fp, PersonMeta* meta, FILE* ndjsonFile, size_t* offset, size_t* renumbered, JsonStreamError* streamError)
+{
+  PersonNdjsonImport import = {0};
+  import.nextId = meta->autoIncrementId;
+  import.stream.renumber = true;
+  import.stream.nextId = meta->autoIncrementId;
+
+  PersonJsonError errorCode = importNdjsonPeople(fp, ndjsonFile, offset, true, &import, streamError);
+
+  *renumbered = import.stream.renumbered;
+  meta->count += import.count;
+  meta->autoIncrementId = import.nextId;
+  updatePersonMeta(fp, meta);
+
+  return errorCode;
+}
+
+void printPeopleHeader()
 {
   printf("%-5s | %-30s | %-10s\n", "ID", "Name", "Age");
 
   for (size_t i = 0; i < 5 + 30 + 10 + 3 * 2; i++)
     printf("-");
   printf("\n");
+}
+
+void printPersonRow(const Person* person)
+{
+  printf("%-5ld | %-30s | %-10d\n", person->id, person->name, person->age);
+}
+
+void printPeople(Person* people, size_t size)
+{
+  printPeopleHeader();
 
   for (size_t i = 0; i < size; i++)
-  {
-    Person* person = &people[i];
-    printf("%-5ld | %-30s | %-10d\n", person->id, person->name, person->age);
-  }
+    printPersonRow(&people[i]);
 }
 
 void freePerson(Person* person)
@@ -402,3 +1546,35 @@ void freePeople(Person* people, size_t size)
     freePerson(&people[i]);
   }
 }
+
+PersonJsonError readPersonJsonMetadata(FILE* jsonFile, PersonMeta* meta)
+{
+  const JsonKey metadataKey = createJsonKey("metadata");
+  const JsonKey autoIdKey = createJsonKey("autoIncrementId");
+  const JsonKey countKey = createJsonKey("count");
+
+  JsonDocument* document = openJsonDocument(jsonFile);
+  PersonJsonError errorCode = NO_PERSON_JSON_ERROR;
+  JsonCursor root, metadata, field;
+  long long value;
+
+  if (!getJsonRoot(document, &root))
+    errorCode = EXPECTED_JSON_OBJECT;
+  else if (getJsonCursorType(&root) != OBJECT_NODE)
+    errorCode = INVALID_PERSON_JSON_OBJECT;
+  else if (!getJsonField(&root, &metadataKey, &metadata) || getJsonCursorType(&metadata) != OBJECT_NODE)
+    errorCode = EXPECTED_METADATA_OBJECT;
+  else if (!getJsonField(&metadata, &autoIdKey, &field) || !getJsonCursorInteger(&field, &value))
+    errorCode = EXPECTED_METADATA_AUTO_ID;
+  else
+  {
+    meta->autoIncrementId = (size_t)value;
+    if (!getJsonField(&metadata, &countKey, &field) || !getJsonCursorInteger(&field, &value))
+      errorCode = EXPECTED_METADATA_COUNT;
+    else
+      meta->count = (size_t)value;
+  }
+
+  closeJsonDocument(document);
+  return errorCode;
+}
@@ -7,7 +7,9 @@
 #define PERSON_H
 
 #include "json-parser.h"
+#include "utils.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -44,6 +46,49 @@ typedef struct Person
   char* name;
 } Person;
 
+/**
+ * @brief Nome predefinito del file del database.
+ */
+#define PERSON_DB_FILENAME "people.db"
+
+/**
+ * @brief Cambia il file del database usato da initPersonDB e dalle
+ *        operazioni che lo sostituiscono (eliminazione, caricamenti, ...).
+ *
+ * Va chiamata prima di initPersonDB, da un processo che gestisce un
+ * database diverso da quello predefinito (per esempio una replica).
+ *
+ * @param filename Nome del file del database.
+ * @return false se il nome è troppo lungo.
+ */
+bool setPersonDbFilename(const char* filename);
+
+/**
+ * @brief Restituisce il nome del file del database.
+ */
+const char* getPersonDbFilename();
+
+/**
+ * @brief Restituisce il nome del file temporaneo in cui viene scritto il
+ *        nuovo database prima di sostituire quello attuale.
+ */
+const char* getPersonDbTempFilename();
+
+/**
+ * @brief Segnala che il processo ha scritto nel database.
+ *
+ * Viene chiamata da tutte le funzioni che scrivono nel file del database o
+ * lo sostituiscono; le pagine lette prima della scrittura non vengono più
+ * restituite dalla cache della modalità diretta (vedi person-scan.h).
+ */
+void markPersonDbWrite();
+
+/**
+ * @brief Restituisce il numero di scritture nel database fatte dal
+ *        processo.
+ */
+uint64_t getPersonDbGeneration();
+
 /**
  * @brief Inizializza il database delle persone.
  *
@@ -74,6 +119,14 @@ void updatePersonMeta(FILE* fp, PersonMeta* meta);
  */
 void loadPersonMeta(FILE* fp, PersonMeta* meta);
 
+/**
+ * @brief Posiziona il file sulla prima persona del database.
+ *
+ * @param fp Puntatore al file del database.
+ * @return Dimensione totale del file, cioè la fine dell'ultima persona.
+ */
+const size_t getEndAndSeekToFirstPerson(FILE* fp);
+
 /**
  * @brief Legge tutte le persone dal database.
  *
@@ -84,6 +137,21 @@ void loadPersonMeta(FILE* fp, PersonMeta* meta);
  */
 Person* readPeople(FILE* fp);
 
+/**
+ * @brief Legge la persona alla posizione corrente del file senza allocare
+ *        un nuovo nome.
+ *
+ * Il nome viene copiato in `name`, che viene riutilizzato tra una lettura
+ * e l'altra; `person->name` punta ai dati del buffer ed è valido fino alla
+ * lettura successiva.
+ *
+ * @param fp Puntatore al file del database.
+ * @param person Puntatore alla persona da riempire.
+ * @param name Buffer in cui copiare il nome.
+ * @return Dimensione in byte del record letto.
+ */
+size_t readPersonRecord(FILE* fp, Person* person, Buffer* name);
+
 /**
  * @brief Inserisce una nuova persona nel database.
  *
@@ -95,6 +163,29 @@ Person* readPeople(FILE* fp);
  */
 void insertPerson(FILE* fp, Person* person, PersonMeta* meta);
 
+/**
+ * @brief Codifica una persona nel formato binario del database.
+ *
+ * Accoda al buffer il record `id | age | nameLength | name` esattamente
+ * come verrebbe scritto da insertPerson.
+ *
+ * @param buffer Puntatore al buffer di destinazione.
+ * @param person Puntatore alla persona da codificare.
+ */
+void encodePerson(Buffer* buffer, const Person* person);
+
+/**
+ * @brief Inserisce un blocco di persone già codificate nel database.
+ *
+ * I record vengono scritti in coda al file con una sola scrittura.
+ * I metadati non vengono modificati.
+ *
+ * @param fp Puntatore al file del database.
+ * @param records Record codificati con encodePerson.
+ * @param size Dimensione in byte dei record.
+ */
+void insertEncodedPeople(FILE* fp, const char* records, size_t size);
+
 /**
  * @brief Trova una persona nel database tramite ID.
  *
@@ -113,6 +204,17 @@ Person* findPersonById(FILE* fp, const size_t id);
  */
 Person* findPerson(FILE* fp, const char* name);
 
+/**
+ * @brief Trova tutte le persone con un certo nome leggendo il database.
+ *
+ * @param fp Puntatore al file del database.
+ * @param name Nome da cercare.
+ * @param count Numero di persone trovate.
+ * @return Array delle persone trovate (da liberare con freePeople e free),
+ *         NULL se nessuna.
+ */
+Person* findPeopleByName(FILE* fp, const char* name, size_t* count);
+
 /**
  * @brief Elimina una persona dal database tramite ID.
  *
@@ -138,6 +240,20 @@ bool deletePerson(FILE** fpPtr, PersonMeta* meta, const size_t id);
  */
 bool updatePerson(FILE** fpPtr, PersonMeta* meta, const size_t id, Person* updatedPerson);
 
+/**
+ * @brief Dimensione in byte oltre la quale il JSON esportato viene scritto
+ *        su file.
+ */
+#define PERSON_EXPORT_BUFFER_SIZE (1 << 20)
+
+/**
+ * @brief Accoda al buffer l'oggetto JSON di una persona.
+ *
+ * @param buffer Puntatore al buffer di destinazione.
+ * @param person Puntatore alla persona da serializzare.
+ */
+void appendPersonJson(Buffer* buffer, const Person* person);
+
 /**
  * @brief Converte un database di persone in formato JSON e lo scrive su file.
  *
@@ -146,10 +262,28 @@ bool updatePerson(FILE** fpPtr, PersonMeta* meta, const size_t id, Person* updat
  * @return true se la conversione ha avuto successo, false in caso di errore.
  *
  * @note La funzione scrive i dati del database delle persone nel
- *       file specificato in formato JSON.
+ *       file specificato in formato JSON. Il testo viene serializzato in un
+ *       buffer di PERSON_EXPORT_BUFFER_SIZE byte e scritto a blocchi.
  */
 bool personDbToJson(FILE* fp, const char* filename);
 
+/**
+ * @brief Converte un database di persone in JSON usando più thread.
+ *
+ * I record vengono letti a blocchi di PERSON_EXPORT_BUFFER_SIZE byte che
+ * terminano al confine di un record; ogni blocco viene serializzato da un
+ * worker nel proprio buffer e i buffer vengono scritti nell'ordine del
+ * database, aggiungendo le virgole tra un blocco e l'altro. Lettura,
+ * serializzazione e scrittura procedono in parallelo. Con un solo thread
+ * equivale a personDbToJson.
+ *
+ * @param fp Puntatore al file del database.
+ * @param filename Nome del file di output.
+ * @param threadCount Numero di thread da usare per la serializzazione.
+ * @return true se la conversione ha avuto successo, false in caso di errore.
+ */
+bool personDbToJsonParallel(FILE* fp, const char* filename, size_t threadCount);
+
 /**
  * @enum PersonJsonError
  * @brief Enumerazione degli errori possibili durante la conversione
@@ -168,7 +302,8 @@ typedef enum PersonJsonError
   EXPECTED_PERSON_OBJECT,
   EXPECTED_PERSON_ID,
   EXPECTED_PERSON_AGE,
-  EXPECTED_PERSON_NAME
+  EXPECTED_PERSON_NAME,
+  INVALID_JSON_SYNTAX
 } PersonJsonError;
 
 /**
@@ -180,9 +315,162 @@ typedef enum PersonJsonError
  *                 cui estrarre i dati.
  * @return Un valore della enumerazione PersonJsonError che indica
  *         il risultato dell'operazione.
+ *
+ * @note I campi vengono cercati per chiave con getObjectField, quindi
+ *       l'ordine delle chiavi negli oggetti non ha importanza.
  */
 PersonJsonError loadPersonDbFromJson(FILE** fpPtr, PersonMeta* meta, JsonNode* rootNode);
 
+/**
+ * @brief Dimensione in byte oltre la quale i record importati vengono
+ *        scritti nel database.
+ */
+#define PERSON_IMPORT_BATCH_SIZE (1 << 20)
+
+/**
+ * @brief Carica un database di persone da un file JSON senza costruire
+ *        l'albero JSON in memoria.
+ *
+ * Il file viene letto in streaming: ogni persona viene codificata appena
+ * il suo oggetto è completo e i record vengono scritti a blocchi di
+ * PERSON_IMPORT_BATCH_SIZE byte, quindi la memoria usata non dipende dal
+ * numero di persone.
+ *
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Puntatore ai metadati (aggiornati solo in caso di successo).
+ * @param jsonFile Puntatore al file JSON da leggere.
+ * @param streamError Puntatore in cui salvare l'eventuale errore di
+ *                    sintassi (può essere NULL).
+ * @return Un valore della enumerazione PersonJsonError; INVALID_JSON_SYNTAX
+ *         se il file non è un JSON valido.
+ */
+PersonJsonError loadPersonDbFromJsonStream(FILE** fpPtr, PersonMeta* meta, FILE* jsonFile, JsonStreamError* streamError);
+
+/**
+ * @brief Come loadPersonDbFromJsonStream, ma legge il JSON da una sorgente
+ *        qualsiasi (per esempio un flusso compresso).
+ *
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Puntatore ai metadati (aggiornati solo in caso di successo).
+ * @param read Funzione che legge il JSON dalla sorgente.
+ * @param source Puntatore passato a `read`.
+ * @param streamError Puntatore in cui salvare l'eventuale errore di
+ *                    sintassi (può essere NULL).
+ * @return Un valore della enumerazione PersonJsonError.
+ */
+PersonJsonError loadPersonDbFromJsonSource(FILE** fpPtr, PersonMeta* meta, JsonStreamRead read, void* source, JsonStreamError* streamError);
+
+/**
+ * @brief Dimensione in byte dei blocchi di persone elaborati da ogni
+ *        thread durante l'importazione parallela.
+ */
+#define PERSON_IMPORT_CHUNK_SIZE (4 << 20)
+
+/**
+ * @brief Carica un database di persone da un file JSON usando più thread.
+ *
+ * Una scansione strutturale veloce divide l'array `people` in blocchi
+ * che terminano al confine di un oggetto; i blocchi vengono analizzati e
+ * codificati in parallelo e poi scritti nel database nell'ordine
+ * originale. Il resto del documento, con l'array `people` vuoto, viene
+ * controllato con le stesse regole di loadPersonDbFromJsonStream, così i
+ * documenti accettati e rifiutati sono gli stessi. Con un solo thread
+ * equivale a loadPersonDbFromJsonStream.
+ *
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Puntatore ai metadati (aggiornati solo in caso di successo).
+ * @param jsonFile Puntatore al file JSON da leggere.
+ * @param threadCount Numero di thread da usare per l'analisi.
+ * @param streamError Puntatore in cui salvare l'eventuale errore di
+ *                    sintassi (può essere NULL).
+ * @return Un valore della enumerazione PersonJsonError.
+ *
+ * @note In caso di errore il file viene rianalizzato in modo sequenziale,
+ *       per riportare il primo errore del file e la sua posizione esatta.
+ */
+PersonJsonError loadPersonDbFromJsonParallel(FILE** fpPtr, PersonMeta* meta, FILE* jsonFile, size_t threadCount, JsonStreamError* streamError);
+
+/**
+ * @brief Esporta il database in formato NDJSON (JSON Lines).
+ *
+ * Ogni persona viene scritta come un oggetto JSON su una riga a sé,
+ * senza metadati, quindi il file può essere diviso, concatenato o letto
+ * in modo incrementale.
+ *
+ * @param fp Puntatore al file del database.
+ * @param filename Nome del file di output.
+ * @return true se l'esportazione ha avuto successo, false in caso di errore.
+ */
+bool personDbToNdjson(FILE* fp, const char* filename);
+
+/**
+ * @brief Sostituisce il database con le persone di un file NDJSON.
+ *
+ * Le righe vuote vengono ignorate. Il conteggio è il numero di persone
+ * lette e il prossimo ID è il massimo ID letto più uno.
+ *
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Puntatore ai metadati (aggiornati solo in caso di successo).
+ * @param ndjsonFile Puntatore al file NDJSON da leggere.
+ * @param streamError Puntatore in cui salvare l'eventuale errore di
+ *                    sintassi, con il numero della riga (può essere NULL).
+ * @return Un valore della enumerazione PersonJsonError.
+ */
+PersonJsonError loadPersonDbFromNdjson(FILE** fpPtr, PersonMeta* meta, FILE* ndjsonFile, JsonStreamError* streamError);
+
+/**
+ * @brief Legge solo i metadati di un file JSON esportato.
+ *
+ * Il file viene navigato su richiesta: l'array delle persone non viene
+ * analizzato, al massimo viene saltato per trovare la fine dei suoi
+ * delimitatori, quindi la lettura è quasi immediata anche per file molto
+ * grandi con i metadati all'inizio.
+ *
+ * @param jsonFile Puntatore al file JSON da leggere.
+ * @param meta Puntatore in cui salvare i metadati letti.
+ * @return Un valore della enumerazione PersonJsonError.
+ */
+PersonJsonError readPersonJsonMetadata(FILE* jsonFile, PersonMeta* meta);
+
+/**
+ * @brief Aggiunge al database le persone di un file NDJSON a partire da
+ *        una posizione.
+ *
+ * Vengono importate solo le righe complete (terminate da '\n'), mantenendo
+ * gli ID presenti nel file. Alla fine `offset` indica la prima riga non
+ * importata: chiamando di nuovo la funzione si riprende da lì, anche dopo
+ * un errore o mentre il file viene ancora scritto.
+ *
+ * Le righe già importate si saltano solo riprendendo da `offset`. Una riga
+ * con un ID minore del prossimo ID del database (o di un ID appena
+ * importato) viene aggiunta con il prossimo ID libero, così gli ID restano
+ * crescenti e non si ripetono.
+ *
+ * @param fp Puntatore al file del database.
+ * @param meta Puntatore ai metadati.
+ * @param ndjsonFile Puntatore al file NDJSON da leggere.
+ * @param offset Posizione da cui leggere, aggiornata alla fine.
+ * @param renumbered Numero di persone aggiunte con un nuovo ID.
+ * @param streamError Puntatore in cui salvare l'eventuale errore di
+ *                    sintassi; la riga è contata a partire da `offset`.
+ * @return Un valore della enumerazione PersonJsonError.
+ *
+ * @note Le persone importate prima di un errore restano nel database.
+ */
+PersonJsonError appendPeopleFromNdjson(FILE* fp, PersonMeta* meta, FILE* ndjsonFile, size_t* offset, size_t* renumbered, JsonStreamError* streamError);
+
+/**
+ * @brief Stampa l'intestazione della tabella delle persone.
+ */
+void printPeopleHeader();
+
+/**
+ * @brief Stampa una riga della tabella delle persone.
+ *
+ * @param person Puntatore alla persona da stampare.
+ */
+void printPersonRow(const Person* person);
+
 /**
  * @brief Stampa l'elenco delle persone.
  *
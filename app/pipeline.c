@@ -0,0 +1,179 @@
+#include "pipeline.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/sysinfo.h>
+
+typedef enum PipelineSlotState
+{
+  FREE_SLOT = 0,
+  FILLED_SLOT,
+  PROCESSING_SLOT,
+  PROCESSED_SLOT
+} PipelineSlotState;
+
+typedef struct Pipeline
+{
+  void* context;
+  PipelineProcess process;
+  PipelineConsume consume;
+  PipelineChunk* chunks;
+  PipelineSlotState* states;
+  size_t slotCount;
+  size_t produced;
+  size_t nextProcess;
+  size_t nextConsume;
+  bool producing;
+  bool failed;
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+} Pipeline;
+
+static void* runPipelineWorker(void* arg)
+{
+  Pipeline* pipeline = (Pipeline*)arg;
+
+  pthread_mutex_lock(&pipeline->mutex);
+  while (true)
+  {
+    while (!pipeline->failed && pipeline->nextProcess == pipeline->produced && pipeline->producing)
+      pthread_cond_wait(&pipeline->changed, &pipeline->mutex);
+
+    if (pipeline->failed || pipeline->nextProcess == pipeline->produced)
+      break;
+
+    size_t slot = pipeline->nextProcess % pipeline->slotCount;
+    pipeline->nextProcess++;
+    pipeline->states[slot] = PROCESSING_SLOT;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    bool success = pipeline->process(pipeline->context, &pipeline->chunks[slot]);
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->states[slot] = PROCESSED_SLOT;
+    if (!success)
+      pipeline->failed = true;
+    pthread_cond_broadcast(&pipeline->changed);
+  }
+  pthread_mutex_unlock(&pipeline->mutex);
+
+  return NULL;
+}
+
+static void* runPipelineConsumer(void* arg)
+{
+  Pipeline* pipeline = (Pipeline*)arg;
+
+  pthread_mutex_lock(&pipeline->mutex);
+  while (true)
+  {
+    size_t slot = pipeline->nextConsume % pipeline->slotCount;
+    while (!pipeline->failed && (pipeline->nextConsume == pipeline->produced || pipeline->states[slot] != PROCESSED_SLOT) &&
+           (pipeline->producing || pipeline->nextConsume < pipeline->produced))
+      pthread_cond_wait(&pipeline->changed, &pipeline->mutex);
+
+    if (pipeline->failed || pipeline->nextConsume == pipeline->produced)
+      break;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    bool success = pipeline->consume(pipeline->context, &pipeline->chunks[slot]);
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->states[slot] = FREE_SLOT;
+    pipeline->nextConsume++;
+    if (!success)
+      pipeline->failed = true;
+    pthread_cond_broadcast(&pipeline->changed);
+  }
+  pthread_mutex_unlock(&pipeline->mutex);
+
+  return NULL;
+}
+
+size_t getProcessorCount()
+{
+  // unistd.h can't be included next to utils.h because of pause()
+  int count = get_nprocs();
+  return count > 0 ? (size_t)count : 1;
+}
+
+bool runPipeline(void* context, size_t workerCount, PipelineProduce produce, PipelineProcess process, PipelineConsume consume)
+{
+  if (workerCount == 0)
+    workerCount = 1;
+
+  Pipeline pipeline;
+  pipeline.context = context;
+  pipeline.process = process;
+  pipeline.consume = consume;
+  pipeline.slotCount = workerCount * PIPELINE_CHUNKS_PER_WORKER;
+  pipeline.chunks = (PipelineChunk*)malloc(pipeline.slotCount * sizeof(PipelineChunk));
+  pipeline.states = (PipelineSlotState*)malloc(pipeline.slotCount * sizeof(PipelineSlotState));
+  pipeline.produced = 0;
+  pipeline.nextProcess = 0;
+  pipeline.nextConsume = 0;
+  pipeline.producing = true;
+  pipeline.failed = false;
+  pthread_mutex_init(&pipeline.mutex, NULL);
+  pthread_cond_init(&pipeline.changed, NULL);
+
+  for (size_t i = 0; i < pipeline.slotCount; i++)
+  {
+    initBuffer(&pipeline.chunks[i].input, 0);
+    initBuffer(&pipeline.chunks[i].output, 0);
+    pipeline.states[i] = FREE_SLOT;
+  }
+
+  pthread_t* workers = (pthread_t*)malloc(workerCount * sizeof(pthread_t));
+  for (size_t i = 0; i < workerCount; i++)
+    pthread_create(&workers[i], NULL, runPipelineWorker, &pipeline);
+
+  pthread_t consumer;
+  pthread_create(&consumer, NULL, runPipelineConsumer, &pipeline);
+
+  pthread_mutex_lock(&pipeline.mutex);
+  while (true)
+  {
+    size_t slot = pipeline.produced % pipeline.slotCount;
+    while (!pipeline.failed && pipeline.states[slot] != FREE_SLOT)
+      pthread_cond_wait(&pipeline.changed, &pipeline.mutex);
+
+    if (pipeline.failed)
+      break;
+    pthread_mutex_unlock(&pipeline.mutex);
+
+    PipelineChunk* chunk = &pipeline.chunks[slot];
+    chunk->index = pipeline.produced;
+    chunk->count = 0;
+    clearBuffer(&chunk->input);
+    clearBuffer(&chunk->output);
+    bool hasChunk = produce(context, chunk);
+
+    pthread_mutex_lock(&pipeline.mutex);
+    if (!hasChunk)
+      break;
+    pipeline.states[slot] = FILLED_SLOT;
+    pipeline.produced++;
+    pthread_cond_broadcast(&pipeline.changed);
+  }
+  pipeline.producing = false;
+  pthread_cond_broadcast(&pipeline.changed);
+  pthread_mutex_unlock(&pipeline.mutex);
+
+  for (size_t i = 0; i < workerCount; i++)
+    pthread_join(workers[i], NULL);
+  pthread_join(consumer, NULL);
+
+  for (size_t i = 0; i < pipeline.slotCount; i++)
+  {
+    freeBuffer(&pipeline.chunks[i].input);
+    freeBuffer(&pipeline.chunks[i].output);
+  }
+
+  free(workers);
+  free(pipeline.chunks);
+  free(pipeline.states);
+  pthread_mutex_destroy(&pipeline.mutex);
+  pthread_cond_destroy(&pipeline.changed);
+
+  return !pipeline.failed;
+}
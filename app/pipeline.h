@@ -0,0 +1,87 @@
+/**
+ * @file pipeline.h
+ * @brief Pipeline a blocchi ordinati eseguita su più thread.
+ *
+ * Un produttore (il thread chiamante) prepara i blocchi in ordine, un
+ * gruppo di worker li elabora in parallelo e un thread scrittore li
+ * consuma nello stesso ordine in cui sono stati prodotti. Il numero di
+ * blocchi in volo è limitato, quindi la memoria usata non dipende dalla
+ * quantità totale di dati.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "utils.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @struct PipelineChunk
+ * @brief Blocco di lavoro che attraversa la pipeline.
+ *
+ * @var index
+ * Posizione del blocco nell'ordine di produzione.
+ * @var input
+ * Dati preparati dal produttore.
+ * @var output
+ * Dati prodotti dal worker e letti dal consumatore.
+ * @var count
+ * Numero di elementi contenuti nel blocco (usato liberamente dagli stadi).
+ */
+typedef struct PipelineChunk
+{
+  size_t index;
+  Buffer input;
+  Buffer output;
+  size_t count;
+} PipelineChunk;
+
+/**
+ * @brief Prepara il prossimo blocco.
+ *
+ * @return true se il blocco è stato preparato, false se non ci sono
+ *         altri blocchi (o in caso di errore, segnalato tramite il contesto).
+ */
+typedef bool (*PipelineProduce)(void* context, PipelineChunk* chunk);
+
+/**
+ * @brief Elabora un blocco su un thread worker.
+ *
+ * @return false per interrompere la pipeline.
+ */
+typedef bool (*PipelineProcess)(void* context, PipelineChunk* chunk);
+
+/**
+ * @brief Consuma un blocco elaborato, nell'ordine di produzione.
+ *
+ * @return false per interrompere la pipeline.
+ */
+typedef bool (*PipelineConsume)(void* context, PipelineChunk* chunk);
+
+/**
+ * @brief Numero di blocchi in volo per ogni worker.
+ */
+#define PIPELINE_CHUNKS_PER_WORKER 2
+
+/**
+ * @brief Restituisce il numero di processori disponibili.
+ *
+ * @return Numero di processori online, almeno 1.
+ */
+size_t getProcessorCount();
+
+/**
+ * @brief Esegue una pipeline ordinata.
+ *
+ * @param context Puntatore passato a tutti gli stadi.
+ * @param workerCount Numero di thread worker (almeno 1).
+ * @param produce Stadio di produzione, eseguito sul thread chiamante.
+ * @param process Stadio di elaborazione, eseguito sui worker.
+ * @param consume Stadio di consumo, eseguito su un thread dedicato.
+ * @return true se tutti i blocchi sono stati consumati, false se uno
+ *         stadio ha interrotto la pipeline.
+ */
+bool runPipeline(void* context, size_t workerCount, PipelineProduce produce, PipelineProcess process, PipelineConsume consume);
+
+#endif // PIPELINE_H
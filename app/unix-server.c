@@ -0,0 +1,128 @@
+// accept4 is a GNU extension
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "unix-server.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+int openUnixListener(const char* path)
+{
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path))
+    return -1;
+  strcpy(address.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return -1;
+
+  unlink(path);
+  if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int acceptUnixClient(int listener)
+{
+  return accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+size_t readUnixSocket(int fd, char* buffer, size_t size, bool* closed)
+{
+  size_t total = 0;
+  while (total < size)
+  {
+    ssize_t count = read(fd, buffer + total, size - total);
+    if (count > 0)
+    {
+      total += (size_t)count;
+      continue;
+    }
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+      *closed = true;
+    break;
+  }
+  return total;
+}
+
+size_t writeUnixSocket(int fd, const char* data, size_t size, bool* closed)
+{
+  size_t total = 0;
+  while (total < size)
+  {
+    // MSG_NOSIGNAL turns a closed peer into EPIPE instead of SIGPIPE
+    ssize_t count = send(fd, data + total, size - total, MSG_NOSIGNAL);
+    if (count > 0)
+    {
+      total += (size_t)count;
+      continue;
+    }
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+      *closed = true;
+    break;
+  }
+  return total;
+}
+
+void closeDescriptor(int fd)
+{
+  close(fd);
+}
+
+static volatile sig_atomic_t stopRequested = 0;
+static struct sigaction oldInterruptAction;
+static struct sigaction oldTerminateAction;
+
+static void requestStop(int signal)
+{
+  (void)signal;
+  stopRequested = 1;
+}
+
+void watchStopSignals()
+{
+  // Without SA_RESTART the signal makes blocking calls return EINTR
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = requestStop;
+  sigemptyset(&action.sa_mask);
+
+  stopRequested = 0;
+  sigaction(SIGINT, &action, &oldInterruptAction);
+  sigaction(SIGTERM, &action, &oldTerminateAction);
+}
+
+bool isStopRequested()
+{
+  return stopRequested != 0;
+}
+
+void restoreStopSignals()
+{
+  sigaction(SIGINT, &oldInterruptAction, NULL);
+  sigaction(SIGTERM, &oldTerminateAction, NULL);
+}
+
+void blockStopSignals(bool blocked)
+{
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(blocked ? SIG_BLOCK : SIG_UNBLOCK, &signals, NULL);
+}
@@ -0,0 +1,92 @@
+/**
+ * @file unix-server.h
+ * @brief Socket di dominio Unix non bloccanti e segnali di chiusura.
+ *
+ * Le funzioni che richiedono unistd.h (incluso anche da signal.h) stanno
+ * in un file a parte, perché unistd.h non può essere incluso insieme a
+ * utils.h (per pause()).
+ */
+
+#ifndef UNIX_SERVER_H
+#define UNIX_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Crea un socket in ascolto su un percorso.
+ *
+ * Un file già presente sul percorso (per esempio lasciato da un server
+ * terminato male) viene rimosso.
+ *
+ * @param path Percorso del socket.
+ * @return Descrittore del socket non bloccante, -1 in caso di errore.
+ */
+int openUnixListener(const char* path);
+
+/**
+ * @brief Accetta un client in attesa.
+ *
+ * @param listener Descrittore del socket in ascolto.
+ * @return Descrittore non bloccante del client, -1 se non ci sono client.
+ */
+int acceptUnixClient(int listener);
+
+/**
+ * @brief Legge i byte disponibili da un socket.
+ *
+ * @param fd Descrittore del socket.
+ * @param buffer Buffer di destinazione.
+ * @param size Dimensione del buffer.
+ * @param closed Impostato a true se il client ha chiuso la connessione o
+ *               c'è stato un errore.
+ * @return Numero di byte letti (0 se per ora non ce ne sono altri).
+ */
+size_t readUnixSocket(int fd, char* buffer, size_t size, bool* closed);
+
+/**
+ * @brief Scrive quanti più byte possibile su un socket.
+ *
+ * @param fd Descrittore del socket.
+ * @param data Dati da scrivere.
+ * @param size Numero di byte da scrivere.
+ * @param closed Impostato a true se la connessione non è più utilizzabile.
+ * @return Numero di byte scritti.
+ */
+size_t writeUnixSocket(int fd, const char* data, size_t size, bool* closed);
+
+/**
+ * @brief Chiude un descrittore.
+ */
+void closeDescriptor(int fd);
+
+/**
+ * @brief Installa un gestore di SIGINT e SIGTERM che registra la richiesta
+ *        di chiusura invece di terminare il processo.
+ *
+ * I segnali interrompono le attese (per esempio epoll_wait) del thread
+ * che li riceve.
+ */
+void watchStopSignals();
+
+/**
+ * @brief Indica se è arrivato SIGINT o SIGTERM dopo watchStopSignals.
+ */
+bool isStopRequested();
+
+/**
+ * @brief Ripristina i gestori di SIGINT e SIGTERM precedenti a
+ *        watchStopSignals.
+ */
+void restoreStopSignals();
+
+/**
+ * @brief Blocca o sblocca SIGINT e SIGTERM per il thread chiamante.
+ *
+ * I thread creati mentre i segnali sono bloccati non li ricevono mai.
+ *
+ * @param blocked true per bloccare i segnali.
+ */
+void blockStopSignals(bool blocked);
+
+#endif // UNIX_SERVER_H
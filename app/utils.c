@@ -1,5 +1,4 @@
 #include "utils.h"
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -59,23 +58,255 @@ void pause()
   free(temp);
 }
 
+void initBuffer(Buffer* buffer, size_t capacity)
+{
+  buffer->data = capacity > 0 ? (char*)malloc(capacity) : NULL;
+  buffer->size = 0;
+  buffer->capacity = buffer->data ? capacity : 0;
+}
+
+void reserveBuffer(Buffer* buffer, size_t capacity)
+{
+  if (capacity <= buffer->capacity)
+    return;
+
+  size_t newCapacity = buffer->capacity > 0 ? buffer->capacity : 64;
+  while (newCapacity < capacity)
+    newCapacity *= 2;
+
+  buffer->data = (char*)realloc(buffer->data, newCapacity);
+  buffer->capacity = newCapacity;
+}
+
+void appendBuffer(Buffer* buffer, const void* data, size_t size)
+{
+  reserveBuffer(buffer, buffer->size + size);
+  memcpy(buffer->data + buffer->size, data, size);
+  buffer->size += size;
+}
+
+void clearBuffer(Buffer* buffer)
+{
+  buffer->size = 0;
+}
+
+void freeBuffer(Buffer* buffer)
+{
+  free(buffer->data);
+  buffer->data = NULL;
+  buffer->size = 0;
+  buffer->capacity = 0;
+}
+
+size_t formatSize_t(char* dst, size_t n)
+{
+  char digits[20];
+  size_t length = 0;
+  do
+  {
+    digits[length++] = (char)('0' + n % 10);
+    n /= 10;
+  } while (n > 0);
+
+  for (size_t i = 0; i < length; i++)
+    dst[i] = digits[length - 1 - i];
+  return length;
+}
+
+size_t formatInt(char* dst, int n)
+{
+  if (n >= 0)
+    return formatSize_t(dst, (size_t)n);
+
+  // Negate as unsigned so INT_MIN doesn't overflow
+  unsigned int magnitude = 0u - (unsigned int)n;
+  dst[0] = '-';
+  return 1 + formatSize_t(dst + 1, magnitude);
+}
+
+void appendSize_tToBuffer(Buffer* buffer, size_t n)
+{
+  reserveBuffer(buffer, buffer->size + 20);
+  buffer->size += formatSize_t(buffer->data + buffer->size, n);
+}
+
+void appendIntToBuffer(Buffer* buffer, int n)
+{
+  reserveBuffer(buffer, buffer->size + 11);
+  buffer->size += formatInt(buffer->data + buffer->size, n);
+}
+
+void appendStringToBuffer(Buffer* buffer, const char* str)
+{
+  appendBuffer(buffer, str, strlen(str));
+}
+
+void appendJsonStringToBuffer(Buffer* buffer, const char* str)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  appendBuffer(buffer, "\"", 1);
+
+  const char* run = str;
+  for (const char* p = str; *p != '\0'; p++)
+  {
+    unsigned char c = (unsigned char)*p;
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    // Copy the unescaped run in one go before writing the escape sequence
+    appendBuffer(buffer, run, p - run);
+    run = p + 1;
+
+    char escape[6] = {'\\', 0, 0, 0, 0, 0};
+    size_t length = 2;
+    switch (c)
+    {
+    case '"':
+    case '\\':
+      escape[1] = (char)c;
+      break;
+    case '\b':
+      escape[1] = 'b';
+      break;
+    case '\f':
+      escape[1] = 'f';
+      break;
+    case '\n':
+      escape[1] = 'n';
+      break;
+    case '\r':
+      escape[1] = 'r';
+      break;
+    case '\t':
+      escape[1] = 't';
+      break;
+    default:
+      escape[1] = 'u';
+      escape[2] = '0';
+      escape[3] = '0';
+      escape[4] = hex[c >> 4];
+      escape[5] = hex[c & 0xF];
+      length = 6;
+      break;
+    }
+    appendBuffer(buffer, escape, length);
+  }
+  appendStringToBuffer(buffer, run);
+
+  appendBuffer(buffer, "\"", 1);
+}
+
+bool flushBuffer(Buffer* buffer, FILE* fp)
+{
+  size_t written = fwrite(buffer->data, sizeof(char), buffer->size, fp);
+  bool success = written == buffer->size;
+  clearBuffer(buffer);
+  return success;
+}
+
+size_t encodeVarint(char* dst, uint64_t value)
+{
+  size_t length = 0;
+  while (value >= 0x80)
+  {
+    dst[length++] = (char)((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  dst[length++] = (char)value;
+  return length;
+}
+
+size_t decodeVarint(const char* src, size_t size, uint64_t* value)
+{
+  uint64_t result = 0;
+  for (size_t i = 0; i < size && i < VARINT_MAX_SIZE; i++)
+  {
+    unsigned char byte = (unsigned char)src[i];
+    result |= (uint64_t)(byte & 0x7f) << (7 * i);
+    if (!(byte & 0x80))
+    {
+      *value = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+void appendVarintToBuffer(Buffer* buffer, uint64_t value)
+{
+  reserveBuffer(buffer, buffer->size + VARINT_MAX_SIZE);
+  buffer->size += encodeVarint(buffer->data + buffer->size, value);
+}
+
+uint64_t zigzagEncode(int64_t value)
+{
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+int64_t zigzagDecode(uint64_t value)
+{
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+uint32_t updateCrc32(uint32_t crc, const void* data, size_t size)
+{
+  // Slicing-by-8: table[k][b] is the CRC of byte b followed by k zero bytes,
+  // so eight bytes are folded in with eight lookups
+  static uint32_t table[8][256];
+  static bool tableReady = false;
+  if (!tableReady)
+  {
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      uint32_t value = i;
+      for (int bit = 0; bit < 8; bit++)
+        value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+      table[0][i] = value;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      for (int k = 1; k < 8; k++)
+        table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+    }
+    tableReady = true;
+  }
+
+  const unsigned char* bytes = (const unsigned char*)data;
+  crc = ~crc;
+  while (size >= 8)
+  {
+    uint32_t low;
+    uint32_t high;
+    memcpy(&low, bytes, sizeof(uint32_t));
+    memcpy(&high, bytes + 4, sizeof(uint32_t));
+    low ^= crc;
+    crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^ table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+          table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^ table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+    bytes += 8;
+    size -= 8;
+  }
+  while (size-- > 0)
+    crc = table[0][(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
 char* size_tToString(const size_t n)
 {
-  // Get how many digits using log10 and add 1 for '\0'
-  // If n is 0 then length is 2 because there's no log10 of 0
-  const size_t length = n == 0 ? 2 : ceil(log10(n)) + (n == 0 ? 2 : 1);
-  char* str = (char*)malloc(length);
-  sprintf(str, "%ld", n);
+  char digits[20];
+  const size_t length = formatSize_t(digits, n);
+  char* str = (char*)malloc(length + 1);
+  memcpy(str, digits, length);
+  str[length] = '\0';
   return str;
 }
 
 char* intToString(const int n)
 {
-  // Get how many digits using log10 and add 1 for '\0'
-  // Add another 1 if negative for '-'
-  // If n is 0 then length is 2 because there's no log10 of 0
-  const size_t length = n == 0 ? 2 : ceil(log10(abs(n))) + (n < 0 ? 2 : 1);
-  char* str = (char*)malloc(length);
-  sprintf(str, "%d", n);
+  char digits[11];
+  const size_t length = formatInt(digits, n);
+  char* str = (char*)malloc(length + 1);
+  memcpy(str, digits, length);
+  str[length] = '\0';
   return str;
 }
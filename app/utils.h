@@ -1,7 +1,10 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 /**
  * @brief Legge una riga di input dallo standard input (stdin) fino a
@@ -60,6 +63,171 @@ void clearScreen();
  */
 void pause();
 
+/**
+ * @struct Buffer
+ * @brief Buffer di byte a crescita dinamica.
+ *
+ * @var data
+ * Puntatore ai byte memorizzati.
+ * @var size
+ * Numero di byte utilizzati.
+ * @var capacity
+ * Numero di byte allocati.
+ */
+typedef struct Buffer
+{
+  char* data;
+  size_t size;
+  size_t capacity;
+} Buffer;
+
+/**
+ * @brief Inizializza un buffer vuoto con una capacità iniziale.
+ *
+ * @param buffer Puntatore al buffer da inizializzare.
+ * @param capacity Capacità iniziale in byte (può essere 0).
+ */
+void initBuffer(Buffer* buffer, size_t capacity);
+
+/**
+ * @brief Garantisce che il buffer possa contenere almeno `capacity` byte.
+ *
+ * La capacità viene raddoppiata finché non è sufficiente, quindi il
+ * costo di accodamenti ripetuti è ammortizzato.
+ *
+ * @param buffer Puntatore al buffer.
+ * @param capacity Capacità minima richiesta in byte.
+ */
+void reserveBuffer(Buffer* buffer, size_t capacity);
+
+/**
+ * @brief Accoda dei byte alla fine del buffer.
+ *
+ * @param buffer Puntatore al buffer.
+ * @param data Byte da accodare.
+ * @param size Numero di byte da accodare.
+ */
+void appendBuffer(Buffer* buffer, const void* data, size_t size);
+
+/**
+ * @brief Svuota il buffer senza liberare la memoria allocata.
+ *
+ * @param buffer Puntatore al buffer.
+ */
+void clearBuffer(Buffer* buffer);
+
+/**
+ * @brief Libera la memoria allocata per il buffer.
+ *
+ * @param buffer Puntatore al buffer.
+ */
+void freeBuffer(Buffer* buffer);
+
+/**
+ * @brief Scrive un size_t in base 10 senza terminatore.
+ *
+ * @param dst Destinazione, deve contenere almeno 20 caratteri.
+ * @param n Numero da scrivere.
+ * @return Numero di caratteri scritti.
+ */
+size_t formatSize_t(char* dst, size_t n);
+
+/**
+ * @brief Scrive un int in base 10 senza terminatore.
+ *
+ * @param dst Destinazione, deve contenere almeno 11 caratteri.
+ * @param n Numero da scrivere.
+ * @return Numero di caratteri scritti.
+ */
+size_t formatInt(char* dst, int n);
+
+/**
+ * @brief Accoda un size_t in base 10 al buffer.
+ */
+void appendSize_tToBuffer(Buffer* buffer, size_t n);
+
+/**
+ * @brief Accoda un int in base 10 al buffer.
+ */
+void appendIntToBuffer(Buffer* buffer, int n);
+
+/**
+ * @brief Accoda una stringa C al buffer (senza il '\0').
+ */
+void appendStringToBuffer(Buffer* buffer, const char* str);
+
+/**
+ * @brief Accoda una stringa JSON, virgolette comprese, al buffer.
+ *
+ * Virgolette, backslash e caratteri di controllo vengono trasformati
+ * nelle rispettive sequenze di escape.
+ *
+ * @param buffer Puntatore al buffer.
+ * @param str Stringa da accodare.
+ */
+void appendJsonStringToBuffer(Buffer* buffer, const char* str);
+
+/**
+ * @brief Scrive il contenuto del buffer su file e lo svuota.
+ *
+ * @param buffer Puntatore al buffer.
+ * @param fp File di destinazione.
+ * @return true se tutti i byte sono stati scritti.
+ */
+bool flushBuffer(Buffer* buffer, FILE* fp);
+
+/**
+ * @brief Numero massimo di byte di un intero a 64 bit codificato come varint.
+ */
+#define VARINT_MAX_SIZE 10
+
+/**
+ * @brief Scrive un intero senza segno come varint (7 bit per byte, il bit
+ *        più alto indica che segue un altro byte).
+ *
+ * @param dst Destinazione, deve contenere almeno VARINT_MAX_SIZE byte.
+ * @param value Valore da scrivere.
+ * @return Numero di byte scritti.
+ */
+size_t encodeVarint(char* dst, uint64_t value);
+
+/**
+ * @brief Legge un varint scritto con encodeVarint.
+ *
+ * @param src Byte da leggere.
+ * @param size Numero di byte disponibili.
+ * @param value Valore letto.
+ * @return Numero di byte letti, 0 se il varint è troncato o non valido.
+ */
+size_t decodeVarint(const char* src, size_t size, uint64_t* value);
+
+/**
+ * @brief Accoda un varint al buffer.
+ */
+void appendVarintToBuffer(Buffer* buffer, uint64_t value);
+
+/**
+ * @brief Trasforma un intero con segno in uno senza segno vicino allo zero
+ *        (0, -1, 1, -2, ... diventano 0, 1, 2, 3, ...), così i valori
+ *        negativi piccoli restano varint corti.
+ */
+uint64_t zigzagEncode(int64_t value);
+
+/**
+ * @brief Inverso di zigzagEncode.
+ */
+int64_t zigzagDecode(uint64_t value);
+
+/**
+ * @brief Aggiorna un CRC-32 (lo stesso di zlib e PNG) con altri byte.
+ *
+ * @param crc CRC dei byte precedenti, 0 all'inizio.
+ * @param data Byte da aggiungere.
+ * @param size Numero di byte.
+ * @return CRC di tutti i byte.
+ */
+uint32_t updateCrc32(uint32_t crc, const void* data, size_t size);
+
 char* size_tToString(const size_t n);
 
 char* intToString(const int n);
@@ -0,0 +1,97 @@
+/**
+ * Microbenchmark della crescita dei vettori del parser JSON (vec_alloc).
+ *
+ * Confronta vec_alloc con la versione precedente, che ricalcolava la
+ * capacità con pow/floor/log2 e chiamava realloc a ogni inserimento. Con un
+ * file JSON come argomento misura anche lex e parse sul file.
+ *
+ * Compilazione ed esecuzione dalla radice del repository:
+ *
+ *   gcc -O2 -Iapp bench/vec-alloc.c app/json-parser.c -o vec-alloc -lm
+ *   ./vec-alloc [file.json]
+ */
+
+#include "json-parser.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PUSH_COUNT 10000000
+
+double getSeconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// vec_alloc before the geometric growth, kept only for comparison
+void* legacyVecAlloc(void* vec, size_t* cap, const size_t size, const size_t elemSize)
+{
+  if (size == 0 || elemSize == 0)
+    return vec;
+  *cap = pow(2, floor(log2(size)) + 1);
+  void* newVec = realloc(vec, *cap * elemSize);
+  if (newVec == NULL)
+    free(vec);
+  return newVec;
+}
+
+double benchPushes(void* (*alloc)(void*, size_t*, const size_t, const size_t))
+{
+  Token* tokens = NULL;
+  size_t capacity = 0;
+
+  double start = getSeconds();
+  for (size_t size = 1; size <= PUSH_COUNT; size++)
+  {
+    tokens = (Token*)alloc(tokens, &capacity, size, sizeof(Token));
+    tokens[size - 1].type = NULL_LEX;
+  }
+  double elapsed = getSeconds() - start;
+
+  free(tokens);
+  return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+  printf("%d inserimenti di un Token:\n", PUSH_COUNT);
+  printf("  precedente: %.3f s\n", benchPushes(legacyVecAlloc));
+  printf("  vec_alloc:  %.3f s\n", benchPushes(vec_alloc));
+
+  if (argc < 2)
+    return 0;
+
+  FILE* jsonFile = fopen(argv[1], "r");
+  if (!jsonFile)
+  {
+    printf("Errore: Non riesce aprire il file JSON '%s'\n", argv[1]);
+    return 1;
+  }
+
+  LexError lexError;
+  double start = getSeconds();
+  TokenManager* manager = lex(jsonFile, &lexError);
+  double lexed = getSeconds();
+  if (!manager)
+  {
+    fclose(jsonFile);
+    return 1;
+  }
+
+  ParserError parserError;
+  JsonNode* root = parse(jsonFile, manager, &parserError);
+  double parsed = getSeconds();
+
+  printf("File '%s' (%zu token):\n", argv[1], manager->size);
+  printf("  lex:   %.3f s\n", lexed - start);
+  printf("  parse: %.3f s\n", parsed - lexed);
+
+  if (root)
+    freeJsonTree(root);
+  deleteTokenManager(manager);
+  fclose(jsonFile);
+  return 0;
+}
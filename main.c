@@ -11,9 +11,61 @@
  * - Aggiornare una persona esistente.
  * - Salvare il db a un file JSON.
  * - Caricare il db da un file JSON.
+ * - Salvare il db a un file NDJSON (una persona per riga).
+ * - Caricare il db da un file NDJSON.
+ * - Aggiungere al db le nuove righe di un file NDJSON, riprendendo dalla
+ *   prima riga non ancora importata.
+ * - Leggere i metadati di un file JSON senza caricarlo.
+ * - Convertire il db in una tabella a record fissi.
+ * - Convertire il db in formato colonnare per le analisi.
+ * - Calcolare statistiche sulle età e sui nomi.
+ * - Visualizzare le persone ordinate o solo le prime K.
+ * - Consultare e ridimensionare il filtro di Bloom usato dalle ricerche.
+ * - Trovare le persone per nome tramite il dizionario dei nomi.
+ * - Salvare il db a un file JSON compresso (caricabile con l'opzione JSON).
+ * - Creare una copia compressa del db o ripristinare il db da essa.
+ * - Salvare e ripristinare uno snapshot binario del db e dei file derivati.
+ * - Esportare in NDJSON solo le modifiche successive a un LSN del registro.
+ *
+ * Con `--replica <registro> [db]` il programma diventa una replica in sola
+ * lettura: applica di continuo il registro delle modifiche di un altro
+ * processo al proprio db e risponde alle ricerche.
+ *
+ * Con `--batch [file]` il programma esegue senza menu i comandi letti dal
+ * file (o dallo standard input) e scrive le risposte in NDJSON; i comandi
+ * sono descritti in app/person-command.h.
+ *
+ * Con `--serve [socket]` il programma diventa un server che accetta gli
+ * stessi comandi da più client locali su un socket di dominio Unix.
+ *
+ * Con `--shards [N]` il programma lavora sul db partizionato per ID in N
+ * file; se il manifesto delle partizioni non esiste, le partizioni vengono
+ * create dividendo il db attuale. Da quel momento le altre modalità
+ * rifiutano di partire, perché il db non partizionato non riceve più le
+ * modifiche.
+ *
+ * `--direct` può precedere tutte le altre opzioni: le scansioni del db
+ * leggono il file con O_DIRECT e usano una cache del processo di
+ * dimensione fissa invece della cache del kernel.
  */
+#include "app/compress.h"
 #include "app/json-parser.h"
+#include "app/person-aggregate.h"
+#include "app/person-bloom.h"
+#include "app/person-command.h"
+#include "app/person-columns.h"
+#include "app/person-compress.h"
+#include "app/person-dict.h"
+#include "app/person-log.h"
+#include "app/person-replica.h"
+#include "app/person-scan.h"
+#include "app/person-server.h"
+#include "app/person-shard.h"
+#include "app/person-snapshot.h"
+#include "app/person-sort.h"
+#include "app/person-table.h"
 #include "app/person.h"
+#include "app/pipeline.h"
 #include "app/utils.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -39,6 +91,64 @@ void printMenu();
  */
 int getValidAge();
 
+/**
+ * @brief Elimina i file derivati dal db (file colonnare, dizionario dei nomi
+ *        e tabella a record fissi).
+ *
+ * Va chiamata dopo ogni modifica del db, così le analisi successive
+ * ricreano i file invece di leggere dati vecchi.
+ */
+void invalidateDerivedFiles();
+
+/**
+ * @brief Numero di modifiche del db fatte da questo processo, aumentato da
+ *        invalidateDerivedFiles.
+ */
+size_t derivedFilesVersion = 0;
+
+/**
+ * @brief Esegue i comandi di un file senza menu.
+ *
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Metadati del database.
+ * @param bloom Filtro di Bloom del database.
+ * @param changeLog Registro delle modifiche.
+ * @param filename File dei comandi, NULL o "-" per lo standard input.
+ * @return Codice di uscita del programma.
+ */
+int runBatch(FILE** fpPtr, PersonMeta* meta, PersonBloom* bloom, PersonLog* changeLog, const char* filename);
+
+/**
+ * @brief Esegue il programma come server su un socket di dominio Unix.
+ *
+ * @param fpPtr Puntatore al puntatore del file del database.
+ * @param meta Metadati del database.
+ * @param bloom Filtro di Bloom del database.
+ * @param changeLog Registro delle modifiche.
+ * @param path Percorso del socket.
+ * @return Codice di uscita del programma.
+ */
+int runServer(FILE** fpPtr, PersonMeta* meta, PersonBloom* bloom, PersonLog* changeLog, const char* path);
+
+/**
+ * @brief Esegue il programma come replica in sola lettura.
+ *
+ * @param logFilename Registro delle modifiche del db principale.
+ * @param dbFilename File del db della replica.
+ * @return Codice di uscita del programma.
+ */
+int runReplica(const char* logFilename, const char* dbFilename);
+
+/**
+ * @brief Esegue il programma sul db partizionato.
+ *
+ * @param shardCount Numero di partizioni da creare se non esistono, 0 per
+ *                   il numero predefinito; se esistono già deve essere 0
+ *                   o uguale al loro numero.
+ * @return Codice di uscita del programma.
+ */
+int runShards(size_t shardCount);
+
 typedef enum MenuOption
 {
   NO_CHOSEN_OPTION = 0,
@@ -49,13 +159,80 @@ typedef enum MenuOption
   UPDATE_PERSON_OPTION,
   SAVE_TO_JSON_OPTION,
   LOAD_JSON_OPTION,
+  SAVE_TO_NDJSON_OPTION,
+  LOAD_NDJSON_OPTION,
+  APPEND_NDJSON_OPTION,
+  INSPECT_JSON_OPTION,
+  BUILD_TABLE_OPTION,
+  BUILD_COLUMNS_OPTION,
+  AGGREGATE_OPTION,
+  LIST_SORTED_OPTION,
+  BLOOM_INFO_OPTION,
+  FIND_BY_NAME_OPTION,
+  SAVE_TO_COMPRESSED_JSON_OPTION,
+  COMPRESSED_DB_OPTION,
+  SNAPSHOT_OPTION,
+  EXPORT_CHANGES_OPTION,
   EXIT_OPTION,
 } MenuOption;
 
-int main()
+typedef enum ReplicaMenuOption
+{
+  REPLICA_FIND_PERSON_OPTION = 1,
+  REPLICA_LIST_PEOPLE_OPTION,
+  REPLICA_STATUS_OPTION,
+  REPLICA_EXIT_OPTION,
+} ReplicaMenuOption;
+
+typedef enum ShardMenuOption
+{
+  SHARD_CREATE_PERSON_OPTION = 1,
+  SHARD_FIND_PERSON_OPTION,
+  SHARD_LIST_PEOPLE_OPTION,
+  SHARD_DELETE_PERSON_OPTION,
+  SHARD_UPDATE_PERSON_OPTION,
+  SHARD_FIND_BY_NAME_OPTION,
+  SHARD_AGGREGATE_OPTION,
+  SHARD_SAVE_TO_NDJSON_OPTION,
+  SHARD_INFO_OPTION,
+  SHARD_EXIT_OPTION,
+} ShardMenuOption;
+
+int main(int argc, char* argv[])
 {
+  if (argc >= 2 && strcmp(argv[1], "--direct") == 0)
+  {
+    if (!setPersonDirectIo(true, PAGE_CACHE_DEFAULT_SIZE))
+    {
+      fprintf(stderr, "Errore: Non riesce allocare la cache per la lettura diretta.\n");
+      return 1;
+    }
+    argc--;
+    argv++;
+  }
+
+  if (argc >= 3 && strcmp(argv[1], "--replica") == 0)
+    return runReplica(argv[2], argc >= 4 ? argv[3] : PERSON_REPLICA_FILENAME);
+  if (argc >= 2 && strcmp(argv[1], "--shards") == 0)
+  {
+    size_t shardCount = argc >= 3 ? (size_t)strtoul(argv[2], NULL, 10) : 0;
+    if (argc >= 3 && (shardCount == 0 || shardCount > PERSON_SHARD_MAX_COUNT))
+    {
+      fprintf(stderr, "Numero di partizioni non valido: '%s' (da 1 a %d).\n", argv[2], PERSON_SHARD_MAX_COUNT);
+      return 1;
+    }
+    return runShards(shardCount);
+  }
+
+  // Once split, changes only reach the shards and the single file is left behind
+  if (hasPersonShards())
+  {
+    fprintf(stderr, "Il database è diviso in partizioni ('%s'): usare --shards.\n", PERSON_SHARD_MANIFEST_FILENAME);
+    return 1;
+  }
+
   FILE* fp = NULL;
-  PersonMeta meta = {0};
+  PersonMeta meta = {0, 0};
   fp = initPersonDB(&meta);
 
   if (!fp)
@@ -64,6 +241,46 @@ int main()
     return 1;
   }
 
+  // Lets FIND/DELETE/UPDATE answer most misses without scanning the db
+  double bloomFalsePositiveRate = PERSON_BLOOM_FALSE_POSITIVE_RATE;
+  PersonBloom bloom;
+  openPersonBloom(fp, &meta, bloomFalsePositiveRate, PERSON_BLOOM_FILENAME, &bloom);
+  bloomFalsePositiveRate = bloom.falsePositiveRate;
+
+  // Every change is logged with an LSN so exports can ship only what changed
+  PersonLog* changeLog = openPersonLog(PERSON_LOG_FILENAME, fp);
+  if (!changeLog)
+  {
+    fprintf(stderr, "Errore nell'apertura del registro delle modifiche.\n");
+    freePersonBloom(&bloom);
+    fclose(fp);
+    return 1;
+  }
+
+  if (argc >= 2 && strcmp(argv[1], "--batch") == 0)
+  {
+    int status = runBatch(&fp, &meta, &bloom, changeLog, argc >= 3 ? argv[2] : NULL);
+    closePersonLog(changeLog);
+    freePersonBloom(&bloom);
+    fclose(fp);
+    return status;
+  }
+  if (argc >= 2 && strcmp(argv[1], "--serve") == 0)
+  {
+    int status = runServer(&fp, &meta, &bloom, changeLog, argc >= 3 ? argv[2] : PERSON_SERVER_SOCKET);
+    closePersonLog(changeLog);
+    freePersonBloom(&bloom);
+    fclose(fp);
+    return status;
+  }
+
+  // Version of the db at the last search by name that had no dictionary
+  size_t dictScanVersion = (size_t)-1;
+
+  // Position reached in the last NDJSON file appended, to resume from there
+  char* appendFilename = NULL;
+  size_t appendOffset = 0;
+
   int choice;
   do
   {
@@ -84,6 +301,12 @@ int main()
 
       Person person = {0, age, name};
       insertPerson(fp, &person, &meta);
+      logPersonInsert(changeLog, &person, &meta);
+      invalidateDerivedFiles();
+      addPersonToBloom(&bloom, &person);
+      growPersonBloom(fp, &bloom);
+      bloom.meta = meta;
+      savePersonBloom(&bloom, PERSON_BLOOM_FILENAME);
       free(name);
       printf("\nPersona aggiunta con successo!\n");
 
@@ -96,7 +319,7 @@ int main()
       size_t id = (size_t)getint();
       printf("\n");
 
-      Person* person = findPersonById(fp, id);
+      Person* person = personBloomMayContainId(&bloom, id) ? findPersonById(fp, id) : NULL;
       if (person)
       {
         printf("Persona trovata:\nID: %zu\nNome: %s\nEt\u00e0: %d\n", person->id, person->name, person->age);
@@ -135,8 +358,13 @@ int main()
 
       printf("\n");
 
-      if (deletePerson(&fp, &meta, id))
+      if (personBloomMayContainId(&bloom, id) && deletePerson(&fp, &meta, id))
       {
+        logPersonDelete(changeLog, id, &meta);
+        invalidateDerivedFiles();
+        // Deleted keys stay in the filter, they can only cause false positives
+        bloom.meta = meta;
+        savePersonBloom(&bloom, PERSON_BLOOM_FILENAME);
         printf("Persona eliminata con successo!\n");
       }
       else
@@ -154,7 +382,7 @@ int main()
 
       printf("\n");
 
-      Person* person = findPersonById(fp, id);
+      Person* person = personBloomMayContainId(&bloom, id) ? findPersonById(fp, id) : NULL;
       if (person)
       {
         printf("Inserisci il nuovo nome della persona (vecchio: %s): ", person->name);
@@ -164,6 +392,12 @@ int main()
 
         Person updatedPerson = {id, newAge, newName};
         updatePerson(&fp, &meta, id, &updatedPerson);
+        logPersonUpdate(changeLog, &updatedPerson, &meta);
+        invalidateDerivedFiles();
+        addPersonToBloom(&bloom, &updatedPerson);
+        growPersonBloom(fp, &bloom);
+        bloom.meta = meta;
+        savePersonBloom(&bloom, PERSON_BLOOM_FILENAME);
         free(newName);
 
         printf("\nPersona aggiornata con successo!\n");
@@ -182,7 +416,7 @@ int main()
       filename = (char*)realloc(filename, strlen(filename) + 5);
       strcat(filename, ".json");
 
-      if (personDbToJson(fp, filename))
+      if (personDbToJsonParallel(fp, filename, getProcessorCount()))
       {
 
         printf("\nFile JSON salvato!\n");
@@ -211,92 +445,992 @@ int main()
 
       free(filename);
 
-      LexError lexError;
-      TokenManager* manager = lex(jsonFile, &lexError);
-      if (lexError.type != NO_LEX_ERROR)
+      JsonStreamError streamError;
+      // Compressed exports are recognized by their header
+      PersonJsonError errorCode = isCompressedFile(jsonFile)
+                                      ? loadPersonDbFromCompressedJson(&fp, &meta, jsonFile, &streamError)
+                                      : loadPersonDbFromJsonParallel(&fp, &meta, jsonFile, getProcessorCount(), &streamError);
+      if (errorCode == INVALID_JSON_SYNTAX)
+      {
+        printJsonStreamError(&streamError);
+        remove(getPersonDbTempFilename());
+      }
+      else if (errorCode != NO_PERSON_JSON_ERROR)
+      {
+        printf("\nErrore: Non riesce caricare il file JSON, verificare che il sintasso del file sia giusto.\n");
+        remove(getPersonDbTempFilename());
+      }
+      else
+      {
+        logPersonReset(changeLog, fp);
+        invalidateDerivedFiles();
+        freePersonBloom(&bloom);
+        buildPersonBloom(fp, bloomFalsePositiveRate, &bloom);
+        savePersonBloom(&bloom, PERSON_BLOOM_FILENAME);
+        printf("\nCaricato file JSON nel DB con successo!\n");
+      }
+
+      fclose(jsonFile);
+      break;
+    }
+    case SAVE_TO_NDJSON_OPTION:
+    {
+      printf("Inserisci il nome per il file NDJSON da salvare (non aggiungere l'estensione .ndjson): ");
+      char* filename = getln();
+      filename = (char*)realloc(filename, strlen(filename) + 8);
+      strcat(filename, ".ndjson");
+
+      if (personDbToNdjson(fp, filename))
+      {
+        printf("\nFile NDJSON salvato!\n");
+      }
+      else
+      {
+        perror("\nErrore: Non riesce salvare il file NDJSON\n");
+      }
+
+      free(filename);
+      break;
+    }
+    case LOAD_NDJSON_OPTION:
+    {
+      printf("Inserisci il nome del file NDJSON da caricare: ");
+      char* filename = getln();
+
+      FILE* ndjsonFile = fopen(filename, "r");
+
+      if (!ndjsonFile)
       {
-        printLexError(&lexError);
+        printf("\nErrore: Non riesce aprire il file NDJSON '%s'\n", filename);
+        free(filename);
         break;
       }
 
-      ParserError parserError;
-      parserError.type = NO_PARSER_ERROR;
-      JsonNode* root = parse(jsonFile, manager, &parserError);
-      if (parserError.type != NO_PARSER_ERROR)
+      free(filename);
+
+      JsonStreamError streamError = {NO_LEX_ERROR, NO_PARSER_ERROR, 0, 0};
+      PersonJsonError errorCode = loadPersonDbFromNdjson(&fp, &meta, ndjsonFile, &streamError);
+      if (errorCode == INVALID_JSON_SYNTAX)
+      {
+        printJsonStreamError(&streamError);
+        remove(getPersonDbTempFilename());
+      }
+      else if (errorCode != NO_PERSON_JSON_ERROR)
+      {
+        printf("\nErrore: Non riesce caricare il file NDJSON, verificare la riga %zu.\n", streamError.lineCount);
+        remove(getPersonDbTempFilename());
+      }
+      else
+      {
+        logPersonReset(changeLog, fp);
+        invalidateDerivedFiles();
+        freePersonBloom(&bloom);
+        buildPersonBloom(fp, bloomFalsePositiveRate, &bloom);
+        savePersonBloom(&bloom, PERSON_BLOOM_FILENAME);
+        printf("\nCaricato file NDJSON nel DB con successo!\n");
+      }
+
+      fclose(ndjsonFile);
+      break;
+    }
+    case APPEND_NDJSON_OPTION:
+    {
+      printf("Inserisci il nome del file NDJSON da aggiungere: ");
+      char* filename = getln();
+
+      FILE* ndjsonFile = fopen(filename, "r");
+
+      if (!ndjsonFile)
       {
-        printParseError(&parserError);
+        printf("\nErrore: Non riesce aprire il file NDJSON '%s'\n", filename);
+        free(filename);
         break;
       }
 
-      PersonJsonError errorCode = loadPersonDbFromJson(&fp, &meta, root);
-      if (errorCode != NO_PERSON_JSON_ERROR)
+      if (!appendFilename || strcmp(appendFilename, filename) != 0)
       {
-        printf("\nErrore: Non riesce caricare il file JSON, verificare che il sintasso del file sia giusto.\n");
-        remove("people_temp.db");
+        free(appendFilename);
+        appendFilename = filename;
+        appendOffset = 0;
       }
       else
       {
-        printf("\nCaricato file JSON nel DB con successo!\n");
+        free(filename);
+      }
+
+      fseek(fp, 0, SEEK_END);
+      long appendStart = ftell(fp);
+      PersonMeta appendMeta = meta;
+      size_t previousCount = meta.count;
+      size_t startOffset = appendOffset;
+
+      JsonStreamError streamError = {NO_LEX_ERROR, NO_PARSER_ERROR, 0, 0};
+      size_t renumbered = 0;
+      PersonJsonError errorCode = appendPeopleFromNdjson(fp, &meta, ndjsonFile, &appendOffset, &renumbered, &streamError);
+
+      // Rows appended before an error stay in the db, so they are logged too
+      if (meta.count != previousCount)
+      {
+        Buffer name;
+        initBuffer(&name, 64);
+        fseek(fp, appendStart, SEEK_SET);
+        for (size_t i = previousCount; i < meta.count; i++)
+        {
+          Person person;
+          readPersonRecord(fp, &person, &name);
+          appendMeta.count++;
+          if (person.id + 1 > appendMeta.autoIncrementId)
+            appendMeta.autoIncrementId = person.id + 1;
+          logPersonInsert(changeLog, &person, &appendMeta);
+          addPersonToBloom(&bloom, &person);
+        }
+        freeBuffer(&name);
+
+        invalidateDerivedFiles();
+        growPersonBloom(fp, &bloom);
+        bloom.meta = meta;
+        savePersonBloom(&bloom, PERSON_BLOOM_FILENAME);
+      }
+
+      if (errorCode == INVALID_JSON_SYNTAX)
+        printJsonStreamError(&streamError);
+      else if (errorCode != NO_PERSON_JSON_ERROR)
+        printf("\nErrore: Non riesce aggiungere il file NDJSON, verificare la riga %zu dalla posizione %zu.\n",
+               streamError.lineCount, startOffset);
+
+      printf("\nAggiunte %zu persone, il file è stato importato fino al byte %zu.\n", meta.count - previousCount, appendOffset);
+      if (renumbered > 0)
+        printf("%zu persone avevano un ID già usato e hanno ricevuto un nuovo ID.\n", renumbered);
+
+      fclose(ndjsonFile);
+      break;
+    }
+    case INSPECT_JSON_OPTION:
+    {
+      printf("Inserisci il nome del file JSON da ispezionare: ");
+      char* filename = getln();
+
+      FILE* jsonFile = fopen(filename, "r");
+
+      if (!jsonFile)
+      {
+        printf("\nErrore: Non riesce aprire il file JSON '%s'\n", filename);
+        free(filename);
+        break;
+      }
+
+      free(filename);
+
+      PersonMeta jsonMeta;
+      if (readPersonJsonMetadata(jsonFile, &jsonMeta) != NO_PERSON_JSON_ERROR)
+      {
+        printf("\nErrore: Il file JSON non contiene metadati validi.\n");
+      }
+      else
+      {
+        printf("\nPersone nel file: %zu\n", jsonMeta.count);
+        printf("Prossimo ID: %zu\n", jsonMeta.autoIncrementId);
       }
 
-      freeJsonTree(root);
       fclose(jsonFile);
       break;
     }
-    case EXIT_OPTION:
-      printf("Arrivederci!\n");
+    case BUILD_TABLE_OPTION:
+    {
+      if (!buildPersonTable(fp, PERSON_TABLE_FILENAME, PERSON_TABLE_HEAP_FILENAME))
+      {
+        perror("Errore: Non riesce creare la tabella a record fissi");
+        break;
+      }
+
+      PersonTable* table = openPersonTable(PERSON_TABLE_FILENAME, PERSON_TABLE_HEAP_FILENAME);
+      if (!table)
+      {
+        printf("Errore: La tabella creata non \u00e8 valida.\n");
+        break;
+      }
+
+      printf("Tabella creata in '%s' con %zu record da %zu byte.\n", PERSON_TABLE_FILENAME, table->meta.count, sizeof(PersonRecord));
+      closePersonTable(table);
       break;
-    default:
-      printf("Opzione non valida. Riprova.\n");
+    }
+    case BUILD_COLUMNS_OPTION:
+    {
+      if (!buildPersonColumns(fp, PERSON_COLUMNS_FILENAME))
+      {
+        perror("Errore: Non riesce creare il file colonnare");
+        break;
+      }
+
+      PersonColumns* columns = openPersonColumns(PERSON_COLUMNS_FILENAME);
+      if (!columns)
+      {
+        printf("Errore: Il file colonnare creato non \u00e8 valido.\n");
+        break;
+      }
+
+      printf("File colonnare creato in '%s' con %zu persone in %zu blocchi.\n", PERSON_COLUMNS_FILENAME, columns->meta.count, columns->chunkCount);
+      closePersonColumns(columns);
       break;
     }
+    case AGGREGATE_OPTION:
+    {
+      printf("Statistiche sulle persone\n\n");
+      PersonAgeFilter filter;
+      printf("Inserisci l'et\u00e0 minima: ");
+      filter.minAge = getint();
+      printf("Inserisci l'et\u00e0 massima: ");
+      filter.maxAge = getint();
+      printf("\n");
 
-    if (choice != EXIT_OPTION)
+      // The columnar copy is rebuilt when it no longer matches the db
+      PersonColumns* columns = openPersonColumns(PERSON_COLUMNS_FILENAME);
+      bool current = columns && columns->meta.count == meta.count && columns->meta.autoIncrementId == meta.autoIncrementId;
+      if (columns)
+        closePersonColumns(columns);
+
+      PersonAggregate aggregate;
+      if ((current || buildPersonColumns(fp, PERSON_COLUMNS_FILENAME)) &&
+          aggregatePersonColumns(PERSON_COLUMNS_FILENAME, &filter, getProcessorCount(), &aggregate))
+      {
+        printPersonAggregate(&aggregate);
+      }
+      else
+      {
+        aggregatePersonDb(fp, &filter, &aggregate);
+        printPersonAggregate(&aggregate);
+      }
+
+      break;
+    }
+    case LIST_SORTED_OPTION:
     {
+      printf("Visualizza le persone ordinate\n\n");
+      PersonSortOrder order;
+      printf("Ordina per (1: nome, 2: et\u00e0, 3: ID): ");
+      int key = getint();
+      order.key = key == 1 ? SORT_BY_NAME : key == 2 ? SORT_BY_AGE : SORT_BY_ID;
+      printf("Ordine decrescente? (1: s\u00ec, 0: no): ");
+      order.descending = getint() == 1;
+      printf("Quante persone visualizzare? (0 per tutte): ");
+      int k = getint();
       printf("\n");
-      pause();
+
+      if (k > 0)
+      {
+        size_t count;
+        Person* people = findTopPeople(fp, &order, (size_t)k, &count);
+        printPeople(people, count);
+        freePeople(people, count);
+        free(people);
+      }
+      else if (!sortPersonDb(fp, &order, PERSON_SORT_MEMORY_BUDGET, getProcessorCount(), "people_sorted.tmp") ||
+               !printPersonRecordsFile("people_sorted.tmp"))
+      {
+        perror("Errore: Non riesce ordinare le persone");
+      }
+
+      remove("people_sorted.tmp");
+      break;
     }
-  } while (choice != EXIT_OPTION);
+    case BLOOM_INFO_OPTION:
+    {
+      printf("Filtro di Bloom\n\n");
+      printf("Chiavi (ID e nomi): %zu\n", bloom.filter.itemCount);
+      printf("Dimensione: %zu bit, %zu funzioni hash\n", bloom.filter.bitCount, bloom.filter.hashCount);
+      printf("Falsi positivi configurati: %.4f%%\n", bloom.falsePositiveRate * 100.0);
+      printf("Falsi positivi stimati: %.4f%%\n", estimateBloomFilterFalsePositiveRate(&bloom.filter) * 100.0);
 
-  fclose(fp);
-  return 0;
-}
+      printf("\nInserisci la nuova probabilit\u00e0 di falsi positivi in %% (0 per non modificarla): ");
+      double percent = getdbl();
+      if (percent > 0.0 && percent < 100.0)
+      {
+        bloomFalsePositiveRate = percent / 100.0;
+        freePersonBloom(&bloom);
+        buildPersonBloom(fp, bloomFalsePositiveRate, &bloom);
+        savePersonBloom(&bloom, PERSON_BLOOM_FILENAME);
+        printf("\nFiltro ricreato con %zu bit e %zu funzioni hash.\n", bloom.filter.bitCount, bloom.filter.hashCount);
+      }
 
-void printMenu()
-{
-  clearScreen();
-  printf("--- Menu | PeopleDB ---\n");
-  printf("1. Crea una nuova persona\n");
-  printf("2. Trova una persona per ID\n");
-  printf("3. Visualizza tutte le persone\n");
-  printf("4. Elimina una persona\n");
-  printf("5. Aggiorna una persona esistente\n");
-  printf("6. Salvare tutte le persone in JSON\n");
-  printf("7. Caricare persone da un file JSON\n");
-  printf("   (ATTENTO: Questa operazione sostituisce l'attuale db)\n");
-  printf("8. Esci\n");
-  printf("Scegli un'opzione: ");
-}
+      break;
+    }
+    case FIND_BY_NAME_OPTION:
+    {
+      printf("Trova le persone per nome\n\n");
+      printf("Inserisci il nome della persona: ");
+      char* name = getln();
+      printf("\n");
 
-int getValidAge()
-{
-  const int min = 1;
-  const int max = 999;
+      if (!personBloomMayContainName(&bloom, name))
+      {
+        printf("Nessuna persona trovata.\n");
+        free(name);
+        break;
+      }
 
-  int age;
-  do
-  {
-    age = getint();
+      PersonDict* dict = openPersonDict(PERSON_DICT_FILENAME);
+      if (dict && (dict->meta.count != meta.count || dict->meta.autoIncrementId != meta.autoIncrementId))
+      {
+        closePersonDict(dict);
+        dict = NULL;
+      }
 
-    if (age < min || age > max)
-    {
-      printf("L'et\u00e0 deve essere tra %d e %d. Riprova.\n", min, max);
+      // Building the dictionary costs about three scans of the db, so right
+      // after a change a single scan answers instead; the dictionary is only
+      // rebuilt when a second search comes before the next change
+      if (!dict && dictScanVersion == derivedFilesVersion && buildPersonDict(fp, PERSON_DICT_FILENAME))
+        dict = openPersonDict(PERSON_DICT_FILENAME);
+      dictScanVersion = derivedFilesVersion;
+
+      size_t count;
+      Person* people = dict ? findPeopleInDict(dict, name, &count) : findPeopleByName(fp, name, &count);
+      if (people)
+      {
+        printPeople(people, count);
+        freePeople(people, count);
+        free(people);
+      }
+      else
+      {
+        printf("Nessuna persona trovata.\n");
+      }
+
+      if (dict)
+        closePersonDict(dict);
+      free(name);
+      break;
     }
-    else
+    case SAVE_TO_COMPRESSED_JSON_OPTION:
     {
+      printf("Inserisci il nome per il file JSON compresso da salvare (non aggiungere l'estensione .json.lz): ");
+      char* filename = getln();
+      filename = (char*)realloc(filename, strlen(filename) + 9);
+      strcat(filename, ".json.lz");
+
+      if (personDbToCompressedJson(fp, filename))
+      {
+        printf("\nFile JSON compresso salvato!\n");
+      }
+      else
+      {
+        perror("\nErrore: Non riesce salvare il file JSON compresso\n");
+      }
+
+      free(filename);
       break;
     }
-  } while (1);
+    case COMPRESSED_DB_OPTION:
+    {
+      printf("Copia compressa del db\n\n");
+      printf("1. Crea la copia compressa in '%s'\n", PERSON_COMPRESSED_FILENAME);
+      printf("2. Ripristina il db dalla copia compressa\n");
+      printf("   (ATTENTO: Questa operazione sostituisce l'attuale db)\n");
+      printf("Scegli un'opzione: ");
+      int action = getint();
+      printf("\n");
 
-  return age;
+      if (action == 1)
+      {
+        PersonMeta compressedMeta;
+        size_t compressedSize;
+        if (!compressPersonDb(fp, PERSON_COMPRESSED_FILENAME) ||
+            !readCompressedPersonDbMeta(PERSON_COMPRESSED_FILENAME, &compressedMeta, &compressedSize))
+        {
+          perror("Errore: Non riesce creare la copia compressa");
+          break;
+        }
+
+        fseek(fp, 0, SEEK_END);
+        size_t dbSize = ftell(fp);
+        printf("Copia compressa creata con %zu persone: %zu byte invece di %zu.\n", compressedMeta.count, compressedSize, dbSize);
+      }
+      else if (action == 2)
+      {
+        if (!compressedPersonDbToDb(PERSON_COMPRESSED_FILENAME, &fp, &meta))
+        {
+          printf("Errore: Non riesce ripristinare il db da '%s'.\n", PERSON_COMPRESSED_FILENAME);
+          break;
+        }
+
+        logPersonReset(changeLog, fp);
+        invalidateDerivedFiles();
+        freePersonBloom(&bloom);
+        buildPersonBloom(fp, bloomFalsePositiveRate, &bloom);
+        savePersonBloom(&bloom, PERSON_BLOOM_FILENAME);
+        printf("Ripristinate %zu persone dalla copia compressa.\n", meta.count);
+      }
+      else
+      {
+        printf("Opzione non valida.\n");
+      }
+
+      break;
+    }
+    case SNAPSHOT_OPTION:
+    {
+      // Derived files go into the snapshot as they are, so a restore doesn't rebuild them
+      const char* const derivedFilenames[] = {PERSON_BLOOM_FILENAME, PERSON_COLUMNS_FILENAME, PERSON_DICT_FILENAME};
+      const size_t derivedCount = sizeof(derivedFilenames) / sizeof(derivedFilenames[0]);
+
+      printf("Snapshot del db\n\n");
+      printf("1. Salva uno snapshot\n");
+      printf("2. Ripristina il db da uno snapshot\n");
+      printf("   (ATTENTO: Questa operazione sostituisce l'attuale db)\n");
+      printf("Scegli un'opzione: ");
+      int action = getint();
+      if (action != 1 && action != 2)
+      {
+        printf("\nOpzione non valida.\n");
+        break;
+      }
+
+      printf("Inserisci il nome dello snapshot (non aggiungere l'estensione %s): ", PERSON_SNAPSHOT_EXTENSION);
+      char* filename = getln();
+      filename = (char*)realloc(filename, strlen(filename) + strlen(PERSON_SNAPSHOT_EXTENSION) + 1);
+      strcat(filename, PERSON_SNAPSHOT_EXTENSION);
+
+      PersonSnapshotInfo info;
+      if (action == 1)
+      {
+        if (savePersonSnapshot(fp, filename, derivedFilenames, derivedCount, &info))
+        {
+          printf("\nSnapshot salvato con %zu persone e %zu file: %zu byte (%zu non compressi).\n", info.meta.count, info.sectionCount, info.storedSize, info.rawSize);
+        }
+        else
+        {
+          perror("\nErrore: Non riesce salvare lo snapshot");
+        }
+      }
+      else if (restorePersonSnapshot(filename, &fp, &meta, derivedFilenames, derivedCount, &info))
+      {
+        // The table is not in the snapshot, so the one on disk belongs to the replaced db
+        remove(PERSON_TABLE_FILENAME);
+        remove(PERSON_TABLE_HEAP_FILENAME);
+        logPersonReset(changeLog, fp);
+        freePersonBloom(&bloom);
+        openPersonBloom(fp, &meta, bloomFalsePositiveRate, PERSON_BLOOM_FILENAME, &bloom);
+        bloomFalsePositiveRate = bloom.falsePositiveRate;
+        printf("\nRipristinate %zu persone e %zu file dallo snapshot.\n", meta.count, info.sectionCount);
+      }
+      else
+      {
+        printf("\nErrore: Lo snapshot '%s' manca, non \u00e8 valido o \u00e8 danneggiato.\n", filename);
+      }
+
+      free(filename);
+      break;
+    }
+    case EXPORT_CHANGES_OPTION:
+    {
+      printf("Esporta le modifiche\n\n");
+      printf("LSN nel registro: da %llu a %llu\n", (unsigned long long)changeLog->firstLsn, (unsigned long long)changeLog->lastLsn);
+      printf("Inserisci l'ultimo LSN gi\u00e0 elaborato (0 per tutte le modifiche): ");
+      char* input = getln();
+      uint64_t afterLsn = strtoull(input, NULL, 10);
+      free(input);
+
+      printf("Inserisci il nome per il file NDJSON da salvare (non aggiungere l'estensione .ndjson): ");
+      char* filename = getln();
+      filename = (char*)realloc(filename, strlen(filename) + 8);
+      strcat(filename, ".ndjson");
+
+      size_t entryCount;
+      if (exportPersonLogToNdjson(changeLog, afterLsn, filename, &entryCount))
+      {
+        printf("\nEsportate %zu modifiche. Per la prossima esportazione usare l'LSN %llu.\n", entryCount, (unsigned long long)changeLog->lastLsn);
+      }
+      else
+      {
+        perror("\nErrore: Non riesce esportare le modifiche\n");
+      }
+
+      free(filename);
+      break;
+    }
+    case EXIT_OPTION:
+      printf("Arrivederci!\n");
+      break;
+    default:
+      printf("Opzione non valida. Riprova.\n");
+      break;
+    }
+
+    if (choice != EXIT_OPTION)
+    {
+      printf("\n");
+      pause();
+    }
+  } while (choice != EXIT_OPTION);
+
+  free(appendFilename);
+  closePersonLog(changeLog);
+  freePersonBloom(&bloom);
+  fclose(fp);
+  return 0;
+}
+
+void printMenu()
+{
+  clearScreen();
+  printf("--- Menu | PeopleDB ---\n");
+  printf("1. Crea una nuova persona\n");
+  printf("2. Trova una persona per ID\n");
+  printf("3. Visualizza tutte le persone\n");
+  printf("4. Elimina una persona\n");
+  printf("5. Aggiorna una persona esistente\n");
+  printf("6. Salvare tutte le persone in JSON\n");
+  printf("7. Caricare persone da un file JSON\n");
+  printf("   (ATTENTO: Questa operazione sostituisce l'attuale db)\n");
+  printf("8. Salvare tutte le persone in NDJSON\n");
+  printf("9. Caricare persone da un file NDJSON\n");
+  printf("   (ATTENTO: Questa operazione sostituisce l'attuale db)\n");
+  printf("10. Aggiungere persone da un file NDJSON\n");
+  printf("   (riprende dalla prima riga non ancora importata dello stesso file)\n");
+  printf("11. Leggere i metadati di un file JSON\n");
+  printf("12. Convertire il db in una tabella a record fissi\n");
+  printf("13. Convertire il db in formato colonnare\n");
+  printf("14. Statistiche sulle persone\n");
+  printf("15. Visualizza le persone ordinate\n");
+  printf("16. Filtro di Bloom delle ricerche\n");
+  printf("17. Trova le persone per nome\n");
+  printf("18. Salvare tutte le persone in JSON compresso\n");
+  printf("19. Copia compressa del db\n");
+  printf("20. Snapshot binario del db\n");
+  printf("21. Esportare le modifiche da un LSN in NDJSON\n");
+  printf("22. Esci\n");
+  printf("Scegli un'opzione: ");
+}
+
+int getValidAge()
+{
+  const int min = 1;
+  const int max = 999;
+
+  int age;
+  do
+  {
+    age = getint();
+
+    if (age < min || age > max)
+    {
+      printf("L'et\u00e0 deve essere tra %d e %d. Riprova.\n", min, max);
+    }
+    else
+    {
+      break;
+    }
+  } while (1);
+
+  return age;
+}
+
+void invalidateDerivedFiles()
+{
+  derivedFilesVersion++;
+  remove(PERSON_COLUMNS_FILENAME);
+  remove(PERSON_DICT_FILENAME);
+  remove(PERSON_TABLE_FILENAME);
+  remove(PERSON_TABLE_HEAP_FILENAME);
+}
+
+int runBatch(FILE** fpPtr, PersonMeta* meta, PersonBloom* bloom, PersonLog* changeLog, const char* filename)
+{
+  FILE* input = stdin;
+  if (filename && strcmp(filename, "-") != 0)
+  {
+    input = fopen(filename, "r");
+    if (!input)
+    {
+      perror("Impossibile aprire il file dei comandi");
+      return 1;
+    }
+  }
+
+  PersonCommandContext context;
+  initPersonCommandContext(&context, fpPtr, meta, bloom, PERSON_BLOOM_FILENAME, changeLog, invalidateDerivedFiles);
+  runPersonCommands(&context, input, stdout);
+
+  if (input != stdin)
+    fclose(input);
+  return 0;
+}
+
+int runServer(FILE** fpPtr, PersonMeta* meta, PersonBloom* bloom, PersonLog* changeLog, const char* path)
+{
+  PersonCommandContext context;
+  initPersonCommandContext(&context, fpPtr, meta, bloom, PERSON_BLOOM_FILENAME, changeLog, invalidateDerivedFiles);
+
+  fprintf(stderr, "Server in ascolto su '%s' (Ctrl+C per chiudere).\n", path);
+  if (!runPersonServer(path, &context, getProcessorCount()))
+  {
+    perror("Impossibile avviare il server");
+    return 1;
+  }
+  return 0;
+}
+
+int runReplica(const char* logFilename, const char* dbFilename)
+{
+  if (!setPersonDbFilename(dbFilename))
+  {
+    fprintf(stderr, "Nome del database della replica non valido.\n");
+    return 1;
+  }
+
+  PersonReplica* replica = startPersonReplica(logFilename);
+  if (!replica)
+  {
+    fprintf(stderr, "Errore nell'apertura del database.\n");
+    return 1;
+  }
+
+  int choice;
+  do
+  {
+    clearScreen();
+    printf("--- Menu | PeopleDB (replica di '%s') ---\n", logFilename);
+    printf("1. Trova una persona per ID\n");
+    printf("2. Visualizza tutte le persone\n");
+    printf("3. Stato della replica\n");
+    printf("4. Esci\n");
+    printf("Scegli un'opzione: ");
+    choice = getint();
+
+    clearScreen();
+
+    switch (choice)
+    {
+    case REPLICA_FIND_PERSON_OPTION:
+    {
+      printf("Trova una persona per ID\n\n");
+      printf("Inserisci l'ID della persona: ");
+      size_t id = (size_t)getint();
+      printf("\n");
+
+      // The apply thread holds the mutex while it writes to the db
+      pthread_mutex_lock(&replica->mutex);
+      Person* person = findPersonById(replica->fp, id);
+      pthread_mutex_unlock(&replica->mutex);
+
+      if (person)
+      {
+        printf("Persona trovata:\nID: %zu\nNome: %s\nEt\u00e0: %d\n", person->id, person->name, person->age);
+        freePerson(person);
+        free(person);
+      }
+      else
+      {
+        printf("Persona non trovata.\n");
+      }
+
+      break;
+    }
+    case REPLICA_LIST_PEOPLE_OPTION:
+    {
+      printf("Visualizza tutte le persone\n\n");
+      pthread_mutex_lock(&replica->mutex);
+      size_t count = replica->meta.count;
+      Person* people = readPeople(replica->fp);
+      pthread_mutex_unlock(&replica->mutex);
+
+      if (count > 0)
+      {
+        printPeople(people, count);
+        freePeople(people, count);
+        free(people);
+      }
+      else
+      {
+        printf("Nessuna persona trovata.\n");
+      }
+
+      break;
+    }
+    case REPLICA_STATUS_OPTION:
+    {
+      pthread_mutex_lock(&replica->mutex);
+      pollPersonReplica(replica);
+      printf("Stato della replica\n\n");
+      printf("Registro: %s\n", replica->logFilename);
+      printf("Database: %s\n", getPersonDbFilename());
+      printf("Ultimo LSN applicato: %llu\n", (unsigned long long)replica->appliedLsn);
+      printf("Persone: %zu\n", replica->meta.count);
+      printf("Prossimo ID: %zu\n", replica->meta.autoIncrementId);
+      pthread_mutex_unlock(&replica->mutex);
+      break;
+    }
+    case REPLICA_EXIT_OPTION:
+      printf("Arrivederci!\n");
+      break;
+    default:
+      printf("Opzione non valida. Riprova.\n");
+      break;
+    }
+
+    if (choice != REPLICA_EXIT_OPTION)
+    {
+      printf("\n");
+      pause();
+    }
+  } while (choice != REPLICA_EXIT_OPTION);
+
+  stopPersonReplica(replica);
+  return 0;
+}
+
+int runShards(size_t shardCount)
+{
+  PersonShardSet* set = openPersonShards();
+  if (!set && hasPersonShards())
+  {
+    // Splitting again would overwrite the shards with the old single file
+    fprintf(stderr, "Errore nell'apertura delle partizioni elencate in '%s'.\n", PERSON_SHARD_MANIFEST_FILENAME);
+    return 1;
+  }
+  if (set && shardCount != 0 && shardCount != set->shardCount)
+  {
+    fprintf(stderr, "Il database è già diviso in %zu partizioni, non in %zu.\n", set->shardCount, shardCount);
+    closePersonShards(set);
+    return 1;
+  }
+  if (!set)
+  {
+    if (shardCount == 0)
+      shardCount = PERSON_SHARD_DEFAULT_COUNT;
+
+    PersonMeta meta;
+    FILE* fp = initPersonDB(&meta);
+    if (!fp)
+      return 1;
+
+    bool split = splitPersonDb(fp, shardCount);
+    fclose(fp);
+    if (!split)
+    {
+      fprintf(stderr, "Impossibile dividere il database in %zu partizioni.\n", shardCount);
+      return 1;
+    }
+
+    set = openPersonShards();
+    if (!set)
+    {
+      fprintf(stderr, "Errore nell'apertura delle partizioni.\n");
+      return 1;
+    }
+  }
+
+  int choice;
+  do
+  {
+    clearScreen();
+    printf("--- Menu | PeopleDB (%zu partizioni) ---\n", set->shardCount);
+    printf("1. Crea una nuova persona\n");
+    printf("2. Trova una persona per ID\n");
+    printf("3. Visualizza tutte le persone\n");
+    printf("4. Elimina una persona\n");
+    printf("5. Aggiorna una persona esistente\n");
+    printf("6. Trova le persone per nome\n");
+    printf("7. Statistiche sulle persone\n");
+    printf("8. Salvare tutte le persone in NDJSON\n");
+    printf("9. Informazioni sulle partizioni\n");
+    printf("10. Esci\n");
+    printf("Scegli un'opzione: ");
+    choice = getint();
+
+    clearScreen();
+
+    switch (choice)
+    {
+    case SHARD_CREATE_PERSON_OPTION:
+    {
+      printf("Crea una nuova persona\n\n");
+      printf("Inserisci il nome della persona: ");
+      char* name = getln();
+      printf("Inserisci l'et\u00e0 della persona: ");
+      int age = getValidAge();
+
+      Person person = {0, age, name};
+      insertShardedPerson(set, &person);
+      free(name);
+      printf("\nPersona aggiunta con successo!\n");
+
+      break;
+    }
+    case SHARD_FIND_PERSON_OPTION:
+    {
+      printf("Trova una persona per ID\n\n");
+      printf("Inserisci l'ID della persona: ");
+      size_t id = (size_t)getint();
+      printf("\n");
+
+      Person* person = findShardedPersonById(set, id);
+      if (person)
+      {
+        printf("Persona trovata:\nID: %zu\nNome: %s\nEt\u00e0: %d\n", person->id, person->name, person->age);
+        freePerson(person);
+        free(person);
+      }
+      else
+      {
+        printf("Persona non trovata.\n");
+      }
+
+      break;
+    }
+    case SHARD_LIST_PEOPLE_OPTION:
+    {
+      printf("Visualizza tutte le persone\n\n");
+      size_t count;
+      Person* people = readShardedPeople(set, &count);
+      if (count > 0)
+      {
+        printPeople(people, count);
+        freePeople(people, count);
+      }
+      else
+      {
+        printf("Nessuna persona trovata.\n");
+      }
+      free(people);
+
+      break;
+    }
+    case SHARD_DELETE_PERSON_OPTION:
+    {
+      printf("Elimina una persona\n\n");
+      printf("Inserisci l'ID della persona da eliminare: ");
+      size_t id = (size_t)getint();
+
+      printf("\n");
+
+      if (deleteShardedPerson(set, id))
+      {
+        printf("Persona eliminata con successo!\n");
+      }
+      else
+      {
+        printf("Persona non trovata.\n");
+      }
+
+      break;
+    }
+    case SHARD_UPDATE_PERSON_OPTION:
+    {
+      printf("Aggiorna una persona esistente\n\n");
+      printf("Inserisci l'ID della persona da aggiornare: ");
+      size_t id = (size_t)getint();
+
+      printf("\n");
+
+      Person* person = findShardedPersonById(set, id);
+      if (person)
+      {
+        printf("Inserisci il nuovo nome della persona (vecchio: %s): ", person->name);
+        char* newName = getln();
+        printf("Inserisci la nuova et\u00e0 della persona (vecchio: %d): ", person->age);
+        int newAge = getValidAge();
+
+        Person updatedPerson = {id, newAge, newName};
+        updateShardedPerson(set, id, &updatedPerson);
+        free(newName);
+        freePerson(person);
+        free(person);
+
+        printf("\nPersona aggiornata con successo!\n");
+      }
+      else
+      {
+        printf("\nPersona non trovata.\n");
+      }
+
+      break;
+    }
+    case SHARD_FIND_BY_NAME_OPTION:
+    {
+      printf("Trova le persone per nome\n\n");
+      printf("Inserisci il nome della persona: ");
+      char* name = getln();
+      printf("\n");
+
+      size_t count;
+      Person* people = findShardedPeopleByName(set, name, &count);
+      if (people)
+      {
+        printPeople(people, count);
+        freePeople(people, count);
+        free(people);
+      }
+      else
+      {
+        printf("Nessuna persona trovata.\n");
+      }
+
+      free(name);
+      break;
+    }
+    case SHARD_AGGREGATE_OPTION:
+    {
+      printf("Statistiche sulle persone\n\n");
+      PersonAgeFilter filter;
+      printf("Inserisci l'et\u00e0 minima: ");
+      filter.minAge = getint();
+      printf("Inserisci l'et\u00e0 massima: ");
+      filter.maxAge = getint();
+      printf("\n");
+
+      PersonAggregate aggregate;
+      aggregateShardedPeople(set, &filter, &aggregate);
+      printPersonAggregate(&aggregate);
+
+      break;
+    }
+    case SHARD_SAVE_TO_NDJSON_OPTION:
+    {
+      printf("Inserisci il nome per il file NDJSON da salvare (non aggiungere l'estensione .ndjson): ");
+      char* filename = getln();
+      filename = (char*)realloc(filename, strlen(filename) + 8);
+      strcat(filename, ".ndjson");
+
+      if (shardedPeopleToNdjson(set, filename))
+      {
+        printf("\nFile NDJSON salvato!\n");
+      }
+      else
+      {
+        perror("\nErrore: Non riesce salvare il file NDJSON\n");
+      }
+
+      free(filename);
+      break;
+    }
+    case SHARD_INFO_OPTION:
+    {
+      printf("Informazioni sulle partizioni\n\n");
+      printf("Persone: %zu\n", set->meta.count);
+      printf("Prossimo ID: %zu\n\n", set->meta.autoIncrementId);
+      for (size_t i = 0; i < set->shardCount; i++)
+      {
+        const PersonShard* shard = &set->shards[i];
+        printf("%s: %zu persone\n", shard->filename, shard->meta.count);
+      }
+
+      break;
+    }
+    case SHARD_EXIT_OPTION:
+      printf("Arrivederci!\n");
+      break;
+    default:
+      printf("Opzione non valida. Riprova.\n");
+      break;
+    }
+
+    if (choice != SHARD_EXIT_OPTION)
+    {
+      printf("\n");
+      pause();
+    }
+  } while (choice != SHARD_EXIT_OPTION);
+
+  closePersonShards(set);
+  return 0;
 }
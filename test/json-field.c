@@ -0,0 +1,151 @@
+/**
+ * Test della ricerca dei campi negli oggetti JSON larghi.
+ *
+ * Un oggetto con molti campi viene letto sia come albero (getObjectField)
+ * sia con i cursori di JsonDocument (getJsonField), e ogni campo viene
+ * cercato per chiave, dall'ultimo al primo. Oltre ai valori trovati si
+ * controlla quanto cresce il tempo: con la scansione lineare di tutti i
+ * campi, un oggetto con FIELD_SCALE volte i campi richiede FIELD_SCALE²
+ * volte il tempo; con l'indice circa FIELD_SCALE volte.
+ *
+ * Compilazione ed esecuzione dalla radice del repository, in una cartella
+ * in cui si può scrivere:
+ *
+ *   g++ -Iapp test/json-field.c app/json-parser.c -o json-field -lm
+ *   ./json-field
+ */
+
+#include "json-parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_JSON_FILENAME "test-json-field.json"
+#define SMALL_FIELD_COUNT 2000
+#define FIELD_SCALE 8
+#define MAX_GROWTH (FIELD_SCALE * 3)
+
+double getSeconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+bool writeWideObject(size_t fieldCount)
+{
+  FILE* jsonFile = fopen(TEST_JSON_FILENAME, "w");
+  if (!jsonFile)
+    return false;
+  fprintf(jsonFile, "{");
+  for (size_t i = 0; i < fieldCount; i++)
+    fprintf(jsonFile, "%s\"k%zu\": %zu", i > 0 ? ", " : "", i, i);
+  fprintf(jsonFile, "}");
+  return fclose(jsonFile) == 0;
+}
+
+JsonKey* createFieldKeys(size_t fieldCount, char* names)
+{
+  JsonKey* keys = (JsonKey*)malloc(fieldCount * sizeof(JsonKey));
+  for (size_t i = 0; i < fieldCount; i++)
+  {
+    char* name = names + i * 16;
+    sprintf(name, "k%zu", i);
+    keys[i] = createJsonKey(name);
+  }
+  return keys;
+}
+
+// Looks every field up from the last to the first, returns the seconds taken or -1 on a wrong result
+double lookUpTreeFields(size_t fieldCount, const JsonKey* keys)
+{
+  FILE* jsonFile = fopen(TEST_JSON_FILENAME, "r");
+  LexError lexError;
+  ParserError parserError;
+  TokenManager* manager = lex(jsonFile, &lexError);
+  JsonNode* root = manager ? parse(jsonFile, manager, &parserError) : NULL;
+  if (!root)
+    return -1;
+
+  bool correct = true;
+  double start = getSeconds();
+  for (size_t i = fieldCount; correct && i-- > 0;)
+  {
+    JsonNode* field = getObjectField(root, &keys[i]);
+    correct = field != NULL && field->type == INTEGER_NODE && (size_t)field->value.v_int == i;
+  }
+  double elapsed = getSeconds() - start;
+
+  const JsonKey prefixKey = createJsonKey("k");
+  const JsonKey longerKey = createJsonKey("k1x");
+  correct = correct && getObjectField(root, &prefixKey) == NULL && getObjectField(root, &longerKey) == NULL;
+
+  freeJsonTree(root);
+  deleteTokenManager(manager);
+  fclose(jsonFile);
+  return correct ? elapsed : -1;
+}
+
+double lookUpDocumentFields(size_t fieldCount, const JsonKey* keys)
+{
+  FILE* jsonFile = fopen(TEST_JSON_FILENAME, "r");
+  JsonDocument* document = openJsonDocument(jsonFile);
+  JsonCursor root, field;
+  bool correct = getJsonRoot(document, &root);
+
+  double start = getSeconds();
+  for (size_t i = fieldCount; correct && i-- > 0;)
+  {
+    long long value;
+    correct = getJsonField(&root, &keys[i], &field) && getJsonCursorInteger(&field, &value) && (size_t)value == i;
+  }
+  double elapsed = getSeconds() - start;
+
+  const JsonKey prefixKey = createJsonKey("k");
+  const JsonKey longerKey = createJsonKey("k1x");
+  correct = correct && !getJsonField(&root, &prefixKey, &field) && !getJsonField(&root, &longerKey, &field);
+
+  closeJsonDocument(document);
+  fclose(jsonFile);
+  return correct ? elapsed : -1;
+}
+
+bool checkGrowth(const char* name, double (*lookUp)(size_t, const JsonKey*))
+{
+  double times[2];
+  for (size_t i = 0; i < 2; i++)
+  {
+    size_t fieldCount = SMALL_FIELD_COUNT * (i == 0 ? 1 : FIELD_SCALE);
+    char* names = (char*)malloc(fieldCount * 16);
+    JsonKey* keys = createFieldKeys(fieldCount, names);
+    times[i] = writeWideObject(fieldCount) ? lookUp(fieldCount, keys) : -1;
+    free(keys);
+    free(names);
+    if (times[i] < 0)
+    {
+      printf("ERRORE  %s: campo non trovato o sbagliato con %zu campi\n", name, fieldCount);
+      return false;
+    }
+  }
+
+  // Both sizes are timed on the same machine, so only their ratio matters
+  double growth = times[1] / (times[0] > 1e-6 ? times[0] : 1e-6);
+  bool success = growth < MAX_GROWTH;
+  printf("%s  %s: %.4f s con %d campi, %.4f s con %d campi (x%.1f, massimo x%d)\n", success ? "OK    " : "ERRORE", name,
+         times[0], SMALL_FIELD_COUNT, times[1], SMALL_FIELD_COUNT * FIELD_SCALE, growth, MAX_GROWTH);
+  return success;
+}
+
+int main()
+{
+  size_t failures = 0;
+  if (!checkGrowth("getObjectField", lookUpTreeFields))
+    failures++;
+  if (!checkGrowth("getJsonField", lookUpDocumentFields))
+    failures++;
+
+  remove(TEST_JSON_FILENAME);
+  printf("%zu test falliti\n", failures);
+  return failures == 0 ? 0 : 1;
+}
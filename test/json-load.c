@@ -0,0 +1,156 @@
+/**
+ * Test degli errori del caricamento JSON sequenziale e parallelo.
+ *
+ * Ogni documento viene caricato con loadPersonDbFromJsonStream e con
+ * loadPersonDbFromJsonParallel: i due caricamenti devono restituire lo
+ * stesso codice, e per i documenti non validi il codice non deve essere
+ * NO_PERSON_JSON_ERROR. I documenti più grandi di un blocco del caricamento
+ * parallelo controllano anche le virgole tra un blocco e l'altro.
+ *
+ * Compilazione ed esecuzione dalla radice del repository, in una cartella
+ * in cui si può scrivere:
+ *
+ *   g++ -Iapp test/json-load.c app/*.c -o json-load -lpthread
+ *   ./json-load
+ */
+
+#include "person.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_JSON_FILENAME "test-json-load.json"
+#define TEST_THREAD_COUNT 4
+
+#define METADATA "\"metadata\": {\"autoIncrementId\": 2, \"count\": 2}"
+#define PEOPLE "{\"id\": 0, \"age\": 30, \"name\": \"Ann\"}, {\"id\": 1, \"age\": 40, \"name\": \"Bob\"}"
+
+typedef struct JsonLoadCase
+{
+  const char* name;
+  const char* text;
+  PersonJsonError expected;
+} JsonLoadCase;
+
+const JsonLoadCase jsonLoadCases[] = {
+  {"valido", "{" METADATA ", \"people\": [" PEOPLE "]}", NO_PERSON_JSON_ERROR},
+  {"array vuoto", "{" METADATA ", \"people\": []}", NO_PERSON_JSON_ERROR},
+  {"campo dopo l'array senza virgola", "{" METADATA ", \"people\": [" PEOPLE "] \"junk\": 1}", INVALID_JSON_SYNTAX},
+  {"virgola finale nella radice", "{" METADATA ", \"people\": [" PEOPLE "],}", INVALID_JSON_SYNTAX},
+  {"testo dopo l'array", "{" METADATA ", \"people\": [" PEOPLE "], xyz}", INVALID_JSON_SYNTAX},
+  {"virgola iniziale nell'array", "{" METADATA ", \"people\": [, " PEOPLE "]}", INVALID_JSON_SYNTAX},
+  {"virgola finale nell'array", "{" METADATA ", \"people\": [" PEOPLE ",]}", INVALID_JSON_SYNTAX},
+  {"virgola mancante dopo i metadati", "{" METADATA " \"people\": [" PEOPLE "]}", INVALID_JSON_SYNTAX},
+  {"testo dopo la radice", "{" METADATA ", \"people\": [" PEOPLE "]} x", INVALID_JSON_SYNTAX},
+  {"due radici", "{" METADATA ", \"people\": []} {}", INVALID_JSON_SYNTAX},
+  {"valore non valido in un altro campo", "{\"x\": [1 2], " METADATA ", \"people\": [" PEOPLE "]}", INVALID_JSON_SYNTAX},
+  {"persona senza età", "{" METADATA ", \"people\": [{\"id\": 0, \"name\": \"Ann\"}]}", EXPECTED_PERSON_AGE},
+  {"metadati mancanti", "{\"people\": [" PEOPLE "]}", EXPECTED_METADATA_OBJECT},
+  {"array mancante", "{" METADATA "}", EXPECTED_PEOPLE_ARRAY},
+};
+
+typedef enum BoundaryMutation
+{
+  KEEP_SEPARATOR = 0,
+  DROP_SEPARATOR,
+  DOUBLE_SEPARATOR,
+  TRAILING_SEPARATOR
+} BoundaryMutation;
+
+const char* boundaryMutationNames[] = {"confine valido", "virgola mancante al confine", "virgola doppia al confine",
+                                       "virgola finale al confine"};
+
+bool writeTestJson(const char* text, size_t length)
+{
+  FILE* jsonFile = fopen(TEST_JSON_FILENAME, "wb");
+  if (!jsonFile)
+    return false;
+  bool success = fwrite(text, sizeof(char), length, jsonFile) == length;
+  return fclose(jsonFile) == 0 && success;
+}
+
+// Loads the test file with both loaders, true if they agree on the expected code
+bool checkJsonLoad(const char* name, PersonJsonError expected)
+{
+  PersonMeta meta;
+  FILE* fp = initPersonDB(&meta);
+  FILE* jsonFile = fopen(TEST_JSON_FILENAME, "rb");
+  if (!fp || !jsonFile)
+  {
+    printf("ERRORE  %s: file non apribili\n", name);
+    return false;
+  }
+
+  PersonJsonError sequential = loadPersonDbFromJsonStream(&fp, &meta, jsonFile, NULL);
+  PersonJsonError parallel = loadPersonDbFromJsonParallel(&fp, &meta, jsonFile, TEST_THREAD_COUNT, NULL);
+  fclose(jsonFile);
+  fclose(fp);
+
+  bool success = sequential == expected && parallel == expected;
+  printf("%s  %s: sequenziale %d, parallelo %d, atteso %d\n", success ? "OK    " : "ERRORE", name, sequential, parallel,
+         expected);
+  return success;
+}
+
+// Builds a people array longer than one parallel chunk and changes the separator that follows
+// the first chunk
+bool checkBoundary(BoundaryMutation mutation)
+{
+  const char* head = "{" METADATA ", \"people\": [";
+  const char* person = "{\"id\": 0, \"age\": 30, \"name\": \"Ann\"}";
+  size_t headLength = strlen(head);
+  size_t personLength = strlen(person);
+
+  // The first chunk ends with the first person that takes it to PERSON_IMPORT_CHUNK_SIZE bytes,
+  // counting the opening bracket added to every chunk
+  size_t chunkPeople = 1;
+  while (1 + chunkPeople * (personLength + 1) - 1 < PERSON_IMPORT_CHUNK_SIZE)
+    chunkPeople++;
+  size_t peopleCount = chunkPeople * 2;
+
+  Buffer text;
+  initBuffer(&text, headLength + peopleCount * (personLength + 2) + 16);
+  appendBuffer(&text, head, headLength);
+  for (size_t i = 0; i < peopleCount; i++)
+  {
+    if (i > 0 && (i != chunkPeople || mutation != DROP_SEPARATOR))
+      appendBuffer(&text, ",", 1);
+    if (i == chunkPeople && mutation == DOUBLE_SEPARATOR)
+      appendBuffer(&text, ",", 1);
+    appendBuffer(&text, person, personLength);
+    if (i + 1 == chunkPeople && mutation == TRAILING_SEPARATOR)
+      break;
+  }
+  if (mutation == TRAILING_SEPARATOR)
+    appendBuffer(&text, ",", 1);
+  appendBuffer(&text, "]}", 2);
+
+  bool success = writeTestJson(text.data, text.size) &&
+                 checkJsonLoad(boundaryMutationNames[mutation],
+                               mutation == KEEP_SEPARATOR ? NO_PERSON_JSON_ERROR : INVALID_JSON_SYNTAX);
+  freeBuffer(&text);
+  return success;
+}
+
+int main()
+{
+  if (!setPersonDbFilename("test-json-load.db"))
+    return 1;
+
+  size_t failures = 0;
+  for (size_t i = 0; i < sizeof(jsonLoadCases) / sizeof(jsonLoadCases[0]); i++)
+  {
+    const JsonLoadCase* test = &jsonLoadCases[i];
+    if (!writeTestJson(test->text, strlen(test->text)) || !checkJsonLoad(test->name, test->expected))
+      failures++;
+  }
+
+  for (int mutation = KEEP_SEPARATOR; mutation <= TRAILING_SEPARATOR; mutation++)
+    if (!checkBoundary((BoundaryMutation)mutation))
+      failures++;
+
+  remove(TEST_JSON_FILENAME);
+  remove(getPersonDbFilename());
+  printf("%zu test falliti\n", failures);
+  return failures == 0 ? 0 : 1;
+}
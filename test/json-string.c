@@ -0,0 +1,135 @@
+/**
+ * Test delle sequenze \u nelle stringhe JSON.
+ *
+ * Ogni stringa viene letta in tre modi: come albero (parse), in streaming
+ * (parseJsonBufferStream) e con i cursori di JsonDocument. Le tre letture
+ * devono dare gli stessi byte UTF-8: le coppie di surrogati diventano un
+ * solo carattere, i surrogati senza coppia diventano U+FFFD.
+ *
+ * Compilazione ed esecuzione dalla radice del repository, in una cartella
+ * in cui si può scrivere:
+ *
+ *   g++ -Iapp test/json-string.c app/json-parser.c -o json-string -lm
+ *   ./json-string
+ */
+
+#include "json-parser.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_JSON_FILENAME "test-json-string.json"
+#define REPLACEMENT "\xEF\xBF\xBD"
+
+typedef struct JsonStringCase
+{
+  const char* name;
+  const char* json;
+  const char* expected;
+} JsonStringCase;
+
+const JsonStringCase jsonStringCases[] = {
+  {"carattere a due byte", "\"\\u00e8\"", "\xC3\xA8"},
+  {"carattere a tre byte", "\"\\u20AC\"", "\xE2\x82\xAC"},
+  {"coppia di surrogati", "\"\\uD83D\\uDE00\"", "\xF0\x9F\x98\x80"},
+  {"surrogato alto alla fine", "\"a\\uD83D\"", "a" REPLACEMENT},
+  {"surrogato alto seguito da testo", "\"\\uD83Dx\"", REPLACEMENT "x"},
+  {"surrogato alto seguito da un'altra sequenza", "\"\\uD83D\\n\"", REPLACEMENT "\n"},
+  {"surrogato alto seguito da un carattere", "\"\\uD83D\\u0041\"", REPLACEMENT "A"},
+  {"due surrogati alti", "\"\\uD83D\\uD83D\\uDE00\"", REPLACEMENT "\xF0\x9F\x98\x80"},
+  {"surrogato basso da solo", "\"\\uDE00b\"", REPLACEMENT "b"},
+  {"surrogati invertiti", "\"\\uDE00\\uD83D\"", REPLACEMENT REPLACEMENT},
+};
+
+typedef struct StreamString
+{
+  char* value;
+} StreamString;
+
+bool onStreamString(void* userData, const char* str, size_t length)
+{
+  StreamString* result = (StreamString*)userData;
+  result->value = (char*)malloc(length + 1);
+  memcpy(result->value, str, length);
+  result->value[length] = '\0';
+  return true;
+}
+
+char* readTreeString()
+{
+  FILE* jsonFile = fopen(TEST_JSON_FILENAME, "r");
+  LexError lexError;
+  ParserError parserError;
+  TokenManager* manager = lex(jsonFile, &lexError);
+  JsonNode* root = manager ? parse(jsonFile, manager, &parserError) : NULL;
+  char* value = NULL;
+  if (root && root->type == STRING_NODE)
+  {
+    value = root->value.v_string;
+    root->value.v_string = NULL;
+  }
+  if (root)
+    freeJsonTree(root);
+  if (manager)
+    deleteTokenManager(manager);
+  fclose(jsonFile);
+  return value;
+}
+
+char* readStreamedString(const char* json)
+{
+  JsonStreamHandler handler;
+  memset(&handler, 0, sizeof(JsonStreamHandler));
+  handler.onString = onStreamString;
+  StreamString result = {NULL};
+  if (!parseJsonBufferStream(json, strlen(json), &handler, &result, NULL))
+  {
+    free(result.value);
+    return NULL;
+  }
+  return result.value;
+}
+
+char* readDocumentString()
+{
+  FILE* jsonFile = fopen(TEST_JSON_FILENAME, "r");
+  JsonDocument* document = openJsonDocument(jsonFile);
+  JsonCursor root;
+  char* value = getJsonRoot(document, &root) ? getJsonCursorString(&root) : NULL;
+  closeJsonDocument(document);
+  fclose(jsonFile);
+  return value;
+}
+
+bool checkString(const char* reader, const JsonStringCase* test, char* value)
+{
+  bool success = value != NULL && strcmp(value, test->expected) == 0;
+  if (!success)
+    printf("ERRORE  %s (%s): risultato diverso da quello atteso\n", test->name, reader);
+  free(value);
+  return success;
+}
+
+int main()
+{
+  size_t failures = 0;
+  for (size_t i = 0; i < sizeof(jsonStringCases) / sizeof(jsonStringCases[0]); i++)
+  {
+    const JsonStringCase* test = &jsonStringCases[i];
+    FILE* jsonFile = fopen(TEST_JSON_FILENAME, "w");
+    if (!jsonFile || fputs(test->json, jsonFile) == EOF || fclose(jsonFile) != 0)
+      return 1;
+
+    bool success = checkString("albero", test, readTreeString());
+    success = checkString("streaming", test, readStreamedString(test->json)) && success;
+    success = checkString("documento", test, readDocumentString()) && success;
+    if (success)
+      printf("OK      %s\n", test->name);
+    else
+      failures++;
+  }
+
+  remove(TEST_JSON_FILENAME);
+  printf("%zu test falliti\n", failures);
+  return failures == 0 ? 0 : 1;
+}